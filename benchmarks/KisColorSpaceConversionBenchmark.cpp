@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisColorSpaceConversionBenchmark.h"
+
+#include <QThread>
+
+#include <KoColorSpace.h>
+#include <KoColorSpaceRegistry.h>
+
+#include <kis_image.h>
+#include <kis_paint_layer.h>
+#include <kis_paint_device.h>
+#include <kis_sequential_iterator.h>
+
+namespace {
+
+const int IMAGE_SIZE = 4096;
+const int NUM_LAYERS = 4;
+
+const KoColorSpace* dstColorSpaceById(const QString &id)
+{
+    return id == "lab16" ?
+        KoColorSpaceRegistry::instance()->lab16() :
+        KoColorSpaceRegistry::instance()->rgb16();
+}
+
+void fillWithNoise(KisPaintDeviceSP dev, const QRect &rc, quint32 seed)
+{
+    quint32 state = seed * 2654435761U + 1;
+
+    KisSequentialIterator it(dev, rc);
+    while (it.nextPixel()) {
+        // cheap LCG, we don't want the random source to be measured
+        state = state * 1664525U + 1013904223U;
+
+        quint8 *pixel = it.rawData();
+        pixel[0] = state >> 24;
+        pixel[1] = state >> 16;
+        pixel[2] = state >> 8;
+        pixel[3] = 0xff;
+    }
+}
+
+KisImageSP createImage(int numThreads)
+{
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, IMAGE_SIZE, IMAGE_SIZE, cs, "color space conversion benchmark");
+    image->setWorkingThreadsLimit(numThreads);
+
+    for (int i = 0; i < NUM_LAYERS; i++) {
+        KisPaintLayerSP layer = new KisPaintLayer(image, QString("layer %1").arg(i), OPACITY_OPAQUE_U8, cs);
+        fillWithNoise(layer->paintDevice(), image->bounds(), i);
+        image->addNode(layer, image->root());
+    }
+
+    image->initialRefreshGraph();
+
+    return image;
+}
+
+void addConversionRows()
+{
+    QTest::addColumn<int>("numThreads");
+    QTest::addColumn<QString>("dstColorSpace");
+
+    const int maxThreads = QThread::idealThreadCount();
+
+    for (const QString &dstColorSpace : {QString("rgb16"), QString("lab16")}) {
+        for (int numThreads : {1, 2, 4, 8, 16}) {
+            if (numThreads > maxThreads) break;
+            QTest::addRow("rgb8-to-%s-%d-threads", qPrintable(dstColorSpace), numThreads)
+                << numThreads << dstColorSpace;
+        }
+    }
+}
+
+}
+
+void KisColorSpaceConversionBenchmark::benchmarkSequentialConversion_data()
+{
+    QTest::addColumn<QString>("dstColorSpace");
+
+    QTest::addRow("rgb8-to-rgb16") << QString("rgb16");
+    QTest::addRow("rgb8-to-lab16") << QString("lab16");
+}
+
+void KisColorSpaceConversionBenchmark::benchmarkSequentialConversion()
+{
+    QFETCH(QString, dstColorSpace);
+
+    const KoColorSpace *dstCs = dstColorSpaceById(dstColorSpace);
+    KisImageSP image = createImage(1);
+
+    QBENCHMARK_ONCE {
+        KisNodeSP node = image->root()->firstChild();
+        while (node) {
+            node->paintDevice()->convertTo(dstCs);
+            node = node->nextSibling();
+        }
+    }
+}
+
+void KisColorSpaceConversionBenchmark::benchmarkImageConversion_data()
+{
+    addConversionRows();
+}
+
+void KisColorSpaceConversionBenchmark::benchmarkImageConversion()
+{
+    QFETCH(int, numThreads);
+    QFETCH(QString, dstColorSpace);
+
+    const KoColorSpace *dstCs = dstColorSpaceById(dstColorSpace);
+    KisImageSP image = createImage(numThreads);
+
+    QBENCHMARK_ONCE {
+        image->convertImageColorSpace(dstCs,
+                                      KoColorConversionTransformation::internalRenderingIntent(),
+                                      KoColorConversionTransformation::internalConversionFlags());
+        image->waitForDone();
+    }
+
+    QVERIFY(*image->colorSpace() == *dstCs);
+}
+
+QTEST_MAIN(KisColorSpaceConversionBenchmark)
@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisTileCompressionBenchmark.h"
+
+#include <QTest>
+
+#include <KisDocument.h>
+#include <KisPart.h>
+#include <kis_image.h>
+#include <kis_group_layer.h>
+#include <kis_paint_device.h>
+#include <kis_layer_utils.h>
+
+#include "tiles3/kis_tiled_data_manager.h"
+#include "tiles3/swap/kis_tile_compressor_2.h"
+
+namespace {
+KisDocument *s_document = 0;
+QVector<KisTileSP> s_tiles;
+
+void addColumns()
+{
+    QTest::addColumn<QString>("compressionName");
+    QTest::addColumn<int>("compressionLevel");
+
+    Q_FOREACH (const QString &name, KisTileCompressor2::availableCompressions()) {
+        if (name == "ZSTD") {
+            QTest::newRow("ZSTD-1") << name << 1;
+            QTest::newRow("ZSTD-3") << name << 3;
+            QTest::newRow("ZSTD-9") << name << 9;
+        } else {
+            QTest::newRow(name.toLatin1()) << name << -1;
+        }
+    }
+}
+
+void collectTiles(KisPaintDeviceSP dev)
+{
+    if (!dev) return;
+
+    KisDataManagerSP dm = dev->dataManager();
+    const QRect rc = dev->extent();
+
+    for (int y = rc.y(); y <= rc.bottom(); y += KisTileData::HEIGHT) {
+        for (int x = rc.x(); x <= rc.right(); x += KisTileData::WIDTH) {
+            s_tiles << dm->getTile(dm->xToCol(x), dm->yToRow(y), false);
+        }
+    }
+}
+}
+
+void KisTileCompressionBenchmark::initTestCase()
+{
+    s_document = KisPart::instance()->createDocument();
+    s_document->loadNativeFormat(QString(FILES_DATA_DIR) + '/' + "load_test.kra");
+
+    KisImageSP image = s_document->image();
+    QVERIFY(image);
+    image->refreshGraph();
+    image->waitForDone();
+
+    KisLayerUtils::recursiveApplyNodes(image->root(),
+        [] (KisNodeSP node) {
+            collectTiles(node->paintDevice());
+            collectTiles(node->original());
+            collectTiles(node->projection());
+        });
+
+    qDebug() << "Collected" << s_tiles.size() << "tiles";
+    QVERIFY(!s_tiles.isEmpty());
+}
+
+void KisTileCompressionBenchmark::cleanupTestCase()
+{
+    s_tiles.clear();
+    delete s_document;
+    s_document = 0;
+}
+
+void KisTileCompressionBenchmark::benchmarkCompression_data()
+{
+    addColumns();
+}
+
+void KisTileCompressionBenchmark::benchmarkCompression()
+{
+    QFETCH(QString, compressionName);
+    QFETCH(int, compressionLevel);
+
+    KisTileCompressor2 compressor(compressionName, compressionLevel);
+    QByteArray buffer;
+
+    qint64 uncompressedSize = 0;
+    qint64 compressedSize = 0;
+
+    QBENCHMARK {
+        uncompressedSize = 0;
+        compressedSize = 0;
+
+        Q_FOREACH (KisTileSP tile, s_tiles) {
+            KisTileData *td = tile->tileData();
+
+            const qint32 bufferSize = compressor.tileDataBufferSize(td);
+            if (buffer.size() < bufferSize) {
+                buffer.resize(bufferSize);
+            }
+
+            qint32 bytesWritten = 0;
+            tile->lockForRead();
+            compressor.compressTileData(td, (quint8*)buffer.data(), buffer.size(), bytesWritten);
+            tile->unlockForRead();
+
+            uncompressedSize += td->pixelSize() * KisTileData::WIDTH * KisTileData::HEIGHT;
+            compressedSize += bytesWritten;
+        }
+    }
+
+    qDebug() << compressionName << compressionLevel
+             << "compressed" << uncompressedSize << "->" << compressedSize
+             << "ratio:" << qreal(compressedSize) / uncompressedSize;
+}
+
+void KisTileCompressionBenchmark::benchmarkDecompression_data()
+{
+    addColumns();
+}
+
+void KisTileCompressionBenchmark::benchmarkDecompression()
+{
+    QFETCH(QString, compressionName);
+    QFETCH(int, compressionLevel);
+
+    KisTileCompressor2 compressor(compressionName, compressionLevel);
+
+    QVector<QByteArray> compressedTiles;
+
+    Q_FOREACH (KisTileSP tile, s_tiles) {
+        KisTileData *td = tile->tileData();
+
+        QByteArray buffer(compressor.tileDataBufferSize(td), 0);
+        qint32 bytesWritten = 0;
+
+        tile->lockForRead();
+        compressor.compressTileData(td, (quint8*)buffer.data(), buffer.size(), bytesWritten);
+        tile->unlockForRead();
+
+        buffer.resize(bytesWritten);
+        compressedTiles << buffer;
+    }
+
+    /**
+     * Decompress into scratch tiles, so that the document
+     * itself is never touched
+     */
+    QMap<qint32, KisTiledDataManagerSP> scratchManagers;
+    QMap<qint32, KisTileSP> scratchTiles;
+
+    QBENCHMARK {
+        for (int i = 0; i < s_tiles.size(); i++) {
+            const qint32 pixelSize = s_tiles[i]->pixelSize();
+
+            KisTileSP scratch = scratchTiles.value(pixelSize);
+            if (!scratch) {
+                QByteArray defaultPixel(pixelSize, 0);
+                KisTiledDataManagerSP dm =
+                    new KisTiledDataManager(pixelSize, (const quint8*)defaultPixel.constData());
+                scratch = dm->getTile(0, 0, true);
+
+                scratchManagers.insert(pixelSize, dm);
+                scratchTiles.insert(pixelSize, scratch);
+            }
+
+            scratch->lockForWrite();
+            QVERIFY(compressor.decompressTileData((quint8*)compressedTiles[i].data(),
+                                                  compressedTiles[i].size(),
+                                                  scratch->tileData()));
+            scratch->unlockForWrite();
+        }
+    }
+
+    scratchTiles.clear();
+    scratchManagers.clear();
+}
+
+QTEST_MAIN(KisTileCompressionBenchmark)
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTileDataAllocatorBenchmark.h"
+
+#include <QThread>
+
+#include "tiles3/KisTileDataAllocator.h"
+#include "tiles3/kis_tile_data.h"
+
+namespace {
+
+const int NUM_CYCLES = 20000;
+const int NUM_TILES_PER_THREAD = 32;
+
+class AllocatingThread : public QThread
+{
+public:
+    AllocatingThread(qint32 pixelSize, bool useSystemMalloc)
+        : m_pixelSize(pixelSize),
+          m_useSystemMalloc(useSystemMalloc)
+    {
+    }
+
+    void run() override {
+        KisTileDataAllocator *allocator = KisTileDataAllocator::instance();
+        const int tileSize = m_pixelSize * KisTileData::WIDTH * KisTileData::HEIGHT;
+
+        quint8 *tiles[NUM_TILES_PER_THREAD];
+
+        for (int i = 0; i < NUM_CYCLES; i++) {
+            /**
+             * Allocate a bunch of tiles, touch them and free them in
+             * the same order, which is a typical pattern for
+             * a stroke creating temporary tiles
+             */
+            for (int j = 0; j < NUM_TILES_PER_THREAD; j++) {
+                tiles[j] = m_useSystemMalloc ?
+                    static_cast<quint8*>(malloc(tileSize)) :
+                    allocator->allocate(m_pixelSize);
+
+                tiles[j][0] = j;
+            }
+
+            for (int j = 0; j < NUM_TILES_PER_THREAD; j++) {
+                if (m_useSystemMalloc) {
+                    free(tiles[j]);
+                } else {
+                    allocator->deallocate(tiles[j], m_pixelSize);
+                }
+            }
+        }
+    }
+
+private:
+    qint32 m_pixelSize;
+    bool m_useSystemMalloc;
+};
+
+}
+
+void KisTileDataAllocatorBenchmark::benchmarkContention_data()
+{
+    QTest::addColumn<int>("numThreads");
+    QTest::addColumn<int>("pixelSize");
+    QTest::addColumn<bool>("useSystemMalloc");
+
+    for (int numThreads : {1, 16, 32}) {
+        for (int pixelSize : {4, 8, 16, 20}) {
+            QTest::addRow("malloc-%d-threads-%dbpp", numThreads, pixelSize)
+                << numThreads << pixelSize << true;
+            QTest::addRow("allocator-%d-threads-%dbpp", numThreads, pixelSize)
+                << numThreads << pixelSize << false;
+        }
+    }
+}
+
+void KisTileDataAllocatorBenchmark::benchmarkContention()
+{
+    QFETCH(int, numThreads);
+    QFETCH(int, pixelSize);
+    QFETCH(bool, useSystemMalloc);
+
+    QBENCHMARK {
+        QVector<AllocatingThread*> threads;
+
+        for (int i = 0; i < numThreads; i++) {
+            threads << new AllocatingThread(pixelSize, useSystemMalloc);
+        }
+
+        Q_FOREACH (AllocatingThread *thread, threads) {
+            thread->start();
+        }
+
+        Q_FOREACH (AllocatingThread *thread, threads) {
+            thread->wait();
+        }
+
+        qDeleteAll(threads);
+    }
+}
+
+QTEST_MAIN(KisTileDataAllocatorBenchmark)
@@ -0,0 +1,38 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __KIS_TILE_DATA_ALLOCATOR_BENCHMARK_H
+#define __KIS_TILE_DATA_ALLOCATOR_BENCHMARK_H
+
+#include <QtTest>
+
+/**
+ * Measures contention in the tile data allocator: many threads
+ * allocate and free tiles of the same pixel size at the same time.
+ * The system malloc() is measured as a reference.
+ */
+class KisTileDataAllocatorBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void benchmarkContention_data();
+    void benchmarkContention();
+};
+
+#endif /* __KIS_TILE_DATA_ALLOCATOR_BENCHMARK_H */
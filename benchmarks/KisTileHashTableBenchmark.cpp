@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include "KisTileHashTableBenchmark.h"
+
+#include <QThread>
+
+#include <KoColor.h>
+#include <KoColorSpaceRegistry.h>
+#include <kis_paint_device.h>
+
+#include "tiles3/kis_tiled_data_manager.h"
+#include "tiles3/KisTileHashTableDispatcher.h"
+
+namespace {
+
+const int NUM_LOOKUPS = 1 << 22;
+const int DEVICE_SIZE_IN_TILES = 64;
+
+class LookupThread : public QThread
+{
+public:
+    LookupThread(KisDataManagerSP dm, int seed, int numLookups)
+        : m_dm(dm),
+          m_seed(seed),
+          m_numLookups(numLookups)
+    {
+    }
+
+    void run() override {
+        quint32 state = m_seed * 2654435761U + 1;
+
+        for (int i = 0; i < m_numLookups; i++) {
+            // cheap LCG, we don't want the random source to be measured
+            state = state * 1664525U + 1013904223U;
+
+            /**
+             * Every fourth lookup goes slightly outside the device,
+             * so that the default-tile path is exercised as well
+             */
+            const int range = (i & 0x3) ? DEVICE_SIZE_IN_TILES : DEVICE_SIZE_IN_TILES + 8;
+            const int col = (state >> 8) % range;
+            const int row = (state >> 20) % range;
+
+            if (i & 0x1) {
+                KisTileSP tile = m_dm->getTile(col, row, false);
+                Q_UNUSED(tile);
+            } else {
+                bool existingTile = false;
+                KisTileSP tile = m_dm->getReadOnlyTileLazy(col, row, existingTile);
+                Q_UNUSED(tile);
+            }
+        }
+    }
+
+private:
+    KisDataManagerSP m_dm;
+    int m_seed;
+    int m_numLookups;
+};
+
+}
+
+void KisTileHashTableBenchmark::benchmarkConcurrentLookup_data()
+{
+    QTest::addColumn<int>("numThreads");
+    QTest::addColumn<bool>("useLockFree");
+
+    for (int numThreads : {1, 2, 4, 8, 16, 32, 64}) {
+        QTest::addRow("lock-free-%d-threads", numThreads) << numThreads << true;
+        QTest::addRow("blocking-%d-threads", numThreads) << numThreads << false;
+    }
+}
+
+void KisTileHashTableBenchmark::benchmarkConcurrentLookup()
+{
+    QFETCH(int, numThreads);
+    QFETCH(bool, useLockFree);
+
+    const bool oldValue = KisTileHashTableImplementation::useLockFreeTable();
+    KisTileHashTableImplementation::setUseLockFreeTable(useLockFree);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisPaintDeviceSP dev = new KisPaintDevice(cs);
+
+    const int deviceSize = DEVICE_SIZE_IN_TILES * KisTileData::WIDTH;
+    dev->fill(QRect(0, 0, deviceSize, deviceSize), KoColor(Qt::red, cs));
+
+    KisDataManagerSP dm = dev->dataManager();
+
+    QBENCHMARK {
+        QVector<LookupThread*> threads;
+
+        for (int i = 0; i < numThreads; i++) {
+            threads << new LookupThread(dm, i, NUM_LOOKUPS / numThreads);
+        }
+
+        Q_FOREACH (LookupThread *thread, threads) {
+            thread->start();
+        }
+
+        Q_FOREACH (LookupThread *thread, threads) {
+            thread->wait();
+        }
+
+        qDeleteAll(threads);
+    }
+
+    KisTileHashTableImplementation::setUseLockFreeTable(oldValue);
+}
+
+QTEST_MAIN(KisTileHashTableBenchmark)
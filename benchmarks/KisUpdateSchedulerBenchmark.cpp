@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+
+
+#include "KisUpdateSchedulerBenchmark.h"
+
+#include <KoColor.h>
+#include <KoColorSpaceRegistry.h>
+
+#include <kis_image.h>
+#include <kis_paint_layer.h>
+#include <kis_paint_device.h>
+#include <KisRunnableBasedStrokeStrategy.h>
+#include <KisRunnableStrokeJobData.h>
+#include <KisRunnableStrokeJobUtils.h>
+
+namespace {
+
+const int NUM_STROKE_JOBS = 100000;
+const int IMAGE_SIZE = 4096;
+const int UPDATE_SIZE = 64;
+
+void addThreadCountRows()
+{
+    QTest::addColumn<int>("numThreads");
+    QTest::addColumn<int>("barrierPeriod");
+
+    for (int numThreads : {1, 2, 4, 8, 16, 32, 64}) {
+        QTest::addRow("concurrent-%d-threads", numThreads) << numThreads << 0;
+        QTest::addRow("barriers-%d-threads", numThreads) << numThreads << 64;
+    }
+}
+
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkStrokeJobs_data()
+{
+    addThreadCountRows();
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkStrokeJobs()
+{
+    QFETCH(int, numThreads);
+    QFETCH(int, barrierPeriod);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, IMAGE_SIZE, IMAGE_SIZE, cs, "stroke jobs benchmark");
+    image->setWorkingThreadsLimit(numThreads);
+
+    QAtomicInt counter;
+
+    QBENCHMARK {
+        KisStrokeId id = image->startStroke(new KisRunnableBasedStrokeStrategy(QLatin1String("benchmark-stroke")));
+
+        for (int i = 0; i < NUM_STROKE_JOBS; i++) {
+            const bool isBarrier = barrierPeriod > 0 && i % barrierPeriod == 0;
+
+            image->addJob(id,
+                new KisRunnableStrokeJobData(
+                    [&counter] () { counter.ref(); },
+                    isBarrier ? KisStrokeJobData::BARRIER : KisStrokeJobData::CONCURRENT));
+        }
+
+        image->endStroke(id);
+        image->waitForDone();
+    }
+
+    QVERIFY(counter.load() > 0);
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkStrokeJobsParallelFor_data()
+{
+    addThreadCountRows();
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkStrokeJobsParallelFor()
+{
+    QFETCH(int, numThreads);
+    QFETCH(int, barrierPeriod);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, IMAGE_SIZE, IMAGE_SIZE, cs, "stroke jobs benchmark");
+    image->setWorkingThreadsLimit(numThreads);
+
+    const int batchSize = barrierPeriod > 0 ? barrierPeriod : NUM_STROKE_JOBS;
+    const QVector<int> batch(batchSize, 0);
+
+    QAtomicInt counter;
+
+    QBENCHMARK {
+        KisStrokeId id = image->startStroke(new KisRunnableBasedStrokeStrategy(QLatin1String("benchmark-stroke")));
+
+        QVector<KisRunnableStrokeJobData*> jobs;
+
+        for (int i = 0; i < NUM_STROKE_JOBS; i += batchSize) {
+            if (barrierPeriod > 0) {
+                KritaUtils::addJobBarrier(jobs, [&counter] () { counter.ref(); });
+            }
+
+            KritaUtils::addJobsParallelFor(jobs, batch, numThreads,
+                                           [&counter] (int) { counter.ref(); });
+        }
+
+        Q_FOREACH (KisRunnableStrokeJobData *job, jobs) {
+            image->addJob(id, job);
+        }
+
+        image->endStroke(id);
+        image->waitForDone();
+    }
+
+    QVERIFY(counter.load() > 0);
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkMergeJobs_data()
+{
+    addThreadCountRows();
+}
+
+void KisUpdateSchedulerBenchmark::benchmarkMergeJobs()
+{
+    QFETCH(int, numThreads);
+    QFETCH(int, barrierPeriod);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, IMAGE_SIZE, IMAGE_SIZE, cs, "merge jobs benchmark");
+    image->setWorkingThreadsLimit(numThreads);
+
+    KisPaintLayerSP layer = new KisPaintLayer(image, "layer", OPACITY_OPAQUE_U8);
+    layer->paintDevice()->fill(image->bounds(), KoColor(Qt::red, cs));
+
+    image->addNode(layer);
+    image->initialRefreshGraph();
+
+    QBENCHMARK {
+        for (int y = 0; y < IMAGE_SIZE; y += UPDATE_SIZE) {
+            for (int x = 0; x < IMAGE_SIZE; x += UPDATE_SIZE) {
+                layer->setDirty(QRect(x, y, UPDATE_SIZE, UPDATE_SIZE));
+
+                if (barrierPeriod > 0 && (x / UPDATE_SIZE) % barrierPeriod == 0) {
+                    image->waitForDone();
+                }
+            }
+        }
+
+        image->waitForDone();
+    }
+}
+
+QTEST_MAIN(KisUpdateSchedulerBenchmark)
@@ -27,6 +27,8 @@
 #include <KisDocument.h>
 #include <kis_image.h>
 #include <KisPart.h>
+#include <kis_image_config.h>
+#include <KisImageConfigNotifier.h>
 
 void KisProjectionBenchmark::initTestCase()
 {
@@ -58,5 +60,45 @@ void KisProjectionBenchmark::benchmarkLoading()
     }
 }
 
+void KisProjectionBenchmark::benchmarkUpdatePatches_data()
+{
+    QTest::addColumn<bool>("adaptive");
+
+    QTest::newRow("fixed") << false;
+    QTest::newRow("adaptive") << true;
+}
+
+/**
+ * Compares the fixed-size update patches of KisSimpleUpdateQueue
+ * against the ones sized by the measured merging cost
+ */
+void KisProjectionBenchmark::benchmarkUpdatePatches()
+{
+    QFETCH(bool, adaptive);
+
+    KisImageConfig cfg(false);
+    const bool oldAdaptive = cfg.adaptiveUpdatePatchSize();
+    cfg.setAdaptiveUpdatePatchSize(adaptive);
+    KisImageConfigNotifier::instance()->notifyConfigChanged();
+
+    KisDocument *doc = KisPart::instance()->createDocument();
+    doc->loadNativeFormat(QString(FILES_DATA_DIR) + '/' + "load_test.kra");
+    KisImageSP image = doc->image();
+    image->waitForDone();
+
+    // warm up the cost estimator
+    image->refreshGraphAsync();
+    image->waitForDone();
+
+    QBENCHMARK {
+        image->refreshGraphAsync();
+        image->waitForDone();
+    }
+
+    delete doc;
+
+    cfg.setAdaptiveUpdatePatchSize(oldAdaptive);
+    KisImageConfigNotifier::instance()->notifyConfigChanged();
+}
 
 QTEST_MAIN(KisProjectionBenchmark)
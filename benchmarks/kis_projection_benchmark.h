@@ -32,6 +32,9 @@ private Q_SLOTS:
 
     void benchmarkProjection();
     void benchmarkLoading();
+
+    void benchmarkUpdatePatches_data();
+    void benchmarkUpdatePatches();
 };
 
 #endif
@@ -0,0 +1,7 @@
+/* config-tiles-compression.h.  Generated by cmake from config-tiles-compression.h.cmake */
+
+/* Define if you have LZ4, the fast compression library */
+#cmakedefine HAVE_LZ4 1
+
+/* Define if you have Zstandard, the high-ratio compression library */
+#cmakedefine HAVE_ZSTD 1
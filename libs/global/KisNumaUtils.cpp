@@ -0,0 +1,209 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisNumaUtils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QGlobalStatic>
+#include <QRegularExpression>
+#include <QStringList>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+struct Topology
+{
+    Topology();
+
+    QVector<QVector<int>> nodeCpus;
+    QVector<int> cpuNodes;
+};
+
+QVector<int> parseCpuList(const QString &list)
+{
+    QVector<int> cpus;
+
+    Q_FOREACH (const QString &range, list.trimmed().split(',', QString::SkipEmptyParts)) {
+        const QStringList bounds = range.split('-');
+        bool ok1 = false;
+        bool ok2 = false;
+
+        const int first = bounds.first().toInt(&ok1);
+        const int last = bounds.last().toInt(&ok2);
+        if (!ok1 || !ok2) continue;
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus << cpu;
+        }
+    }
+
+    return cpus;
+}
+
+Topology::Topology()
+{
+#ifdef Q_OS_LINUX
+    QDir nodesDir("/sys/devices/system/node");
+    const QStringList nodeDirs =
+        nodesDir.entryList(QStringList() << "node*", QDir::Dirs, QDir::Name);
+
+    QRegularExpression nodeRe("^node(\\d+)$");
+
+    Q_FOREACH (const QString &dir, nodeDirs) {
+        QRegularExpressionMatch match = nodeRe.match(dir);
+        if (!match.hasMatch()) continue;
+
+        QFile cpuListFile(nodesDir.filePath(dir + "/cpulist"));
+        if (!cpuListFile.open(QIODevice::ReadOnly)) continue;
+
+        const QVector<int> cpus = parseCpuList(QString::fromLatin1(cpuListFile.readAll()));
+
+        // memory-only nodes are of no interest for us
+        if (cpus.isEmpty()) continue;
+
+        const int node = nodeCpus.size();
+        nodeCpus << cpus;
+
+        Q_FOREACH (int cpu, cpus) {
+            if (cpu >= cpuNodes.size()) {
+                cpuNodes.resize(cpu + 1);
+            }
+            cpuNodes[cpu] = node;
+        }
+    }
+#endif
+
+    if (nodeCpus.isEmpty()) {
+        nodeCpus.resize(1);
+    }
+}
+
+Q_GLOBAL_STATIC(Topology, s_topology)
+
+}
+
+namespace KisNumaUtils {
+
+int numNodes()
+{
+    return s_topology->nodeCpus.size();
+}
+
+int currentNode()
+{
+#ifdef Q_OS_LINUX
+    const int cpu = sched_getcpu();
+    const Topology *topology = s_topology;
+
+    if (cpu >= 0 && cpu < topology->cpuNodes.size()) {
+        return topology->cpuNodes[cpu];
+    }
+#endif
+
+    return 0;
+}
+
+bool bindCurrentThreadToNode(int node)
+{
+#ifdef Q_OS_LINUX
+    const Topology *topology = s_topology;
+    if (topology->nodeCpus.size() < 2) return false;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+
+    if (node >= 0) {
+        Q_FOREACH (int cpu, topology->nodeCpus[node % topology->nodeCpus.size()]) {
+            CPU_SET(cpu, &cpuSet);
+        }
+    } else {
+        Q_FOREACH (const QVector<int> &cpus, topology->nodeCpus) {
+            Q_FOREACH (int cpu, cpus) {
+                CPU_SET(cpu, &cpuSet);
+            }
+        }
+    }
+
+    // on Linux pid 0 means the calling thread
+    return !sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+#else
+    Q_UNUSED(node);
+    return false;
+#endif
+}
+
+bool setPreferredNode(void *ptr, size_t size, int node)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_mbind)
+    if (numNodes() < 2 || node < 0) return false;
+
+    /**
+     * We don't link to libnuma, so call the syscall directly.
+     * MPOL_PREFERRED falls back to other nodes when the preferred
+     * one has no free memory.
+     */
+    const int MPOL_PREFERRED = 1;
+    const unsigned long nodeMask = 1UL << (node % (8 * sizeof(unsigned long)));
+
+    return !syscall(SYS_mbind, ptr, size, MPOL_PREFERRED,
+                    &nodeMask, 8 * sizeof(unsigned long), 0);
+#else
+    Q_UNUSED(ptr);
+    Q_UNUSED(size);
+    Q_UNUSED(node);
+    return false;
+#endif
+}
+
+Statistics statistics()
+{
+    Statistics stats;
+
+#ifdef Q_OS_LINUX
+    QDir nodesDir("/sys/devices/system/node");
+    const QStringList nodeDirs =
+        nodesDir.entryList(QStringList() << "node*", QDir::Dirs, QDir::Name);
+
+    Q_FOREACH (const QString &dir, nodeDirs) {
+        QFile file(nodesDir.filePath(dir + "/numastat"));
+        if (!file.open(QIODevice::ReadOnly)) continue;
+
+        Q_FOREACH (const QByteArray &line, file.readAll().split('\n')) {
+            const QList<QByteArray> fields = line.simplified().split(' ');
+            if (fields.size() != 2) continue;
+
+            if (fields[0] == "local_node") {
+                stats.localPages += fields[1].toLongLong();
+            } else if (fields[0] == "other_node") {
+                stats.remotePages += fields[1].toLongLong();
+            }
+        }
+    }
+#endif
+
+    return stats;
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISNUMAUTILS_H
+#define KISNUMAUTILS_H
+
+#include "kritaglobal_export.h"
+
+#include <QtGlobal>
+#include <QVector>
+
+/**
+ * Helpers for placing threads and memory on the nodes of NUMA
+ * machines. The topology is read from sysfs, so the functions work
+ * only on Linux. On other systems (and on non-NUMA machines) the
+ * whole machine is reported as a single node and all the placement
+ * requests are just ignored.
+ */
+namespace KisNumaUtils {
+
+/**
+ * The number of NUMA nodes that have at least one CPU
+ */
+int KRITAGLOBAL_EXPORT numNodes();
+
+/**
+ * The node of the CPU the calling thread is currently running on
+ */
+int KRITAGLOBAL_EXPORT currentNode();
+
+/**
+ * Restricts the calling thread to the CPUs of \p node. Passing -1
+ * lets the thread run on any CPU again.
+ *
+ * \return true if the affinity has been changed
+ */
+bool KRITAGLOBAL_EXPORT bindCurrentThreadToNode(int node);
+
+/**
+ * Asks the kernel to back the pages of [ptr, ptr + size) with the
+ * memory of \p node, when possible. The pages that have already been
+ * touched are not migrated.
+ */
+bool KRITAGLOBAL_EXPORT setPreferredNode(void *ptr, size_t size, int node);
+
+struct Statistics {
+    /// pages allocated on the node the process wanted them to be
+    qint64 localPages = 0;
+    /// pages allocated on a node other than the preferred one
+    qint64 remotePages = 0;
+};
+
+/**
+ * System-wide page allocation counters, summed over all nodes
+ * (see /sys/devices/system/node/nodeN/numastat). The counters are
+ * empty if the system doesn't provide them.
+ */
+Statistics KRITAGLOBAL_EXPORT statistics();
+
+}
+
+#endif // KISNUMAUTILS_H
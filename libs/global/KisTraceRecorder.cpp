@@ -0,0 +1,280 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTraceRecorder.h"
+
+#include <atomic>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QThread>
+
+#include "kis_debug.h"
+
+namespace {
+
+static const int BUFFER_CAPACITY = 8192;
+
+std::atomic<bool> s_enabled(false);
+
+struct Event {
+    const char *category = 0;
+    const char *name = 0;
+    qint64 startUs = 0;
+    qint64 durationUs = 0;
+};
+
+struct ThreadBuffer
+{
+    ThreadBuffer(int _tid, const QString &_threadName)
+        : tid(_tid),
+          threadName(_threadName),
+          events(BUFFER_CAPACITY)
+    {
+    }
+
+    const int tid;
+    const QString threadName;
+
+    /**
+     * The lock is taken by the owning thread only, unless someone is
+     * exporting the trace, so it is effectively uncontended.
+     */
+    QMutex lock;
+    std::vector<Event> events;
+    int nextIndex = 0;
+    int numEvents = 0;
+
+    std::atomic<bool> threadFinished {false};
+};
+
+typedef QSharedPointer<ThreadBuffer> ThreadBufferSP;
+
+struct Registry
+{
+    Registry() {
+        timer.start();
+
+        autoExportFile = QString::fromLocal8Bit(qgetenv("KRITA_TRACE_FILE"));
+        if (!autoExportFile.isEmpty()) {
+            s_enabled.store(true);
+        }
+    }
+
+    ~Registry() {
+        // late spans should not try to access the destroyed registry
+        s_enabled.store(false);
+
+        if (!autoExportFile.isEmpty()) {
+            writeChromeTrace(autoExportFile);
+        }
+    }
+
+    ThreadBufferSP createBuffer() {
+        QString threadName = QThread::currentThread() ? QThread::currentThread()->objectName() : QString();
+
+        QMutexLocker l(&lock);
+
+        const int tid = ++lastTid;
+        if (threadName.isEmpty()) {
+            threadName = QCoreApplication::instance() &&
+                QThread::currentThread() == QCoreApplication::instance()->thread() ?
+                QString("GUI thread") : QString("Thread %1").arg(tid);
+        }
+
+        ThreadBufferSP buffer(new ThreadBuffer(tid, threadName));
+        buffers.append(buffer);
+        return buffer;
+    }
+
+    QByteArray chromeTraceJson() {
+        QJsonArray traceEvents;
+        const qint64 pid = QCoreApplication::applicationPid();
+
+        QList<ThreadBufferSP> buffersCopy;
+        {
+            QMutexLocker l(&lock);
+            buffersCopy = buffers;
+        }
+
+        Q_FOREACH (ThreadBufferSP buffer, buffersCopy) {
+            QJsonObject nameEvent;
+            nameEvent["ph"] = "M";
+            nameEvent["name"] = "thread_name";
+            nameEvent["pid"] = pid;
+            nameEvent["tid"] = buffer->tid;
+            QJsonObject args;
+            args["name"] = buffer->threadName;
+            nameEvent["args"] = args;
+            traceEvents.append(nameEvent);
+
+            QMutexLocker l(&buffer->lock);
+
+            const int firstIndex =
+                (buffer->nextIndex - buffer->numEvents + BUFFER_CAPACITY) % BUFFER_CAPACITY;
+
+            for (int i = 0; i < buffer->numEvents; i++) {
+                const Event &event = buffer->events[(firstIndex + i) % BUFFER_CAPACITY];
+
+                QJsonObject object;
+                object["ph"] = "X";
+                object["cat"] = QLatin1String(event.category);
+                object["name"] = QLatin1String(event.name);
+                object["ts"] = event.startUs;
+                object["dur"] = event.durationUs;
+                object["pid"] = pid;
+                object["tid"] = buffer->tid;
+                traceEvents.append(object);
+            }
+        }
+
+        QJsonObject root;
+        root["traceEvents"] = traceEvents;
+        root["displayTimeUnit"] = "ms";
+
+        return QJsonDocument(root).toJson(QJsonDocument::Compact);
+    }
+
+    bool writeChromeTrace(const QString &fileName) {
+        QFile file(fileName);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            warnKrita << "KisTraceRecorder: failed to open trace file" << fileName;
+            return false;
+        }
+
+        const QByteArray data = chromeTraceJson();
+        return file.write(data) == data.size();
+    }
+
+    void clear() {
+        QMutexLocker l(&lock);
+
+        auto it = buffers.begin();
+        while (it != buffers.end()) {
+            if ((*it)->threadFinished) {
+                it = buffers.erase(it);
+            } else {
+                QMutexLocker bufferLocker(&(*it)->lock);
+                (*it)->nextIndex = 0;
+                (*it)->numEvents = 0;
+                ++it;
+            }
+        }
+    }
+
+    QElapsedTimer timer;
+    QString autoExportFile;
+
+    QMutex lock;
+    QList<ThreadBufferSP> buffers;
+    int lastTid = 0;
+};
+
+Q_GLOBAL_STATIC(Registry, s_registry)
+
+/**
+ * Create the registry on load, so that KRITA_TRACE_FILE takes effect
+ * from the very beginning
+ */
+struct RegistryInitializer {
+    RegistryInitializer() {
+        s_registry();
+    }
+};
+static RegistryInitializer s_registryInitializer;
+
+struct ThreadBufferHolder
+{
+    ~ThreadBufferHolder() {
+        if (buffer) {
+            buffer->threadFinished = true;
+        }
+    }
+
+    ThreadBufferSP buffer;
+};
+
+thread_local ThreadBufferHolder s_threadBuffer;
+
+}
+
+bool KisTraceRecorder::isEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+void KisTraceRecorder::setEnabled(bool value)
+{
+    s_enabled.store(value);
+}
+
+qint64 KisTraceRecorder::timestampUs()
+{
+    return s_registry->timer.nsecsElapsed() / 1000;
+}
+
+void KisTraceRecorder::addCompleteEvent(const char *category, const char *name, qint64 startUs, qint64 durationUs)
+{
+    if (!isEnabled() || s_registry.isDestroyed()) return;
+
+    ThreadBufferSP &buffer = s_threadBuffer.buffer;
+    if (!buffer) {
+        buffer = s_registry->createBuffer();
+    }
+
+    QMutexLocker l(&buffer->lock);
+
+    Event &event = buffer->events[buffer->nextIndex];
+    event.category = category;
+    event.name = name;
+    event.startUs = startUs;
+    event.durationUs = durationUs;
+
+    buffer->nextIndex = (buffer->nextIndex + 1) % BUFFER_CAPACITY;
+    buffer->numEvents = qMin(buffer->numEvents + 1, BUFFER_CAPACITY);
+}
+
+int KisTraceRecorder::bufferCapacity()
+{
+    return BUFFER_CAPACITY;
+}
+
+QByteArray KisTraceRecorder::chromeTraceJson()
+{
+    return s_registry->chromeTraceJson();
+}
+
+bool KisTraceRecorder::exportChromeTrace(const QString &fileName)
+{
+    return s_registry->writeChromeTrace(fileName);
+}
+
+void KisTraceRecorder::clear()
+{
+    s_registry->clear();
+}
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISTRACERECORDER_H
+#define KISTRACERECORDER_H
+
+#include "kritaglobal_export.h"
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+/**
+ * A lightweight recorder of timing spans in the update pipeline, e.g. merge
+ * jobs, stroke jobs, canvas updates compression and texture uploads.
+ *
+ * Every thread writes its spans into its own fixed-size ring buffer, so the
+ * recording itself never contends with other threads. When the recorder is
+ * disabled (default), a span costs a single relaxed atomic read.
+ *
+ * The collected spans can be exported in Chrome's trace-event JSON format
+ * and opened with chrome://tracing or Perfetto.
+ *
+ * If KRITA_TRACE_FILE environment variable is set, the recorder is enabled
+ * on startup and the trace is written into that file on exit.
+ *
+ * NOTE: category and name are stored as raw pointers, so they must be
+ *       string literals (or otherwise have static storage duration).
+ */
+class KRITAGLOBAL_EXPORT KisTraceRecorder
+{
+public:
+    static bool isEnabled();
+    static void setEnabled(bool value);
+
+    /**
+     * Monotonic time in microseconds since the start of the recorder
+     */
+    static qint64 timestampUs();
+
+    static void addCompleteEvent(const char *category, const char *name,
+                                 qint64 startUs, qint64 durationUs);
+
+    /**
+     * Events recorded per thread before the oldest ones start to be
+     * overwritten
+     */
+    static int bufferCapacity();
+
+    static QByteArray chromeTraceJson();
+    static bool exportChromeTrace(const QString &fileName);
+
+    /**
+     * Drops all the recorded events and frees the buffers of the
+     * threads that have already exited
+     */
+    static void clear();
+};
+
+/**
+ * RAII helper that records a span from its construction till its
+ * destruction. Use via KIS_TRACE_SPAN macro.
+ */
+class KisTraceSpan
+{
+public:
+    KisTraceSpan(const char *category, const char *name)
+        : m_category(category),
+          m_name(name),
+          m_startUs(KisTraceRecorder::isEnabled() ? KisTraceRecorder::timestampUs() : -1)
+    {
+    }
+
+    ~KisTraceSpan() {
+        if (m_startUs >= 0) {
+            KisTraceRecorder::addCompleteEvent(m_category, m_name, m_startUs,
+                                               KisTraceRecorder::timestampUs() - m_startUs);
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(KisTraceSpan)
+
+    const char *m_category;
+    const char *m_name;
+    qint64 m_startUs;
+};
+
+#define KIS_TRACE_SPAN_CONCAT_IMPL(a, b) a##b
+#define KIS_TRACE_SPAN_CONCAT(a, b) KIS_TRACE_SPAN_CONCAT_IMPL(a, b)
+#define KIS_TRACE_SPAN(category, name) KisTraceSpan KIS_TRACE_SPAN_CONCAT(__kisTraceSpan, __LINE__)(category, name)
+
+#endif // KISTRACERECORDER_H
@@ -0,0 +1,157 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTraceRecorderTest.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include "KisTraceRecorder.h"
+#include "kis_assert.h"
+
+namespace {
+
+QJsonArray parseEvents(const QByteArray &data, const QString &phase)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    KIS_ASSERT(error.error == QJsonParseError::NoError);
+
+    QJsonArray result;
+    Q_FOREACH (const QJsonValue &value, doc.object()["traceEvents"].toArray()) {
+        if (value.toObject()["ph"].toString() == phase) {
+            result.append(value);
+        }
+    }
+    return result;
+}
+
+struct TracingThread : public QThread
+{
+    void run() override {
+        KIS_TRACE_SPAN("test", "thread span");
+    }
+};
+
+}
+
+void KisTraceRecorderTest::testDisabled()
+{
+    KisTraceRecorder::setEnabled(false);
+    KisTraceRecorder::clear();
+
+    {
+        KIS_TRACE_SPAN("test", "disabled span");
+    }
+
+    QCOMPARE(parseEvents(KisTraceRecorder::chromeTraceJson(), "X").size(), 0);
+}
+
+void KisTraceRecorderTest::testChromeTraceExport()
+{
+    KisTraceRecorder::setEnabled(true);
+    KisTraceRecorder::clear();
+
+    {
+        KIS_TRACE_SPAN("test", "outer span");
+        KIS_TRACE_SPAN("test", "inner span");
+        QTest::qSleep(2);
+    }
+
+    TracingThread thread;
+    thread.setObjectName("TestTraceThread");
+    thread.start();
+    thread.wait();
+
+    KisTraceRecorder::setEnabled(false);
+
+    const QByteArray data = KisTraceRecorder::chromeTraceJson();
+    const QJsonArray events = parseEvents(data, "X");
+
+    QCOMPARE(events.size(), 3);
+
+    QJsonObject outer;
+    QJsonObject inner;
+    QJsonObject threadSpan;
+
+    Q_FOREACH (const QJsonValue &value, events) {
+        QJsonObject object = value.toObject();
+        QCOMPARE(object["cat"].toString(), QString("test"));
+
+        if (object["name"].toString() == "outer span") {
+            outer = object;
+        } else if (object["name"].toString() == "inner span") {
+            inner = object;
+        } else if (object["name"].toString() == "thread span") {
+            threadSpan = object;
+        }
+    }
+
+    QVERIFY(!outer.isEmpty());
+    QVERIFY(!inner.isEmpty());
+    QVERIFY(!threadSpan.isEmpty());
+
+    // the inner span is nested into the outer one
+    QVERIFY(outer["ts"].toDouble() <= inner["ts"].toDouble());
+    QVERIFY(outer["ts"].toDouble() + outer["dur"].toDouble() >=
+            inner["ts"].toDouble() + inner["dur"].toDouble());
+    QVERIFY(inner["dur"].toDouble() >= 2000);
+
+    QCOMPARE(outer["tid"].toInt(), inner["tid"].toInt());
+    QVERIFY(threadSpan["tid"].toInt() != outer["tid"].toInt());
+
+    bool threadNameFound = false;
+    Q_FOREACH (const QJsonValue &value, parseEvents(data, "M")) {
+        QJsonObject object = value.toObject();
+        if (object["tid"].toInt() == threadSpan["tid"].toInt()) {
+            QCOMPARE(object["args"].toObject()["name"].toString(), QString("TestTraceThread"));
+            threadNameFound = true;
+        }
+    }
+    QVERIFY(threadNameFound);
+
+    KisTraceRecorder::clear();
+}
+
+void KisTraceRecorderTest::testRingBufferOverflow()
+{
+    KisTraceRecorder::setEnabled(true);
+    KisTraceRecorder::clear();
+
+    const int capacity = KisTraceRecorder::bufferCapacity();
+
+    for (int i = 0; i < capacity + 100; i++) {
+        KisTraceRecorder::addCompleteEvent("test", "overflow", i, 1);
+    }
+
+    KisTraceRecorder::setEnabled(false);
+
+    const QJsonArray events = parseEvents(KisTraceRecorder::chromeTraceJson(), "X");
+    QCOMPARE(events.size(), capacity);
+
+    // the oldest events are overwritten
+    QCOMPARE(events.first().toObject()["ts"].toInt(), 100);
+    QCOMPARE(events.last().toObject()["ts"].toInt(), capacity + 99);
+
+    KisTraceRecorder::clear();
+}
+
+QTEST_MAIN(KisTraceRecorderTest)
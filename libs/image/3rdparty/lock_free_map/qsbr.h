@@ -18,16 +18,40 @@
 
 #define CALL_MEMBER(obj, pmf) ((obj).*(pmf))
 
+/**
+ * Deferred memory reclamation for ConcurrentMap.
+ *
+ * The original Junction QSBR could only release the retired objects when
+ * *no* thread held raw pointers into the map, i.e. it needed a global
+ * quiescent state. Under a constant stream of readers (e.g. many threads
+ * rendering the same paint device) such state might never come and the
+ * garbage grew until flush() started spinning.
+ *
+ * Now we use two-slot epoch counting instead. Every reader registers itself
+ * in the slot of the epoch it has entered and gets that epoch back as a
+ * token. Every retired object is stamped with the epoch current at the
+ * moment of retirement. The epoch can be advanced as soon as the readers of
+ * the *previous* epoch have left, new readers don't block it, because they
+ * are counted in the other slot. An object retired in epoch E is destroyed
+ * after the epoch reached E + 2, when no reader could have seen it.
+ *
+ * update() is called on every access to the map, so the reclamation is
+ * amortized: until RECLAIM_BATCH_SIZE objects are retired, update() only
+ * reads a counter, which changes on retirements only.
+ */
 class QSBR
 {
 private:
     struct Action {
         void (*func)(void*);
         quint64 param[4]; // Size limit found experimentally. Verified by assert below.
+        int epoch = 0;
 
         Action() = default;
 
-        Action(void (*f)(void*), void* p, quint64 paramSize) : func(f)
+        Action(void (*f)(void*), void* p, quint64 paramSize, int _epoch)
+            : func(f),
+              epoch(_epoch)
         {
             KIS_ASSERT(paramSize <= sizeof(param)); // Verify size limit.
             memcpy(&param, p, paramSize);
@@ -39,40 +63,107 @@ private:
         }
     };
 
-    QAtomicInt m_rawPointerUsers;
+    static const int RECLAIM_BATCH_SIZE = 64;
+
+    QAtomicInt m_epoch;
+    QAtomicInt m_readers[2];
+
+    /**
+     * The number of the retired objects that are not destroyed yet
+     */
+    QAtomicInt m_numRetiredActions;
+
     KisLocklessStack<Action> m_pendingActions;
-    KisLocklessStack<Action> m_migrationReclaimActions;
 
-    void releasePoolSafely(KisLocklessStack<Action> *pool, bool force = false) {
-        KisLocklessStack<Action> tmp;
-        tmp.mergeFrom(*pool);
-        if (tmp.isEmpty()) return;
+    /**
+     * Actions that were already taken from m_pendingActions, but whose
+     * epoch has not expired yet. Accessed under m_reclaimLock only.
+     */
+    QVector<Action> m_deferredActions;
+    QMutex m_reclaimLock;
+
+    bool tryAdvanceEpoch(int *epoch) {
+        const int currentEpoch = m_epoch.loadAcquire();
+
+        if (m_readers[(currentEpoch - 1) & 0x1].loadAcquire()) {
+            *epoch = currentEpoch;
+            return false;
+        }
+
+        // the epoch is advanced under m_reclaimLock only, the ordered
+        // RMW is needed to synchronize with the readers' registration
+        m_epoch.fetchAndAddOrdered(1);
+        *epoch = currentEpoch + 1;
+        return true;
+    }
+
+    void releaseExpiredActions(int epoch) {
+        // compact the vector in place to keep its capacity
+        const int numActions = m_deferredActions.size();
+        int numNotExpired = 0;
 
-        if (force || tmp.size() > 4096) {
-            while (m_rawPointerUsers.loadAcquire());
+        for (int i = 0; i < numActions; i++) {
+            Action &action = m_deferredActions[i];
 
-            Action action;
-            while (tmp.pop(action)) {
+            if (epoch - action.epoch >= 2) {
                 action();
-            }
-        } else {
-            if (!m_rawPointerUsers.loadAcquire()) {
-                Action action;
-                while (tmp.pop(action)) {
-                    action();
-                }
             } else {
-                // push elements back to the source
-                pool->mergeFrom(tmp);
+                m_deferredActions[numNotExpired++] = action;
             }
         }
+
+        m_deferredActions.resize(numNotExpired);
+        m_numRetiredActions.fetchAndAddOrdered(numNotExpired - numActions);
+    }
+
+    void collectPendingActions() {
+        KisLocklessStack<Action> tmp;
+        tmp.mergeFrom(m_pendingActions);
+
+        Action action;
+        while (tmp.pop(action)) {
+            m_deferredActions.append(action);
+        }
+    }
+
+    void releasePoolSafely(bool force) {
+        collectPendingActions();
+        if (m_deferredActions.isEmpty()) return;
+
+        int epoch = 0;
+
+        if (force || m_deferredActions.size() > 4096) {
+            /**
+             * We wait only for the readers that entered the map before the
+             * objects had been retired. The readers coming in the meantime
+             * are counted in the other slot, so the loop is guaranteed
+             * to finish even if the map is never quiescent as a whole.
+             */
+            while (!m_deferredActions.isEmpty()) {
+                while (!tryAdvanceEpoch(&epoch));
+                releaseExpiredActions(epoch);
+            }
+        } else {
+            tryAdvanceEpoch(&epoch);
+            releaseExpiredActions(epoch);
+        }
     }
 
 public:
+    QSBR()
+        : m_epoch(0),
+          m_numRetiredActions(0)
+    {
+        m_readers[0].store(0);
+        m_readers[1].store(0);
+        m_deferredActions.reserve(RECLAIM_BATCH_SIZE);
+    }
 
     template <class T>
     void enqueue(void (T::*pmf)(), T* target, bool migration = false)
     {
+        Q_UNUSED(migration);
+
         struct Closure {
             void (T::*pmf)();
             T* target;
@@ -86,37 +177,61 @@ public:
 
         Closure closure = {pmf, target};
 
-        if (migration) {
-            m_migrationReclaimActions.push(Action(Closure::thunk, &closure, sizeof(closure)));
-        } else {
-            m_pendingActions.push(Action(Closure::thunk, &closure, sizeof(closure)));
-        }
+        /**
+         * The object is already unlinked from the map, so only the readers
+         * of the current (or earlier) epoch can still reference it.
+         */
+        m_pendingActions.push(Action(Closure::thunk, &closure, sizeof(closure),
+                                     m_epoch.loadAcquire()));
+        m_numRetiredActions.ref();
     }
 
     void update()
     {
-        releasePoolSafely(&m_pendingActions);
-        releasePoolSafely(&m_migrationReclaimActions);
+        if (m_numRetiredActions.loadAcquire() < RECLAIM_BATCH_SIZE) return;
+        if (!m_reclaimLock.tryLock()) return;
+        releasePoolSafely(false);
+        m_reclaimLock.unlock();
     }
 
     void flush()
     {
-        releasePoolSafely(&m_pendingActions, true);
-        releasePoolSafely(&m_migrationReclaimActions, true);
+        QMutexLocker l(&m_reclaimLock);
+        releasePoolSafely(true);
     }
 
-    void lockRawPointerAccess()
+    /**
+     * Registers the calling thread as a user of raw pointers of the map.
+     * The returned token must be passed to unlockRawPointerAccess().
+     */
+    int lockRawPointerAccess()
     {
-        m_rawPointerUsers.ref();
+        while (1) {
+            const int epoch = m_epoch.loadAcquire();
+            QAtomicInt &readers = m_readers[epoch & 0x1];
+
+            readers.ref();
+
+            /**
+             * If the epoch has been advanced while we were registering,
+             * then our slot might already be reused by a newer epoch,
+             * which the reclaimer might consider as drained. Just retry.
+             */
+            if (m_epoch.loadAcquire() == epoch) {
+                return epoch;
+            }
+
+            readers.deref();
+        }
     }
 
-    void unlockRawPointerAccess()
+    void unlockRawPointerAccess(int token)
     {
-        m_rawPointerUsers.deref();
+        m_readers[token & 0x1].deref();
     }
 
     bool sanityRawPointerAccessLocked() const {
-        return m_rawPointerUsers.loadAcquire();
+        return m_readers[0].loadAcquire() || m_readers[1].loadAcquire();
     }
 };
 
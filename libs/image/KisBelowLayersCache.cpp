@@ -0,0 +1,300 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisBelowLayersCache.h"
+
+#include <QMutex>
+#include <QRegion>
+#include <QGlobalStatic>
+
+#include "kis_paint_device.h"
+#include "kis_painter.h"
+#include "kis_image_config.h"
+
+/**
+ * The region of the cache gets fragmented by the dab-sized updates,
+ * it is cheaper to start from scratch than to keep a huge region.
+ */
+static const int MAX_REGION_RECTS = 512;
+
+struct KisBelowLayersCache::Private
+{
+    QMutex lock;
+    QAtomicInt isEnabled;
+    QAtomicInt hasData;
+
+    Key key;
+    KisPaintDeviceSP device;
+    QRegion validRegion;
+    int generation = 0;
+    qint64 memoryUsage = 0;
+
+    /**
+     * The usage stamp for the LRU eviction, updated without any locks
+     */
+    QAtomicInteger<qint64> lastUsed;
+
+    /**
+     * The amount of memory accounted in the budget, guarded by
+     * the lock of the budget
+     */
+    qint64 accountedUsage = 0;
+
+    void resetUnlocked() {
+        key = Key();
+        device = 0;
+        validRegion = QRegion();
+        generation++;
+        memoryUsage = 0;
+        hasData.storeRelease(0);
+    }
+};
+
+/**
+ * The memory budget shared by all the caches.
+ *
+ * The lock of the budget is always taken before the lock of a cache,
+ * so the cache must never call the budget while holding its own lock.
+ */
+struct KisBelowLayersCacheBudget
+{
+    typedef KisBelowLayersCache::Private CachePrivate;
+
+    KisBelowLayersCacheBudget()
+        : limit(qint64(KisImageConfig(true).belowLayersCacheLimit()) << 20)
+    {
+    }
+
+    void registerCache(CachePrivate *cache) {
+        QMutexLocker l(&lock);
+        caches.append(cache);
+    }
+
+    void unregisterCache(CachePrivate *cache) {
+        QMutexLocker l(&lock);
+        caches.removeOne(cache);
+        totalUsage.fetchAndAddOrdered(-cache->accountedUsage);
+        cache->accountedUsage = 0;
+    }
+
+    void touch(CachePrivate *cache) {
+        cache->lastUsed.storeRelease(usageCounter.fetchAndAddOrdered(1));
+    }
+
+    /**
+     * Accounts the current memory usage of \p cache and drops the
+     * least recently used caches until the total fits the limit
+     */
+    void updateUsage(CachePrivate *cache) {
+        QMutexLocker l(&lock);
+
+        qint64 usage = 0;
+        {
+            QMutexLocker cacheLocker(&cache->lock);
+            usage = cache->memoryUsage;
+        }
+
+        totalUsage.fetchAndAddOrdered(usage - cache->accountedUsage);
+        cache->accountedUsage = usage;
+
+        evictUnlocked();
+    }
+
+    void setLimit(qint64 value) {
+        QMutexLocker l(&lock);
+        limit = value;
+        evictUnlocked();
+    }
+
+    QMutex lock;
+    QVector<CachePrivate*> caches;
+    QAtomicInteger<qint64> totalUsage;
+    QAtomicInteger<qint64> usageCounter;
+    qint64 limit;
+
+private:
+    void evictUnlocked() {
+        while (totalUsage.loadAcquire() > limit) {
+            CachePrivate *victim = 0;
+
+            Q_FOREACH (CachePrivate *cache, caches) {
+                if (cache->accountedUsage > 0 &&
+                    (!victim || cache->lastUsed.loadAcquire() < victim->lastUsed.loadAcquire())) {
+
+                    victim = cache;
+                }
+            }
+
+            if (!victim) break;
+
+            {
+                QMutexLocker cacheLocker(&victim->lock);
+                victim->resetUnlocked();
+            }
+
+            totalUsage.fetchAndAddOrdered(-victim->accountedUsage);
+            victim->accountedUsage = 0;
+        }
+    }
+};
+
+Q_GLOBAL_STATIC(KisBelowLayersCacheBudget, s_budget)
+
+KisBelowLayersCache::KisBelowLayersCache()
+    : m_d(new Private)
+{
+    s_budget->registerCache(m_d.data());
+}
+
+KisBelowLayersCache::~KisBelowLayersCache()
+{
+    if (!s_budget.isDestroyed()) {
+        s_budget->unregisterCache(m_d.data());
+    }
+}
+
+bool KisBelowLayersCache::isEnabled() const
+{
+    return m_d->isEnabled.loadAcquire();
+}
+
+void KisBelowLayersCache::setEnabled(bool value)
+{
+    m_d->isEnabled.storeRelease(value);
+
+    if (!value) {
+        invalidate();
+    }
+}
+
+bool KisBelowLayersCache::tryFetch(const Key &key, const QRect &rect, KisPaintDeviceSP dst)
+{
+    if (!m_d->hasData.loadAcquire()) return false;
+
+    KisPaintDeviceSP device;
+
+    {
+        QMutexLocker l(&m_d->lock);
+
+        if (!(m_d->key == key) ||
+            !QRegion(rect).subtracted(m_d->validRegion).isEmpty()) {
+
+            return false;
+        }
+
+        device = m_d->device;
+    }
+
+    s_budget->touch(m_d.data());
+
+    KisPainter::copyAreaOptimized(rect.topLeft(), device, dst, rect);
+    return true;
+}
+
+void KisBelowLayersCache::store(const Key &key, const QRect &rect, KisPaintDeviceSP src)
+{
+    KisPaintDeviceSP device;
+    int generation = 0;
+
+    {
+        QMutexLocker l(&m_d->lock);
+
+        if (!(m_d->key == key) ||
+            !m_d->device ||
+            !(*m_d->device->colorSpace() == *src->colorSpace()) ||
+            m_d->validRegion.rectCount() > MAX_REGION_RECTS) {
+
+            m_d->resetUnlocked();
+            m_d->key = key;
+            m_d->device = new KisPaintDevice(src->colorSpace());
+            m_d->device->prepareClone(src);
+        }
+
+        device = m_d->device;
+        generation = m_d->generation;
+    }
+
+    KisPainter::copyAreaOptimized(rect.topLeft(), src, device, rect);
+
+    bool usageChanged = false;
+
+    {
+        QMutexLocker l(&m_d->lock);
+
+        // the cache might have been invalidated while we were copying
+        if (m_d->generation == generation) {
+            m_d->validRegion += rect;
+            m_d->hasData.storeRelease(1);
+
+            qint64 imageData = 0;
+            qint64 temporaryData = 0;
+            qint64 lodData = 0;
+            device->estimateMemoryStats(imageData, temporaryData, lodData);
+
+            const qint64 usage = imageData + temporaryData + lodData;
+            usageChanged = usage != m_d->memoryUsage;
+            m_d->memoryUsage = usage;
+        }
+    }
+
+    s_budget->touch(m_d.data());
+
+    if (usageChanged) {
+        s_budget->updateUsage(m_d.data());
+    }
+}
+
+void KisBelowLayersCache::invalidate()
+{
+    /**
+     * A store that hasn't finished yet is not a problem: the
+     * update it belongs to doesn't intersect the one that made
+     * us invalidate the cache
+     */
+    if (!m_d->hasData.loadAcquire()) return;
+
+    {
+        QMutexLocker l(&m_d->lock);
+        m_d->resetUnlocked();
+    }
+
+    s_budget->updateUsage(m_d.data());
+}
+
+qint64 KisBelowLayersCache::memoryUsage() const
+{
+    QMutexLocker l(&m_d->lock);
+    return m_d->memoryUsage;
+}
+
+qint64 KisBelowLayersCache::totalMemoryUsage()
+{
+    return s_budget->totalUsage.loadAcquire();
+}
+
+void KisBelowLayersCache::setMemoryLimit(qint64 value)
+{
+    s_budget->setLimit(value);
+}
+
+qint64 KisBelowLayersCache::memoryLimit()
+{
+    QMutexLocker l(&s_budget->lock);
+    return s_budget->limit;
+}
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISBELOWLAYERSCACHE_H
+#define KISBELOWLAYERSCACHE_H
+
+#include <QScopedPointer>
+#include <QVector>
+
+#include "kritaimage_export.h"
+#include "kis_types.h"
+
+class QRect;
+
+/**
+ * Keeps the composition of the layers lying below the layer being
+ * painted on, so that KisAsyncMerger doesn't have to composite all of
+ * them again on every update of the painted layer.
+ *
+ * Every group layer owns a cache for its children. The cache is keyed
+ * by the child the updates come through (the "above" node) and the
+ * list of the children below it. Any merge of the group that doesn't
+ * match the key invalidates the whole cache. It is safe, because a
+ * change in any of the lower layers comes with a merge of the group
+ * having that layer as a filthy node.
+ *
+ * All the caches share a single memory budget (see
+ * KisImageConfig::belowLayersCacheLimit()). When the budget is
+ * exceeded, the caches that were used least recently are dropped.
+ */
+class KRITAIMAGE_EXPORT KisBelowLayersCache
+{
+public:
+    struct Key {
+        const KisNode *aboveNode = 0;
+        QVector<const KisNode*> belowNodes;
+        int levelOfDetail = 0;
+
+        bool operator==(const Key &rhs) const {
+            return aboveNode == rhs.aboveNode &&
+                levelOfDetail == rhs.levelOfDetail &&
+                belowNodes == rhs.belowNodes;
+        }
+    };
+
+public:
+    KisBelowLayersCache();
+    ~KisBelowLayersCache();
+
+    bool isEnabled() const;
+    void setEnabled(bool value);
+
+    /**
+     * Copies the cached composition of \p rect into \p dst. Returns
+     * false if the cache was built for a different key or doesn't
+     * cover the whole rect.
+     */
+    bool tryFetch(const Key &key, const QRect &rect, KisPaintDeviceSP dst);
+
+    /**
+     * Saves the composition of the layers below the node of \p key in
+     * \p rect of \p src. If the cache has been built for a different
+     * key, it is reset.
+     */
+    void store(const Key &key, const QRect &rect, KisPaintDeviceSP src);
+
+    /**
+     * Drops all the cached data
+     */
+    void invalidate();
+
+    /**
+     * The amount of memory occupied by the cached device, in bytes
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * The amount of memory occupied by all the caches, in bytes
+     */
+    static qint64 totalMemoryUsage();
+
+    /**
+     * Sets the memory budget shared by all the caches, in bytes. By
+     * default, it is read from KisImageConfig on creation of the first
+     * cache.
+     */
+    static void setMemoryLimit(qint64 value);
+    static qint64 memoryLimit();
+
+private:
+    friend struct KisBelowLayersCacheBudget;
+
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif // KISBELOWLAYERSCACHE_H
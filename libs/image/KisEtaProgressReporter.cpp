@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisEtaProgressReporter.h"
+
+#include <atomic>
+
+#include <QMutex>
+#include <QTimer>
+#include <QTime>
+#include <QElapsedTimer>
+#include <KoProgressProxy.h>
+#include <klocalizedstring.h>
+
+
+struct KisEtaProgressReporter::Private
+{
+    Private(KisEtaProgressReporter *q)
+        : timer(q)
+        , startDelayTimer(q)
+    {
+    }
+
+    QMutex mutex;
+    QTimer timer;
+    QTimer startDelayTimer;
+    QElapsedTimer elapsedTimer;
+
+    std::atomic<qint64> doneAmount {0};
+    qint64 totalAmount = 0;
+    bool isRunning = false;
+
+    KoProgressProxy *progressProxy = 0;
+    QString jobName;
+
+    /**
+     * The progress proxy has integer range only, so the amounts are
+     * scaled down to fit into it
+     */
+    static const int PROGRESS_RANGE = 1000;
+    static const int TIMER_INTERVAL = 500;
+    static const int PROGRESS_DELAY = 1000;
+};
+
+
+KisEtaProgressReporter::KisEtaProgressReporter(KoProgressProxy *progressProxy, const QString &jobName, QObject *parent)
+    : QObject(parent),
+      m_d(new Private(this))
+{
+    m_d->progressProxy = progressProxy;
+    m_d->jobName = jobName;
+
+    m_d->timer.setInterval(Private::TIMER_INTERVAL);
+    m_d->timer.setSingleShot(false);
+
+    connect(this, SIGNAL(sigStartTicking()), SLOT(startTicking()), Qt::QueuedConnection);
+    connect(this, SIGNAL(sigStopTicking()), SLOT(stopTicking()), Qt::QueuedConnection);
+    connect(&m_d->timer, SIGNAL(timeout()), SLOT(timerTicked()));
+
+    m_d->startDelayTimer.setInterval(Private::PROGRESS_DELAY);
+    m_d->startDelayTimer.setSingleShot(true);
+
+    connect(&m_d->startDelayTimer, SIGNAL(timeout()), &m_d->timer, SLOT(start()));
+    connect(&m_d->startDelayTimer, SIGNAL(timeout()), SLOT(timerTicked()));
+}
+
+KisEtaProgressReporter::~KisEtaProgressReporter()
+{
+}
+
+void KisEtaProgressReporter::start(qint64 totalAmount)
+{
+    QMutexLocker locker(&m_d->mutex);
+
+    m_d->totalAmount = totalAmount;
+    m_d->doneAmount = 0;
+    m_d->elapsedTimer.start();
+
+    if (!m_d->isRunning) {
+        m_d->isRunning = true;
+        emit sigStartTicking();
+    }
+}
+
+void KisEtaProgressReporter::addProgress(qint64 amount)
+{
+    m_d->doneAmount.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void KisEtaProgressReporter::finish()
+{
+    QMutexLocker locker(&m_d->mutex);
+
+    if (m_d->isRunning) {
+        m_d->isRunning = false;
+        emit sigStopTicking();
+    }
+}
+
+qint64 KisEtaProgressReporter::estimateRemainingTime(qint64 elapsed, qint64 done, qint64 total)
+{
+    if (done <= 0 || total <= 0 || elapsed <= 0) return -1;
+
+    done = qMin(done, total);
+    return qint64(qreal(elapsed) * (total - done) / done);
+}
+
+void KisEtaProgressReporter::startTicking()
+{
+    m_d->startDelayTimer.start();
+}
+
+void KisEtaProgressReporter::stopTicking()
+{
+    const bool progressWasShown = m_d->timer.isActive();
+
+    m_d->startDelayTimer.stop();
+    m_d->timer.stop();
+
+    if (progressWasShown) {
+        m_d->progressProxy->setRange(0, 100);
+        m_d->progressProxy->setValue(100);
+        m_d->progressProxy->setFormat("%p%");
+    }
+}
+
+void KisEtaProgressReporter::timerTicked()
+{
+    QMutexLocker locker(&m_d->mutex);
+
+    if (!m_d->isRunning || m_d->totalAmount <= 0) return;
+
+    const qint64 total = m_d->totalAmount;
+    const qint64 done = qMin(m_d->doneAmount.load(std::memory_order_relaxed), total);
+    const qint64 remaining =
+        estimateRemainingTime(m_d->elapsedTimer.elapsed(), done, total);
+
+    QString format = m_d->jobName;
+
+    if (remaining >= 0) {
+        const QTime remainingTime = QTime(0, 0).addMSecs(remaining);
+        const QString remainingString =
+            remainingTime.toString(remaining >= 3600000 ? "h:mm:ss" : "m:ss");
+
+        format = i18nc("progress bar format, %p is percentage, %2 is the estimated remaining time",
+                       "%1: %p% (%2 left)", m_d->jobName, remainingString);
+    }
+
+    m_d->progressProxy->setRange(0, Private::PROGRESS_RANGE);
+    m_d->progressProxy->setValue(int(done * Private::PROGRESS_RANGE / total));
+    m_d->progressProxy->setFormat(format);
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KISETAPROGRESSREPORTER_H
+#define KISETAPROGRESSREPORTER_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include "kritaimage_export.h"
+
+class KoProgressProxy;
+
+/**
+ * Reports the progress of a long operation, split into many small jobs,
+ * together with the estimated remaining time.
+ *
+ * start(), addProgress() and finish() may be called from any thread.
+ * They only update the counters, the progress proxy itself is written
+ * from the thread the reporter lives in, on a timer, the same way
+ * KisQueuesProgressUpdater does it. The progress is shown only if
+ * the operation takes longer than a second.
+ */
+class KRITAIMAGE_EXPORT KisEtaProgressReporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    KisEtaProgressReporter(KoProgressProxy *progressProxy, const QString &jobName, QObject *parent = 0);
+    ~KisEtaProgressReporter() override;
+
+    void start(qint64 totalAmount);
+    void addProgress(qint64 amount);
+    void finish();
+
+    /**
+     * Estimates the remaining time in milliseconds, -1 if there is
+     * not enough data for the estimation yet
+     */
+    static qint64 estimateRemainingTime(qint64 elapsed, qint64 done, qint64 total);
+
+private Q_SLOTS:
+    void startTicking();
+    void stopTicking();
+    void timerTicked();
+
+Q_SIGNALS:
+    void sigStartTicking();
+    void sigStopTicking();
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif // KISETAPROGRESSREPORTER_H
@@ -34,3 +34,8 @@ void KisFakeRunnableStrokeJobsExecutor::addRunnableJobs(const QVector<KisRunnabl
 
     qDeleteAll(list);
 }
+
+int KisFakeRunnableStrokeJobsExecutor::threadsLimit() const
+{
+    return 1;
+}
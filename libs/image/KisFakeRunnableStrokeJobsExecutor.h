@@ -26,6 +26,11 @@ class KRITAIMAGE_EXPORT KisFakeRunnableStrokeJobsExecutor : public KisRunnableSt
 {
 public:
     void addRunnableJobs(const QVector<KisRunnableStrokeJobDataBase*> &list);
+
+    /**
+     * The jobs are executed right in the calling thread
+     */
+    int threadsLimit() const;
 };
 
 #endif // KISFAKERUNNABLESTROKEJOBSEXECUTOR_H
@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisMergeCostEstimator.h"
+
+#include <QGlobalStatic>
+#include <QMutexLocker>
+
+#include "kis_layer.h"
+#include "kis_group_layer.h"
+#include "kis_adjustment_layer.h"
+#include "kis_clone_layer.h"
+#include "generator/kis_generator_layer.h"
+#include "kis_projection_leaf.h"
+
+Q_GLOBAL_STATIC(KisMergeCostEstimator, s_instance)
+
+namespace {
+
+/**
+ * The initial guesses of the cost of a pixel in nanoseconds. They are
+ * replaced by the real measurements as soon as the merger processes a
+ * few tiles of the layers of the class.
+ */
+const qreal initialCostPerPixel[KisMergeCostEstimator::NumCostClasses] = {
+    2.0,  // Composite
+    3.0,  // PaintLayer
+    3.0,  // GroupLayer
+    30.0, // AdjustmentLayer
+    20.0, // GeneratorLayer
+    3.0,  // CloneLayer
+    30.0, // EffectMasks
+    60.0  // LayerStyle
+};
+
+/**
+ * The weight of the initial guess, expressed in pixels
+ */
+const qreal initialWeight = 64 * 64;
+
+/**
+ * The old measurements decay with every new batch of samples, so the
+ * estimation follows the changes of the load of the system
+ */
+const qreal decayFactor = 0.9;
+
+}
+
+KisMergeCostEstimator::Samples::Samples()
+{
+    clear();
+}
+
+void KisMergeCostEstimator::Samples::clear()
+{
+    for (int i = 0; i < NumCostClasses; i++) {
+        pixels[i] = 0;
+        nsecs[i] = 0;
+    }
+    isEmpty = true;
+}
+
+KisMergeCostEstimator::KisMergeCostEstimator()
+{
+    reset();
+}
+
+KisMergeCostEstimator* KisMergeCostEstimator::instance()
+{
+    return s_instance;
+}
+
+KisMergeCostEstimator::CostClass KisMergeCostEstimator::classify(const KisBaseRectsWalker::JobItem &item)
+{
+    const KisProjectionLeafSP leaf = item.m_leaf;
+
+    if (leaf->isRoot() || (item.m_position & KisBaseRectsWalker::N_EXTRA)) {
+        return Composite;
+    }
+
+    const bool isRecalculated =
+        (item.m_position & (KisBaseRectsWalker::N_FILTHY | KisBaseRectsWalker::N_FILTHY_PROJECTION)) ||
+        ((item.m_position & KisBaseRectsWalker::N_ABOVE_FILTHY) && leaf->dependsOnLowerNodes());
+
+    if (!isRecalculated) {
+        return Composite;
+    }
+
+    const KisLayer *layer = dynamic_cast<const KisLayer*>(leaf->node().data());
+    if (!layer) {
+        return Composite;
+    }
+
+    if (layer->layerStyle()) {
+        return LayerStyle;
+    } else if (layer->hasEffectMasks()) {
+        return EffectMasks;
+    } else if (dynamic_cast<const KisAdjustmentLayer*>(layer)) {
+        return AdjustmentLayer;
+    } else if (dynamic_cast<const KisGeneratorLayer*>(layer)) {
+        return GeneratorLayer;
+    } else if (dynamic_cast<const KisCloneLayer*>(layer)) {
+        return CloneLayer;
+    } else if (dynamic_cast<const KisGroupLayer*>(layer)) {
+        return GroupLayer;
+    }
+
+    return PaintLayer;
+}
+
+void KisMergeCostEstimator::addSamples(const Samples &samples)
+{
+    if (samples.isEmpty) return;
+
+    QMutexLocker l(&m_mutex);
+
+    for (int i = 0; i < NumCostClasses; i++) {
+        if (!samples.pixels[i]) continue;
+
+        m_pixels[i] = decayFactor * m_pixels[i] + samples.pixels[i];
+        m_nsecs[i] = decayFactor * m_nsecs[i] + samples.nsecs[i];
+    }
+}
+
+qreal KisMergeCostEstimator::costPerPixel(CostClass costClass) const
+{
+    QMutexLocker l(&m_mutex);
+    return m_nsecs[costClass] / m_pixels[costClass];
+}
+
+qreal KisMergeCostEstimator::estimateCost(KisBaseRectsWalker &walker) const
+{
+    qreal costs[NumCostClasses];
+
+    {
+        QMutexLocker l(&m_mutex);
+        for (int i = 0; i < NumCostClasses; i++) {
+            costs[i] = m_nsecs[i] / m_pixels[i];
+        }
+    }
+
+    qreal result = 0.0;
+
+    Q_FOREACH (const KisBaseRectsWalker::JobItem &item, walker.leafStack()) {
+        const qreal area = qreal(item.m_applyRect.width()) * item.m_applyRect.height();
+        result += area * costs[classify(item)];
+    }
+
+    return result;
+}
+
+void KisMergeCostEstimator::reset()
+{
+    QMutexLocker l(&m_mutex);
+
+    for (int i = 0; i < NumCostClasses; i++) {
+        m_pixels[i] = initialWeight;
+        m_nsecs[i] = initialWeight * initialCostPerPixel[i];
+    }
+}
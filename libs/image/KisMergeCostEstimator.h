@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISMERGECOSTESTIMATOR_H
+#define KISMERGECOSTESTIMATOR_H
+
+#include <QMutex>
+
+#include "kritaimage_export.h"
+#include "kis_base_rects_walker.h"
+
+/**
+ * Keeps track of how much time KisAsyncMerger spends on every pixel of
+ * different kinds of layers and estimates the cost of a merge job
+ * from that. KisSimpleUpdateQueue uses the estimation to size the
+ * update patches so that every merge job takes roughly the same time.
+ *
+ * The costs are measured on the fly and are shared by all the images,
+ * since they depend on the machine rather than on the image itself.
+ */
+class KRITAIMAGE_EXPORT KisMergeCostEstimator
+{
+public:
+    enum CostClass {
+        /// the layer is only composited onto the projection
+        Composite = 0,
+        PaintLayer,
+        GroupLayer,
+        AdjustmentLayer,
+        GeneratorLayer,
+        CloneLayer,
+        EffectMasks,
+        LayerStyle,
+        NumCostClasses
+    };
+
+    /**
+     * Samples collected by a single merger, they are passed to the
+     * estimator in a batch to avoid locking on every layer
+     */
+    struct Samples {
+        Samples();
+
+        inline void add(CostClass costClass, qint64 pixels, qint64 nsecs) {
+            this->pixels[costClass] += pixels;
+            this->nsecs[costClass] += nsecs;
+            isEmpty = false;
+        }
+
+        void clear();
+
+        qint64 pixels[NumCostClasses];
+        qint64 nsecs[NumCostClasses];
+        bool isEmpty;
+    };
+
+public:
+    KisMergeCostEstimator();
+    static KisMergeCostEstimator* instance();
+
+    static CostClass classify(const KisBaseRectsWalker::JobItem &item);
+
+    void addSamples(const Samples &samples);
+
+    /**
+     * @return the current estimation of the cost of a pixel of
+     *         \p costClass in nanoseconds
+     */
+    qreal costPerPixel(CostClass costClass) const;
+
+    /**
+     * @return the estimated time in nanoseconds needed to merge
+     *         the rects collected by \p walker
+     */
+    qreal estimateCost(KisBaseRectsWalker &walker) const;
+
+    /**
+     * Drops all the measurements and returns to the initial guesses
+     */
+    void reset();
+
+private:
+    mutable QMutex m_mutex;
+    qreal m_pixels[NumCostClasses];
+    qreal m_nsecs[NumCostClasses];
+};
+
+#endif // KISMERGECOSTESTIMATOR_H
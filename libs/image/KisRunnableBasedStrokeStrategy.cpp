@@ -42,6 +42,10 @@ struct KisRunnableBasedStrokeStrategy::JobsInterface : public KisRunnableStrokeJ
         m_q->addMutatedJobs(newList);
     }
 
+    int threadsLimit() const {
+        return m_q->threadsLimit();
+    }
+
 private:
     KisRunnableBasedStrokeStrategy *m_q;
 };
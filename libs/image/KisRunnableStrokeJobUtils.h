@@ -19,10 +19,15 @@
 #ifndef KISRUNNABLESTROKEJOBUTILS_H
 #define KISRUNNABLESTROKEJOBUTILS_H
 
+#include <atomic>
+
 #include <QVector>
+#include <QRect>
+#include <QSharedPointer>
 
 #include "kis_stroke_job_strategy.h"
 #include "KisRunnableStrokeJobData.h"
+#include "krita_utils.h"
 
 namespace KritaUtils
 {
@@ -47,6 +52,58 @@ void addJobUniquelyCuncurrent(QVector<Job*> &jobs, Func func) {
     jobs.append(new KisRunnableStrokeJobData(func, KisStrokeJobData::UNIQUELY_CONCURRENT));
 }
 
+/**
+ * Adds concurrent jobs that call \p func for every element of \p items.
+ *
+ * Instead of creating a separate stroke job per element, only
+ * \p numWorkers jobs are created. Each of them pulls the next
+ * unprocessed element from a shared atomic counter until the batch
+ * is exhausted, so the strokes queue doesn't have to allocate and
+ * dispatch thousands of tiny jobs, and the load is still balanced
+ * between the threads. \p numWorkers should be the number of threads
+ * that run the jobs, i.e. KisStrokeStrategy::threadsLimit() or
+ * KisRunnableStrokeJobsInterface::threadsLimit().
+ *
+ * Note that the elements are not guaranteed to be processed in any
+ * specific order.
+ */
+template <typename Item, typename Func, typename Job>
+void addJobsParallelFor(QVector<Job*> &jobs, const QVector<Item> &items, int numWorkers, Func func) {
+    if (items.isEmpty()) return;
+
+    struct SharedState {
+        SharedState(const QVector<Item> &_items, Func _func)
+            : items(_items), func(_func), nextIndex(0) {}
+
+        const QVector<Item> items;
+        Func func;
+        std::atomic<int> nextIndex;
+    };
+
+    QSharedPointer<SharedState> state(new SharedState(items, func));
+
+    numWorkers = qBound(1, numWorkers, items.size());
+
+    for (int i = 0; i < numWorkers; i++) {
+        addJobConcurrent(jobs, [state] () {
+            int index;
+            while ((index = state->nextIndex.fetch_add(1, std::memory_order_relaxed)) < state->items.size()) {
+                state->func(state->items[index]);
+            }
+        });
+    }
+}
+
+/**
+ * Splits \p rc into a grid of patches of \p patchSize and adds
+ * concurrent jobs processing these patches with \p func. See
+ * addJobsParallelFor() for the details.
+ */
+template <typename Func, typename Job>
+void addJobsParallelForPatches(QVector<Job*> &jobs, const QRect &rc, const QSize &patchSize, int numWorkers, Func func) {
+    addJobsParallelFor(jobs, splitRectIntoPatchesTight(rc, patchSize), numWorkers, func);
+}
+
 }
 
 #endif // KISRUNNABLESTROKEJOBUTILS_H
@@ -38,6 +38,11 @@ public:
     void addRunnableJobs(const QVector<T*> &list) {
         this->addRunnableJobs(implicitCastList<KisRunnableStrokeJobDataBase*>(list));
     }
+
+    /**
+     * \return the number of threads the added jobs are executed on
+     */
+    virtual int threadsLimit() const = 0;
 };
 
 #endif // KISRUNNABLESTROKEJOBSINTERFACE_H
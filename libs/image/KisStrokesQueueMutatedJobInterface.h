@@ -29,6 +29,12 @@ public:
     virtual ~KisStrokesQueueMutatedJobInterface();
 
     virtual void addMutatedJobs(KisStrokeId strokeId, const QVector<KisStrokeJobData*> list) = 0;
+
+    /**
+     * \return the number of threads the jobs of the strokes are
+     *         executed on
+     */
+    virtual int threadsLimit() const = 0;
 };
 
 #endif // KISSTROKESQUEUEMUTATEDJOBINTERFACE_H
@@ -0,0 +1,386 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisWorkStealingExecutor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QRunnable>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "kis_assert.h"
+#include "KisNumaUtils.h"
+
+
+struct KisWorkStealingExecutor::Private
+{
+    class Worker : public QThread
+    {
+    public:
+        Worker(Private *_d, int _index)
+            : d(_d), index(_index)
+        {
+            setObjectName(QString("KisUpdaterWorker-%1").arg(index));
+        }
+
+        void run() override {
+            if (d->numaAware) {
+                KisNumaUtils::bindCurrentThreadToNode(index % KisNumaUtils::numNodes());
+            }
+
+            d->workerLoop(this);
+        }
+
+        Private *d;
+        const int index;
+
+        QMutex queueLock;
+        std::deque<QRunnable*> queue;
+    };
+
+    QVector<Worker*> workers;
+    int numStartedWorkers = 0;
+
+    std::atomic<int> numQueuedJobs {0};
+    std::atomic<int> numUnfinishedJobs {0};
+    std::atomic<int> numSleepingWorkers {0};
+    std::atomic<unsigned int> nextWorker {0};
+    bool shouldExit = false;
+    bool numaAware = false;
+
+    QMutex spawnLock;
+
+    QMutex sleepLock;
+    QWaitCondition sleepCondition;
+
+    QMutex doneLock;
+    QWaitCondition doneCondition;
+
+    void createWorkers(int numWorkers);
+    void stopWorkers();
+    void workerLoop(Worker *worker);
+    QRunnable* tryTakeJob(Worker *worker);
+    bool tryWithdrawJob(QRunnable *runnable);
+    void notifyJobFinished();
+    Worker* currentWorker();
+};
+
+KisWorkStealingExecutor::KisWorkStealingExecutor(int maxThreadCount)
+    : m_d(new Private)
+{
+    m_d->createWorkers(qMax(1, maxThreadCount));
+}
+
+KisWorkStealingExecutor::~KisWorkStealingExecutor()
+{
+    waitForDone();
+    m_d->stopWorkers();
+}
+
+void KisWorkStealingExecutor::start(QRunnable *runnable)
+{
+    KIS_SAFE_ASSERT_RECOVER_NOOP(!runnable->autoDelete());
+
+    m_d->numUnfinishedJobs++;
+
+    /**
+     * Spawn one more worker if all the started ones are busy. The
+     * check is racy, but in the worst case a new worker just finds
+     * nothing to do and goes to sleep.
+     */
+    if (m_d->numSleepingWorkers.load() == 0) {
+        QMutexLocker l(&m_d->spawnLock);
+        if (m_d->numStartedWorkers < m_d->workers.size()) {
+            m_d->workers[m_d->numStartedWorkers++]->start();
+        }
+    }
+
+    Private::Worker *worker = m_d->currentWorker();
+
+    if (!worker) {
+        QMutexLocker l(&m_d->spawnLock);
+        const unsigned int index = m_d->nextWorker++ % unsigned(m_d->numStartedWorkers);
+        worker = m_d->workers[int(index)];
+    }
+
+    {
+        QMutexLocker l(&worker->queueLock);
+        worker->queue.push_back(runnable);
+    }
+
+    /**
+     * The worker increments the number of sleepers before checking
+     * the number of queued jobs, and we do the opposite, so at least
+     * one of us sees the change of the other one.
+     */
+    m_d->numQueuedJobs++;
+
+    if (m_d->numSleepingWorkers.load() > 0) {
+        QMutexLocker l(&m_d->sleepLock);
+        m_d->sleepCondition.wakeOne();
+    }
+}
+
+namespace {
+
+struct ConcurrentBatch
+{
+    ConcurrentBatch(const QVector<std::function<void()>> &_tasks)
+        : tasks(_tasks)
+    {
+    }
+
+    void runTasks() {
+        int index = 0;
+        while ((index = nextTask++) < tasks.size()) {
+            tasks[index]();
+        }
+    }
+
+    const QVector<std::function<void()>> &tasks;
+    std::atomic<int> nextTask {0};
+
+    QMutex lock;
+    QWaitCondition helpersFinished;
+    int numActiveHelpers = 0;
+};
+
+class ConcurrentBatchHelper : public QRunnable
+{
+public:
+    ConcurrentBatchHelper(ConcurrentBatch *batch)
+        : m_batch(batch)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override {
+        m_batch->runTasks();
+
+        QMutexLocker l(&m_batch->lock);
+        if (--m_batch->numActiveHelpers == 0) {
+            m_batch->helpersFinished.wakeAll();
+        }
+    }
+
+private:
+    ConcurrentBatch *m_batch;
+};
+
+}
+
+void KisWorkStealingExecutor::runConcurrently(const QVector<std::function<void()>> &tasks)
+{
+    ConcurrentBatch batch(tasks);
+
+    const int numHelpers = qMin(tasks.size(), m_d->workers.size()) - 1;
+
+    std::vector<std::unique_ptr<ConcurrentBatchHelper>> helpers;
+    batch.numActiveHelpers = qMax(0, numHelpers);
+
+    for (int i = 0; i < numHelpers; i++) {
+        helpers.emplace_back(new ConcurrentBatchHelper(&batch));
+        start(helpers.back().get());
+    }
+
+    batch.runTasks();
+
+    /**
+     * All the tasks have been taken, the helpers still waiting in
+     * the queues will find nothing to do, so just take them back
+     */
+    for (auto it = helpers.begin(); it != helpers.end(); ++it) {
+        if (m_d->tryWithdrawJob(it->get())) {
+            m_d->notifyJobFinished();
+
+            QMutexLocker l(&batch.lock);
+            batch.numActiveHelpers--;
+        }
+    }
+
+    QMutexLocker l(&batch.lock);
+    while (batch.numActiveHelpers > 0) {
+        batch.helpersFinished.wait(&batch.lock);
+    }
+}
+
+void KisWorkStealingExecutor::waitForDone()
+{
+    QMutexLocker l(&m_d->doneLock);
+    while (m_d->numUnfinishedJobs.load() > 0) {
+        m_d->doneCondition.wait(&m_d->doneLock);
+    }
+}
+
+void KisWorkStealingExecutor::setMaxThreadCount(int value)
+{
+    value = qMax(1, value);
+    if (value == m_d->workers.size()) return;
+
+    waitForDone();
+    m_d->stopWorkers();
+    m_d->createWorkers(value);
+}
+
+int KisWorkStealingExecutor::maxThreadCount() const
+{
+    return m_d->workers.size();
+}
+
+void KisWorkStealingExecutor::setNumaAware(bool value)
+{
+    if (value == m_d->numaAware) return;
+
+    const int numWorkers = m_d->workers.size();
+
+    waitForDone();
+    m_d->stopWorkers();
+    m_d->numaAware = value;
+    m_d->createWorkers(numWorkers);
+}
+
+bool KisWorkStealingExecutor::numaAware() const
+{
+    return m_d->numaAware;
+}
+
+void KisWorkStealingExecutor::Private::createWorkers(int numWorkers)
+{
+    KIS_SAFE_ASSERT_RECOVER_NOOP(workers.isEmpty());
+
+    shouldExit = false;
+    numStartedWorkers = 0;
+
+    for (int i = 0; i < numWorkers; i++) {
+        workers << new Worker(this, i);
+    }
+}
+
+void KisWorkStealingExecutor::Private::stopWorkers()
+{
+    {
+        QMutexLocker l(&sleepLock);
+        shouldExit = true;
+        sleepCondition.wakeAll();
+    }
+
+    Q_FOREACH (Worker *worker, workers) {
+        worker->wait();
+        KIS_SAFE_ASSERT_RECOVER_NOOP(worker->queue.empty());
+    }
+
+    qDeleteAll(workers);
+    workers.clear();
+    numStartedWorkers = 0;
+}
+
+void KisWorkStealingExecutor::Private::workerLoop(Worker *worker)
+{
+    while (1) {
+        QRunnable *job = tryTakeJob(worker);
+
+        if (job) {
+            job->run();
+            notifyJobFinished();
+            continue;
+        }
+
+        QMutexLocker l(&sleepLock);
+        if (shouldExit) break;
+
+        numSleepingWorkers++;
+        if (numQueuedJobs.load() <= 0) {
+            sleepCondition.wait(&sleepLock);
+        }
+        numSleepingWorkers--;
+    }
+}
+
+QRunnable* KisWorkStealingExecutor::Private::tryTakeJob(Worker *worker)
+{
+    if (numQueuedJobs.load() <= 0) return 0;
+
+    QRunnable *job = 0;
+
+    {
+        QMutexLocker l(&worker->queueLock);
+        if (!worker->queue.empty()) {
+            job = worker->queue.back();
+            worker->queue.pop_back();
+        }
+    }
+
+    /**
+     * Our own deque is empty, steal the oldest job of some other
+     * worker. The deques of the workers that haven't been started
+     * yet are always empty, but checking them is cheap.
+     */
+    for (int i = 1; !job && i < workers.size(); i++) {
+        Worker *victim = workers[(worker->index + i) % workers.size()];
+
+        QMutexLocker l(&victim->queueLock);
+        if (!victim->queue.empty()) {
+            job = victim->queue.front();
+            victim->queue.pop_front();
+        }
+    }
+
+    if (job) {
+        numQueuedJobs--;
+    }
+
+    return job;
+}
+
+bool KisWorkStealingExecutor::Private::tryWithdrawJob(QRunnable *runnable)
+{
+    Q_FOREACH (Worker *worker, workers) {
+        QMutexLocker l(&worker->queueLock);
+
+        auto it = std::find(worker->queue.begin(), worker->queue.end(), runnable);
+        if (it != worker->queue.end()) {
+            worker->queue.erase(it);
+            numQueuedJobs--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void KisWorkStealingExecutor::Private::notifyJobFinished()
+{
+    if (--numUnfinishedJobs == 0) {
+        QMutexLocker l(&doneLock);
+        doneCondition.wakeAll();
+    }
+}
+
+KisWorkStealingExecutor::Private::Worker* KisWorkStealingExecutor::Private::currentWorker()
+{
+    Worker *worker = dynamic_cast<Worker*>(QThread::currentThread());
+    return worker && worker->d == this ? worker : 0;
+}
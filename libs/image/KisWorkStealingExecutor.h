@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISWORKSTEALINGEXECUTOR_H
+#define KISWORKSTEALINGEXECUTOR_H
+
+#include <functional>
+
+#include <QScopedPointer>
+#include <QVector>
+
+#include "kritaimage_export.h"
+
+class QRunnable;
+
+/**
+ * A thread pool for the jobs of the updater context. It replaces
+ * QThreadPool, which keeps all the queued jobs in a single queue
+ * guarded by a single mutex and lets its idle threads expire.
+ *
+ * Every worker thread has its own deque of jobs. The jobs started
+ * from within a worker thread are pushed to the deque of this
+ * worker, the other ones are distributed between the workers in a
+ * round-robin manner. A worker takes the jobs from the back of its
+ * own deque and, when it is empty, steals them from the front of
+ * the deques of the other workers.
+ *
+ * The worker threads are started lazily, when there is no idle
+ * worker to take a new job, and live until the executor is
+ * destroyed or the number of threads is changed.
+ *
+ * NOTE: the executor never deletes the runnables, so they must
+ *       have autoDelete() disabled.
+ */
+class KRITAIMAGE_EXPORT KisWorkStealingExecutor
+{
+public:
+    KisWorkStealingExecutor(int maxThreadCount = 1);
+    ~KisWorkStealingExecutor();
+
+    /**
+     * Queues \p runnable for execution on one of the worker threads
+     */
+    void start(QRunnable *runnable);
+
+    /**
+     * Executes \p tasks concurrently and returns when all of them
+     * are finished. The calling thread executes the tasks itself,
+     * while the idle workers of the executor help it. The helpers
+     * that haven't been picked up by the moment the caller runs out
+     * of tasks are just withdrawn, so the function never waits for
+     * the workers busy with other jobs and is safe to call from
+     * within a job of the executor.
+     */
+    void runConcurrently(const QVector<std::function<void()>> &tasks);
+
+    /**
+     * Blocks the caller until all the queued jobs are finished
+     */
+    void waitForDone();
+
+    /**
+     * Changes the number of worker threads. Waits until all
+     * the queued jobs are finished and stops the current workers.
+     */
+    void setMaxThreadCount(int value);
+    int maxThreadCount() const;
+
+    /**
+     * When enabled, the workers are distributed between the NUMA nodes
+     * of the machine in a round-robin manner and every worker is bound
+     * to the CPUs of its node. Waits until all the queued jobs are
+     * finished and restarts the workers.
+     *
+     * \see KisNumaUtils
+     */
+    void setNumaAware(bool value);
+    bool numaAware() const;
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif // KISWORKSTEALINGEXECUTOR_H
@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisConvertColorSpaceDevicesCommand.h"
+
+#include <QMutex>
+#include <klocalizedstring.h>
+
+#include "kis_image.h"
+#include "kis_paint_device.h"
+#include "kis_undo_adapter.h"
+#include "kis_composite_progress_proxy.h"
+#include "krita_utils.h"
+#include <KisRegion.h>
+#include "KisEtaProgressReporter.h"
+#include "KisRunnableStrokeJobData.h"
+#include "KisRunnableStrokeJobUtils.h"
+#include "KisRunnableStrokeJobsInterface.h"
+
+
+namespace {
+
+struct DeviceConversion {
+    KisPaintDeviceSP device;
+    QSharedPointer<KisPaintDevice::ColorSpaceConversionStruct> conversion;
+};
+
+struct ConversionPatch {
+    ConversionPatch() : deviceIndex(-1) {}
+    ConversionPatch(int _deviceIndex, const QRect &_rect) : deviceIndex(_deviceIndex), rect(_rect) {}
+
+    int deviceIndex;
+    QRect rect;
+};
+
+}
+
+struct KisConvertColorSpaceDevicesCommand::Private
+{
+    struct Request {
+        vKisPaintDeviceSP devices;
+        KisUndoAdapter *undoAdapter = 0;
+        KUndo2Command *postConversionCommand = 0;
+    };
+
+    ~Private() {
+        Q_FOREACH (const Request &request, requests) {
+            delete request.postConversionCommand;
+        }
+    }
+
+    KisImageWSP image;
+    const KoColorSpace *dstColorSpace = 0;
+    KoColorConversionTransformation::Intent renderingIntent;
+    KoColorConversionTransformation::ConversionFlags conversionFlags;
+
+    QMutex mutex;
+    QVector<Request> requests;
+    bool firstRun = true;
+
+    QVector<DeviceConversion> conversions;
+    QSharedPointer<KisEtaProgressReporter> progress;
+
+    void uploadConversions();
+};
+
+void KisConvertColorSpaceDevicesCommand::Private::uploadConversions()
+{
+    int deviceIndex = 0;
+
+    for (auto it = requests.begin(); it != requests.end(); ++it) {
+        KUndo2Command *cmd = new KUndo2Command();
+
+        for (int i = 0; i < it->devices.size(); i++) {
+            const DeviceConversion &conversion = conversions[deviceIndex++];
+            conversion.device->uploadColorSpaceConversionStruct(conversion.conversion.data(), cmd);
+        }
+
+        it->undoAdapter->addCommand(cmd);
+
+        if (it->postConversionCommand) {
+            it->undoAdapter->addCommand(it->postConversionCommand);
+            it->postConversionCommand = 0;
+        }
+    }
+
+    conversions.clear();
+
+    if (progress) {
+        progress->finish();
+        progress.clear();
+    }
+}
+
+KisConvertColorSpaceDevicesCommand::KisConvertColorSpaceDevicesCommand(KisImageWSP image,
+                                                                       const KoColorSpace *dstColorSpace,
+                                                                       KoColorConversionTransformation::Intent renderingIntent,
+                                                                       KoColorConversionTransformation::ConversionFlags conversionFlags,
+                                                                       KUndo2Command *parent)
+    : KUndo2Command(parent),
+      m_d(new Private)
+{
+    m_d->image = image;
+    m_d->dstColorSpace = dstColorSpace;
+    m_d->renderingIntent = renderingIntent;
+    m_d->conversionFlags = conversionFlags;
+}
+
+KisConvertColorSpaceDevicesCommand::~KisConvertColorSpaceDevicesCommand()
+{
+}
+
+void KisConvertColorSpaceDevicesCommand::addDevices(const vKisPaintDeviceSP &devices,
+                                                    KisUndoAdapter *undoAdapter,
+                                                    KUndo2Command *postConversionCommand)
+{
+    Private::Request request;
+
+    Q_FOREACH (KisPaintDeviceSP device, devices) {
+        if (device && !request.devices.contains(device)) {
+            request.devices << device;
+        }
+    }
+
+    request.undoAdapter = undoAdapter;
+    request.postConversionCommand = postConversionCommand;
+
+    QMutexLocker l(&m_d->mutex);
+    m_d->requests << request;
+}
+
+void KisConvertColorSpaceDevicesCommand::redo()
+{
+    if (!m_d->firstRun) return;
+    m_d->firstRun = false;
+
+    KIS_SAFE_ASSERT_RECOVER_RETURN(runnableJobsInterface());
+
+    const QSize patchSize = KritaUtils::optimalPatchSize();
+
+    QVector<ConversionPatch> patches;
+    qint64 totalPixels = 0;
+
+    Q_FOREACH (const Private::Request &request, m_d->requests) {
+        Q_FOREACH (KisPaintDeviceSP device, request.devices) {
+            DeviceConversion conversion;
+            conversion.device = device;
+            conversion.conversion.reset(
+                device->createColorSpaceConversionStruct(m_d->dstColorSpace,
+                                                         m_d->renderingIntent,
+                                                         m_d->conversionFlags));
+
+            const int deviceIndex = m_d->conversions.size();
+            m_d->conversions << conversion;
+
+            const KisRegion region = device->regionForColorSpaceConversion(conversion.conversion.data());
+            Q_FOREACH (const QRect &rc, KritaUtils::splitRegionIntoPatches(region, patchSize)) {
+                patches << ConversionPatch(deviceIndex, rc);
+                totalPixels += qint64(rc.width()) * rc.height();
+            }
+        }
+    }
+
+    KisImageSP image = m_d->image.toStrongRef();
+    if (image && totalPixels > 0) {
+        m_d->progress.reset(new KisEtaProgressReporter(image->compositeProgressProxy(),
+                                                       i18n("Converting color space")),
+                            &QObject::deleteLater);
+        m_d->progress->moveToThread(image->thread());
+        m_d->progress->start(totalPixels);
+    }
+
+    QSharedPointer<Private> d = m_d;
+    QVector<KisRunnableStrokeJobDataBase*> jobsData;
+
+    KritaUtils::addJobsParallelFor(jobsData, patches, runnableJobsInterface()->threadsLimit(),
+                                   [d] (const ConversionPatch &patch) {
+        const DeviceConversion &conversion = d->conversions[patch.deviceIndex];
+        conversion.device->updateColorSpaceConversionStruct(conversion.conversion.data(), patch.rect);
+
+        if (d->progress) {
+            d->progress->addProgress(qint64(patch.rect.width()) * patch.rect.height());
+        }
+    });
+
+    KritaUtils::addJobBarrier(jobsData, [d] () {
+        d->uploadConversions();
+    });
+
+    runnableJobsInterface()->addRunnableJobs(jobsData);
+}
+
+void KisConvertColorSpaceDevicesCommand::undo()
+{
+    /**
+     * The conversion has been undone by the commands it added
+     * to the undo adapters of the nodes
+     */
+}
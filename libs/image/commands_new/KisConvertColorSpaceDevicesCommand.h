@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KISCONVERTCOLORSPACEDEVICESCOMMAND_H
+#define KISCONVERTCOLORSPACEDEVICESCOMMAND_H
+
+#include <kundo2command.h>
+#include <KoColorConversionTransformation.h>
+#include <QSharedPointer>
+
+#include "kis_types.h"
+#include "kis_stroke_strategy_undo_command_based.h"
+
+class KoColorSpace;
+class KisUndoAdapter;
+
+
+/**
+ * Converts the color space of a set of paint devices in parallel.
+ *
+ * The devices are collected with addDevices() (usually by
+ * KisConvertColorSpaceProcessingVisitor, which may run concurrently
+ * for different nodes). When the command is executed for the first
+ * time in a KisStrokeStrategyUndoCommandBased stroke, it splits every
+ * device into tile-aligned patches and adds a batch of concurrent jobs
+ * converting them, followed by a barrier job that switches the devices
+ * to the converted data.
+ *
+ * The undo information of every device is not stored in the command
+ * itself, it is added to the undo adapter passed to addDevices(), so
+ * that it is undone together with the rest of the node's changes.
+ * Therefore undo() and all the subsequent redo() calls do nothing.
+ */
+class KRITAIMAGE_EXPORT KisConvertColorSpaceDevicesCommand : public KUndo2Command, public KisStrokeStrategyUndoCommandBased::MutatedCommandInterface
+{
+public:
+    KisConvertColorSpaceDevicesCommand(KisImageWSP image,
+                                       const KoColorSpace *dstColorSpace,
+                                       KoColorConversionTransformation::Intent renderingIntent,
+                                       KoColorConversionTransformation::ConversionFlags conversionFlags,
+                                       KUndo2Command *parent = 0);
+    ~KisConvertColorSpaceDevicesCommand() override;
+
+    /**
+     * Schedules conversion of \p devices. The resulting undo command is
+     * added to \p undoAdapter, followed by \p postConversionCommand, if
+     * any. The command takes ownership of \p postConversionCommand.
+     *
+     * The method is thread-safe.
+     */
+    void addDevices(const vKisPaintDeviceSP &devices,
+                    KisUndoAdapter *undoAdapter,
+                    KUndo2Command *postConversionCommand = 0);
+
+    void redo() override;
+    void undo() override;
+
+private:
+    struct Private;
+    QSharedPointer<Private> m_d;
+};
+
+#endif // KISCONVERTCOLORSPACEDEVICESCOMMAND_H
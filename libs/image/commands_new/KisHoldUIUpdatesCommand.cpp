@@ -65,11 +65,10 @@ void KisHoldUIUpdatesCommand::partB()
     QSharedPointer<bool> batchUpdateStarted = m_batchUpdateStarted;
 
     QVector<KisRunnableStrokeJobDataBase*> jobsData;
-    Q_FOREACH (const QRect &rc, totalDirtyRects) {
-        KritaUtils::addJobConcurrent(jobsData, [updatesFacade, rc] () {
-            updatesFacade->notifyUIUpdateCompleted(rc);
-        });
-    }
+    KritaUtils::addJobsParallelFor(jobsData, totalDirtyRects, runnableJobsInterface()->threadsLimit(),
+                                   [updatesFacade] (const QRect &rc) {
+        updatesFacade->notifyUIUpdateCompleted(rc);
+    });
 
     KritaUtils::addJobBarrier(jobsData, [updatesFacade, batchUpdateStarted] () {
         updatesFacade->notifyBatchUpdateEnded();
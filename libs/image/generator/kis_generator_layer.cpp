@@ -36,6 +36,7 @@
 #include "kis_thread_safe_signal_compressor.h"
 #include "kis_recalculate_generator_layer_job.h"
 #include "kis_generator_stroke_strategy.h"
+#include <KisRunnableStrokeJobData.h>
 
 #define UPDATE_DELAY 100 /*ms */
 
@@ -139,9 +140,11 @@ void KisGeneratorLayer::update()
 
     auto rc = processRegion.begin();
     while (rc != processRegion.end()) {
-        QList<KisStrokeJobData *> jobs = KisGeneratorStrokeStrategy::createJobsData(this, cookie, f, originalDevice, *rc, filterConfig);
+        QVector<KisRunnableStrokeJobData *> jobs =
+            KisGeneratorStrokeStrategy::createJobsData(this, cookie, f, originalDevice, *rc, filterConfig,
+                                                       image->workingThreadsLimit());
 
-        Q_FOREACH (KisStrokeJobData *job, jobs) {
+        Q_FOREACH (KisRunnableStrokeJobData *job, jobs) {
             image->addJob(strokeId, job);
         }
 
@@ -23,42 +23,13 @@
 #include <kis_processing_information.h>
 #include <kis_selection.h>
 #include <krita_utils.h>
+#include <KisRunnableStrokeJobData.h>
+#include <KisRunnableStrokeJobUtils.h>
 
 #include "kis_generator_stroke_strategy.h"
 
-struct KisGeneratorStrokeStrategy::Private {
-    class ProcessData : public KisStrokeJobData
-    {
-    public:
-        ProcessData(KisGeneratorLayerSP _layer,
-            QSharedPointer<bool> _cookie,
-            KisGeneratorSP _f,
-            KisProcessingInformation &_dstCfg,
-            QRect _rect,
-            KisFilterConfigurationSP _filterConfig, QSharedPointer<KisProcessingVisitor::ProgressHelper> _helper)
-            : KisStrokeJobData(CONCURRENT)
-            , layer(_layer)
-            , f(_f)
-            , dstCfg(_dstCfg)
-            , tile(_rect)
-            , filterConfig(_filterConfig)
-            , helper(_helper)
-            , cookie(_cookie)
-        {
-        }
-
-        KisGeneratorLayerSP layer;
-        KisGeneratorSP f;
-        KisProcessingInformation dstCfg;
-        QRect tile;
-        KisFilterConfigurationSP filterConfig;
-        QSharedPointer<KisProcessingVisitor::ProgressHelper> helper;
-        QSharedPointer<bool> cookie;
-    };
-};
-
 KisGeneratorStrokeStrategy::KisGeneratorStrokeStrategy(KisImageWSP image)
-    : KisSimpleStrokeStrategy(QLatin1String("KisGenerator"))
+    : KisRunnableBasedStrokeStrategy(QLatin1String("KisGenerator"))
     , m_image(image)
 {
     enableJob(KisSimpleStrokeStrategy::JOB_INIT, true, KisStrokeJobData::BARRIER, KisStrokeJobData::EXCLUSIVE);
@@ -69,29 +40,33 @@ KisGeneratorStrokeStrategy::KisGeneratorStrokeStrategy(KisImageWSP image)
     setCanForgetAboutMe(false);
 }
 
-QList<KisStrokeJobData *> KisGeneratorStrokeStrategy::createJobsData(KisGeneratorLayerSP layer, QSharedPointer<bool> cookie, KisGeneratorSP f, KisPaintDeviceSP dev, const QRect &rc, const KisFilterConfigurationSP filterConfig)
+QVector<KisRunnableStrokeJobData *> KisGeneratorStrokeStrategy::createJobsData(KisGeneratorLayerSP layer, QSharedPointer<bool> cookie, KisGeneratorSP f, KisPaintDeviceSP dev, const QRect &rc, const KisFilterConfigurationSP filterConfig, int numWorkers)
 {
-    QList<KisStrokeJobData *> jobsData;
+    QVector<KisRunnableStrokeJobData *> jobsData;
 
     QSharedPointer<KisProcessingVisitor::ProgressHelper> helper(new KisProcessingVisitor::ProgressHelper(layer));
 
-    if (f->allowsSplittingIntoPatches())
-    {
+    auto generateTile = [layer, cookie, f, dev, filterConfig, helper] (const QRect &tile) {
+        KisProcessingInformation dstCfg(dev, tile.topLeft(), KisSelectionSP());
+        f->generate(dstCfg, tile.size(), filterConfig, helper->updater());
+
+        // HACK ALERT!!!
+        // this avoids cyclic loop with KisRecalculateGeneratorLayerJob::run()
+        layer->setDirty(QVector<QRect>({tile}));
+    };
+
+    if (f->allowsSplittingIntoPatches()) {
         using KritaUtils::optimalPatchSize;
         using KritaUtils::splitRectIntoPatches;
 
-        QVector<QRect> tiles = splitRectIntoPatches(rc, optimalPatchSize());
-
-        Q_FOREACH (const QRect &tile, tiles)
-        {
-            KisProcessingInformation dstCfg(dev, tile.topLeft(), KisSelectionSP());
-            jobsData << new Private::ProcessData(layer, cookie, f, dstCfg, tile, filterConfig, helper);
-        }
-    }
-    else
-    {
-        KisProcessingInformation dstCfg(dev, rc.topLeft(), KisSelectionSP());
-        jobsData << new Private::ProcessData(layer, cookie, f, dstCfg, rc, filterConfig, helper);
+        KritaUtils::addJobsParallelFor(jobsData,
+                                       splitRectIntoPatches(rc, optimalPatchSize()),
+                                       numWorkers,
+                                       generateTile);
+    } else {
+        KritaUtils::addJobConcurrent(jobsData, [generateTile, rc] () {
+            generateTile(rc);
+        });
     }
 
     return jobsData;
@@ -104,17 +79,3 @@ KisGeneratorStrokeStrategy::~KisGeneratorStrokeStrategy()
 void KisGeneratorStrokeStrategy::initStrokeCallback()
 {
 }
-
-void KisGeneratorStrokeStrategy::doStrokeCallback(KisStrokeJobData *data)
-{
-    Private::ProcessData *d_pd = dynamic_cast<Private::ProcessData *>(data);
-    if (d_pd) {
-        d_pd->cookie.clear();
-        d_pd->f->generate(d_pd->dstCfg, d_pd->tile.size(), d_pd->filterConfig, d_pd->helper->updater());
-
-        // HACK ALERT!!!
-        // this avoids cyclic loop with KisRecalculateGeneratorLayerJob::run()
-        d_pd->layer->setDirty(QVector<QRect>({d_pd->tile}));
-        return;
-    }
-}
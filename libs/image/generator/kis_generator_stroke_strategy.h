@@ -22,22 +22,28 @@
 #include <QSharedPointer>
 #include <kis_generator.h>
 #include <kis_generator_layer.h>
-#include "kis_simple_stroke_strategy.h"
+#include "KisRunnableBasedStrokeStrategy.h"
 
-class KisGeneratorStrokeStrategy: public QObject, public KisSimpleStrokeStrategy
+class KisRunnableStrokeJobData;
+
+class KisGeneratorStrokeStrategy: public QObject, public KisRunnableBasedStrokeStrategy
 {
     Q_OBJECT
 public:
     KisGeneratorStrokeStrategy(KisImageWSP image);
     ~KisGeneratorStrokeStrategy() override;
 
-    static QList<KisStrokeJobData *> createJobsData(KisGeneratorLayerSP layer, QSharedPointer<bool> cookie, KisGeneratorSP f, KisPaintDeviceSP dev, const QRect &rc, const KisFilterConfigurationSP filterConfig);
+    /**
+     * Creates the jobs generating \p rc of \p dev. When the generator
+     * allows splitting, the patches of the rect are processed by
+     * \p numWorkers concurrent jobs. \p cookie is held until the last
+     * of the jobs is done.
+     */
+    static QVector<KisRunnableStrokeJobData *> createJobsData(KisGeneratorLayerSP layer, QSharedPointer<bool> cookie, KisGeneratorSP f, KisPaintDeviceSP dev, const QRect &rc, const KisFilterConfigurationSP filterConfig, int numWorkers);
 
 private:
     void initStrokeCallback() override;
-    void doStrokeCallback(KisStrokeJobData *data) override;
 
 private:
-    struct Private;
     KisImageSP m_image;
 };
@@ -19,8 +19,11 @@
 #include "kis_async_merger.h"
 
 
+#include <vector>
+
 #include <kis_debug.h>
 #include <QBitArray>
+#include <QElapsedTimer>
 
 #include <KoChannelInfo.h>
 #include <KoCompositeOpRegistry.h>
@@ -44,6 +47,11 @@
 
 #include "kis_merge_walker.h"
 #include "kis_refresh_subtree_walker.h"
+#include "kis_full_refresh_walker.h"
+#include "KisWorkStealingExecutor.h"
+#include "KisBelowLayersCache.h"
+#include "KisTraceRecorder.h"
+#include "KisMergeCostEstimator.h"
 
 #include "kis_abstract_projection_plane.h"
 
@@ -216,11 +224,115 @@ private:
 /*                     KisAsyncMerger                                */
 /*********************************************************************/
 
+/**
+ * The size of the blocks a huge merge is split into. It is a multiple
+ * of the tile size, so the blocks never write into the same tiles.
+ */
+static const int PARALLEL_MERGE_BLOCK_SIZE = 256;
+
+/**
+ * Only the merges bigger than this area are split. Smaller ones are
+ * already split into patches by KisSimpleUpdateQueue, and the walkers
+ * are not free to collect.
+ */
+static const qint64 PARALLEL_MERGE_MIN_AREA = 1024 * 1024;
+
+void KisAsyncMerger::setParallelExecutor(KisWorkStealingExecutor *executor)
+{
+    m_parallelExecutor = executor;
+}
+
+bool KisAsyncMerger::tryStartParallelMerge(KisBaseRectsWalker &walker, bool notifyClones)
+{
+    if (!m_parallelExecutor || m_parallelExecutor->maxThreadCount() < 2) return false;
+
+    const KisBaseRectsWalker::UpdateType type = walker.type();
+    if (type == KisBaseRectsWalker::UNSUPPORTED) return false;
+
+    const QRect rc = walker.requestedRect();
+    if (qint64(rc.width()) * rc.height() < PARALLEL_MERGE_MIN_AREA) return false;
+
+    const int blockSize = PARALLEL_MERGE_BLOCK_SIZE;
+    auto alignDown = [blockSize] (int value) {
+        return value >= 0 ? value / blockSize * blockSize : -((-value + blockSize - 1) / blockSize * blockSize);
+    };
+
+    QVector<KisBaseRectsWalkerSP> walkers;
+
+    for (int y = alignDown(rc.top()); y <= rc.bottom(); y += blockSize) {
+        for (int x = alignDown(rc.left()); x <= rc.right(); x += blockSize) {
+            const QRect blockRect(x, y, blockSize, blockSize);
+            const QRect subRect = rc & blockRect;
+            if (subRect.isEmpty()) continue;
+
+            KisBaseRectsWalkerSP subWalker;
+
+            if (type == KisBaseRectsWalker::UPDATE) {
+                subWalker = new KisMergeWalker(walker.cropRect(), KisMergeWalker::DEFAULT);
+            } else if (type == KisBaseRectsWalker::UPDATE_NO_FILTHY) {
+                subWalker = new KisMergeWalker(walker.cropRect(), KisMergeWalker::NO_FILTHY);
+            } else {
+                subWalker = new KisFullRefreshWalker(walker.cropRect());
+            }
+
+            subWalker->collectRects(walker.startNode(), subRect);
+
+            /**
+             * The blocks can be merged independently only if none of
+             * them needs or changes the pixels of its neighbours,
+             * that is there are no blurring filters, layer styles and
+             * so on in the graph. Otherwise just merge it as a whole.
+             */
+            auto fitsBlock = [blockRect] (const QRect &rect) {
+                return rect.isEmpty() || blockRect.contains(rect);
+            };
+
+            if (!fitsBlock(subWalker->accessRect()) ||
+                !fitsBlock(subWalker->changeRect()) ||
+                subWalker->levelOfDetail() != walker.levelOfDetail()) {
+
+                return false;
+            }
+
+            walkers.append(subWalker);
+        }
+    }
+
+    std::vector<KisAsyncMerger> mergers(walkers.size());
+    QVector<std::function<void()>> tasks;
+
+    for (int i = 0; i < walkers.size(); i++) {
+        KisAsyncMerger *merger = &mergers[i];
+        KisBaseRectsWalkerSP subWalker = walkers[i];
+
+        tasks.append([merger, subWalker] () {
+            merger->startMerge(*subWalker, false);
+        });
+    }
+
+    m_parallelExecutor->runConcurrently(tasks);
+
+    if (notifyClones) {
+        Q_FOREACH (KisBaseRectsWalkerSP subWalker, walkers) {
+            doNotifyClones(*subWalker);
+        }
+    }
+
+    return true;
+}
+
 void KisAsyncMerger::startMerge(KisBaseRectsWalker &walker, bool notifyClones) {
+    KIS_TRACE_SPAN("merger", "merge walker");
+
+    if (tryStartParallelMerge(walker, notifyClones)) return;
+
     KisMergeWalker::LeafStack &leafStack = walker.leafStack();
 
     const bool useTempProjections = walker.needRectVaries();
 
+    KisMergeCostEstimator::Samples costSamples;
+    QElapsedTimer costTimer;
+
     while(!leafStack.isEmpty()) {
         KisMergeWalker::JobItem item = leafStack.pop();
         KisProjectionLeafSP currentLeaf = item.m_leaf;
@@ -259,8 +371,15 @@ void KisAsyncMerger::startMerge(KisBaseRectsWalker &walker, bool notifyClones) {
 
         if (!m_currentProjection) {
             setupProjection(currentLeaf, applyRect, useTempProjections);
+
+            if (processBelowLayersCached(leafStack, item, useTempProjections,
+                                         walker.levelOfDetail())) {
+                continue;
+            }
         }
 
+        costTimer.start();
+
         KisUpdateOriginalVisitor originalVisitor(applyRect,
                                                  m_currentProjection,
                                                  walker.cropRect());
@@ -294,6 +413,10 @@ void KisAsyncMerger::startMerge(KisBaseRectsWalker &walker, bool notifyClones) {
 
         compositeWithProjection(currentLeaf, applyRect);
 
+        costSamples.add(KisMergeCostEstimator::classify(item),
+                        qint64(applyRect.width()) * applyRect.height(),
+                        costTimer.nsecsElapsed());
+
         if(item.m_position & KisMergeWalker::N_TOPMOST) {
             writeProjection(currentLeaf, useTempProjections, applyRect);
             resetProjection();
@@ -304,6 +427,8 @@ void KisAsyncMerger::startMerge(KisBaseRectsWalker &walker, bool notifyClones) {
                  walker.levelOfDetail());
     }
 
+    KisMergeCostEstimator::instance()->addSamples(costSamples);
+
     if(notifyClones) {
         doNotifyClones(walker);
     }
@@ -374,6 +499,92 @@ bool KisAsyncMerger::compositeWithProjection(KisProjectionLeafSP leaf, const QRe
     return true;
 }
 
+/**
+ * Caching the composition of one or two layers is not worth
+ * an extra copy of the pixels
+ */
+static const int MIN_CACHED_BELOW_LAYERS = 3;
+
+bool KisAsyncMerger::processBelowLayersCached(KisBaseRectsWalker::LeafStack &leafStack,
+                                              const KisBaseRectsWalker::JobItem &firstItem,
+                                              bool useTempProjection, int levelOfDetail)
+{
+    KisProjectionLeafSP parentLeaf = firstItem.m_leaf->parent();
+    KisGroupLayer *group = parentLeaf ? dynamic_cast<KisGroupLayer*>(parentLeaf->node().data()) : 0;
+    if (!group) return false;
+
+    KisBelowLayersCache *cache = group->belowLayersCache();
+    if (!cache->isEnabled()) return false;
+
+    /**
+     * The level of the group is starting. Collect the layers below
+     * the one the update comes through. They are on the top of the
+     * stack, the bottommost one has already been popped.
+     */
+    const QRect rect = firstItem.m_applyRect;
+
+    KisBelowLayersCache::Key key;
+    key.levelOfDetail = levelOfDetail;
+
+    auto isCacheableBelowItem = [rect] (const KisBaseRectsWalker::JobItem &item) {
+        return (item.m_position & KisBaseRectsWalker::N_BELOW_FILTHY) &&
+            !(item.m_position & (KisBaseRectsWalker::N_TOPMOST | KisBaseRectsWalker::N_EXTRA)) &&
+            item.m_applyRect == rect;
+    };
+
+    int index = leafStack.size() - 1;
+
+    if (isCacheableBelowItem(firstItem)) {
+        key.belowNodes << firstItem.m_leaf->node().data();
+
+        for (; index >= 0 && isCacheableBelowItem(leafStack[index]); index--) {
+            key.belowNodes << leafStack[index].m_leaf->node().data();
+        }
+    }
+
+    const bool hasAboveItem =
+        !key.belowNodes.isEmpty() && index >= 0 &&
+        (leafStack[index].m_position & (KisBaseRectsWalker::N_FILTHY |
+                                        KisBaseRectsWalker::N_FILTHY_PROJECTION)) &&
+        !(leafStack[index].m_position & KisBaseRectsWalker::N_EXTRA);
+
+    /**
+     * Any other kind of the group's merge means that something
+     * might have changed in its lower layers
+     */
+    if (!hasAboveItem ||
+        key.belowNodes.size() < MIN_CACHED_BELOW_LAYERS ||
+        useTempProjection || !m_currentProjection) {
+
+        cache->invalidate();
+        return false;
+    }
+
+    key.aboveNode = leafStack[index].m_leaf->node().data();
+
+    const int numBelowLayers = key.belowNodes.size();
+
+    if (cache->tryFetch(key, rect, m_currentProjection)) {
+        DEBUG_NODE_ACTION("Fetched from cache", numBelowLayers, firstItem.m_leaf, rect);
+
+        for (int i = 1; i < numBelowLayers; i++) {
+            leafStack.pop();
+        }
+        return true;
+    }
+
+    compositeWithProjection(firstItem.m_leaf, rect);
+
+    for (int i = 1; i < numBelowLayers; i++) {
+        KisBaseRectsWalker::JobItem item = leafStack.pop();
+        compositeWithProjection(item.m_leaf, rect);
+    }
+
+    cache->store(key, rect, m_currentProjection);
+
+    return true;
+}
+
 void KisAsyncMerger::doNotifyClones(KisBaseRectsWalker &walker) {
     KisBaseRectsWalker::CloneNotificationsVector &vector =
         walker.cloneNotifications();
@@ -21,21 +21,35 @@
 
 #include "kritaimage_export.h"
 #include "kis_types.h"
+#include "kis_base_rects_walker.h"
 
 class QRect;
 class KisBaseRectsWalker;
+class KisWorkStealingExecutor;
 
 class KRITAIMAGE_EXPORT KisAsyncMerger
 {
 public:
     void startMerge(KisBaseRectsWalker &walker, bool notifyClones = true);
 
+    /**
+     * Lets the merger split huge update rects into tile-aligned
+     * blocks and merge them concurrently on the idle threads of
+     * \p executor. The merger still returns only when the whole
+     * rect is merged.
+     */
+    void setParallelExecutor(KisWorkStealingExecutor *executor);
+
 private:
+    bool tryStartParallelMerge(KisBaseRectsWalker &walker, bool notifyClones);
     inline void resetProjection();
     inline void setupProjection(KisProjectionLeafSP currentLeaf, const QRect& rect, bool useTempProjection);
     inline void writeProjection(KisProjectionLeafSP topmostLeaf, bool useTempProjection, const QRect &rect);
     inline bool compositeWithProjection(KisProjectionLeafSP leaf, const QRect &rect);
     inline void doNotifyClones(KisBaseRectsWalker &walker);
+    bool processBelowLayersCached(KisBaseRectsWalker::LeafStack &leafStack,
+                                  const KisBaseRectsWalker::JobItem &firstItem,
+                                  bool useTempProjection, int levelOfDetail);
 
 private:
     /**
@@ -62,6 +76,11 @@ private:
      * setupProjection()
      */
     KisPaintDeviceSP m_cachedPaintDevice;
+
+    /**
+     * The executor used for splitting huge merges, may be null
+     */
+    KisWorkStealingExecutor *m_parallelExecutor {0};
 };
 
 
@@ -222,6 +222,20 @@ public:
         return m_levelOfDetail;
     }
 
+    /**
+     * The maximum size of the patch the requested rect of the walker
+     * can be merged into. KisSimpleUpdateQueue estimates it when the
+     * walker is queued, so that the merging code, which runs under the
+     * queue lock, doesn't have to estimate the merge cost again.
+     */
+    inline void setPatchSize(const QSize &size) {
+        m_patchSize = size;
+    }
+
+    inline QSize patchSize() const {
+        return m_patchSize;
+    }
+
     virtual UpdateType type() const = 0;
 
 protected:
@@ -511,6 +525,8 @@ private:
     QRect m_lastNeedRect;
 
     int m_levelOfDetail {0};
+
+    QSize m_patchSize;
 };
 
 #endif /* __KIS_BASE_RECTS_WALKER_H */
@@ -37,6 +37,8 @@
 #include "kis_selection_mask.h"
 #include "kis_psd_layer_style.h"
 #include "kis_layer_properties_icons.h"
+#include "kis_image_config.h"
+#include "KisBelowLayersCache.h"
 
 
 struct Q_DECL_HIDDEN KisGroupLayer::Private
@@ -54,12 +56,14 @@ public:
     qint32 x;
     qint32 y;
     bool passThroughMode;
+    KisBelowLayersCache belowLayersCache;
 };
 
 KisGroupLayer::KisGroupLayer(KisImageWSP image, const QString &name, quint8 opacity) :
     KisLayer(image, name, opacity),
     m_d(new Private())
 {
+    m_d->belowLayersCache.setEnabled(KisImageConfig(true).useBelowLayersCache());
     resetCache();
 }
 
@@ -73,6 +77,7 @@ KisGroupLayer::KisGroupLayer(const KisGroupLayer &rhs) :
     m_d->paintDevice->setDefaultPixel(const_cast<KisGroupLayer*>(&rhs)->m_d->paintDevice->defaultPixel());
     m_d->paintDevice->setProjectionDevice(true);
     m_d->passThroughMode = rhs.passThroughMode();
+    m_d->belowLayersCache.setEnabled(rhs.m_d->belowLayersCache.isEnabled());
 }
 
 KisGroupLayer::~KisGroupLayer()
@@ -193,6 +198,11 @@ void KisGroupLayer::fillMergedLayerTemplate(KisLayerSP dstLayer, KisLayerSP prev
     }
 }
 
+KisBelowLayersCache* KisGroupLayer::belowLayersCache() const
+{
+    return &m_d->belowLayersCache;
+}
+
 void KisGroupLayer::resetCache(const KoColorSpace *colorSpace)
 {
     if (!colorSpace)
@@ -200,6 +210,8 @@ void KisGroupLayer::resetCache(const KoColorSpace *colorSpace)
 
     Q_ASSERT(colorSpace);
 
+    m_d->belowLayersCache.invalidate();
+
     if (!m_d->paintDevice) {
 
         KisPaintDeviceSP dev = new KisPaintDevice(this, colorSpace, new KisDefaultBounds(image()));
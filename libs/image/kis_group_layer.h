@@ -23,6 +23,7 @@
 #include "kis_types.h"
 
 class KoColorSpace;
+class KisBelowLayersCache;
 
 /**
  * A KisLayer that bundles child layers into a single layer.
@@ -60,6 +61,13 @@ public:
      */
     void resetCache(const KoColorSpace *colorSpace = 0);
 
+    /**
+     * The composition of the children lying below the one being
+     * painted on, used by KisAsyncMerger to avoid compositing them
+     * on every update.
+     */
+    KisBelowLayersCache* belowLayersCache() const;
+
     /**
      * XXX: make the colorspace of a layergroup user-settable: we want
      * to be able to have, for instance, a group of grayscale layers
@@ -29,6 +29,8 @@
 #include <QSize>
 #include <QDateTime>
 #include <QRect>
+#include <QMutex>
+#include <QHash>
 #include <QtConcurrent>
 
 #include <klocalizedstring.h>
@@ -81,6 +83,7 @@
 #include "commands_new/kis_image_resize_command.h"
 #include "commands_new/kis_image_set_resolution_command.h"
 #include "commands_new/kis_activate_selection_mask_command.h"
+#include "commands_new/KisConvertColorSpaceDevicesCommand.h"
 #include "kis_do_something_command.h"
 #include "kis_composite_progress_proxy.h"
 #include "kis_layer_composition.h"
@@ -251,9 +254,12 @@ public:
     QPointF axesCenter;
     bool allowMasksOnRootNode = false;
 
+    QMutex regionsOfInterestLock;
+    QHash<const QObject*, QRect> regionsOfInterest;
+
     bool tryCancelCurrentStrokeAsync();
 
-    void notifyProjectionUpdatedInPatches(const QRect &rc, QVector<KisRunnableStrokeJobData *> &jobs);
+    void notifyProjectionUpdatedInPatches(const QRect &rc, int numWorkers, QVector<KisRunnableStrokeJobData *> &jobs);
 
     void convertImageColorSpaceImpl(const KoColorSpace *dstColorSpace,
                                     bool convertLayers,
@@ -833,14 +839,12 @@ void KisImage::purgeUnusedData(bool isCancellable)
                    deviceList << node->getLodCapableDevices();
                  });
 
-            Q_FOREACH (KisPaintDeviceSP device, deviceList) {
-                if (!device) continue;
+            deviceList.removeAll(KisPaintDeviceSP());
 
-                KritaUtils::addJobConcurrent(jobsData,
-                    [device] () {
-                        const_cast<KisPaintDevice*>(device.data())->purgeDefaultPixels();
-                    });
-            }
+            KritaUtils::addJobsParallelFor(jobsData, deviceList.toVector(), threadsLimit(),
+                [] (KisPaintDeviceSP device) {
+                    device->purgeDefaultPixels();
+                });
 
             addMutatedJobs(jobsData);
         }
@@ -1252,11 +1256,23 @@ void KisImage::KisImagePrivate::convertImageColorSpaceImpl(const KoColorSpace *d
         KisStrokeJobData::BARRIER);
 
     if (convertLayers) {
+        /**
+         * The visitor only collects the devices of the layers, the pixels
+         * are converted by the devices command, which splits all the
+         * devices into patches and converts them in parallel
+         */
+        KisConvertColorSpaceDevicesCommand *devicesCommand =
+            new KisConvertColorSpaceDevicesCommand(KisImageWSP(q), dstColorSpace,
+                                                   renderingIntent, conversionFlags);
+
         applicator.applyVisitor(
                     new KisConvertColorSpaceProcessingVisitor(
                         srcColorSpace, dstColorSpace,
-                        renderingIntent, conversionFlags),
+                        renderingIntent, conversionFlags,
+                        devicesCommand),
                     KisStrokeJobData::CONCURRENT);
+
+        applicator.applyCommand(devicesCommand, KisStrokeJobData::BARRIER);
     } else {
         applicator.applyCommand(
             new KisDoSomethingCommand<
@@ -1755,20 +1771,17 @@ KisStrokeId KisImage::startStroke(KisStrokeStrategy *strokeStrategy)
     return m_d->scheduler.startStroke(strokeStrategy);
 }
 
-void KisImage::KisImagePrivate::notifyProjectionUpdatedInPatches(const QRect &rc, QVector<KisRunnableStrokeJobData*> &jobs)
+void KisImage::KisImagePrivate::notifyProjectionUpdatedInPatches(const QRect &rc, int numWorkers, QVector<KisRunnableStrokeJobData*> &jobs)
 {
     KisImageConfig imageConfig(true);
     int patchWidth = imageConfig.updatePatchWidth();
     int patchHeight = imageConfig.updatePatchHeight();
 
-    for (int y = 0; y < rc.height(); y += patchHeight) {
-        for (int x = 0; x < rc.width(); x += patchWidth) {
-            QRect patchRect(x, y, patchWidth, patchHeight);
-            patchRect &= rc;
-
-            KritaUtils::addJobConcurrent(jobs, std::bind(&KisImage::notifyProjectionUpdated, q, patchRect));
-        }
-    }
+    KisImage *image = q;
+    KritaUtils::addJobsParallelForPatches(jobs, rc, QSize(patchWidth, patchHeight), numWorkers,
+        [image] (const QRect &patchRect) {
+            image->notifyProjectionUpdated(patchRect);
+        });
 }
 
 bool KisImage::startIsolatedMode(KisNodeSP node, bool isolateLayer, bool isolateGroup)
@@ -1818,7 +1831,7 @@ bool KisImage::startIsolatedMode(KisNodeSP node, bool isolateLayer, bool isolate
                 m_image->refreshGraphAsync(m_node);
             } else {
                 QVector<KisRunnableStrokeJobData*> jobs;
-                m_image->m_d->notifyProjectionUpdatedInPatches(m_image->bounds(), jobs);
+                m_image->m_d->notifyProjectionUpdatedInPatches(m_image->bounds(), this->threadsLimit(), jobs);
                 this->runnableJobsInterface()->addRunnableJobs(jobs);
             }
 
@@ -1885,7 +1898,7 @@ void KisImage::stopIsolatedMode()
                 //oldRootNode->setDirty(updateRect);
 
                 QVector<KisRunnableStrokeJobData*> jobs;
-                m_image->m_d->notifyProjectionUpdatedInPatches(m_image->bounds(), jobs);
+                m_image->m_d->notifyProjectionUpdatedInPatches(m_image->bounds(), this->threadsLimit(), jobs);
                 this->runnableJobsInterface()->addRunnableJobs(jobs);
             }
         }
@@ -2329,6 +2342,24 @@ void KisImage::setDesiredLevelOfDetail(int lod)
     m_d->scheduler.setDesiredLevelOfDetail(lod);
 }
 
+void KisImage::setRegionOfInterest(const QObject *owner, const QRect &rc)
+{
+    QMutexLocker l(&m_d->regionsOfInterestLock);
+
+    if (rc.isEmpty()) {
+        m_d->regionsOfInterest.remove(owner);
+    } else {
+        m_d->regionsOfInterest.insert(owner, rc);
+    }
+
+    m_d->scheduler.setRegionsOfInterest(m_d->regionsOfInterest.values().toVector());
+}
+
+void KisImage::removeRegionOfInterest(const QObject *owner)
+{
+    setRegionOfInterest(owner, QRect());
+}
+
 int KisImage::currentLevelOfDetail() const
 {
     if (m_d->blockLevelOfDetail) {
@@ -706,6 +706,23 @@ public:
      */
     void setDesiredLevelOfDetail(int lod);
 
+    /**
+     * Notify KisImage which area is currently visible on the canvas
+     * \p owner (in image pixels). Every canvas showing the image keeps
+     * its own region, the projection updates of all these regions will
+     * be processed before the updates of the rest of the image. An
+     * empty rect removes the region of \p owner.
+     */
+    void setRegionOfInterest(const QObject *owner, const QRect &rc);
+
+    /**
+     * Remove the region of interest of \p owner, e.g. when the canvas
+     * is destroyed or switched to another image.
+     *
+     * \see setRegionOfInterest()
+     */
+    void removeRegionOfInterest(const QObject *owner);
+
     /**
      * Relative position of the mirror axis center
      *     0,0 - topleft corner of the image
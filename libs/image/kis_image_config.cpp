@@ -33,6 +33,8 @@
 #include <QDir>
 
 #include "kis_global.h"
+#include <config-tiles-compression.h>
+#include <config-hash-table-implementaion.h>
 #include <cmath>
 #include <QTemporaryFile>
 
@@ -115,6 +117,72 @@ void KisImageConfig::setUpdatePatchWidth(int value)
     m_config.writeEntry("updatePatchWidth", value);
 }
 
+bool KisImageConfig::adaptiveUpdatePatchSize(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("adaptiveUpdatePatchSize", true) : true;
+}
+
+void KisImageConfig::setAdaptiveUpdatePatchSize(bool value)
+{
+    m_config.writeEntry("adaptiveUpdatePatchSize", value);
+}
+
+int KisImageConfig::updatePatchTargetTime(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("updatePatchTargetTime", 4000) : 4000;
+}
+
+void KisImageConfig::setUpdatePatchTargetTime(int value)
+{
+    m_config.writeEntry("updatePatchTargetTime", value);
+}
+
+bool KisImageConfig::prioritizeUpdatesInViewport(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("prioritizeUpdatesInViewport", true) : true;
+}
+
+void KisImageConfig::setPrioritizeUpdatesInViewport(bool value)
+{
+    m_config.writeEntry("prioritizeUpdatesInViewport", value);
+}
+
+bool KisImageConfig::syncLodCacheInBackground(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("syncLodCacheInBackground", true) : true;
+}
+
+void KisImageConfig::setSyncLodCacheInBackground(bool value)
+{
+    m_config.writeEntry("syncLodCacheInBackground", value);
+}
+
+bool KisImageConfig::numaAwareThreads(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("numaAwareThreads", false) : false;
+}
+
+void KisImageConfig::setNumaAwareThreads(bool value)
+{
+    m_config.writeEntry("numaAwareThreads", value);
+}
+
+bool KisImageConfig::numaAwareTileAllocation(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("numaAwareTileAllocation", false) : false;
+}
+
+void KisImageConfig::setNumaAwareTileAllocation(bool value)
+{
+    m_config.writeEntry("numaAwareTileAllocation", value);
+}
+
 qreal KisImageConfig::maxCollectAlpha() const
 {
     return m_config.readEntry("maxCollectAlpha", 2.5);
@@ -174,6 +242,137 @@ void KisImageConfig::setSwapWindowSize(int value)
     m_config.writeEntry("swapWindowSize", value);
 }
 
+QString KisImageConfig::swapCompressionAlgorithm(bool requestDefault) const
+{
+#ifdef HAVE_LZ4
+    const QString defaultAlgorithm = "LZ4";
+#else
+    const QString defaultAlgorithm = "LZF";
+#endif
+
+    return !requestDefault ?
+        m_config.readEntry("swapCompressionAlgorithm", defaultAlgorithm) : defaultAlgorithm;
+}
+
+void KisImageConfig::setSwapCompressionAlgorithm(const QString &value)
+{
+    m_config.writeEntry("swapCompressionAlgorithm", value);
+}
+
+int KisImageConfig::swapCompressionLevel(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("swapCompressionLevel", 3) : 3;
+}
+
+void KisImageConfig::setSwapCompressionLevel(int value)
+{
+    m_config.writeEntry("swapCompressionLevel", value);
+}
+
+int KisImageConfig::swapperThreadCount(bool requestDefault) const
+{
+    const int defaultValue = qMax(1, QThread::idealThreadCount() / 2);
+
+    return !requestDefault ?
+        qMax(1, m_config.readEntry("swapperThreadCount", defaultValue)) : defaultValue;
+}
+
+void KisImageConfig::setSwapperThreadCount(int value)
+{
+    m_config.writeEntry("swapperThreadCount", value);
+}
+
+int KisImageConfig::swapperBatchSize(bool requestDefault) const
+{
+    return !requestDefault ?
+        qMax(1, m_config.readEntry("swapperBatchSize", 64)) : 64;
+}
+
+void KisImageConfig::setSwapperBatchSize(int value)
+{
+    m_config.writeEntry("swapperBatchSize", value);
+}
+
+bool KisImageConfig::enableTileDeduplication(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("enableTileDeduplication", false) : false;
+}
+
+void KisImageConfig::setEnableTileDeduplication(bool value)
+{
+    m_config.writeEntry("enableTileDeduplication", value);
+}
+
+bool KisImageConfig::useLockFreeTileHashTable(bool requestDefault) const
+{
+#ifdef USE_LOCK_FREE_HASH_TABLE
+    const bool defaultValue = true;
+#else
+    const bool defaultValue = false;
+#endif
+
+    return !requestDefault ?
+        m_config.readEntry("useLockFreeTileHashTable", defaultValue) : defaultValue;
+}
+
+void KisImageConfig::setUseLockFreeTileHashTable(bool value)
+{
+    m_config.writeEntry("useLockFreeTileHashTable", value);
+}
+
+bool KisImageConfig::enableDeltaMementos(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("enableDeltaMementos", false) : false;
+}
+
+void KisImageConfig::setEnableDeltaMementos(bool value)
+{
+    m_config.writeEntry("enableDeltaMementos", value);
+}
+
+bool KisImageConfig::compressHistoryTiles(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("compressHistoryTiles", true) : true;
+}
+
+void KisImageConfig::setCompressHistoryTiles(bool value)
+{
+    m_config.writeEntry("compressHistoryTiles", value);
+}
+
+bool KisImageConfig::useBelowLayersCache(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("useBelowLayersCache", true) : true;
+}
+
+void KisImageConfig::setUseBelowLayersCache(bool value)
+{
+    m_config.writeEntry("useBelowLayersCache", value);
+}
+
+qreal KisImageConfig::belowLayersCacheLimitPercent(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("belowLayersCacheLimitPercent", 10.0) : 10.0;
+}
+
+void KisImageConfig::setBelowLayersCacheLimitPercent(qreal value)
+{
+    m_config.writeEntry("belowLayersCacheLimitPercent", value);
+}
+
+int KisImageConfig::belowLayersCacheLimit() const
+{
+    qreal cp = qreal(belowLayersCacheLimitPercent()) / 100.0;
+
+    return tilesHardLimit() * cp;
+}
+
 int KisImageConfig::tilesHardLimit() const
 {
     qreal hp = qreal(memoryHardLimitPercent()) / 100.0;
@@ -189,6 +388,13 @@ int KisImageConfig::tilesSoftLimit() const
     return tilesHardLimit() * sp;
 }
 
+int KisImageConfig::tilesCompressedLimit() const
+{
+    qreal cp = qreal(memoryCompressedLimitPercent()) / 100.0;
+
+    return tilesHardLimit() * cp;
+}
+
 int KisImageConfig::poolLimit() const
 {
     qreal hp = qreal(memoryHardLimitPercent()) / 100.0;
@@ -230,6 +436,17 @@ void KisImageConfig::setMemoryPoolLimitPercent(qreal value)
     m_config.writeEntry("memoryPoolLimitPercent", value);
 }
 
+qreal KisImageConfig::memoryCompressedLimitPercent(bool requestDefault) const
+{
+    return !requestDefault ?
+        m_config.readEntry("memoryCompressedLimitPercent", 25.0) : 25.0;
+}
+
+void KisImageConfig::setMemoryCompressedLimitPercent(qreal value)
+{
+    m_config.writeEntry("memoryCompressedLimitPercent", value);
+}
+
 QString KisImageConfig::safelyGetWritableTempLocation(const QString &suffix, const QString &configKey, bool requestDefault) const
 {
 #ifdef Q_OS_MACOS
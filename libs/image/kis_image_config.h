@@ -43,6 +43,47 @@ public:
     int updatePatchWidth() const;
     void setUpdatePatchWidth(int value);
 
+    /**
+     * Let KisSimpleUpdateQueue scale the update patches according to the
+     * measured cost of merging the layers, so that every merge job takes
+     * about updatePatchTargetTime() microseconds
+     */
+    bool adaptiveUpdatePatchSize(bool requestDefault = false) const;
+    void setAdaptiveUpdatePatchSize(bool value);
+
+    int updatePatchTargetTime(bool requestDefault = false) const; // usec
+    void setUpdatePatchTargetTime(int value);
+
+    /**
+     * Start the merge jobs of the area visible on the canvas before
+     * the rest of the image
+     */
+    bool prioritizeUpdatesInViewport(bool requestDefault = false) const;
+    void setPrioritizeUpdatesInViewport(bool value);
+
+    /**
+     * Regenerate the level of detail caches as soon as the image gets
+     * idle after a legacy stroke, instead of doing that on the start
+     * of the next instant preview stroke
+     */
+    bool syncLodCacheInBackground(bool requestDefault = false) const;
+    void setSyncLodCacheInBackground(bool value);
+
+    /**
+     * Bind the worker threads of the updater to the NUMA nodes of the
+     * machine, one node after another
+     */
+    bool numaAwareThreads(bool requestDefault = false) const;
+    void setNumaAwareThreads(bool value);
+
+    /**
+     * Keep separate pools of tile memory for every NUMA node and serve
+     * the tiles from the node of the thread that allocates them. Takes
+     * effect after restart.
+     */
+    bool numaAwareTileAllocation(bool requestDefault = false) const;
+    void setNumaAwareTileAllocation(bool value);
+
     qreal maxCollectAlpha() const;
     qreal maxMergeAlpha() const;
     qreal maxMergeCollectAlpha() const;
@@ -58,16 +99,80 @@ public:
     int swapWindowSize() const;
     void setSwapWindowSize(int value);
 
+    /**
+     * Algorithm used for compressing tiles in the swap file: "LZF",
+     * "LZ4" or "ZSTD". If the algorithm is not available in the current
+     * build, LZF is used.
+     */
+    QString swapCompressionAlgorithm(bool requestDefault = false) const;
+    void setSwapCompressionAlgorithm(const QString &value);
+
+    /**
+     * Compression level for the algorithms that support it (ZSTD only)
+     */
+    int swapCompressionLevel(bool requestDefault = false) const;
+    void setSwapCompressionLevel(int value);
+
+    /**
+     * Number of threads used by the swapper for compressing
+     * the tiles that are being swapped out
+     */
+    int swapperThreadCount(bool requestDefault = false) const;
+    void setSwapperThreadCount(int value);
+
+    /**
+     * Number of tiles the swapper compresses in parallel and
+     * writes to the swap file in one go
+     */
+    int swapperBatchSize(bool requestDefault = false) const;
+    void setSwapperBatchSize(int value);
+
+    /**
+     * Let the pooler look for byte-identical tiles and make
+     * them share the same memory
+     */
+    bool enableTileDeduplication(bool requestDefault = false) const;
+    void setEnableTileDeduplication(bool value);
+
+    /**
+     * Selects the implementation of the tile hash tables used by the
+     * data managers: lock-free (leapfrog-based) or the blocking one
+     * guarded by a QReadWriteLock. The value is read only once, on
+     * creation of the first hash table.
+     */
+    bool useLockFreeTileHashTable(bool requestDefault = false) const;
+    void setUseLockFreeTileHashTable(bool value);
+
+    /**
+     * Let the memento manager keep only the rows that differ from
+     * the newer revision of a tile in the undo history
+     */
+    bool enableDeltaMementos(bool requestDefault = false) const;
+    void setEnableDeltaMementos(bool value);
+
+    bool compressHistoryTiles(bool requestDefault = false) const;
+    void setCompressHistoryTiles(bool value);
+
+    bool useBelowLayersCache(bool requestDefault = false) const;
+    void setUseBelowLayersCache(bool value);
+
+    qreal belowLayersCacheLimitPercent(bool requestDefault = false) const; // % of tilesHardLimit()
+    void setBelowLayersCacheLimitPercent(qreal value);
+    int belowLayersCacheLimit() const; // MiB
+
     int tilesHardLimit() const; // MiB
     int tilesSoftLimit() const; // MiB
+    int tilesCompressedLimit() const; // MiB
     int poolLimit() const; // MiB
 
     qreal memoryHardLimitPercent(bool requestDefault = false) const; // % of total RAM
     qreal memorySoftLimitPercent(bool requestDefault = false) const; // % of memoryHardLimitPercent() * (1 - 0.01 * memoryPoolLimitPercent())
     qreal memoryPoolLimitPercent(bool requestDefault = false) const; // % of memoryHardLimitPercent()
+    qreal memoryCompressedLimitPercent(bool requestDefault = false) const; // % of tilesHardLimit()
     void setMemoryHardLimitPercent(qreal value);
     void setMemorySoftLimitPercent(qreal value);
     void setMemoryPoolLimitPercent(qreal value);
+    void setMemoryCompressedLimitPercent(qreal value);
 
     static int totalRAM(); // MiB
 
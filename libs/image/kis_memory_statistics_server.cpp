@@ -22,10 +22,14 @@
 #include <QApplication>
 
 #include "kis_image.h"
+#include "kis_group_layer.h"
+#include "KisBelowLayersCache.h"
 #include "kis_image_config.h"
 #include "kis_signal_compressor.h"
 
 #include "tiles3/kis_tile_data_store.h"
+#include "tiles3/KisTileDataAllocator.h"
+#include "KisNumaUtils.h"
 
 Q_GLOBAL_STATIC(KisMemoryStatisticsServer, s_instance)
 
@@ -95,7 +99,8 @@ qint64 calculateNodeMemoryHiBoundStep(KisNodeSP node,
                                       QSet<KisPaintDevice*> &devices,
                                       qint64 &layersSize,
                                       qint64 &projectionsSize,
-                                      qint64 &lodSize)
+                                      qint64 &lodSize,
+                                      qint64 &belowLayersCacheSize)
 {
     qint64 memBound = 0;
 
@@ -108,10 +113,18 @@ qint64 calculateNodeMemoryHiBoundStep(KisNodeSP node,
     addDevice(node->original(), originalIsProjection, devices, memBound, layersSize, projectionsSize, lodSize);
     addDevice(node->projection(), true, devices, memBound, layersSize, projectionsSize, lodSize);
 
+    KisGroupLayer *group = dynamic_cast<KisGroupLayer*>(node.data());
+    if (group) {
+        const qint64 cacheSize = group->belowLayersCache()->memoryUsage();
+        memBound += cacheSize;
+        belowLayersCacheSize += cacheSize;
+    }
+
     node = node->firstChild();
     while (node) {
         memBound += calculateNodeMemoryHiBoundStep(node, devices,
-                                                   layersSize, projectionsSize, lodSize);
+                                                   layersSize, projectionsSize, lodSize,
+                                                   belowLayersCacheSize);
         node = node->nextSibling();
     }
 
@@ -121,18 +134,21 @@ qint64 calculateNodeMemoryHiBoundStep(KisNodeSP node,
 qint64 calculateNodeMemoryHiBound(KisNodeSP node,
                                   qint64 &layersSize,
                                   qint64 &projectionsSize,
-                                  qint64 &lodSize)
+                                  qint64 &lodSize,
+                                  qint64 &belowLayersCacheSize)
 {
     layersSize = 0;
     projectionsSize = 0;
     lodSize = 0;
+    belowLayersCacheSize = 0;
 
     QSet<KisPaintDevice*> devices;
     return calculateNodeMemoryHiBoundStep(node,
                                           devices,
                                           layersSize,
                                           projectionsSize,
-                                          lodSize);
+                                          lodSize,
+                                          belowLayersCacheSize);
 }
 
 
@@ -148,7 +164,8 @@ KisMemoryStatisticsServer::fetchMemoryStatistics(KisImageSP image) const
             calculateNodeMemoryHiBound(image->root(),
                                        stats.layersSize,
                                        stats.projectionsSize,
-                                       stats.lodSize);
+                                       stats.lodSize,
+                                       stats.belowLayersCacheSize);
     }
     stats.totalMemorySize = tileStats.totalMemorySize;
     stats.realMemorySize = tileStats.realMemorySize;
@@ -156,6 +173,28 @@ KisMemoryStatisticsServer::fetchMemoryStatistics(KisImageSP image) const
     stats.poolSize = tileStats.poolSize;
 
     stats.swapSize = tileStats.swapSize;
+    stats.swapFileSize = tileStats.swapFileSize;
+    stats.numSwappedOutTiles = tileStats.numSwappedOutTiles;
+    stats.numSwapBatches = tileStats.numSwapBatches;
+
+    stats.compressedSize = tileStats.compressedSize;
+    stats.numCompressedTiles = tileStats.numCompressedTiles;
+    stats.compressionSavedSize = tileStats.compressionSavedSize;
+
+    stats.numDeduplicatedTiles = tileStats.numDeduplicatedTiles;
+    stats.deduplicationSavedSize = tileStats.deduplicationSavedSize;
+
+    stats.deltaSize = tileStats.deltaSize;
+    stats.numDeltaTiles = tileStats.numDeltaTiles;
+
+    KisTileDataAllocator *allocator = KisTileDataAllocator::instance();
+    if (allocator && allocator->numNodes() > 1) {
+        stats.numRemoteTileDeallocations = allocator->remoteDeallocations();
+
+        const KisNumaUtils::Statistics numaStats = KisNumaUtils::statistics();
+        stats.numaLocalPages = numaStats.localPages;
+        stats.numaRemotePages = numaStats.remotePages;
+    }
 
     KisImageConfig cfg(true);
 
@@ -163,6 +202,7 @@ KisMemoryStatisticsServer::fetchMemoryStatistics(KisImageSP image) const
     stats.tilesSoftLimit = cfg.tilesSoftLimit() * MiB;
     stats.tilesPoolLimit = cfg.poolLimit() * MiB;
     stats.totalMemoryLimit = stats.tilesHardLimit + stats.tilesPoolLimit;
+    stats.belowLayersCacheLimit = KisBelowLayersCache::memoryLimit();
 
     return stats;
 }
@@ -38,6 +38,7 @@ public:
               layersSize(0),
               projectionsSize(0),
               lodSize(0),
+              belowLayersCacheSize(0),
 
               totalMemorySize(0),
               realMemorySize(0),
@@ -45,11 +46,29 @@ public:
               poolSize(0),
 
               swapSize(0),
+              swapFileSize(0),
+              numSwappedOutTiles(0),
+              numSwapBatches(0),
+
+              compressedSize(0),
+              numCompressedTiles(0),
+              compressionSavedSize(0),
+
+              numDeduplicatedTiles(0),
+              deduplicationSavedSize(0),
+
+              deltaSize(0),
+              numDeltaTiles(0),
+
+              numRemoteTileDeallocations(0),
+              numaLocalPages(0),
+              numaRemotePages(0),
 
               totalMemoryLimit(0),
               tilesHardLimit(0),
               tilesSoftLimit(0),
-              tilesPoolLimit(0)
+              tilesPoolLimit(0),
+              belowLayersCacheLimit(0)
         {
         }
 
@@ -57,6 +76,7 @@ public:
         qint64 layersSize;
         qint64 projectionsSize;
         qint64 lodSize;
+        qint64 belowLayersCacheSize;
 
         qint64 totalMemorySize;
         qint64 realMemorySize;
@@ -64,11 +84,30 @@ public:
         qint64 poolSize;
 
         qint64 swapSize;
+        qint64 swapFileSize;
+        qint64 numSwappedOutTiles;
+        qint64 numSwapBatches;
+
+        qint64 compressedSize;
+        qint64 numCompressedTiles;
+        qint64 compressionSavedSize;
+
+        qint64 numDeduplicatedTiles;
+        qint64 deduplicationSavedSize;
+
+        qint64 deltaSize;
+        qint64 numDeltaTiles;
+
+        // NUMA counters, zero if NUMA mode is disabled or not supported
+        qint64 numRemoteTileDeallocations;
+        qint64 numaLocalPages;
+        qint64 numaRemotePages;
 
         qint64 totalMemoryLimit;
         qint64 tilesHardLimit;
         qint64 tilesSoftLimit;
         qint64 tilesPoolLimit;
+        qint64 belowLayersCacheLimit;
     };
 
 
@@ -113,6 +113,13 @@ public:
 
     void init(const KoColorSpace *cs, const quint8 *defaultPixel);
     void convertColorSpace(const KoColorSpace * dstColorSpace, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags, KUndo2Command *parentCommand);
+
+    struct ColorSpaceConversionStructImpl;
+    ColorSpaceConversionStruct* createColorSpaceConversionStruct(const KoColorSpace *dstColorSpace, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags);
+    KisRegion regionForColorSpaceConversion(ColorSpaceConversionStruct *dst) const;
+    void updateColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, const QRect &rect);
+    void uploadColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, KUndo2Command *parentCommand);
+
     bool assignProfile(const KoColorProfile * profile, KUndo2Command *parentCommand);
 
     KUndo2Command* reincarnateWithDetachedHistory(bool copyContent);
@@ -413,6 +420,27 @@ public:
     void updateLodDataStruct(LodDataStruct *dst, const QRect &srcRect);
     void uploadLodDataStruct(LodDataStruct *dst);
     KisRegion regionForLodSyncing() const;
+    KisRegion regionForLodSyncing(LodDataStruct *dst) const;
+
+    /**
+     * The state of the device at the moment of the last upload of
+     * the level of detail plane. It lets the next synchronization
+     * regenerate only the tiles that have been changed since then
+     * either in lod0 or in the lodN plane.
+     */
+    struct LodSyncState {
+        LodSyncState() : levelOfDetail(0), colorSpace(0) {}
+
+        int levelOfDetail;
+        const KoColorSpace *colorSpace;
+        QPoint srcOffset;
+        QByteArray srcDefaultPixel;
+        QHash<quint64, quint64> srcTileRevisions;
+        QHash<quint64, quint64> lodTileRevisions;
+    };
+
+    static QHash<quint64, quint64> fetchTileRevisions(Data *data);
+    bool canSyncLodIncrementally(Data *srcData, int lod) const;
 
     void updateLodDataManager(KisDataManager *srcDataManager,
                               KisDataManager *dstDataManager, const QPoint &srcOffset, const QPoint &dstOffset,
@@ -577,6 +605,7 @@ private:
 private:
     DataSP m_data;
     mutable QScopedPointer<Data> m_lodData;
+    QScopedPointer<LodSyncState> m_lodSyncState;
     mutable QScopedPointer<Data> m_externalFrameData;
     mutable QMutex m_dataSwitchLock;
 
@@ -656,24 +685,150 @@ struct KisPaintDevice::Private::StrategyPolicy {
 };
 
 struct KisPaintDevice::Private::LodDataStructImpl : public KisPaintDevice::LodDataStruct {
-    LodDataStructImpl(Data *_lodData) : lodData(_lodData) {}
+    LodDataStructImpl(Data *_lodData) : lodData(_lodData), isIncremental(false) {}
     QScopedPointer<Data> lodData;
+
+    bool isIncremental;
+    KisRegion incrementalRegion;
+    LodSyncState pendingSyncState;
 };
 
+namespace {
+inline quint64 tileKey(qint32 col, qint32 row) {
+    return (quint64(quint32(col)) << 32) | quint32(row);
+}
+
+inline QRect tileKeyRect(quint64 key) {
+    return QRect(qint32(quint32(key >> 32)) * KisTileData::WIDTH,
+                 qint32(quint32(key)) * KisTileData::HEIGHT,
+                 KisTileData::WIDTH, KisTileData::HEIGHT);
+}
+}
+
+QHash<quint64, quint64> KisPaintDevice::Private::fetchTileRevisions(Data *data)
+{
+    QHash<quint64, quint64> revisions;
+
+    Q_FOREACH (KisTileSP tile, data->dataManager()->tiles()) {
+        revisions.insert(tileKey(tile->col(), tile->row()), tile->contentRevision());
+    }
+
+    return revisions;
+}
+
+bool KisPaintDevice::Private::canSyncLodIncrementally(Data *srcData, int lod) const
+{
+    if (!m_lodSyncState || !m_lodData) return false;
+
+    const LodSyncState &state = *m_lodSyncState;
+
+    /**
+     * We compare color spaces as pure pointers, because they must be
+     * exactly the same, since they come from the common source.
+     */
+    return state.levelOfDetail == lod &&
+        state.colorSpace == srcData->colorSpace() &&
+        state.srcOffset == QPoint(srcData->x(), srcData->y()) &&
+        state.srcDefaultPixel ==
+            QByteArray::fromRawData((const char*)srcData->dataManager()->defaultPixel(),
+                                    srcData->dataManager()->pixelSize()) &&
+        m_lodData->levelOfDetail() == lod &&
+        m_lodData->colorSpace() == srcData->colorSpace() &&
+        m_lodData->x() == KisLodTransform::coordToLodCoord(srcData->x(), lod) &&
+        m_lodData->y() == KisLodTransform::coordToLodCoord(srcData->y(), lod);
+}
+
 KisRegion KisPaintDevice::Private::regionForLodSyncing() const
 {
     Data *srcData = currentNonLodData();
     return srcData->dataManager()->region().translated(srcData->x(), srcData->y());
 }
 
+KisRegion KisPaintDevice::Private::regionForLodSyncing(LodDataStruct *_dst) const
+{
+    LodDataStructImpl *dst = dynamic_cast<LodDataStructImpl*>(_dst);
+    KIS_SAFE_ASSERT_RECOVER(dst) { return regionForLodSyncing(); }
+
+    return dst->isIncremental ? dst->incrementalRegion : regionForLodSyncing();
+}
+
 KisPaintDevice::LodDataStruct* KisPaintDevice::Private::createLodDataStruct(int newLod)
 {
     KIS_SAFE_ASSERT_RECOVER_NOOP(newLod > 0);
 
     Data *srcData = currentNonLodData();
 
+    LodSyncState syncState;
+    syncState.levelOfDetail = newLod;
+    syncState.colorSpace = srcData->colorSpace();
+    syncState.srcOffset = QPoint(srcData->x(), srcData->y());
+    syncState.srcDefaultPixel =
+        QByteArray((const char*)srcData->dataManager()->defaultPixel(),
+                   srcData->dataManager()->pixelSize());
+    syncState.srcTileRevisions = fetchTileRevisions(srcData);
+
+    if (canSyncLodIncrementally(srcData, newLod)) {
+        /**
+         * The lodN plane is still valid, so we can just take a
+         * (copy-on-write) copy of it and regenerate only the tiles that
+         * have been changed in lod0 since the last sync, and the ones
+         * the lodN strokes have painted on.
+         */
+        Data *lodData = new Data(q, m_lodData.data(), true);
+        LodDataStructImpl *lodStruct = new LodDataStructImpl(lodData);
+
+        const LodSyncState &oldState = *m_lodSyncState;
+        QVector<QRect> dirtyRects;
+
+        for (auto it = syncState.srcTileRevisions.constBegin(); it != syncState.srcTileRevisions.constEnd(); ++it) {
+            if (oldState.srcTileRevisions.value(it.key(), 0) != it.value()) {
+                dirtyRects << tileKeyRect(it.key());
+            }
+        }
+
+        for (auto it = oldState.srcTileRevisions.constBegin(); it != oldState.srcTileRevisions.constEnd(); ++it) {
+            if (!syncState.srcTileRevisions.contains(it.key())) {
+                dirtyRects << tileKeyRect(it.key());
+            }
+        }
+
+        const QPoint srcOffset(srcData->x(), srcData->y());
+        for (QRect &rc : dirtyRects) {
+            rc.translate(srcOffset);
+        }
+
+        const QHash<quint64, quint64> lodTileRevisions = fetchTileRevisions(m_lodData.data());
+        const QPoint lodOffset(m_lodData->x(), m_lodData->y());
+
+        auto addLodTileRect = [&dirtyRects, lodOffset, newLod] (quint64 key) {
+            const QRect rc = tileKeyRect(key).translated(lodOffset);
+            dirtyRects << QRect(rc.x() << newLod, rc.y() << newLod,
+                                rc.width() << newLod, rc.height() << newLod);
+        };
+
+        for (auto it = lodTileRevisions.constBegin(); it != lodTileRevisions.constEnd(); ++it) {
+            if (oldState.lodTileRevisions.value(it.key(), 0) != it.value()) {
+                addLodTileRect(it.key());
+            }
+        }
+
+        for (auto it = oldState.lodTileRevisions.constBegin(); it != oldState.lodTileRevisions.constEnd(); ++it) {
+            if (!lodTileRevisions.contains(it.key())) {
+                addLodTileRect(it.key());
+            }
+        }
+
+        lodData->cache()->invalidate();
+
+        lodStruct->isIncremental = true;
+        lodStruct->incrementalRegion = KisRegion::fromOverlappingRects(dirtyRects, KisTileData::WIDTH);
+        lodStruct->pendingSyncState = syncState;
+
+        return lodStruct;
+    }
+
     Data *lodData = new Data(q, srcData, false);
-    LodDataStruct *lodStruct = new LodDataStructImpl(lodData);
+    LodDataStructImpl *lodStruct = new LodDataStructImpl(lodData);
 
     int expectedX = KisLodTransform::coordToLodCoord(srcData->x(), newLod);
     int expectedY = KisLodTransform::coordToLodCoord(srcData->y(), newLod);
@@ -699,6 +854,8 @@ KisPaintDevice::LodDataStruct* KisPaintDevice::Private::createLodDataStruct(int
 
     lodData->cache()->invalidate();
 
+    lodStruct->pendingSyncState = syncState;
+
     return lodStruct;
 }
 
@@ -838,6 +995,9 @@ void KisPaintDevice::Private::uploadLodDataStruct(LodDataStruct *_dst)
 
     m_lodData->prepareClone(dst->lodData.data());
     m_lodData->dataManager()->bitBltRough(dst->lodData->dataManager(), dst->lodData->dataManager()->extent());
+
+    m_lodSyncState.reset(new LodSyncState(dst->pendingSyncState));
+    m_lodSyncState->lodTileRevisions = fetchTileRevisions(m_lodData.data());
 }
 
 void KisPaintDevice::Private::transferFromData(Data *data, KisPaintDeviceSP targetDevice)
@@ -977,6 +1137,88 @@ void KisPaintDevice::Private::convertColorSpace(const KoColorSpace * dstColorSpa
     q->emitColorSpaceChanged();
 }
 
+struct KisPaintDevice::Private::ColorSpaceConversionStructImpl : public KisPaintDevice::ColorSpaceConversionStruct
+{
+    struct Plane {
+        Data *data;
+        KisDataManagerSP dstDataManager;
+        QRect rect;
+    };
+
+    const KoColorSpace *dstColorSpace;
+    KoColorConversionTransformation::Intent renderingIntent;
+    KoColorConversionTransformation::ConversionFlags conversionFlags;
+    QVector<Plane> planes;
+};
+
+KisPaintDevice::ColorSpaceConversionStruct*
+KisPaintDevice::Private::createColorSpaceConversionStruct(const KoColorSpace *dstColorSpace,
+                                                          KoColorConversionTransformation::Intent renderingIntent,
+                                                          KoColorConversionTransformation::ConversionFlags conversionFlags)
+{
+    ColorSpaceConversionStructImpl *conversion = new ColorSpaceConversionStructImpl();
+    conversion->dstColorSpace = dstColorSpace;
+    conversion->renderingIntent = renderingIntent;
+    conversion->conversionFlags = conversionFlags;
+
+    Q_FOREACH (Data *data, allDataObjects()) {
+        if (!data) continue;
+        if (data->colorSpace() == dstColorSpace || *data->colorSpace() == *dstColorSpace) continue;
+
+        ColorSpaceConversionStructImpl::Plane plane;
+        plane.data = data;
+        plane.dstDataManager = data->createConvertedDataManager(dstColorSpace, renderingIntent, conversionFlags);
+        plane.rect = data->dataManager()->region().boundingRect();
+
+        conversion->planes.append(plane);
+    }
+
+    return conversion;
+}
+
+KisRegion KisPaintDevice::Private::regionForColorSpaceConversion(ColorSpaceConversionStruct *_dst) const
+{
+    ColorSpaceConversionStructImpl *dst = dynamic_cast<ColorSpaceConversionStructImpl*>(_dst);
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(dst, KisRegion());
+
+    QVector<QRect> rects;
+
+    Q_FOREACH (const ColorSpaceConversionStructImpl::Plane &plane, dst->planes) {
+        if (!plane.rect.isEmpty()) {
+            rects << plane.rect;
+        }
+    }
+
+    return KisRegion::fromOverlappingRects(rects, KisTileData::WIDTH);
+}
+
+void KisPaintDevice::Private::updateColorSpaceConversionStruct(ColorSpaceConversionStruct *_dst, const QRect &rect)
+{
+    ColorSpaceConversionStructImpl *dst = dynamic_cast<ColorSpaceConversionStructImpl*>(_dst);
+    KIS_SAFE_ASSERT_RECOVER_RETURN(dst);
+
+    Q_FOREACH (const ColorSpaceConversionStructImpl::Plane &plane, dst->planes) {
+        plane.data->convertDataColorSpaceRect(plane.dstDataManager, dst->dstColorSpace,
+                                              plane.rect & rect,
+                                              dst->renderingIntent, dst->conversionFlags);
+    }
+}
+
+void KisPaintDevice::Private::uploadColorSpaceConversionStruct(ColorSpaceConversionStruct *_dst, KUndo2Command *parentCommand)
+{
+    ColorSpaceConversionStructImpl *dst = dynamic_cast<ColorSpaceConversionStructImpl*>(_dst);
+    KIS_SAFE_ASSERT_RECOVER_RETURN(dst);
+
+    KUndo2Command *mainCommand =
+        parentCommand ? new DeviceChangeColorSpaceCommand(q, parentCommand) : 0;
+
+    Q_FOREACH (const ColorSpaceConversionStructImpl::Plane &plane, dst->planes) {
+        plane.data->uploadConvertedDataManager(plane.dstDataManager, dst->dstColorSpace, mainCommand);
+    }
+
+    q->emitColorSpaceChanged();
+}
+
 bool KisPaintDevice::Private::assignProfile(const KoColorProfile * profile, KUndo2Command *parentCommand)
 {
     if (!profile) return false;
@@ -1407,6 +1649,134 @@ QRect calculateExactBoundsImpl(const KisPaintDevice *device, const QRect &startR
                  boundBottom - boundTop + 1);
 }
 
+/**
+ * Bounds of the non-empty pixels of a single tile in the
+ * coordinates of the tile
+ */
+template <class ComparePixelOp>
+QRect calculateTileBounds(const quint8 *data, int pixelSize, ComparePixelOp &compareOp)
+{
+    const int tileWidth = KisTileData::WIDTH;
+    const int tileHeight = KisTileData::HEIGHT;
+    const int rowStride = tileWidth * pixelSize;
+
+    int left = tileWidth;
+    int right = -1;
+    int top = -1;
+    int bottom = -1;
+
+    for (int y = 0; y < tileHeight; y++) {
+        const quint8 *row = data + y * rowStride;
+
+        int x1 = 0;
+        while (x1 < tileWidth && compareOp.isPixelEmpty(row + x1 * pixelSize)) {
+            x1++;
+        }
+
+        if (x1 == tileWidth) continue;
+
+        int x2 = tileWidth - 1;
+        while (x2 > qMax(x1, right) && compareOp.isPixelEmpty(row + x2 * pixelSize)) {
+            x2--;
+        }
+
+        if (top < 0) {
+            top = y;
+        }
+        bottom = y;
+        left = qMin(left, x1);
+        right = qMax(right, x2);
+    }
+
+    return top >= 0 ? QRect(QPoint(left, top), QPoint(right, bottom)) : QRect();
+}
+
+/**
+ * Calculates the exact bounds of the device (in the coordinates of the
+ * data manager) from the bounds of its individual tiles. The bounds of
+ * the tiles are kept in \p cache, so only the tiles that have changed
+ * since the previous call are scanned. The changed tiles lying inside
+ * the bounds of the unchanged ones are not scanned at all, since they
+ * cannot change the result.
+ */
+template <class ComparePixelOp>
+QRect calculateExactBoundsFromTiles(KisDataManagerSP dataManager,
+                                    KisPaintDeviceCache::TileBoundsCache *cache,
+                                    const QByteArray &emptyPixelKey,
+                                    ComparePixelOp compareOp)
+{
+    typedef KisPaintDeviceCache::TileBoundsCache::TileBounds TileBounds;
+
+    struct StaleTile {
+        KisTileSP tile;
+        quint64 key;
+        quint64 revision;
+    };
+
+    const QVector<KisTileSP> tiles = dataManager->tiles();
+
+    QMutexLocker l(&cache->mutex);
+
+    if (cache->emptyPixelKey != emptyPixelKey) {
+        cache->tiles.clear();
+        cache->emptyPixelKey = emptyPixelKey;
+    }
+
+    QHash<quint64, TileBounds> newTiles;
+    newTiles.reserve(tiles.size());
+
+    QVector<StaleTile> staleTiles;
+    QRect bounds;
+
+    Q_FOREACH (KisTileSP tile, tiles) {
+        const quint64 key = (quint64(quint32(tile->col())) << 32) | quint32(tile->row());
+
+        // the revision must be read before reading the pixels!
+        const quint64 revision = tile->contentRevision();
+
+        auto it = cache->tiles.constFind(key);
+        if (it != cache->tiles.constEnd() && it->revision == revision) {
+            bounds |= it->rect;
+            newTiles.insert(key, *it);
+        } else {
+            staleTiles.append({tile, key, revision});
+        }
+    }
+
+    Q_FOREACH (const StaleTile &stale, staleTiles) {
+        KisTileSP tile = stale.tile;
+        if (bounds.contains(tile->extent())) continue;
+
+        TileBounds tileBounds;
+        tileBounds.revision = stale.revision;
+
+        tile->lockForRead();
+
+        const quint8 *data = tile->data();
+
+        if (tile->tileData()->isUniform()) {
+            if (!compareOp.isPixelEmpty(data)) {
+                tileBounds.rect = QRect(0, 0, KisTileData::WIDTH, KisTileData::HEIGHT);
+            }
+        } else {
+            tileBounds.rect = calculateTileBounds(data, tile->pixelSize(), compareOp);
+        }
+
+        tile->unlockForRead();
+
+        if (!tileBounds.rect.isEmpty()) {
+            tileBounds.rect.translate(tile->extent().topLeft());
+        }
+
+        bounds |= tileBounds.rect;
+        newTiles.insert(stale.key, tileBounds);
+    }
+
+    cache->tiles.swap(newTiles);
+
+    return bounds;
+}
+
 }
 
 QRect KisPaintDevice::calculateExactBounds(bool nonDefaultOnly) const
@@ -1430,6 +1800,37 @@ QRect KisPaintDevice::calculateExactBounds(bool nonDefaultOnly) const
         }
     }
 
+    /**
+     * In the wrap-around mode the pixels are read via the wrapped
+     * strategy, so the bounds cannot be taken from the tiles directly
+     */
+    if (!defaultBounds()->wrapAroundMode()) {
+        QRect tileBounds;
+
+        if (nonDefaultOnly) {
+            const KoColor defaultPixel = this->defaultPixel();
+            Impl::CheckNonDefault compareOp(pixelSize(), defaultPixel.data());
+
+            tileBounds = Impl::calculateExactBoundsFromTiles(
+                m_d->dataManager(), m_d->cache()->tileBoundsCache(true),
+                QByteArray(reinterpret_cast<const char*>(defaultPixel.data()), pixelSize()),
+                compareOp);
+        } else {
+            Impl::CheckFullyTransparent compareOp(m_d->colorSpace());
+
+            tileBounds = Impl::calculateExactBoundsFromTiles(
+                m_d->dataManager(), m_d->cache()->tileBoundsCache(false),
+                m_d->colorSpace()->id().toLatin1(),
+                compareOp);
+        }
+
+        if (!tileBounds.isEmpty()) {
+            tileBounds.translate(x(), y());
+        }
+
+        return endRect | tileBounds;
+    }
+
     if (nonDefaultOnly) {
         const KoColor defaultPixel = this->defaultPixel();
         Impl::CheckNonDefault compareOp(pixelSize(), defaultPixel.data());
@@ -2106,11 +2507,43 @@ KisPaintDevice::LodDataStruct::~LodDataStruct()
 {
 }
 
+KisPaintDevice::ColorSpaceConversionStruct::~ColorSpaceConversionStruct()
+{
+}
+
+KisPaintDevice::ColorSpaceConversionStruct*
+KisPaintDevice::createColorSpaceConversionStruct(const KoColorSpace *dstColorSpace,
+                                                 KoColorConversionTransformation::Intent renderingIntent,
+                                                 KoColorConversionTransformation::ConversionFlags conversionFlags)
+{
+    return m_d->createColorSpaceConversionStruct(dstColorSpace, renderingIntent, conversionFlags);
+}
+
+KisRegion KisPaintDevice::regionForColorSpaceConversion(ColorSpaceConversionStruct *dst) const
+{
+    return m_d->regionForColorSpaceConversion(dst);
+}
+
+void KisPaintDevice::updateColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, const QRect &rect)
+{
+    m_d->updateColorSpaceConversionStruct(dst, rect);
+}
+
+void KisPaintDevice::uploadColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, KUndo2Command *parentCommand)
+{
+    m_d->uploadColorSpaceConversionStruct(dst, parentCommand);
+}
+
 KisRegion KisPaintDevice::regionForLodSyncing() const
 {
     return m_d->regionForLodSyncing();
 }
 
+KisRegion KisPaintDevice::regionForLodSyncing(LodDataStruct *dst) const
+{
+    return m_d->regionForLodSyncing(dst);
+}
+
 KisPaintDevice::LodDataStruct* KisPaintDevice::createLodDataStruct(int lod)
 {
     return m_d->createLodDataStruct(lod);
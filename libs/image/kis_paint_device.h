@@ -885,12 +885,51 @@ public:
     };
 
     KisRegion regionForLodSyncing() const;
+
+    /**
+     * Returns the part of the device that should be regenerated to
+     * bring \p dst in sync with the device. If the level of detail
+     * plane of the device has already been uploaded before, only the
+     * tiles changed since that upload are returned.
+     */
+    KisRegion regionForLodSyncing(LodDataStruct *dst) const;
+
     LodDataStruct* createLodDataStruct(int lod);
     void updateLodDataStruct(LodDataStruct *dst, const QRect &srcRect);
     void uploadLodDataStruct(LodDataStruct *dst);
 
     void generateLodCloneDevice(KisPaintDeviceSP dst, const QRect &originalRect, int lod);
 
+public:
+    struct ColorSpaceConversionStruct {
+        virtual ~ColorSpaceConversionStruct();
+    };
+
+    /**
+     * Converts the device into \p dstColorSpace in parallel. It works
+     * the same way as the syncing of the level of detail planes:
+     *
+     * 1) createColorSpaceConversionStruct() allocates the converted
+     *    data for all the frames of the device
+     *
+     * 2) updateColorSpaceConversionStruct() converts a part of the
+     *    device. It may be called concurrently for non-intersecting
+     *    rects covering regionForColorSpaceConversion()
+     *
+     * 3) uploadColorSpaceConversionStruct() switches the device to the
+     *    converted data. The undo information is added to \p parentCommand
+     *
+     * The result is the same as the one of convertTo(). The device
+     * must not be changed by anyone else while the conversion is
+     * in progress.
+     */
+    ColorSpaceConversionStruct* createColorSpaceConversionStruct(const KoColorSpace *dstColorSpace,
+                                                                 KoColorConversionTransformation::Intent renderingIntent = KoColorConversionTransformation::internalRenderingIntent(),
+                                                                 KoColorConversionTransformation::ConversionFlags conversionFlags = KoColorConversionTransformation::internalConversionFlags());
+    KisRegion regionForColorSpaceConversion(ColorSpaceConversionStruct *dst) const;
+    void updateColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, const QRect &rect);
+    void uploadColorSpaceConversionStruct(ColorSpaceConversionStruct *dst, KUndo2Command *parentCommand = 0);
+
     void setProjectionDevice(bool value);
     void tesingFetchLodDevice(KisPaintDeviceSP targetDevice);
 
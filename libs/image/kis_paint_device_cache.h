@@ -21,10 +21,35 @@
 
 #include "kis_lock_free_cache.h"
 #include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
 
 
 class KisPaintDeviceCache
 {
+public:
+    /**
+     * Bounds of the non-empty pixels of every tile of the device, they
+     * are not dropped on invalidate(), but validated by the revision of
+     * the tile instead. It lets the exact bounds be recalculated only
+     * from the tiles that have been changed since the last calculation.
+     */
+    struct TileBoundsCache {
+        struct TileBounds {
+            quint64 revision = 0;
+            QRect rect; // in the coordinates of the data manager
+        };
+
+        QMutex mutex;
+
+        /**
+         * The definition of the "empty" pixel the bounds have been
+         * calculated for
+         */
+        QByteArray emptyPixelKey;
+        QHash<quint64, TileBounds> tiles;
+    };
+
 public:
     KisPaintDeviceCache(KisPaintDevice *paintDevice)
         : m_paintDevice(paintDevice),
@@ -112,6 +137,10 @@ public:
         return m_sequenceNumber;
     }
 
+    TileBoundsCache* tileBoundsCache(bool nonDefaultOnly) {
+        return nonDefaultOnly ? &m_nonDefaultTileBounds : &m_exactTileBounds;
+    }
+
 private:
     inline QImage findThumbnail(qint32 w, qint32 h, qreal oversample) {
         QImage resultImage;
@@ -162,6 +191,9 @@ private:
     NonDefaultPixelCache m_nonDefaultPixelAreaCache;
     RegionCache m_regionCache;
 
+    TileBoundsCache m_exactTileBounds;
+    TileBoundsCache m_nonDefaultTileBounds;
+
     bool m_thumbnailsValid;
     QMap<int, QMap<int, QMap<qreal,QImage> > > m_thumbnails;
     QAtomicInt m_sequenceNumber;
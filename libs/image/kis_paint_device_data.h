@@ -169,47 +169,65 @@ public:
     }
 
     void convertDataColorSpace(const KoColorSpace *dstColorSpace, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags, KUndo2Command *parentCommand) {
-        typedef KisSequentialIteratorBase<ReadOnlyIteratorPolicy<DirectDataAccessPolicy>, DirectDataAccessPolicy> InternalSequentialConstIterator;
-        typedef KisSequentialIteratorBase<WritableIteratorPolicy<DirectDataAccessPolicy>, DirectDataAccessPolicy> InternalSequentialIterator;
-
         if (m_colorSpace == dstColorSpace || *m_colorSpace == *dstColorSpace) {
             return;
         }
 
-        QRect rc = m_dataManager->region().boundingRect();
+        KisDataManagerSP dstDataManager = createConvertedDataManager(dstColorSpace, renderingIntent, conversionFlags);
+        convertDataColorSpaceRect(dstDataManager, dstColorSpace, m_dataManager->region().boundingRect(), renderingIntent, conversionFlags);
+        uploadConvertedDataManager(dstDataManager, dstColorSpace, parentCommand);
+    }
 
+    /**
+     * The conversion of the color space can also be split into three
+     * steps, so that the pixels could be converted in parallel:
+     *
+     * 1) createConvertedDataManager() creates an empty data manager
+     *    in \p dstColorSpace
+     * 2) convertDataColorSpaceRect() converts a part of the data into
+     *    it. It can be called concurrently for non-intersecting rects.
+     * 3) uploadConvertedDataManager() switches the data to the converted
+     *    data manager
+     */
+    KisDataManagerSP createConvertedDataManager(const KoColorSpace *dstColorSpace, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags) {
         const int dstPixelSize = dstColorSpace->pixelSize();
         QScopedArrayPointer<quint8> dstDefaultPixel(new quint8[dstPixelSize]);
         memset(dstDefaultPixel.data(), 0, dstPixelSize);
         m_colorSpace->convertPixelsTo(m_dataManager->defaultPixel(), dstDefaultPixel.data(), dstColorSpace, 1, renderingIntent, conversionFlags);
 
-        KisDataManagerSP dstDataManager = new KisDataManager(dstPixelSize, dstDefaultPixel.data());
+        return new KisDataManager(dstPixelSize, dstDefaultPixel.data());
+    }
+
+    void convertDataColorSpaceRect(KisDataManagerSP dstDataManager, const KoColorSpace *dstColorSpace, const QRect &rc, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags) {
+        typedef KisSequentialIteratorBase<ReadOnlyIteratorPolicy<DirectDataAccessPolicy>, DirectDataAccessPolicy> InternalSequentialConstIterator;
+        typedef KisSequentialIteratorBase<WritableIteratorPolicy<DirectDataAccessPolicy>, DirectDataAccessPolicy> InternalSequentialIterator;
 
+        if (rc.isEmpty()) return;
 
-        if (!rc.isEmpty()) {
-            InternalSequentialConstIterator srcIt(DirectDataAccessPolicy(m_dataManager.data(), cacheInvalidator()), rc);
-            InternalSequentialIterator dstIt(DirectDataAccessPolicy(dstDataManager.data(), cacheInvalidator()), rc);
+        InternalSequentialConstIterator srcIt(DirectDataAccessPolicy(m_dataManager.data(), cacheInvalidator()), rc);
+        InternalSequentialIterator dstIt(DirectDataAccessPolicy(dstDataManager.data(), cacheInvalidator()), rc);
 
-            int nConseqPixels = srcIt.nConseqPixels();
+        int nConseqPixels = srcIt.nConseqPixels();
 
-            // since we are accessing data managers directly, the columns are always aligned
-            KIS_SAFE_ASSERT_RECOVER_NOOP(srcIt.nConseqPixels() == dstIt.nConseqPixels());
+        // since we are accessing data managers directly, the columns are always aligned
+        KIS_SAFE_ASSERT_RECOVER_NOOP(srcIt.nConseqPixels() == dstIt.nConseqPixels());
 
-            while(srcIt.nextPixels(nConseqPixels) &&
-                  dstIt.nextPixels(nConseqPixels)) {
+        while(srcIt.nextPixels(nConseqPixels) &&
+              dstIt.nextPixels(nConseqPixels)) {
 
-                nConseqPixels = srcIt.nConseqPixels();
+            nConseqPixels = srcIt.nConseqPixels();
 
-                const quint8 *srcData = srcIt.rawDataConst();
-                quint8 *dstData = dstIt.rawData();
+            const quint8 *srcData = srcIt.rawDataConst();
+            quint8 *dstData = dstIt.rawData();
 
-                m_colorSpace->convertPixelsTo(srcData, dstData,
-                                              dstColorSpace,
-                                              nConseqPixels,
-                                              renderingIntent, conversionFlags);
-            }
+            m_colorSpace->convertPixelsTo(srcData, dstData,
+                                          dstColorSpace,
+                                          nConseqPixels,
+                                          renderingIntent, conversionFlags);
         }
+    }
 
+    void uploadConvertedDataManager(KisDataManagerSP dstDataManager, const KoColorSpace *dstColorSpace, KUndo2Command *parentCommand) {
         // becomes owned by the parent
         ChangeColorSpaceCommand *cmd =
             new ChangeColorSpaceCommand(this,
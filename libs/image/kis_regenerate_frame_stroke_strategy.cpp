@@ -29,6 +29,10 @@
 #include "kis_async_merger.h"
 #include "kis_projection_updates_filter.h"
 
+#include <KisRunnableStrokeJobData.h>
+#include <KisRunnableStrokeJobUtils.h>
+#include <KisRunnableStrokeJobsInterface.h>
+
 
 struct KisRegenerateFrameStrokeStrategy::Private
 {
@@ -82,7 +86,7 @@ struct KisRegenerateFrameStrokeStrategy::Private
 KisRegenerateFrameStrokeStrategy::KisRegenerateFrameStrokeStrategy(int frameId,
                                                                    const KisRegion &dirtyRegion,
                                                                    KisImageAnimationInterface *interface)
-    : KisSimpleStrokeStrategy(QLatin1String("regenerate_external_frame_stroke")),
+    : KisRunnableBasedStrokeStrategy(QLatin1String("regenerate_external_frame_stroke")),
       m_d(new Private)
 {
     m_d->type = EXTERNAL_FRAME;
@@ -106,7 +110,7 @@ KisRegenerateFrameStrokeStrategy::KisRegenerateFrameStrokeStrategy(int frameId,
 }
 
 KisRegenerateFrameStrokeStrategy::KisRegenerateFrameStrokeStrategy(KisImageAnimationInterface *interface)
-    : KisSimpleStrokeStrategy(QLatin1String("regenerate_current_frame_stroke"), kundo2_i18n("Render Animation")),
+    : KisRunnableBasedStrokeStrategy(QLatin1String("regenerate_current_frame_stroke"), kundo2_i18n("Render Animation")),
       m_d(new Private)
 {
     m_d->type = CURRENT_FRAME;
@@ -151,15 +155,31 @@ void KisRegenerateFrameStrokeStrategy::initStrokeCallback()
 void KisRegenerateFrameStrokeStrategy::doStrokeCallback(KisStrokeJobData *data)
 {
     Private::Data *d = dynamic_cast<Private::Data*>(data);
-    KIS_ASSERT(d);
-    KIS_ASSERT(!m_d->dirtyRegion.isEmpty());
-    KIS_ASSERT(m_d->type == EXTERNAL_FRAME);
 
-    KisBaseRectsWalkerSP walker = new KisFullRefreshWalker(d->cropRect);
-    walker->collectRects(d->root, d->rect);
+    if (d) {
+        KIS_ASSERT(!m_d->dirtyRegion.isEmpty());
+        KIS_ASSERT(m_d->type == EXTERNAL_FRAME);
+
+        using KritaUtils::splitRectIntoPatches;
+        using KritaUtils::optimalPatchSize;
+
+        KisNodeSP root = d->root;
+        const QRect cropRect = d->cropRect;
+
+        QVector<KisRunnableStrokeJobData*> jobs;
+        KritaUtils::addJobsParallelFor(jobs, splitRectIntoPatches(d->rect, optimalPatchSize()), threadsLimit(),
+                                       [root, cropRect] (const QRect &rc) {
+            KisBaseRectsWalkerSP walker = new KisFullRefreshWalker(cropRect);
+            walker->collectRects(root, rc);
+
+            KisAsyncMerger merger;
+            merger.startMerge(*walker);
+        });
 
-    KisAsyncMerger merger;
-    merger.startMerge(*walker);
+        runnableJobsInterface()->addRunnableJobs(jobs);
+    } else {
+        KisRunnableBasedStrokeStrategy::doStrokeCallback(data);
+    }
 }
 
 void KisRegenerateFrameStrokeStrategy::finishStrokeCallback()
@@ -239,17 +259,14 @@ void KisRegenerateFrameStrokeStrategy::resumeStrokeCallback()
 
 QList<KisStrokeJobData*> KisRegenerateFrameStrokeStrategy::createJobsData(KisImageWSP _image)
 {
-    using KritaUtils::splitRectIntoPatches;
-    using KritaUtils::optimalPatchSize;
     KisImageSP image = _image;
 
-    const QRect cropRect = image->bounds();
-    QVector<QRect> rects = splitRectIntoPatches(image->bounds(), optimalPatchSize());
+    /**
+     * The frame is split into patches right in the stroke, so that
+     * they could be processed in a batch of threadsLimit() jobs
+     */
     QList<KisStrokeJobData*> jobsData;
-
-    Q_FOREACH (const QRect &rc, rects) {
-        jobsData << new Private::Data(image->root(), rc, cropRect);
-    }
+    jobsData << new Private::Data(image->root(), image->bounds(), image->bounds());
 
     return jobsData;
 }
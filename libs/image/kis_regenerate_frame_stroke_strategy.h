@@ -19,7 +19,7 @@
 #ifndef __KIS_REGENERATE_FRAME_STROKE_STRATEGY_H
 #define __KIS_REGENERATE_FRAME_STROKE_STRATEGY_H
 
-#include <kis_simple_stroke_strategy.h>
+#include <KisRunnableBasedStrokeStrategy.h>
 
 #include <QScopedPointer>
 
@@ -28,7 +28,7 @@ class KisRegion;
 class KisImageAnimationInterface;
 
 
-class KisRegenerateFrameStrokeStrategy : public KisSimpleStrokeStrategy
+class KisRegenerateFrameStrokeStrategy : public KisRunnableBasedStrokeStrategy
 {
 public:
     enum Type {
@@ -24,6 +24,10 @@
 #include "kis_image_config.h"
 #include "kis_full_refresh_walker.h"
 #include "kis_spontaneous_job.h"
+#include "KisMergeCostEstimator.h"
+#include "kis_lod_transform.h"
+
+#include <cmath>
 
 
 //#define ENABLE_DEBUG_JOIN
@@ -52,9 +56,28 @@
     #define ACCUMULATOR_DEBUG()
 #endif /* ENABLE_ACCUMULATOR */
 
+namespace {
+
+/**
+ * The adaptive patches are never smaller than a quarter of the
+ * configured patch size (to not drown in the overhead of the jobs)
+ * and never bigger than twice the configured size (to still keep all
+ * the threads busy on big updates)
+ */
+const qreal minPatchScale = 0.25;
+const qreal maxPatchScale = 2.0;
+const int patchAlignment = 64;
+
+inline int alignPatchSide(qreal value) {
+    return qMax(patchAlignment, qRound(value / patchAlignment) * patchAlignment);
+}
+
+}
+
 
 KisSimpleUpdateQueue::KisSimpleUpdateQueue()
-    : m_overrideLevelOfDetail(-1)
+    : m_overrideLevelOfDetail(-1),
+      m_prioritizeRegionOfInterest(true)
 {
     updateSettings();
 }
@@ -77,9 +100,14 @@ void KisSimpleUpdateQueue::updateSettings()
     m_patchWidth = config.updatePatchWidth();
     m_patchHeight = config.updatePatchHeight();
 
+    m_adaptivePatchSize = config.adaptiveUpdatePatchSize();
+    m_patchTargetTime = 1000.0 * config.updatePatchTargetTime();
+
     m_maxCollectAlpha = config.maxCollectAlpha();
     m_maxMergeAlpha = config.maxMergeAlpha();
     m_maxMergeCollectAlpha = config.maxMergeCollectAlpha();
+
+    m_prioritizeRegionOfInterest = config.prioritizeUpdatesInViewport();
 }
 
 int KisSimpleUpdateQueue::overrideLevelOfDetail() const
@@ -87,6 +115,18 @@ int KisSimpleUpdateQueue::overrideLevelOfDetail() const
     return m_overrideLevelOfDetail;
 }
 
+void KisSimpleUpdateQueue::setRegionsOfInterest(const QVector<QRect> &rects)
+{
+    QMutexLocker locker(&m_lock);
+    m_regionsOfInterest = rects;
+}
+
+QVector<QRect> KisSimpleUpdateQueue::regionsOfInterest() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_regionsOfInterest;
+}
+
 void KisSimpleUpdateQueue::processQueue(KisUpdaterContext &updaterContext)
 {
     updaterContext.lock();
@@ -101,31 +141,19 @@ bool KisSimpleUpdateQueue::processOneJob(KisUpdaterContext &updaterContext)
 {
     QMutexLocker locker(&m_lock);
 
-    KisBaseRectsWalkerSP item;
-    KisMutableWalkersListIterator iter(m_updatesList);
     bool jobAdded = false;
 
-    int currentLevelOfDetail = updaterContext.currentLevelOfDetail();
-
-    while(iter.hasNext()) {
-        item = iter.next();
-
-        if ((currentLevelOfDetail < 0 || currentLevelOfDetail == item->levelOfDetail()) &&
-            !item->checksumValid()) {
-
-            m_overrideLevelOfDetail = item->levelOfDetail();
-            item->recalculate(item->requestedRect());
-            m_overrideLevelOfDetail = -1;
-        }
-
-        if ((currentLevelOfDetail < 0 || currentLevelOfDetail == item->levelOfDetail()) &&
-            updaterContext.isJobAllowed(item)) {
+    /**
+     * The jobs visible to the user are started first. The rest of
+     * them are started only when there is no visible job that can be
+     * started right now.
+     */
+    if (m_prioritizeRegionOfInterest && !m_regionsOfInterest.isEmpty()) {
+        jobAdded = tryStartMergeJob(updaterContext, true);
+    }
 
-            updaterContext.addMergeJob(item);
-            iter.remove();
-            jobAdded = true;
-            break;
-        }
+    if (!jobAdded) {
+        jobAdded = tryStartMergeJob(updaterContext, false);
     }
 
     if (jobAdded) return true;
@@ -155,6 +183,54 @@ bool KisSimpleUpdateQueue::processOneJob(KisUpdaterContext &updaterContext)
     return jobAdded;
 }
 
+bool KisSimpleUpdateQueue::tryStartMergeJob(KisUpdaterContext &updaterContext, bool visibleOnly)
+{
+    KisBaseRectsWalkerSP item;
+    KisMutableWalkersListIterator iter(m_updatesList);
+
+    int currentLevelOfDetail = updaterContext.currentLevelOfDetail();
+
+    while(iter.hasNext()) {
+        item = iter.next();
+
+        if (visibleOnly && !isVisibleJob(item)) continue;
+
+        if ((currentLevelOfDetail < 0 || currentLevelOfDetail == item->levelOfDetail()) &&
+            !item->checksumValid()) {
+
+            m_overrideLevelOfDetail = item->levelOfDetail();
+            item->recalculate(item->requestedRect());
+            m_overrideLevelOfDetail = -1;
+        }
+
+        if ((currentLevelOfDetail < 0 || currentLevelOfDetail == item->levelOfDetail()) &&
+            updaterContext.isJobAllowed(item)) {
+
+            updaterContext.addMergeJob(item);
+            iter.remove();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool KisSimpleUpdateQueue::isVisibleJob(KisBaseRectsWalkerSP walker) const
+{
+    const int lod = walker->levelOfDetail();
+    const QRect changeRect = walker->changeRect();
+
+    Q_FOREACH (const QRect &rc, m_regionsOfInterest) {
+        const QRect roi = lod > 0 ?
+            KisLodTransform::scaledRect(KisLodTransform::alignedRect(rc, lod), lod) :
+            rc;
+
+        if (changeRect.intersects(roi)) return true;
+    }
+
+    return false;
+}
+
 void KisSimpleUpdateQueue::addUpdateJob(KisNodeSP node, const QVector<QRect> &rects, const QRect& cropRect, int levelOfDetail)
 {
     addJob(node, rects, cropRect, levelOfDetail, KisBaseRectsWalker::UPDATE);
@@ -184,7 +260,8 @@ void KisSimpleUpdateQueue::addFullRefreshJob(KisNodeSP node, const QVector<QRect
 void KisSimpleUpdateQueue::addJob(KisNodeSP node, const QVector<QRect> &rects,
                                   const QRect& cropRect,
                                   int levelOfDetail,
-                                  KisBaseRectsWalker::UpdateType type)
+                                  KisBaseRectsWalker::UpdateType type,
+                                  bool allowSplitting)
 {
     QList<KisBaseRectsWalkerSP> walkers;
 
@@ -192,22 +269,35 @@ void KisSimpleUpdateQueue::addJob(KisNodeSP node, const QVector<QRect> &rects,
         if (rc.isEmpty()) continue;
 
         KisBaseRectsWalkerSP walker;
+        QSize patchSize(m_patchWidth, m_patchHeight);
+
+        if (allowSplitting) {
+            /**
+             * The rect can be split only if it is bigger than the
+             * smallest possible patch. Then we need to collect the rects
+             * to know which layers the update will go through.
+             */
+            if (m_adaptivePatchSize &&
+                rc.width() > alignPatchSide(minPatchScale * m_patchWidth) &&
+                rc.height() > alignPatchSide(minPatchScale * m_patchHeight)) {
+
+                walker = createWalker(cropRect, type);
+                walker->collectRects(node, rc);
+                patchSize = patchSizeForWalker(walker);
+            }
+
+            if(trySplitJob(node, rc, cropRect, levelOfDetail, type, patchSize)) continue;
+        }
 
-        if(trySplitJob(node, rc, cropRect, levelOfDetail, type)) continue;
         if(tryMergeJob(node, rc, cropRect, levelOfDetail, type)) continue;
 
-        if (type == KisBaseRectsWalker::UPDATE) {
-            walker = new KisMergeWalker(cropRect, KisMergeWalker::DEFAULT);
+        if (!walker) {
+            walker = createWalker(cropRect, type);
+            walker->collectRects(node, rc);
+            patchSize = patchSizeForWalker(walker);
         }
-        else if (type == KisBaseRectsWalker::FULL_REFRESH)  {
-            walker = new KisFullRefreshWalker(cropRect);
-        }
-        else if (type == KisBaseRectsWalker::UPDATE_NO_FILTHY) {
-            walker = new KisMergeWalker(cropRect, KisMergeWalker::NO_FILTHY);
-        }
-        /* else if(type == KisBaseRectsWalker::UNSUPPORTED) fatalKrita; */
 
-        walker->collectRects(node, rc);
+        walker->setPatchSize(patchSize);
         walkers.append(walker);
     }
 
@@ -254,36 +344,85 @@ qint32 KisSimpleUpdateQueue::sizeMetric() const
 bool KisSimpleUpdateQueue::trySplitJob(KisNodeSP node, const QRect& rc,
                                        const QRect& cropRect,
                                        int levelOfDetail,
-                                       KisBaseRectsWalker::UpdateType type)
+                                       KisBaseRectsWalker::UpdateType type,
+                                       const QSize &patchSize)
 {
-    if(rc.width() <= m_patchWidth || rc.height() <= m_patchHeight)
+    const int patchWidth = patchSize.width();
+    const int patchHeight = patchSize.height();
+
+    if(rc.width() <= patchWidth || rc.height() <= patchHeight)
         return false;
 
     // a bit of recursive splitting...
 
-    qint32 firstCol = rc.x() / m_patchWidth;
-    qint32 firstRow = rc.y() / m_patchHeight;
+    qint32 firstCol = rc.x() / patchWidth;
+    qint32 firstRow = rc.y() / patchHeight;
 
-    qint32 lastCol = (rc.x() + rc.width()) / m_patchWidth;
-    qint32 lastRow = (rc.y() + rc.height()) / m_patchHeight;
+    qint32 lastCol = (rc.x() + rc.width()) / patchWidth;
+    qint32 lastRow = (rc.y() + rc.height()) / patchHeight;
 
     QVector<QRect> splitRects;
 
     for(qint32 i = firstRow; i <= lastRow; i++) {
         for(qint32 j = firstCol; j <= lastCol; j++) {
-            QRect maxPatchRect(j * m_patchWidth, i * m_patchHeight,
-                               m_patchWidth, m_patchHeight);
+            QRect maxPatchRect(j * patchWidth, i * patchHeight,
+                               patchWidth, patchHeight);
             QRect patchRect = rc & maxPatchRect;
             splitRects.append(patchRect);
         }
     }
 
     KIS_SAFE_ASSERT_RECOVER_NOOP(!splitRects.isEmpty());
-    addJob(node, splitRects, cropRect, levelOfDetail, type);
+
+    /**
+     * The patches must not be split once again, since the estimation
+     * of the adaptive patch size might differ for them a bit
+     */
+    addJob(node, splitRects, cropRect, levelOfDetail, type, false);
 
     return true;
 }
 
+KisBaseRectsWalkerSP KisSimpleUpdateQueue::createWalker(const QRect& cropRect,
+                                                        KisBaseRectsWalker::UpdateType type) const
+{
+    KisBaseRectsWalkerSP walker;
+
+    if (type == KisBaseRectsWalker::UPDATE) {
+        walker = new KisMergeWalker(cropRect, KisMergeWalker::DEFAULT);
+    }
+    else if (type == KisBaseRectsWalker::FULL_REFRESH)  {
+        walker = new KisFullRefreshWalker(cropRect);
+    }
+    else if (type == KisBaseRectsWalker::UPDATE_NO_FILTHY) {
+        walker = new KisMergeWalker(cropRect, KisMergeWalker::NO_FILTHY);
+    }
+    /* else if(type == KisBaseRectsWalker::UNSUPPORTED) fatalKrita; */
+
+    return walker;
+}
+
+QSize KisSimpleUpdateQueue::patchSizeForWalker(KisBaseRectsWalkerSP walker) const
+{
+    const QSize fixedPatchSize(m_patchWidth, m_patchHeight);
+    if (!m_adaptivePatchSize) return fixedPatchSize;
+
+    const QRect rc = walker->requestedRect();
+    const qreal area = qreal(rc.width()) * rc.height();
+    if (area <= 0) return fixedPatchSize;
+
+    const qreal costPerPixel = KisMergeCostEstimator::instance()->estimateCost(*walker) / area;
+    if (costPerPixel <= 0) return fixedPatchSize;
+
+    const qreal targetArea = m_patchTargetTime / costPerPixel;
+    const qreal scale = qBound(minPatchScale,
+                               std::sqrt(targetArea / (qreal(m_patchWidth) * m_patchHeight)),
+                               maxPatchScale);
+
+    return QSize(alignPatchSide(scale * m_patchWidth),
+                 alignPatchSide(scale * m_patchHeight));
+}
+
 bool KisSimpleUpdateQueue::tryMergeJob(KisNodeSP node, const QRect& rc,
                                        const QRect& cropRect,
                                        int levelOfDetail,
@@ -312,7 +451,8 @@ bool KisSimpleUpdateQueue::tryMergeJob(KisNodeSP node, const QRect& rc,
         if(item->cropRect() != cropRect) continue;
         if(item->levelOfDetail() != levelOfDetail) continue;
 
-        if(joinRects(baseRect, item->requestedRect(), m_maxMergeAlpha)) {
+        if(joinRects(baseRect, item->requestedRect(), m_maxMergeAlpha,
+                     item->patchSize())) {
             goodCandidate = item;
             break;
         }
@@ -343,6 +483,8 @@ void KisSimpleUpdateQueue::collectJobs(KisBaseRectsWalkerSP &baseWalker,
     KisBaseRectsWalkerSP item;
     KisMutableWalkersListIterator iter(m_updatesList);
 
+    const QSize patchSize = baseWalker->patchSize();
+
     while(iter.hasNext()) {
         item = iter.next();
 
@@ -352,7 +494,7 @@ void KisSimpleUpdateQueue::collectJobs(KisBaseRectsWalkerSP &baseWalker,
         if(item->cropRect() != baseWalker->cropRect()) continue;
         if(item->levelOfDetail() != baseWalker->levelOfDetail()) continue;
 
-        if(joinRects(baseRect, item->requestedRect(), maxAlpha)) {
+        if(joinRects(baseRect, item->requestedRect(), maxAlpha, patchSize)) {
             iter.remove();
         }
     }
@@ -363,10 +505,11 @@ void KisSimpleUpdateQueue::collectJobs(KisBaseRectsWalkerSP &baseWalker,
 }
 
 bool KisSimpleUpdateQueue::joinRects(QRect& baseRect,
-                                     const QRect& newRect, qreal maxAlpha)
+                                     const QRect& newRect, qreal maxAlpha,
+                                     const QSize &patchSize)
 {
     QRect unitedRect = baseRect | newRect;
-    if(unitedRect.width() > m_patchWidth || unitedRect.height() > m_patchHeight)
+    if(unitedRect.width() > patchSize.width() || unitedRect.height() > patchSize.height())
         return false;
 
     bool result = false;
@@ -400,3 +543,8 @@ KisSpontaneousJobsList& KisTestableSimpleUpdateQueue::getSpontaneousJobsList()
 {
     return m_spontaneousJobsList;
 }
+
+void KisTestableSimpleUpdateQueue::setAdaptivePatchSize(bool value)
+{
+    m_adaptivePatchSize = value;
+}
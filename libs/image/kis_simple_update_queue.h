@@ -56,17 +56,42 @@ public:
 
     int overrideLevelOfDetail() const;
 
+    /**
+     * Set the areas of the image the user is looking at (in image
+     * pixels of lod0), one per canvas. The merge jobs intersecting any
+     * of them are started first, the others are postponed till there
+     * are no visible jobs that can be started. An empty list disables
+     * the prioritization.
+     */
+    void setRegionsOfInterest(const QVector<QRect> &rects);
+    QVector<QRect> regionsOfInterest() const;
+
 protected:
-    void addJob(KisNodeSP node, const QVector<QRect> &rects, const QRect& cropRect, int levelOfDetail, KisBaseRectsWalker::UpdateType type);
+    void addJob(KisNodeSP node, const QVector<QRect> &rects, const QRect& cropRect, int levelOfDetail, KisBaseRectsWalker::UpdateType type, bool allowSplitting = true);
 
     bool processOneJob(KisUpdaterContext &updaterContext);
+    bool tryStartMergeJob(KisUpdaterContext &updaterContext, bool visibleOnly);
+    bool isVisibleJob(KisBaseRectsWalkerSP walker) const;
 
-    bool trySplitJob(KisNodeSP node, const QRect& rc, const QRect& cropRect, int levelOfDetail, KisBaseRectsWalker::UpdateType type);
+    bool trySplitJob(KisNodeSP node, const QRect& rc, const QRect& cropRect, int levelOfDetail, KisBaseRectsWalker::UpdateType type, const QSize &patchSize);
     bool tryMergeJob(KisNodeSP node, const QRect& rc, const QRect& cropRect, int levelOfDetail, KisBaseRectsWalker::UpdateType type);
 
     void collectJobs(KisBaseRectsWalkerSP &baseWalker, QRect baseRect,
                      const qreal maxAlpha);
-    bool joinRects(QRect& baseRect, const QRect& newRect, qreal maxAlpha);
+    bool joinRects(QRect& baseRect, const QRect& newRect, qreal maxAlpha, const QSize &patchSize);
+
+    KisBaseRectsWalkerSP createWalker(const QRect& cropRect, KisBaseRectsWalker::UpdateType type) const;
+
+    /**
+     * The size of the patches the requested rect of \p walker should
+     * be split into. When adaptive patches are enabled, the size is
+     * scaled so that merging a patch takes m_patchTargetTime.
+     *
+     * The estimation is not cheap, so it is done once, when the walker
+     * is queued, and stored in the walker (see
+     * KisBaseRectsWalker::patchSize()).
+     */
+    QSize patchSizeForWalker(KisBaseRectsWalkerSP walker) const;
 
 protected:
 
@@ -87,6 +112,14 @@ protected:
     qint32 m_patchWidth;
     qint32 m_patchHeight;
 
+    /**
+     * If true, the patch size is adjusted to the estimated cost of
+     * the merge, so that every job takes about m_patchTargetTime
+     * nanoseconds.
+     */
+    bool m_adaptivePatchSize;
+    qreal m_patchTargetTime;
+
     /**
      * Maximum coefficient of work while regular optimization()
      */
@@ -104,6 +137,9 @@ protected:
     qreal m_maxMergeCollectAlpha;
 
     int m_overrideLevelOfDetail;
+
+    bool m_prioritizeRegionOfInterest;
+    QVector<QRect> m_regionsOfInterest;
 };
 
 class KRITAIMAGE_EXPORT KisTestableSimpleUpdateQueue : public KisSimpleUpdateQueue
@@ -111,6 +147,7 @@ class KRITAIMAGE_EXPORT KisTestableSimpleUpdateQueue : public KisSimpleUpdateQue
 public:
     KisWalkersList& getWalkersList();
     KisSpontaneousJobsList& getSpontaneousJobsList();
+    void setAdaptivePatchSize(bool value);
 };
 
 #endif /* __KIS_SIMPLE_UPDATE_QUEUE_H */
@@ -166,6 +166,12 @@ void KisStrokeStrategy::addMutatedJob(KisStrokeJobData *data)
     addMutatedJobs({data});
 }
 
+int KisStrokeStrategy::threadsLimit() const
+{
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(m_mutatedJobsInterface, 1);
+    return m_mutatedJobsInterface->threadsLimit();
+}
+
 void KisStrokeStrategy::setExclusive(bool value)
 {
     m_exclusive = value;
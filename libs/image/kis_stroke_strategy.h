@@ -143,6 +143,13 @@ protected:
      */
     void addMutatedJob(KisStrokeJobData *data);
 
+    /**
+     * \return the number of threads the jobs of the stroke are executed
+     *         on, e.g. to decide how many jobs a batch should be split
+     *         into. The same requirements as for addMutatedJobs() apply.
+     */
+    int threadsLimit() const;
+
 
     // you are not supposed to change these parameters
     // after the KisStroke object has been created
@@ -32,6 +32,7 @@ typedef QQueue<KisStrokeSP> StrokesQueue;
 typedef QQueue<KisStrokeSP>::iterator StrokesQueueIterator;
 
 #include "kis_image_interfaces.h"
+#include "KisTraceRecorder.h"
 class KisStrokesQueue::LodNUndoStrokesFacade : public KisStrokesFacade
 {
 public:
@@ -79,6 +80,8 @@ struct Q_DECL_HIDDEN KisStrokesQueue::Private {
           balancingRatioOverride(-1.0),
           currentStrokeLoaded(false),
           lodNNeedsSynchronization(true),
+          lodSyncInBackground(false),
+          threadsLimit(1),
           desiredLevelOfDetail(0),
           nextDesiredLevelOfDetail(0),
           lodNStrokesFacade(_q),
@@ -93,6 +96,8 @@ struct Q_DECL_HIDDEN KisStrokesQueue::Private {
     bool currentStrokeLoaded;
 
     bool lodNNeedsSynchronization;
+    bool lodSyncInBackground;
+    QAtomicInt threadsLimit;
     int desiredLevelOfDetail;
     int nextDesiredLevelOfDetail;
     QMutex mutex;
@@ -111,6 +116,7 @@ struct Q_DECL_HIDDEN KisStrokesQueue::Private {
     bool shouldWrapInSuspendUpdatesStroke() const;
 
     void switchDesiredLevelOfDetail(bool forced);
+    void trySyncLodNInBackground();
     bool hasUnfinishedStrokes() const;
     void tryClearUndoOnStrokeCompletion(KisStrokeSP finishingStroke);
 };
@@ -169,6 +175,14 @@ void KisStrokesQueue::Private::cancelForgettableStrokes()
 
             if (stroke->canForgetAboutMe()) {
                 stroke->cancelStroke();
+
+                /**
+                 * A cancelled sync stroke doesn't upload anything,
+                 * so the caches should be regenerated again
+                 */
+                if (stroke->type() == KisStroke::LODN) {
+                    lodNNeedsSynchronization = true;
+                }
             }
         }
     }
@@ -348,6 +362,16 @@ void KisStrokesQueue::addMutatedJobs(KisStrokeId id, const QVector<KisStrokeJobD
     stroke->addMutatedJobs(list);
 }
 
+int KisStrokesQueue::threadsLimit() const
+{
+    return m_d->threadsLimit.loadAcquire();
+}
+
+void KisStrokesQueue::setThreadsLimit(int value)
+{
+    m_d->threadsLimit.storeRelease(value);
+}
+
 void KisStrokesQueue::endStroke(KisStrokeId id)
 {
     QMutexLocker locker(&m_d->mutex);
@@ -413,11 +437,13 @@ bool KisStrokesQueue::tryCancelCurrentStrokeAsync()
             currentStroke->cancelStroke();
 
             // we shouldn't cancel buddies...
-            if (currentStroke->type() == KisStroke::LOD0) {
+            if (currentStroke->type() == KisStroke::LOD0 ||
+                currentStroke->type() == KisStroke::LODN) {
                 /**
                  * If the buddy has already finished, we cannot undo it because
                  * it doesn't store any undo data. Therefore we just regenerate
-                 * the LOD caches.
+                 * the LOD caches. The same happens when a sync stroke is
+                 * cancelled before uploading its data.
                  */
                 m_d->lodNNeedsSynchronization = true;
             }
@@ -531,6 +557,8 @@ void KisStrokesQueue::Private::tryClearUndoOnStrokeCompletion(KisStrokeSP finish
 void KisStrokesQueue::processQueue(KisUpdaterContext &updaterContext,
                                    bool externalJobsPending)
 {
+    KIS_TRACE_SPAN("strokes", "process strokes queue");
+
     updaterContext.lock();
     m_d->mutex.lock();
 
@@ -593,6 +621,27 @@ void KisStrokesQueue::Private::switchDesiredLevelOfDetail(bool forced)
     }
 }
 
+void KisStrokesQueue::Private::trySyncLodNInBackground()
+{
+    /**
+     * Don't wait for the next instant preview stroke to regenerate the
+     * caches, do that right when the image becomes idle. The sync stroke
+     * regenerates only the tiles changed since the previous sync, so it
+     * is cheap when nothing has happened.
+     *
+     * The stroke is forgettable: if the user starts a new stroke, the
+     * sync is cancelled and lodNNeedsSynchronization is raised again,
+     * so the user never has to wait for the background sync.
+     */
+    if (lodSyncInBackground &&
+        strokesQueue.isEmpty() &&
+        desiredLevelOfDetail &&
+        lodNNeedsSynchronization) {
+
+        startLod0ToNStroke(desiredLevelOfDetail, true);
+    }
+}
+
 void KisStrokesQueue::explicitRegenerateLevelOfDetail()
 {
     QMutexLocker locker(&m_d->mutex);
@@ -616,6 +665,12 @@ void KisStrokesQueue::notifyUFOChangedImage()
     m_d->lodNNeedsSynchronization = true;
 }
 
+void KisStrokesQueue::setLodSyncInBackground(bool value)
+{
+    QMutexLocker locker(&m_d->mutex);
+    m_d->lodSyncInBackground = value;
+}
+
 void KisStrokesQueue::debugDumpAllStrokes()
 {
     QMutexLocker locker(&m_d->mutex);
@@ -743,6 +798,7 @@ bool KisStrokesQueue::checkStrokeState(bool hasStrokeJobsRunning,
         m_d->currentStrokeLoaded = false;
 
         m_d->switchDesiredLevelOfDetail(false);
+        m_d->trySyncLodNInBackground();
 
         if(!m_d->strokesQueue.isEmpty()) {
             result = checkStrokeState(false, runningLevelOfDetail);
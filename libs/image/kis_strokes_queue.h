@@ -78,10 +78,24 @@ public:
      */
     void notifyUFOChangedImage();
 
+    /**
+     * When enabled, the queue regenerates the level of detail caches
+     * right after the last legacy stroke is finished, so that the next
+     * instant preview stroke doesn't have to wait for the synchronization
+     */
+    void setLodSyncInBackground(bool value);
+
+    /**
+     * Sets the number of threads of the updater context the queue
+     * is processed by, see threadsLimit()
+     */
+    void setThreadsLimit(int value);
+
     void debugDumpAllStrokes();
 
     // interface for KisStrokeStrategy only!
     void addMutatedJobs(KisStrokeId id, const QVector<KisStrokeJobData*> list) final;
+    int threadsLimit() const final;
 
 private:
     bool processOneJob(KisUpdaterContext &updaterContext,
@@ -26,6 +26,7 @@
 #include "kundo2command.h"
 #include "KisRunnableStrokeJobDataBase.h"
 #include "KisRunnableStrokeJobsInterface.h"
+#include "KisRunnableStrokeJobUtils.h"
 #include "kis_paintop_utils.h"
 
 
@@ -275,33 +276,6 @@ struct KisSuspendProjectionUpdatesStrokeStrategy::Private
         Private *m_d;
     };
 
-    struct UploadDataToUIData : public KisRunnableStrokeJobDataBase
-    {
-        UploadDataToUIData(const QRect &rc, int updateEpoch, KisSuspendProjectionUpdatesStrokeStrategy *strategy)
-            : KisRunnableStrokeJobDataBase(KisStrokeJobData::CONCURRENT),
-              m_strategy(strategy),
-              m_rc(rc),
-              m_updateEpoch(updateEpoch)
-        {
-        }
-
-        void run() override {
-            // check if we've already started stinking...
-            if (m_strategy->m_d->updatesEpoch > m_updateEpoch) {
-                return;
-            }
-
-            KisImageSP image = m_strategy->m_d->image.toStrongRef();
-            KIS_SAFE_ASSERT_RECOVER_RETURN(image);
-
-            image->notifyProjectionUpdated(m_rc);
-        }
-
-        KisSuspendProjectionUpdatesStrokeStrategy *m_strategy;
-        QRect m_rc;
-        int m_updateEpoch;
-    };
-
     struct BlockUILodSync : public KisRunnableStrokeJobDataBase
     {
         BlockUILodSync(bool block, KisSuspendProjectionUpdatesStrokeStrategy *strategy)
@@ -350,10 +324,23 @@ struct KisSuspendProjectionUpdatesStrokeStrategy::Private
 
             image->signalRouter()->emitNotifyBatchUpdateStarted();
 
+            KisSuspendProjectionUpdatesStrokeStrategy *strategy = m_strategy;
+            const int updatesEpoch = m_strategy->m_d->updatesEpoch;
+
             QVector<KisRunnableStrokeJobDataBase*> jobsData;
-            Q_FOREACH (const QRect &rc, m_strategy->m_d->accumulatedDirtyRects) {
-                jobsData << new Private::UploadDataToUIData(rc, m_strategy->m_d->updatesEpoch, m_strategy);
-            }
+            KritaUtils::addJobsParallelFor(jobsData, m_strategy->m_d->accumulatedDirtyRects,
+                                           m_strategy->runnableJobsInterface()->threadsLimit(),
+                                           [strategy, updatesEpoch] (const QRect &rc) {
+                // check if we've already started stinking...
+                if (strategy->m_d->updatesEpoch > updatesEpoch) {
+                    return;
+                }
+
+                KisImageSP image = strategy->m_d->image.toStrongRef();
+                KIS_SAFE_ASSERT_RECOVER_RETURN(image);
+
+                image->notifyProjectionUpdated(rc);
+            });
 
             m_strategy->runnableJobsInterface()->addRunnableJobs(jobsData);
 
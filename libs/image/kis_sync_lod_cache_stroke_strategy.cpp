@@ -22,6 +22,10 @@
 #include <kundo2magicstring.h>
 #include "krita_utils.h"
 #include "kis_layer_utils.h"
+#include <KisRegion.h>
+#include <KisRunnableStrokeJobData.h>
+#include <KisRunnableStrokeJobUtils.h>
+#include <KisRunnableStrokeJobsInterface.h>
 
 
 struct KisSyncLodCacheStrokeStrategy::Private
@@ -36,23 +40,12 @@ struct KisSyncLodCacheStrokeStrategy::Private
 
     class InitData : public KisStrokeJobData {
     public:
-        InitData(KisPaintDeviceSP _device)
+        InitData(const KisPaintDeviceList &_devices)
             : KisStrokeJobData(SEQUENTIAL),
-              device(_device)
+              devices(_devices)
             {}
 
-        KisPaintDeviceSP device;
-    };
-
-    class ProcessData : public KisStrokeJobData {
-    public:
-        ProcessData(KisPaintDeviceSP _device, const QRect &_rect)
-            : KisStrokeJobData(CONCURRENT),
-              device(_device), rect(_rect)
-            {}
-
-        KisPaintDeviceSP device;
-        QRect rect;
+        KisPaintDeviceList devices;
     };
 
     class AdditionalProcessNode : public KisStrokeJobData {
@@ -67,7 +60,7 @@ struct KisSyncLodCacheStrokeStrategy::Private
 };
 
 KisSyncLodCacheStrokeStrategy::KisSyncLodCacheStrokeStrategy(KisImageWSP image, bool forgettable)
-    : KisSimpleStrokeStrategy(QLatin1String("SyncLodCacheStroke"), kundo2_i18n("Instant Preview")),
+    : KisRunnableBasedStrokeStrategy(QLatin1String("SyncLodCacheStroke"), kundo2_i18n("Instant Preview")),
       m_d(new Private)
 {
     m_d->image = image;
@@ -93,21 +86,47 @@ KisSyncLodCacheStrokeStrategy::~KisSyncLodCacheStrokeStrategy()
 void KisSyncLodCacheStrokeStrategy::doStrokeCallback(KisStrokeJobData *data)
 {
     Private::InitData *initData = dynamic_cast<Private::InitData*>(data);
-    Private::ProcessData *processData = dynamic_cast<Private::ProcessData*>(data);
     Private::AdditionalProcessNode *additionalProcessNode = dynamic_cast<Private::AdditionalProcessNode*>(data);
 
     if (initData) {
-        KisPaintDeviceSP dev = initData->device;
-        const int lod = dev->defaultBounds()->currentLevelOfDetail();
-        m_d->dataObjects.insert(dev, dev->createLodDataStruct(lod));
-    } else if (processData) {
-        KisPaintDeviceSP dev = processData->device;
-        KIS_ASSERT(m_d->dataObjects.contains(dev));
-
-        KisPaintDevice::LodDataStruct *data = m_d->dataObjects.value(dev);
-        dev->updateLodDataStruct(data, processData->rect);
+        using KritaUtils::splitRegionIntoPatches;
+        using KritaUtils::optimalPatchSize;
+
+        /**
+         * The regions are calculated only when all the previous strokes
+         * have finished their work, so that only the tiles changed since
+         * the previous synchronization were regenerated.
+         */
+        typedef QPair<KisPaintDeviceSP, QRect> DevicePatch;
+        QVector<DevicePatch> patches;
+
+        Q_FOREACH (KisPaintDeviceSP dev, initData->devices) {
+            const int lod = dev->defaultBounds()->currentLevelOfDetail();
+            KisPaintDevice::LodDataStruct *data = dev->createLodDataStruct(lod);
+            m_d->dataObjects.insert(dev, data);
+
+            const KisRegion region = dev->regionForLodSyncing(data);
+            Q_FOREACH (const QRect &rc, splitRegionIntoPatches(region, optimalPatchSize())) {
+                patches << DevicePatch(dev, rc);
+            }
+        }
+
+        Private *d = m_d.data();
+        QVector<KisRunnableStrokeJobData*> jobsData;
+
+        KritaUtils::addJobsParallelFor(jobsData, patches, threadsLimit(),
+                                       [d] (const DevicePatch &patch) {
+            KIS_ASSERT(d->dataObjects.contains(patch.first));
+
+            KisPaintDevice::LodDataStruct *data = d->dataObjects.value(patch.first);
+            patch.first->updateLodDataStruct(data, patch.second);
+        });
+
+        runnableJobsInterface()->addRunnableJobs(jobsData);
     } else if (additionalProcessNode) {
         additionalProcessNode->node->syncLodCache();
+    } else {
+        KisRunnableBasedStrokeStrategy::doStrokeCallback(data);
     }
 }
 
@@ -134,8 +153,6 @@ void KisSyncLodCacheStrokeStrategy::cancelStrokeCallback()
 QList<KisStrokeJobData*> KisSyncLodCacheStrokeStrategy::createJobsData(KisImageWSP _image)
 {
     using KisLayerUtils::recursiveApplyNodes;
-    using KritaUtils::splitRegionIntoPatches;
-    using KritaUtils::optimalPatchSize;
 
     KisImageSP image = _image;
 
@@ -149,18 +166,7 @@ QList<KisStrokeJobData*> KisSyncLodCacheStrokeStrategy::createJobsData(KisImageW
 
     KritaUtils::makeContainerUnique(deviceList);
 
-    Q_FOREACH (KisPaintDeviceSP device, deviceList) {
-        jobsData << new Private::InitData(device);
-    }
-
-    Q_FOREACH (KisPaintDeviceSP device, deviceList) {
-        KisRegion region = device->regionForLodSyncing();
-        QVector<QRect> rects = splitRegionIntoPatches(region, optimalPatchSize());
-
-        Q_FOREACH (const QRect &rc, rects) {
-            jobsData << new Private::ProcessData(device, rc);
-        }
-    }
+    jobsData << new Private::InitData(deviceList);
 
     recursiveApplyNodes(image->root(),
                         [&jobsData](KisNodeSP node) {
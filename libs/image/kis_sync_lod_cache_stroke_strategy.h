@@ -19,11 +19,11 @@
 #ifndef __KIS_SYNC_LOD_CACHE_STROKE_STRATEGY_H
 #define __KIS_SYNC_LOD_CACHE_STROKE_STRATEGY_H
 
-#include <kis_simple_stroke_strategy.h>
+#include <KisRunnableBasedStrokeStrategy.h>
 
 #include <QScopedPointer>
 
-class KisSyncLodCacheStrokeStrategy : public KisSimpleStrokeStrategy
+class KisSyncLodCacheStrokeStrategy : public KisRunnableBasedStrokeStrategy
 {
 public:
     KisSyncLodCacheStrokeStrategy(KisImageWSP image, bool forgettable);
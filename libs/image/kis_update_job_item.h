@@ -29,6 +29,7 @@
 #include "kis_base_rects_walker.h"
 #include "kis_async_merger.h"
 #include "kis_updater_context.h"
+#include "KisTraceRecorder.h"
 
 //#define DEBUG_JOBS_SEQUENCE
 
@@ -51,6 +52,9 @@ public:
     {
         setAutoDelete(false);
         KIS_SAFE_ASSERT_RECOVER_NOOP(m_atomicType.is_lock_free());
+
+        // huge merges are split and helped by the idle threads
+        m_merger.setParallelExecutor(&updaterContext->m_executor);
     }
     ~KisUpdateJobItem() override
     {
@@ -58,67 +62,57 @@ public:
     }
 
     void run() override {
-        if (!isRunning()) return;
+        KIS_SAFE_ASSERT_RECOVER_RETURN(isRunning());
 
         /**
-         * Here we break the idea of QThreadPool a bit. Ideally, we should split the
-         * jobs into distinct QRunnable objects and pass all of them to QThreadPool.
-         * That is a nice idea, but it doesn't work well when the jobs are small enough
-         * and the number of available cores is high (>4 cores). It this case the
-         * threads just tend to execute the job very quickly and go to sleep, which is
-         * an expensive operation.
-         *
-         * To overcome this problem we try to bulk-process the jobs. In sigJobFinished()
-         * signal (which is DirectConnection), the context may add the job to ourselves(!!!),
-         * so we switch from "done" state into "running" again.
+         * Every job is a separate task of the work-stealing executor. When
+         * the job finishes, the context may start the next one right from
+         * jobFinished(). The executor pushes it to the deque of the current
+         * worker, so this thread picks it up as soon as we return and the
+         * idle workers may steal it, instead of the job going to sleep.
          */
 
-        while (1) {
-            KIS_SAFE_ASSERT_RECOVER_RETURN(isRunning());
-
-            if(m_exclusive) {
-                m_updaterContext->m_exclusiveJobLock.lockForWrite();
-            } else {
-                m_updaterContext->m_exclusiveJobLock.lockForRead();
-            }
+        if(m_exclusive) {
+            m_updaterContext->m_exclusiveJobLock.lockForWrite();
+        } else {
+            m_updaterContext->m_exclusiveJobLock.lockForRead();
+        }
 
-            if(m_atomicType == Type::MERGE) {
-                runMergeJob();
-            } else {
-                KIS_ASSERT(m_atomicType == Type::STROKE ||
-                           m_atomicType == Type::SPONTANEOUS);
+        if(m_atomicType == Type::MERGE) {
+            runMergeJob();
+        } else {
+            KIS_ASSERT(m_atomicType == Type::STROKE ||
+                       m_atomicType == Type::SPONTANEOUS);
 
-                if (m_runnableJob) {
+            if (m_runnableJob) {
 #ifdef DEBUG_JOBS_SEQUENCE
-                    if (m_atomicType == Type::STROKE) {
-                        qDebug() << "running: stroke" << m_runnableJob->debugName();
-                    } else if (m_atomicType == Type::SPONTANEOUS) {
-                        qDebug() << "running: spont " << m_runnableJob->debugName();
-                    } else {
-                        qDebug() << "running: unkn. " << m_runnableJob->debugName();
-                    }
+                if (m_atomicType == Type::STROKE) {
+                    qDebug() << "running: stroke" << m_runnableJob->debugName();
+                } else if (m_atomicType == Type::SPONTANEOUS) {
+                    qDebug() << "running: spont " << m_runnableJob->debugName();
+                } else {
+                    qDebug() << "running: unkn. " << m_runnableJob->debugName();
+                }
 #endif
 
-                    m_runnableJob->run();
-                }
-            }
+                KisTraceSpan span("updater",
+                                  m_atomicType == Type::STROKE ?
+                                      "stroke job" : "spontaneous job");
 
-            setDone();
+                m_runnableJob->run();
+            }
+        }
 
-            m_updaterContext->doSomeUsefulWork();
+        setDone();
 
-            // may flip the current state from Waiting -> Running again
-            m_updaterContext->jobFinished();
+        m_updaterContext->doSomeUsefulWork();
+        m_updaterContext->jobFinished();
 
-            m_updaterContext->m_exclusiveJobLock.unlock();
+        m_updaterContext->m_exclusiveJobLock.unlock();
 
-            // try to exit the loop. Please note, that no one can flip the state from
-            // WAITING to EMPTY except ourselves!
-            Type expectedValue = Type::WAITING;
-            if (m_atomicType.compare_exchange_strong(expectedValue, Type::EMPTY)) {
-                break;
-            }
-        }
+        // the executor doesn't touch the item after run() returns,
+        // so from now on the context may reuse it for another job
+        m_atomicType = Type::EMPTY;
     }
 
     inline void runMergeJob() {
@@ -132,15 +126,16 @@ public:
 
 #endif
 
+        KIS_TRACE_SPAN("updater", "merge job");
+
         m_merger.startMerge(*m_walker);
 
         QRect changeRect = m_walker->changeRect();
         m_updaterContext->continueUpdate(changeRect);
     }
 
-    // return true if the thread should actually be started
-    inline bool setWalker(KisBaseRectsWalkerSP walker) {
-        KIS_ASSERT(m_atomicType <= Type::WAITING);
+    inline void setWalker(KisBaseRectsWalkerSP walker) {
+        KIS_ASSERT(m_atomicType == Type::EMPTY);
 
         m_accessRect = walker->accessRect();
         m_changeRect = walker->changeRect();
@@ -149,13 +144,11 @@ public:
         m_exclusive = false;
         m_runnableJob = 0;
 
-        const Type oldState = m_atomicType.exchange(Type::MERGE);
-        return oldState == Type::EMPTY;
+        m_atomicType = Type::MERGE;
     }
 
-    // return true if the thread should actually be started
-    inline bool setStrokeJob(KisStrokeJob *strokeJob) {
-        KIS_ASSERT(m_atomicType <= Type::WAITING);
+    inline void setStrokeJob(KisStrokeJob *strokeJob) {
+        KIS_ASSERT(m_atomicType == Type::EMPTY);
 
         m_runnableJob = strokeJob;
         m_strokeJobSequentiality = strokeJob->sequentiality();
@@ -164,13 +157,11 @@ public:
         m_walker = 0;
         m_accessRect = m_changeRect = QRect();
 
-        const Type oldState = m_atomicType.exchange(Type::STROKE);
-        return oldState == Type::EMPTY;
+        m_atomicType = Type::STROKE;
     }
 
-    // return true if the thread should actually be started
-    inline bool setSpontaneousJob(KisSpontaneousJob *spontaneousJob) {
-        KIS_ASSERT(m_atomicType <= Type::WAITING);
+    inline void setSpontaneousJob(KisSpontaneousJob *spontaneousJob) {
+        KIS_ASSERT(m_atomicType == Type::EMPTY);
 
         m_runnableJob = spontaneousJob;
 
@@ -178,14 +169,22 @@ public:
         m_walker = 0;
         m_accessRect = m_changeRect = QRect();
 
-        const Type oldState = m_atomicType.exchange(Type::SPONTANEOUS);
-        return oldState == Type::EMPTY;
+        m_atomicType = Type::SPONTANEOUS;
     }
 
     inline void setDone() {
+        const Type type = m_atomicType;
+
         m_walker = 0;
         delete m_runnableJob;
         m_runnableJob = 0;
+
+        if (type == Type::MERGE || type == Type::SPONTANEOUS) {
+            m_updaterContext->m_numMergeJobs.deref();
+        } else if (type == Type::STROKE) {
+            m_updaterContext->m_numStrokeJobs.deref();
+        }
+
         m_atomicType = Type::WAITING;
     }
 
@@ -193,6 +192,14 @@ public:
         return m_atomicType >= Type::MERGE;
     }
 
+    /**
+     * The item is free when it has no job and its run() has returned,
+     * a finished item is still WAITING while it calls jobFinished()
+     */
+    inline bool isFree() const {
+        return m_atomicType == Type::EMPTY;
+    }
+
     inline Type type() const {
         return m_atomicType;
     }
@@ -233,6 +240,7 @@ private:
 
     inline void testingSetDone() {
         setDone();
+        m_atomicType = Type::EMPTY;
     }
 
 private:
@@ -52,7 +52,9 @@ struct Q_DECL_HIDDEN KisUpdateScheduler::Private {
         : q(_q)
         , updaterContext(KisImageConfig(true).maxNumberOfThreads(), q)
         , projectionUpdateListener(p)
-    {}
+    {
+        strokesQueue.setThreadsLimit(updaterContext.threadsLimit());
+    }
 
     KisUpdateScheduler *q;
 
@@ -66,6 +68,13 @@ struct Q_DECL_HIDDEN KisUpdateScheduler::Private {
 
     QAtomicInt updatesLockCounter;
     QReadWriteLock updatesStartLock;
+
+    /**
+     * The number of spareThreadAppeared() calls that haven't been
+     * handled yet. Only the thread that raised it from zero processes
+     * the queues, the others just leave the request for it.
+     */
+    QAtomicInt spareThreadRequests;
     KisLazyWaitCondition updatesFinishedCondition;
 
     qreal balancingRatio() const {
@@ -105,6 +114,7 @@ void KisUpdateScheduler::setThreadsLimit(int value)
     lock();
     m_d->updaterContext.lock();
     m_d->updaterContext.setThreadsLimit(value);
+    m_d->strokesQueue.setThreadsLimit(value);
     m_d->updaterContext.unlock();
     unlock(false);
 }
@@ -286,6 +296,11 @@ int KisUpdateScheduler::currentLevelOfDetail() const
     return levelOfDetail;
 }
 
+void KisUpdateScheduler::setRegionsOfInterest(const QVector<QRect> &rects)
+{
+    m_d->updatesQueue.setRegionsOfInterest(rects);
+}
+
 void KisUpdateScheduler::setLod0ToNStrokeStrategyFactory(const KisLodSyncStrokeStrategyFactory &factory)
 {
     m_d->strokesQueue.setLod0ToNStrokeStrategyFactory(factory);
@@ -306,7 +321,17 @@ void KisUpdateScheduler::updateSettings()
     m_d->updatesQueue.updateSettings();
     KisImageConfig config(true);
     m_d->defaultBalancingRatio = config.schedulerBalancingRatio();
+    m_d->strokesQueue.setLodSyncInBackground(config.syncLodCacheInBackground());
     setThreadsLimit(config.maxNumberOfThreads());
+
+    const bool numaAware = config.numaAwareThreads();
+    if (numaAware != m_d->updaterContext.numaAware()) {
+        lock();
+        m_d->updaterContext.lock();
+        m_d->updaterContext.setNumaAware(numaAware);
+        m_d->updaterContext.unlock();
+        unlock(false);
+    }
 }
 
 void KisUpdateScheduler::lock()
@@ -464,7 +489,21 @@ void KisUpdateScheduler::doSomeUsefulWork()
 
 void KisUpdateScheduler::spareThreadAppeared()
 {
-    processQueues();
+    /**
+     * Every finished job calls this method. When many small jobs finish
+     * at once, processing the queues in every one of them would just make
+     * the workers wait for each other on the context lock. Instead, the
+     * queues are processed by one of them, and it repeats the processing
+     * while the others keep reporting about freed threads.
+     */
+    if (m_d->spareThreadRequests.fetchAndAddOrdered(1) > 0) return;
+
+    int numHandledRequests = 0;
+
+    do {
+        numHandledRequests = m_d->spareThreadRequests.loadAcquire();
+        processQueues();
+    } while (m_d->spareThreadRequests.fetchAndAddOrdered(-numHandledRequests) != numHandledRequests);
 }
 
 KisTestableUpdateScheduler::KisTestableUpdateScheduler(KisProjectionUpdateListener *projectionUpdateListener,
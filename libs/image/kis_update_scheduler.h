@@ -165,6 +165,13 @@ public:
      */
     void explicitRegenerateLevelOfDetail();
 
+    /**
+     * Set the areas of the image visible to the user (in lod0 image
+     * pixels). The updates of these areas are processed before the rest
+     * of the image. Pass an empty list to reset.
+     */
+    void setRegionsOfInterest(const QVector<QRect> &rects);
+
     /**
      * Install a factory of a stroke strategy, that will be started
      * every time when the scheduler needs to synchronize LOD caches
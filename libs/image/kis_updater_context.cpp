@@ -19,7 +19,6 @@
 #include "kis_updater_context.h"
 
 #include <QThread>
-#include <QThreadPool>
 
 #include "kis_update_job_item.h"
 #include "kis_stroke_job.h"
@@ -39,7 +38,7 @@ KisUpdaterContext::KisUpdaterContext(qint32 threadCount, QObject *parent)
 
 KisUpdaterContext::~KisUpdaterContext()
 {
-    m_threadPool.waitForDone();
+    m_executor.waitForDone();
     for(qint32 i = 0; i < m_jobs.size(); i++)
         delete m_jobs[i];
 }
@@ -47,18 +46,8 @@ KisUpdaterContext::~KisUpdaterContext()
 void KisUpdaterContext::getJobsSnapshot(qint32 &numMergeJobs,
                                         qint32 &numStrokeJobs)
 {
-    numMergeJobs = 0;
-    numStrokeJobs = 0;
-
-    Q_FOREACH (const KisUpdateJobItem *item, m_jobs) {
-        if(item->type() == KisUpdateJobItem::Type::MERGE ||
-           item->type() == KisUpdateJobItem::Type::SPONTANEOUS) {
-            numMergeJobs++;
-        }
-        else if(item->type() == KisUpdateJobItem::Type::STROKE) {
-            numStrokeJobs++;
-        }
-    }
+    numMergeJobs = m_numMergeJobs.loadAcquire();
+    numStrokeJobs = m_numStrokeJobs.loadAcquire();
 }
 
 KisUpdaterContextSnapshotEx KisUpdaterContext::getContextSnapshotEx() const
@@ -97,15 +86,7 @@ int KisUpdaterContext::currentLevelOfDetail() const
 
 bool KisUpdaterContext::hasSpareThread()
 {
-    bool found = false;
-
-    Q_FOREACH (const KisUpdateJobItem *item, m_jobs) {
-        if(!item->isRunning()) {
-            found = true;
-            break;
-        }
-    }
-    return found;
+    return m_numMergeJobs.loadAcquire() + m_numStrokeJobs.loadAcquire() < m_threadsLimit;
 }
 
 bool KisUpdaterContext::isJobAllowed(KisBaseRectsWalkerSP walker)
@@ -136,16 +117,14 @@ bool KisUpdaterContext::isJobAllowed(KisBaseRectsWalkerSP walker)
 void KisUpdaterContext::addMergeJob(KisBaseRectsWalkerSP walker)
 {
     m_lodCounter.addLod(walker->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setWalker(walker);
+    m_numMergeJobs.ref();
+    item->setWalker(walker);
 
-    // it might happen that we call this function from within
-    // the thread itself, right when it finished its work
-    if (shouldStartThread) {
-        m_threadPool.start(m_jobs[jobIndex]);
-    }
+    // when called from within a job, the item goes to the deque
+    // of the current worker
+    m_executor.start(item);
 }
 
 /**
@@ -154,28 +133,25 @@ void KisUpdaterContext::addMergeJob(KisBaseRectsWalkerSP walker)
 void KisUpdaterContext::addMergeJobTest(KisBaseRectsWalkerSP walker)
 {
     m_lodCounter.addLod(walker->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setWalker(walker);
+    m_numMergeJobs.ref();
+    item->setWalker(walker);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
 
 void KisUpdaterContext::addStrokeJob(KisStrokeJob *strokeJob)
 {
     m_lodCounter.addLod(strokeJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setStrokeJob(strokeJob);
+    m_numStrokeJobs.ref();
+    item->setStrokeJob(strokeJob);
 
-    // it might happen that we call this function from within
-    // the thread itself, right when it finished its work
-    if (shouldStartThread) {
-        m_threadPool.start(m_jobs[jobIndex]);
-    }
+    // when called from within a job, the item goes to the deque
+    // of the current worker
+    m_executor.start(item);
 }
 
 /**
@@ -184,28 +160,25 @@ void KisUpdaterContext::addStrokeJob(KisStrokeJob *strokeJob)
 void KisUpdaterContext::addStrokeJobTest(KisStrokeJob *strokeJob)
 {
     m_lodCounter.addLod(strokeJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setStrokeJob(strokeJob);
+    m_numStrokeJobs.ref();
+    item->setStrokeJob(strokeJob);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
 
 void KisUpdaterContext::addSpontaneousJob(KisSpontaneousJob *spontaneousJob)
 {
     m_lodCounter.addLod(spontaneousJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setSpontaneousJob(spontaneousJob);
+    m_numMergeJobs.ref();
+    item->setSpontaneousJob(spontaneousJob);
 
-    // it might happen that we call this function from within
-    // the thread itself, right when it finished its work
-    if (shouldStartThread) {
-        m_threadPool.start(m_jobs[jobIndex]);
-    }
+    // when called from within a job, the item goes to the deque
+    // of the current worker
+    m_executor.start(item);
 }
 
 /**
@@ -214,18 +187,17 @@ void KisUpdaterContext::addSpontaneousJob(KisSpontaneousJob *spontaneousJob)
 void KisUpdaterContext::addSpontaneousJobTest(KisSpontaneousJob *spontaneousJob)
 {
     m_lodCounter.addLod(spontaneousJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setSpontaneousJob(spontaneousJob);
+    m_numMergeJobs.ref();
+    item->setSpontaneousJob(spontaneousJob);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
 
 void KisUpdaterContext::waitForDone()
 {
-    m_threadPool.waitForDone();
+    m_executor.waitForDone();
 }
 
 bool KisUpdaterContext::walkerIntersectsJob(KisBaseRectsWalkerSP walker,
@@ -235,13 +207,17 @@ bool KisUpdaterContext::walkerIntersectsJob(KisBaseRectsWalkerSP walker,
         (job->accessRect().intersects(walker->changeRect()));
 }
 
-qint32 KisUpdaterContext::findSpareThread()
+KisUpdateJobItem* KisUpdaterContext::acquireJobItem()
 {
-    for(qint32 i=0; i < m_jobs.size(); i++)
-        if(!m_jobs[i]->isRunning())
-            return i;
+    Q_FOREACH (KisUpdateJobItem *item, m_jobs) {
+        if (item->isFree()) {
+            return item;
+        }
+    }
 
-    return -1;
+    KisUpdateJobItem *item = new KisUpdateJobItem(this);
+    m_jobs.append(item);
+    return item;
 }
 
 void KisUpdaterContext::lock()
@@ -256,7 +232,8 @@ void KisUpdaterContext::unlock()
 
 void KisUpdaterContext::setThreadsLimit(int value)
 {
-    m_threadPool.setMaxThreadCount(value);
+    // waits until all the items have left their run()
+    m_executor.setMaxThreadCount(value);
 
     for (int i = 0; i < m_jobs.size(); i++) {
         KIS_SAFE_ASSERT_RECOVER_RETURN(!m_jobs[i]->isRunning());
@@ -267,6 +244,7 @@ void KisUpdaterContext::setThreadsLimit(int value)
         delete m_jobs[i];
     }
 
+    m_threadsLimit = value;
     m_jobs.resize(value);
 
     for(qint32 i = 0; i < m_jobs.size(); i++) {
@@ -276,8 +254,22 @@ void KisUpdaterContext::setThreadsLimit(int value)
 
 int KisUpdaterContext::threadsLimit() const
 {
-    KIS_SAFE_ASSERT_RECOVER_NOOP(m_jobs.size() == m_threadPool.maxThreadCount());
-    return m_jobs.size();
+    KIS_SAFE_ASSERT_RECOVER_NOOP(m_threadsLimit == m_executor.maxThreadCount());
+    return m_threadsLimit;
+}
+
+void KisUpdaterContext::setNumaAware(bool value)
+{
+    for (int i = 0; i < m_jobs.size(); i++) {
+        KIS_SAFE_ASSERT_RECOVER_RETURN(!m_jobs[i]->isRunning());
+    }
+
+    m_executor.setNumaAware(value);
+}
+
+bool KisUpdaterContext::numaAware() const
+{
+    return m_executor.numaAware();
 }
 
 void KisUpdaterContext::continueUpdate(const QRect& rc)
@@ -340,13 +332,12 @@ void KisTestableUpdaterContext::clear()
 void KisTestableUpdaterContext::addSpontaneousJob(KisSpontaneousJob *spontaneousJob)
 {
     m_lodCounter.addLod(spontaneousJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setSpontaneousJob(spontaneousJob);
+    m_numMergeJobs.ref();
+    item->setSpontaneousJob(spontaneousJob);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
 
 /**
@@ -355,13 +346,12 @@ void KisTestableUpdaterContext::addSpontaneousJob(KisSpontaneousJob *spontaneous
 void KisTestableUpdaterContext::addStrokeJob(KisStrokeJob *strokeJob)
 {
     m_lodCounter.addLod(strokeJob->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setStrokeJob(strokeJob);
+    m_numStrokeJobs.ref();
+    item->setStrokeJob(strokeJob);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
 
 /**
@@ -370,11 +360,10 @@ void KisTestableUpdaterContext::addStrokeJob(KisStrokeJob *strokeJob)
 void KisTestableUpdaterContext::addMergeJob(KisBaseRectsWalkerSP walker)
 {
     m_lodCounter.addLod(walker->levelOfDetail());
-    qint32 jobIndex = findSpareThread();
-    Q_ASSERT(jobIndex >= 0);
+    KisUpdateJobItem *item = acquireJobItem();
 
-    const bool shouldStartThread = m_jobs[jobIndex]->setWalker(walker);
+    m_numMergeJobs.ref();
+    item->setWalker(walker);
 
     // HINT: Not calling start() here
-    Q_UNUSED(shouldStartThread);
 }
@@ -22,11 +22,11 @@
 #include <QObject>
 #include <QMutex>
 #include <QReadWriteLock>
-#include <QThreadPool>
 
 #include "kis_base_rects_walker.h"
 #include "kis_async_merger.h"
 #include "kis_lock_free_lod_counter.h"
+#include "KisWorkStealingExecutor.h"
 
 #include "KisUpdaterContextSnapshotEx.h"
 #include "kis_update_scheduler.h"
@@ -48,9 +48,9 @@ public:
 
     /**
      * Returns the number of currently running jobs of each type.
-     * To use this information you should lock the context beforehand.
-     *
-     * \see lock()
+     * The counters are atomic, so the context doesn't need to be
+     * locked, though without the lock the values may be outdated
+     * right after the call.
      */
     void getJobsSnapshot(qint32 &numMergeJobs, qint32 &numStrokeJobs);
 
@@ -139,6 +139,15 @@ public:
      */
     int threadsLimit() const;
 
+    /**
+     * Bind the worker threads of the context to the NUMA nodes of the
+     * machine. The same restrictions as for setThreadsLimit() apply.
+     *
+     * \see KisWorkStealingExecutor::setNumaAware()
+     */
+    void setNumaAware(bool value);
+    bool numaAware() const;
+
     void continueUpdate(const QRect& rc);
     void doSomeUsefulWork();
     void jobFinished();
@@ -146,7 +155,13 @@ public:
 protected:
     static bool walkerIntersectsJob(KisBaseRectsWalkerSP walker,
                                     const KisUpdateJobItem* job);
-    qint32 findSpareThread();
+
+    /**
+     * Returns an item that is not used by any job. If all the items
+     * are still busy (some of them may be finishing their run()),
+     * a new one is created. Should be called with the lock held.
+     */
+    KisUpdateJobItem* acquireJobItem();
 
 protected:
     /**
@@ -158,8 +173,20 @@ protected:
     QReadWriteLock m_exclusiveJobLock;
 
     QMutex m_lock;
+
+    /**
+     * The items carrying the jobs to the executor. They are not bound
+     * to the worker threads, every job is started as a separate task of
+     * the executor in a free item. The number of concurrent jobs is
+     * limited by threadsLimit(), the number of the items may be higher,
+     * because a finished item cannot be reused until its run() returns.
+     */
     QVector<KisUpdateJobItem*> m_jobs;
-    QThreadPool m_threadPool;
+    int m_threadsLimit {0};
+    QAtomicInt m_numMergeJobs;
+    QAtomicInt m_numStrokeJobs;
+
+    KisWorkStealingExecutor m_executor;
     KisLockFreeLodCounter m_lodCounter;
     KisUpdateScheduler *m_scheduler;
 
@@ -137,6 +137,7 @@ void KisColorizeStrokeStrategy::initStrokeCallback()
 
     const QVector<QRect> patchRects =
         splitRectIntoPatches(m_d->boundingRect, optimalPatchSize());
+    const int numWorkers = threadsLimit();
 
     if (!m_d->filteredSourceValid) {
         // TODO: make this conversion concurrent!!!
@@ -163,16 +164,14 @@ void KisColorizeStrokeStrategy::initStrokeCallback()
                 state->activeTransaction.reset(new KisTransaction(state->filteredMainDev));
             });
 
-            Q_FOREACH (const QRect &rc, patchRects) {
-                addJobConcurrent(jobs, [state, rc] () {
-                    KisLodTransformScalar t(state->filteredMainDev);
-                    KisGaussianKernel::applyLoG(state->filteredMainDev,
-                                                rc,
-                                                t.scale(0.5 * state->filteringOptions.edgeDetectionSize),
-                                                -1.0,
-                                                QBitArray(), 0);
-                });
-            }
+            addJobsParallelFor(jobs, patchRects, numWorkers, [state] (const QRect &rc) {
+                KisLodTransformScalar t(state->filteredMainDev);
+                KisGaussianKernel::applyLoG(state->filteredMainDev,
+                                            rc,
+                                            t.scale(0.5 * state->filteringOptions.edgeDetectionSize),
+                                            -1.0,
+                                            QBitArray(), 0);
+            });
 
             addJobSequential(jobs, [state] () {
                 state->activeTransaction.reset();
@@ -180,16 +179,14 @@ void KisColorizeStrokeStrategy::initStrokeCallback()
                 state->activeTransaction.reset(new KisTransaction(state->filteredMainDev));
             });
 
-            Q_FOREACH (const QRect &rc, patchRects) {
-                addJobConcurrent(jobs, [state, rc] () {
-                    KisLodTransformScalar t(state->filteredMainDev);
-                    KisGaussianKernel::applyGaussian(state->filteredMainDev,
-                                                     rc,
-                                                     t.scale(state->filteringOptions.edgeDetectionSize),
-                                                     t.scale(state->filteringOptions.edgeDetectionSize),
-                                                     QBitArray(), 0);
-                });
-            }
+            addJobsParallelFor(jobs, patchRects, numWorkers, [state] (const QRect &rc) {
+                KisLodTransformScalar t(state->filteredMainDev);
+                KisGaussianKernel::applyGaussian(state->filteredMainDev,
+                                                 rc,
+                                                 t.scale(state->filteringOptions.edgeDetectionSize),
+                                                 t.scale(state->filteringOptions.edgeDetectionSize),
+                                                 QBitArray(), 0);
+            });
 
             addJobSequential(jobs, [state] () {
                 state->activeTransaction.reset();
@@ -203,18 +200,16 @@ void KisColorizeStrokeStrategy::initStrokeCallback()
                 state->activeTransaction.reset(new KisTransaction(state->filteredMainDev));
             });
 
-            Q_FOREACH (const QRect &rc, patchRects) {
-                addJobConcurrent(jobs, [state, rc] () {
-                    KisLodTransformScalar t(state->filteredMainDev);
-                    KisGaussianKernel::applyGaussian(state->filteredMainDev,
-                                                     rc,
-                                                     t.scale(state->filteringOptions.fuzzyRadius),
-                                                     t.scale(state->filteringOptions.fuzzyRadius),
-                                                     QBitArray(), 0);
-                    KisPainter gc(state->filteredMainDev);
-                    gc.bitBlt(rc.topLeft(), state->filteredMainDevSavedCopy, rc);
-                });
-            }
+            addJobsParallelFor(jobs, patchRects, numWorkers, [state] (const QRect &rc) {
+                KisLodTransformScalar t(state->filteredMainDev);
+                KisGaussianKernel::applyGaussian(state->filteredMainDev,
+                                                 rc,
+                                                 t.scale(state->filteringOptions.fuzzyRadius),
+                                                 t.scale(state->filteringOptions.fuzzyRadius),
+                                                 QBitArray(), 0);
+                KisPainter gc(state->filteredMainDev);
+                gc.bitBlt(rc.topLeft(), state->filteredMainDevSavedCopy, rc);
+            });
 
             addJobSequential(jobs, [state] () {
                 state->activeTransaction.reset();
@@ -236,14 +231,12 @@ void KisColorizeStrokeStrategy::initStrokeCallback()
             m_d->heightMap = new KisPaintDevice(*m_d->filteredSource);
         });
 
-        Q_FOREACH (const QRect &rc, patchRects) {
-            addJobConcurrent(jobs, [this, rc] () {
-                KritaUtils::filterAlpha8Device(m_d->heightMap, rc,
-                                               [](quint8 pixel) {
-                                                   return quint8(255 - pixel);
-                                               });
-            });
-        }
+        addJobsParallelFor(jobs, patchRects, numWorkers, [this] (const QRect &rc) {
+            KritaUtils::filterAlpha8Device(m_d->heightMap, rc,
+                                           [](quint8 pixel) {
+                                               return quint8(255 - pixel);
+                                           });
+        });
 
         addJobSequential(jobs, [this] () {
             KisProcessingVisitor::ProgressHelper helper(m_d->progressNode);
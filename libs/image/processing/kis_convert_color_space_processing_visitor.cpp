@@ -32,16 +32,19 @@
 #include "kis_time_range.h"
 #include <commands_new/KisChangeChannelFlagsCommand.h>
 #include <commands_new/KisChangeChannelLockFlagsCommand.h>
+#include <commands_new/KisConvertColorSpaceDevicesCommand.h>
 
 
 KisConvertColorSpaceProcessingVisitor::KisConvertColorSpaceProcessingVisitor(const KoColorSpace *srcColorSpace,
                                                                              const KoColorSpace *dstColorSpace,
                                                                              KoColorConversionTransformation::Intent renderingIntent,
-                                                                             KoColorConversionTransformation::ConversionFlags conversionFlags)
+                                                                             KoColorConversionTransformation::ConversionFlags conversionFlags,
+                                                                             KisConvertColorSpaceDevicesCommand *devicesCommand)
     : m_srcColorSpace(srcColorSpace)
     , m_dstColorSpace(dstColorSpace)
     , m_renderingIntent(renderingIntent)
     , m_conversionFlags(conversionFlags)
+    , m_devicesCommand(devicesCommand)
 
 {
 }
@@ -75,29 +78,46 @@ void KisConvertColorSpaceProcessingVisitor::visitNodeWithPaintDevice(KisNode *no
     }
 
 
-    if (layer->original()) {
-        layer->original()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
-    }
+    /**
+     * When the conversion is delegated to m_devicesCommand, the channel
+     * flags should still be restored only after the devices have been
+     * converted, so these commands are passed to it as well.
+     */
+    KUndo2Command *postConversionCommand = parentConversionCommand;
 
-    if (layer->paintDevice()) {
-        layer->paintDevice()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
-    }
+    if (m_devicesCommand) {
+        undoAdapter->addCommand(parentConversionCommand);
+        postConversionCommand = new KUndo2Command();
+
+        m_devicesCommand->addDevices({layer->original(), layer->paintDevice(), layer->projection()},
+                                     undoAdapter, postConversionCommand);
+    } else {
+        if (layer->original()) {
+            layer->original()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
+        }
 
-    if (layer->projection()) {
-        layer->projection()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
+        if (layer->paintDevice()) {
+            layer->paintDevice()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
+        }
+
+        if (layer->projection()) {
+            layer->projection()->convertTo(m_dstColorSpace, m_renderingIntent, m_conversionFlags, parentConversionCommand);
+        }
     }
 
     if (layer && alphaDisabled) {
         new KisChangeChannelFlagsCommand(m_dstColorSpace->channelFlags(true, false),
-                                         layer, parentConversionCommand);
+                                         layer, postConversionCommand);
     }
 
     if (paintLayer && alphaLock) {
         new KisChangeChannelLockFlagsCommand(m_dstColorSpace->channelFlags(true, false),
-                                             paintLayer, parentConversionCommand);
+                                             paintLayer, postConversionCommand);
     }
 
-    undoAdapter->addCommand(parentConversionCommand);
+    if (!m_devicesCommand) {
+        undoAdapter->addCommand(parentConversionCommand);
+    }
     layer->invalidateFrames(KisTimeRange::infinite(0), layer->extent());
 }
 
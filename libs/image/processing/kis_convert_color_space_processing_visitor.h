@@ -25,14 +25,23 @@
 #include <KoColorConversionTransformation.h>
 
 class KoColorSpace;
+class KisConvertColorSpaceDevicesCommand;
 
 class KRITAIMAGE_EXPORT  KisConvertColorSpaceProcessingVisitor : public KisSimpleProcessingVisitor
 {
 public:
+    /**
+     * If \p devicesCommand is set, the pixel data of the layers is not
+     * converted by the visitor itself. Instead, the devices are passed
+     * to \p devicesCommand, which converts them all in parallel later.
+     * The command should be applied to the same applicator after the
+     * visitor.
+     */
     KisConvertColorSpaceProcessingVisitor(const KoColorSpace *srcColorSpace,
                                           const KoColorSpace *dstColorSpace,
                                           KoColorConversionTransformation::Intent renderingIntent,
-                                          KoColorConversionTransformation::ConversionFlags conversionFlags);
+                                          KoColorConversionTransformation::ConversionFlags conversionFlags,
+                                          KisConvertColorSpaceDevicesCommand *devicesCommand = 0);
 
 private:
     void visitNodeWithPaintDevice(KisNode *node, KisUndoAdapter *undoAdapter) override;
@@ -49,6 +58,7 @@ private:
     const KoColorSpace *m_dstColorSpace;
     KoColorConversionTransformation::Intent m_renderingIntent;
     KoColorConversionTransformation::ConversionFlags m_conversionFlags;
+    KisConvertColorSpaceDevicesCommand *m_devicesCommand;
 };
 
 #endif /* __KIS_CONVERT_COLORSPACE_PROCESSING_VISITOR_H */
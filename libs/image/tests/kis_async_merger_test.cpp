@@ -43,6 +43,8 @@
 
 #include "kis_image_config.h"
 #include "KisImageConfigNotifier.h"
+#include "KisWorkStealingExecutor.h"
+#include "KisBelowLayersCache.h"
 
 void KisAsyncMergerTest::init()
 {
@@ -259,6 +261,162 @@ void KisAsyncMergerTest::testFullRefreshWithClones()
       +--------------+
      */
 
+void KisAsyncMergerTest::testParallelFullRefresh()
+{
+    const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->rgb8();
+
+    // the size is not aligned to the merge blocks on purpose
+    KisImageSP image = new KisImage(0, 1500, 1100, colorSpace, "parallel merge test");
+
+    KisPaintLayerSP paintLayer1 = new KisPaintLayer(image, "paint1", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP paintLayer2 = new KisPaintLayer(image, "paint2", 128);
+    KisGroupLayerSP groupLayer = new KisGroupLayer(image, "group", 200);
+
+    paintLayer1->paintDevice()->fill(QRect(0, 0, 1500, 1100), KoColor(Qt::white, colorSpace));
+    paintLayer1->paintDevice()->fill(QRect(100, 70, 900, 500), KoColor(Qt::blue, colorSpace));
+    paintLayer2->paintDevice()->fill(QRect(300, 200, 1100, 850), KoColor(Qt::red, colorSpace));
+
+    image->addNode(paintLayer1, image->rootLayer());
+    image->addNode(groupLayer, image->rootLayer());
+    image->addNode(paintLayer2, groupLayer);
+
+    QRect cropRect(image->bounds());
+
+    {
+        KisFullRefreshWalker walker(cropRect);
+        walker.collectRects(image->rootLayer(), image->bounds());
+
+        KisAsyncMerger merger;
+        merger.startMerge(walker);
+    }
+
+    KisPaintDeviceSP sequentialResult = new KisPaintDevice(*image->projection());
+    image->projection()->clear();
+
+    {
+        KisFullRefreshWalker walker(cropRect);
+        walker.collectRects(image->rootLayer(), image->bounds());
+
+        KisWorkStealingExecutor executor(4);
+        KisAsyncMerger merger;
+        merger.setParallelExecutor(&executor);
+        merger.startMerge(walker);
+    }
+
+    QPoint pt;
+    QVERIFY(TestUtil::comparePaintDevices(pt, sequentialResult, image->projection()));
+}
+
+void KisAsyncMergerTest::testBelowLayersCache()
+{
+    const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, 128, 128, colorSpace, "below layers cache test");
+
+    KisPaintLayerSP paintLayer1 = new KisPaintLayer(image, "paint1", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP paintLayer2 = new KisPaintLayer(image, "paint2", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP paintLayer3 = new KisPaintLayer(image, "paint3", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP paintLayer4 = new KisPaintLayer(image, "paint4", OPACITY_OPAQUE_U8);
+
+    paintLayer1->paintDevice()->fill(image->bounds(), KoColor(Qt::white, colorSpace));
+    paintLayer2->paintDevice()->fill(QRect(0, 0, 64, 128), KoColor(Qt::red, colorSpace));
+    paintLayer3->paintDevice()->fill(QRect(0, 0, 32, 128), KoColor(Qt::green, colorSpace));
+
+    image->addNode(paintLayer1, image->rootLayer());
+    image->addNode(paintLayer2, image->rootLayer());
+    image->addNode(paintLayer3, image->rootLayer());
+    image->addNode(paintLayer4, image->rootLayer());
+
+    // let the updates caused by adding the nodes pass
+    image->waitForDone();
+
+    QVERIFY(image->rootLayer()->belowLayersCache()->isEnabled());
+
+    const QRect cropRect(image->bounds());
+    const QRect updateRect(0, 0, 128, 64);
+
+    auto mergeThrough = [&] (KisNodeSP node) {
+        KisMergeWalker walker(cropRect);
+        walker.collectRects(node, updateRect);
+
+        KisAsyncMerger merger;
+        merger.startMerge(walker);
+    };
+
+    auto projectionColor = [&] (int x, int y) {
+        QColor color;
+        image->projection()->pixel(x, y, &color);
+        return color;
+    };
+
+    // paint on the topmost layer, the lower ones get cached
+    paintLayer4->paintDevice()->fill(QRect(96, 0, 32, 128), KoColor(Qt::blue, colorSpace));
+    mergeThrough(paintLayer4);
+
+    QCOMPARE(projectionColor(10, 10), QColor(Qt::green));
+    QCOMPARE(projectionColor(40, 10), QColor(Qt::red));
+    QCOMPARE(projectionColor(100, 10), QColor(Qt::blue));
+
+    /**
+     * The lower layer is changed silently, so the next update of the
+     * topmost layer takes the stale composition from the cache
+     */
+    paintLayer3->paintDevice()->fill(QRect(0, 0, 32, 128), KoColor(Qt::yellow, colorSpace));
+    mergeThrough(paintLayer4);
+
+    QCOMPARE(projectionColor(10, 10), QColor(Qt::green));
+
+    // the update of the lower layer drops the cache
+    mergeThrough(paintLayer3);
+    QCOMPARE(projectionColor(10, 10), QColor(Qt::yellow));
+
+    mergeThrough(paintLayer4);
+    QCOMPARE(projectionColor(10, 10), QColor(Qt::yellow));
+    QCOMPARE(projectionColor(40, 10), QColor(Qt::red));
+    QCOMPARE(projectionColor(100, 10), QColor(Qt::blue));
+}
+
+void KisAsyncMergerTest::testBelowLayersCacheMemoryLimit()
+{
+    const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->rgb8();
+    const QRect rect(0, 0, 128, 128);
+    const qint64 deviceSize = qint64(rect.width()) * rect.height() * colorSpace->pixelSize();
+
+    KisPaintDeviceSP src = new KisPaintDevice(colorSpace);
+    src->fill(rect, KoColor(Qt::red, colorSpace));
+
+    KisPaintDeviceSP dst = new KisPaintDevice(colorSpace);
+
+    const qint64 oldLimit = KisBelowLayersCache::memoryLimit();
+    KisBelowLayersCache::setMemoryLimit(deviceSize * 3 / 2);
+
+    KisBelowLayersCache::Key key;
+
+    KisBelowLayersCache cache1;
+    KisBelowLayersCache cache2;
+
+    cache1.store(key, rect, src);
+    QCOMPARE(cache1.memoryUsage(), deviceSize);
+    QVERIFY(KisBelowLayersCache::totalMemoryUsage() >= deviceSize);
+
+    // the second cache doesn't fit the budget, the older one is dropped
+    cache2.store(key, rect, src);
+    QCOMPARE(cache1.memoryUsage(), qint64(0));
+    QCOMPARE(cache2.memoryUsage(), deviceSize);
+    QVERIFY(KisBelowLayersCache::totalMemoryUsage() <= KisBelowLayersCache::memoryLimit());
+
+    QVERIFY(!cache1.tryFetch(key, rect, dst));
+    QVERIFY(cache2.tryFetch(key, rect, dst));
+
+    cache1.store(key, rect, src);
+    QCOMPARE(cache1.memoryUsage(), deviceSize);
+    QCOMPARE(cache2.memoryUsage(), qint64(0));
+
+    cache1.invalidate();
+    QCOMPARE(cache1.memoryUsage(), qint64(0));
+
+    KisBelowLayersCache::setMemoryLimit(oldLimit);
+}
+
 void KisAsyncMergerTest::testSubgraphingWithoutUpdatingParent()
 {
     const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->rgb8();
@@ -31,6 +31,9 @@ private Q_SLOTS:
     void testMerger();
     void debugObligeChild();
     void testFullRefreshWithClones();
+    void testParallelFullRefresh();
+    void testBelowLayersCache();
+    void testBelowLayersCacheMemoryLimit();
     void testSubgraphingWithoutUpdatingParent();
 
     void testFullRefreshGroupWithMask();
@@ -294,6 +294,60 @@ void KisPaintDeviceTest::testColorSpaceConversion()
     delete cmd;
 }
 
+#include <algorithm>
+#include "krita_utils.h"
+
+void KisPaintDeviceTest::testColorSpaceConversionInPatches()
+{
+    QImage image(QString(FILES_DATA_DIR) + '/' + "hakonepa.png");
+    const KoColorSpace* srcCs = KoColorSpaceRegistry::instance()->rgb8();
+    const KoColorSpace* dstCs = KoColorSpaceRegistry::instance()->lab16();
+
+    KisPaintDeviceSP dev = new KisPaintDevice(srcCs);
+    dev->convertFromQImage(image, 0);
+    dev->moveTo(10, 10);   // Unalign with tile boundaries
+
+    KisPaintDeviceSP refDev = new KisPaintDevice(*dev);
+    refDev->convertTo(dstCs);
+
+    QScopedPointer<KisPaintDevice::ColorSpaceConversionStruct> conversion(
+        dev->createColorSpaceConversionStruct(dstCs));
+
+    QVector<QRect> patches =
+        KritaUtils::splitRegionIntoPatches(dev->regionForColorSpaceConversion(conversion.data()),
+                                           QSize(128, 128));
+    QVERIFY(patches.size() > 1);
+
+    // the order of the patches should not matter
+    std::reverse(patches.begin(), patches.end());
+
+    Q_FOREACH (const QRect &rc, patches) {
+        dev->updateColorSpaceConversionStruct(conversion.data(), rc);
+    }
+
+    // nothing is changed before uploading
+    QVERIFY(*dev->colorSpace() == *srcCs);
+
+    KUndo2Command* cmd = new KUndo2Command();
+    dev->uploadColorSpaceConversionStruct(conversion.data(), cmd);
+
+    QCOMPARE(dev->exactBounds(), QRect(10, 10, image.width(), image.height()));
+    QCOMPARE(dev->pixelSize(), dstCs->pixelSize());
+    QVERIFY(*dev->colorSpace() == *dstCs);
+
+    QPoint errpoint;
+    QVERIFY(TestUtil::comparePaintDevices(errpoint, dev, refDev));
+
+    cmd->redo();
+    cmd->undo();
+
+    QCOMPARE(dev->exactBounds(), QRect(10, 10, image.width(), image.height()));
+    QCOMPARE(dev->pixelSize(), srcCs->pixelSize());
+    QVERIFY(*dev->colorSpace() == *srcCs);
+
+    delete cmd;
+}
+
 
 void KisPaintDeviceTest::testRoundtripConversion()
 {
@@ -764,6 +818,41 @@ void KisPaintDeviceTest::testAmortizedExactBounds()
     QCOMPARE(dev->exactBoundsAmortized(), fillRect);
 }
 
+void KisPaintDeviceTest::testIncrementalExactBounds()
+{
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisPaintDeviceSP dev = new KisPaintDevice(cs);
+
+    const QRect fillRect(10, 10, 300, 300);
+    dev->fill(fillRect, KoColor(Qt::white, cs));
+    dev->setDirty();
+
+    QCOMPARE(dev->exactBounds(), fillRect);
+
+    // a change outside the bounds extends them
+    dev->setPixel(1000, 1000, QColor(Qt::black));
+    dev->setDirty();
+    QCOMPARE(dev->exactBounds(), QRect(QPoint(10, 10), QPoint(1000, 1000)));
+
+    // a change inside the bounds doesn't affect them
+    dev->fill(QRect(100, 100, 10, 10), KoColor(Qt::red, cs));
+    dev->setDirty();
+    QCOMPARE(dev->exactBounds(), QRect(QPoint(10, 10), QPoint(1000, 1000)));
+
+    // erasing the border pixel shrinks the bounds back
+    dev->clear(QRect(1000, 1000, 1, 1));
+    dev->setDirty();
+    QCOMPARE(dev->exactBounds(), fillRect);
+
+    // erasing a part of a tile that has been cached
+    dev->clear(QRect(10, 10, 300, 20));
+    dev->setDirty();
+    QCOMPARE(dev->exactBounds(), QRect(10, 30, 300, 280));
+
+    dev->moveTo(QPoint(5, 7));
+    QCOMPARE(dev->exactBounds(), QRect(15, 37, 300, 280));
+}
+
 void KisPaintDeviceTest::testNonDefaultPixelArea()
 {
     const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
@@ -1538,6 +1627,65 @@ void KisPaintDeviceTest::testLodDevice()
                                   "lod", "lod1-offset-6-14"));
 }
 
+KisRegion syncLodCacheIncrementally(KisPaintDeviceSP dev, int levelOfDetail)
+{
+    QScopedPointer<KisPaintDevice::LodDataStruct> s(dev->createLodDataStruct(levelOfDetail));
+
+    const KisRegion region = dev->regionForLodSyncing(s.data());
+    Q_FOREACH(QRect rect2, KritaUtils::splitRegionIntoPatches(region, KritaUtils::optimalPatchSize())) {
+        dev->updateLodDataStruct(s.data(), rect2);
+    }
+
+    dev->uploadLodDataStruct(s.data());
+
+    return region;
+}
+
+void KisPaintDeviceTest::testIncrementalLodSync()
+{
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    TestingLodDefaultBounds *bounds = new TestingLodDefaultBounds(QRect(0,0,512,512));
+
+    KisPaintDeviceSP dev = new KisPaintDevice(cs);
+    dev->setDefaultBounds(bounds);
+    fillGradientDevice(dev, QRect(0,0,512,512));
+
+    KisPaintDeviceSP refDev = new KisPaintDevice(cs);
+    refDev->setDefaultBounds(bounds);
+    fillGradientDevice(refDev, QRect(0,0,512,512));
+
+    const QRect lodRect(0,0,256,256);
+
+    // the first sync should regenerate everything
+    bounds->testingSetLevelOfDetail(1);
+    QCOMPARE(syncLodCacheIncrementally(dev, 1).boundingRect(), QRect(0,0,512,512));
+
+    // nothing has changed, nothing to regenerate
+    QVERIFY(syncLodCacheIncrementally(dev, 1).isEmpty());
+
+    // changes in lod0 regenerate only the affected tile
+    bounds->testingSetLevelOfDetail(0);
+    dev->fill(QRect(100,100,10,10), KoColor(Qt::blue, cs));
+    refDev->fill(QRect(100,100,10,10), KoColor(Qt::blue, cs));
+
+    bounds->testingSetLevelOfDetail(1);
+    QCOMPARE(syncLodCacheIncrementally(dev, 1).boundingRect(), QRect(64,64,64,64));
+
+    syncLodCache(refDev, 1);
+    QCOMPARE(dev->convertToQImage(0, lodRect), refDev->convertToQImage(0, lodRect));
+
+    // changes in the lodN plane get reverted on the next sync
+    dev->fill(QRect(10,10,5,5), KoColor(Qt::green, cs));
+    QVERIFY(dev->convertToQImage(0, lodRect) != refDev->convertToQImage(0, lodRect));
+
+    QCOMPARE(syncLodCacheIncrementally(dev, 1).boundingRect(), QRect(0,0,128,128));
+    QCOMPARE(dev->convertToQImage(0, lodRect), refDev->convertToQImage(0, lodRect));
+
+    // switching the level of detail regenerates the whole device
+    bounds->testingSetLevelOfDetail(2);
+    QCOMPARE(syncLodCacheIncrementally(dev, 2).boundingRect(), QRect(0,0,512,512));
+}
+
 void KisPaintDeviceTest::benchmarkLod1Generation()
 {
     const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
@@ -44,12 +44,14 @@ private Q_SLOTS:
     void testMakeClone();
     void testBltPerformance();
     void testColorSpaceConversion();
+    void testColorSpaceConversionInPatches();
     void testDeviceDuplication();
     void testTranslate();
     void testOpacity();
     void testExactBoundsWeirdNullAlphaCase();
     void benchmarkExactBoundsNullDefaultPixel();
     void testAmortizedExactBounds();
+    void testIncrementalExactBounds();
     void testNonDefaultPixelArea();
     void testExactBoundsNonTransparent();
 
@@ -65,6 +67,7 @@ private Q_SLOTS:
 
     void testLodTransform();
     void testLodDevice();
+    void testIncrementalLodSync();
     void benchmarkLod1Generation();
     void benchmarkLod2Generation();
     void benchmarkLod3Generation();
@@ -32,6 +32,7 @@
 
 #include "kis_update_job_item.h"
 #include "kis_simple_update_queue.h"
+#include "KisMergeCostEstimator.h"
 #include "scheduler_utils.h"
 #include <KisGlobalResourcesInterface.h>
 
@@ -123,6 +124,7 @@ void KisSimpleUpdateQueueTest::testSplit(bool useFullRefresh)
     QRect dirtyRect1(0,0,1000,1000);
 
     KisTestableSimpleUpdateQueue queue;
+    queue.setAdaptivePatchSize(false);
     KisWalkersList& walkersList = queue.getWalkersList();
 
     if(!useFullRefresh) {
@@ -150,6 +152,154 @@ void KisSimpleUpdateQueueTest::testSplit(bool useFullRefresh)
     QVERIFY(checkWalker(walkersList[3], QRect(512,512,488,488)));
 }
 
+void KisSimpleUpdateQueueTest::testAdaptiveSplit()
+{
+    QRect imageRect(0,0,1024,1024);
+
+    const KoColorSpace * cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, imageRect.width(), imageRect.height(), cs, "merge test");
+
+    KisPaintLayerSP paintLayer = new KisPaintLayer(image, "test", OPACITY_OPAQUE_U8);
+
+    image->barrierLock();
+    image->addNode(paintLayer);
+    image->unlock();
+
+    // the estimator is shared, so the image must not merge anything meanwhile
+    image->waitForDone();
+
+    QRect dirtyRect1(0,0,1000,1000);
+
+    KisMergeCostEstimator *estimator = KisMergeCostEstimator::instance();
+
+    {
+        // cheap layers are merged in patches bigger than the default ones
+        estimator->reset();
+
+        KisTestableSimpleUpdateQueue queue;
+        KisWalkersList& walkersList = queue.getWalkersList();
+
+        queue.addUpdateJob(paintLayer, dirtyRect1, imageRect, 0);
+
+        QCOMPARE(walkersList.size(), 4);
+        QVERIFY(checkWalker(walkersList[0], QRect(0,0,896,896)));
+        QVERIFY(checkWalker(walkersList[3], QRect(896,896,104,104)));
+    }
+
+    {
+        // expensive layers are split into smaller patches
+        estimator->reset();
+
+        KisMergeCostEstimator::Samples samples;
+        samples.add(KisMergeCostEstimator::PaintLayer, 1000000000, 100000000000);
+        estimator->addSamples(samples);
+
+        QVERIFY(estimator->costPerPixel(KisMergeCostEstimator::PaintLayer) > 99.0);
+
+        KisTestableSimpleUpdateQueue queue;
+        KisWalkersList& walkersList = queue.getWalkersList();
+
+        queue.addUpdateJob(paintLayer, dirtyRect1, imageRect, 0);
+
+        QCOMPARE(walkersList.size(), 36);
+        QVERIFY(checkWalker(walkersList[0], QRect(0,0,192,192)));
+        QVERIFY(checkWalker(walkersList[35], QRect(960,960,40,40)));
+
+        queue.optimize();
+
+        // the patches must not be joined back
+        QCOMPARE(walkersList.size(), 36);
+    }
+
+    estimator->reset();
+}
+
+void KisSimpleUpdateQueueTest::testRegionOfInterest()
+{
+    KisTestableUpdaterContext context(1);
+
+    QRect imageRect(0,0,1024,1024);
+
+    const KoColorSpace * cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, imageRect.width(), imageRect.height(), cs, "merge test");
+
+    KisPaintLayerSP paintLayer = new KisPaintLayer(image, "test", OPACITY_OPAQUE_U8);
+
+    image->barrierLock();
+    image->addNode(paintLayer);
+    image->unlock();
+
+    QRect dirtyRect1(0,0,100,100);
+    QRect dirtyRect2(800,800,100,100);
+
+    KisTestableSimpleUpdateQueue queue;
+    KisWalkersList& walkersList = queue.getWalkersList();
+
+    queue.addUpdateJob(paintLayer, dirtyRect1, imageRect, 0);
+    queue.addUpdateJob(paintLayer, dirtyRect2, imageRect, 0);
+
+    queue.setRegionsOfInterest({QRect(512,512,512,512)});
+    queue.processQueue(context);
+
+    // the visible job is started first, though it was added later
+    QVector<KisUpdateJobItem*> jobs = context.getJobs();
+    QCOMPARE(jobs.size(), 1);
+    QVERIFY(checkWalker(jobs[0]->walker(), dirtyRect2));
+
+    QCOMPARE(walkersList.size(), 1);
+    QVERIFY(checkWalker(walkersList[0], dirtyRect1));
+
+    context.clear();
+
+    // the invisible job is started when there are no visible ones
+    queue.processQueue(context);
+
+    jobs = context.getJobs();
+    QCOMPARE(jobs.size(), 1);
+    QVERIFY(checkWalker(jobs[0]->walker(), dirtyRect1));
+    QVERIFY(walkersList.isEmpty());
+}
+
+void KisSimpleUpdateQueueTest::testMultipleRegionsOfInterest()
+{
+    KisTestableUpdaterContext context(2);
+
+    QRect imageRect(0,0,1024,1024);
+
+    const KoColorSpace * cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, imageRect.width(), imageRect.height(), cs, "merge test");
+
+    KisPaintLayerSP paintLayer = new KisPaintLayer(image, "test", OPACITY_OPAQUE_U8);
+
+    image->barrierLock();
+    image->addNode(paintLayer);
+    image->unlock();
+
+    QRect dirtyRect1(0,0,100,100);
+    QRect dirtyRect2(400,400,100,100);
+    QRect dirtyRect3(800,800,100,100);
+
+    KisTestableSimpleUpdateQueue queue;
+    KisWalkersList& walkersList = queue.getWalkersList();
+
+    queue.addUpdateJob(paintLayer, dirtyRect1, imageRect, 0);
+    queue.addUpdateJob(paintLayer, dirtyRect2, imageRect, 0);
+    queue.addUpdateJob(paintLayer, dirtyRect3, imageRect, 0);
+
+    // two canvases look at the opposite corners of the image
+    queue.setRegionsOfInterest({QRect(0,0,200,200), QRect(700,700,324,324)});
+    queue.processQueue(context);
+
+    // the jobs visible in either canvas are started first
+    QVector<KisUpdateJobItem*> jobs = context.getJobs();
+    QCOMPARE(jobs.size(), 2);
+    QVERIFY(checkWalker(jobs[0]->walker(), dirtyRect1));
+    QVERIFY(checkWalker(jobs[1]->walker(), dirtyRect3));
+
+    QCOMPARE(walkersList.size(), 1);
+    QVERIFY(checkWalker(walkersList[0], dirtyRect2));
+}
+
 void KisSimpleUpdateQueueTest::testChecksum()
 {
     QRect imageRect(0,0,512,512);
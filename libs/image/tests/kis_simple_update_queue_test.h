@@ -33,6 +33,9 @@ private Q_SLOTS:
     void testJobProcessing();
     void testSplitUpdate();
     void testSplitFullRefresh();
+    void testAdaptiveSplit();
+    void testRegionOfInterest();
+    void testMultipleRegionsOfInterest();
     void testChecksum();
     void testMixingTypes();
     void testSpontaneousJobsCompression();
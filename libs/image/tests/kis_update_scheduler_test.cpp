@@ -279,6 +279,39 @@ void KisUpdateSchedulerTest::testEmptyStroke()
     image->waitForDone();
 }
 
+#include <KisRunnableBasedStrokeStrategy.h>
+#include <KisRunnableStrokeJobUtils.h>
+
+void KisUpdateSchedulerTest::testParallelForJobs()
+{
+    KisImageSP image = buildTestingImage();
+    const QRect bounds = image->bounds();
+    const QSize patchSize(64, 64);
+    const int numWorkers = 3;
+
+    QVector<KisRunnableStrokeJobData*> jobs;
+    std::atomic<int> numPatches(0);
+    std::atomic<qint64> processedArea(0);
+
+    KritaUtils::addJobsParallelForPatches(jobs, bounds, patchSize, numWorkers,
+        [&numPatches, &processedArea] (const QRect &rc) {
+            numPatches++;
+            processedArea += rc.width() * rc.height();
+        });
+
+    QCOMPARE(jobs.size(), numWorkers);
+
+    KisStrokeId id = image->startStroke(new KisRunnableBasedStrokeStrategy(QLatin1String("parallel-for-stroke")));
+    Q_FOREACH (KisRunnableStrokeJobData *job, jobs) {
+        image->addJob(id, job);
+    }
+    image->endStroke(id);
+    image->waitForDone();
+
+    QCOMPARE(numPatches.load(), KritaUtils::splitRectIntoPatchesTight(bounds, patchSize).size());
+    QCOMPARE(processedArea.load(), qint64(bounds.width()) * bounds.height());
+}
+
 #include "kis_lazy_wait_condition.h"
 
 void KisUpdateSchedulerTest::testLazyWaitCondition()
@@ -36,6 +36,7 @@ private Q_SLOTS:
     void testLocking();
     void testExclusiveStrokes();
     void testEmptyStroke();
+    void testParallelForJobs();
     void testLazyWaitCondition();
     void testBlockUpdates();
 
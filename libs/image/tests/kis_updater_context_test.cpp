@@ -28,6 +28,7 @@
 #include "kis_merge_walker.h"
 #include "kis_updater_context.h"
 #include "kis_image.h"
+#include "KisWorkStealingExecutor.h"
 
 #include "scheduler_utils.h"
 
@@ -139,6 +140,7 @@ void KisUpdaterContextTest::testSnapshot()
     QCOMPARE(numMergeJobs, 2);
     QCOMPARE(numStrokeJobs, 1);
     QCOMPARE(context.currentLevelOfDetail(), 0);
+    QVERIFY(!context.hasSpareThread());
 
     context.unlock();
 
@@ -150,6 +152,7 @@ void KisUpdaterContextTest::testSnapshot()
         QCOMPARE(numMergeJobs, 0);
         QCOMPARE(numStrokeJobs, 0);
         QCOMPARE(context.currentLevelOfDetail(), -1);
+        QVERIFY(context.hasSpareThread());
 
         data =
             new KisStrokeJobData(KisStrokeJobData::SEQUENTIAL,
@@ -245,5 +248,72 @@ void KisUpdaterContextTest::stressTestExclusiveJobs()
              << "/" << NUM_CHECKS * NUM_JOBS;
 }
 
+class CountingRunnable : public QRunnable
+{
+public:
+    CountingRunnable(KisWorkStealingExecutor *executor, QAtomicInt &counter)
+        : m_executor(executor),
+          m_counter(counter)
+    {
+        setAutoDelete(false);
+    }
+
+    ~CountingRunnable() override {
+        qDeleteAll(m_children);
+    }
+
+    void addChild(CountingRunnable *child) {
+        m_children << child;
+    }
+
+    void run() override {
+        m_counter.ref();
+
+        // the children are pushed to the deque of the current worker
+        Q_FOREACH (CountingRunnable *child, m_children) {
+            m_executor->start(child);
+        }
+    }
+
+private:
+    KisWorkStealingExecutor *m_executor;
+    QAtomicInt &m_counter;
+    QVector<CountingRunnable*> m_children;
+};
+
+void KisUpdaterContextTest::testWorkStealingExecutor()
+{
+    const int numRoots = 16;
+    const int numChildren = 16;
+
+    KisWorkStealingExecutor executor(4);
+    QAtomicInt counter;
+
+    QVector<CountingRunnable*> roots;
+    for (int i = 0; i < numRoots; i++) {
+        CountingRunnable *root = new CountingRunnable(&executor, counter);
+        for (int j = 0; j < numChildren; j++) {
+            root->addChild(new CountingRunnable(&executor, counter));
+        }
+        roots << root;
+    }
+
+    for (int threads = 4; threads >= 1; threads -= 3) {
+        counter = 0;
+
+        executor.setMaxThreadCount(threads);
+        QCOMPARE(executor.maxThreadCount(), threads);
+
+        Q_FOREACH (CountingRunnable *root, roots) {
+            executor.start(root);
+        }
+
+        executor.waitForDone();
+        QCOMPARE(int(counter), numRoots * (numChildren + 1));
+    }
+
+    qDeleteAll(roots);
+}
+
 QTEST_MAIN(KisUpdaterContextTest)
 
@@ -0,0 +1,690 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTileDataAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <QMutex>
+#include <QVector>
+#include <QAtomicInt>
+#include <QThread>
+#include <QThreadStorage>
+#include <QGlobalStatic>
+
+#include "kis_lockless_stack.h"
+#include "kis_tile_data_interface.h"
+#include "kis_image_config.h"
+#include "KisNumaUtils.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+int numaNodesForTileAllocation()
+{
+    return KisImageConfig(true).numaAwareTileAllocation() ?
+        KisNumaUtils::numNodes() : 1;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(KisTileDataAllocator, s_instance, (numaNodesForTileAllocation()))
+
+namespace {
+
+const int NUM_SIZE_CLASSES = 8;
+const qint32 MAX_POOLED_PIXEL_SIZE = 20;
+const qint32 TILE_AREA = __TILE_DATA_WIDTH * __TILE_DATA_HEIGHT;
+
+const int MAX_NUMA_NODES = 8;
+const int MAGAZINE_SIZE = 16;
+const int MIN_BLOCKS_PER_ARENA = 32;
+const quint64 HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Maps pixel size into the index of the size class,
+ * -1 means the size is not pooled
+ */
+inline int sizeClassIndex(qint32 pixelSize)
+{
+    static const int indexes[MAX_POOLED_PIXEL_SIZE + 1] =
+        {-1,  0,  1, -1,  2,  3, -1, -1,  4, -1,  5,
+         -1, -1, -1, -1, -1,  6, -1, -1, -1,  7};
+
+    return pixelSize > 0 && pixelSize <= MAX_POOLED_PIXEL_SIZE ?
+        indexes[pixelSize] : -1;
+}
+
+const qint32 pooledPixelSizes[NUM_SIZE_CLASSES] = {1, 2, 4, 5, 8, 10, 16, 20};
+
+struct Magazine
+{
+    inline bool isEmpty() const {
+        return !count;
+    }
+
+    inline bool isFull() const {
+        return count == MAGAZINE_SIZE;
+    }
+
+    int count = 0;
+    quint8 *blocks[MAGAZINE_SIZE];
+};
+
+struct Arena
+{
+    quint8 *ptr;
+    quint64 size;
+};
+
+quint8* mapArena(quint64 size)
+{
+#if defined(Q_OS_WIN)
+    return static_cast<quint8*>(VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#elif defined(Q_OS_UNIX)
+    /**
+     * Transparent huge pages can be used only for the regions
+     * aligned to the huge page size, so map a bit more and cut
+     * off the unaligned head and tail.
+     */
+    const quint64 mappedSize = size + HUGE_PAGE_SIZE;
+
+    void *result = mmap(0, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) return 0;
+
+    quint8 *ptr = static_cast<quint8*>(result);
+    quint8 *alignedPtr = reinterpret_cast<quint8*>(
+        (reinterpret_cast<quintptr>(ptr) + HUGE_PAGE_SIZE - 1) & ~quintptr(HUGE_PAGE_SIZE - 1));
+
+    if (alignedPtr > ptr) {
+        munmap(ptr, alignedPtr - ptr);
+    }
+
+    const quint64 tailSize = (ptr + mappedSize) - (alignedPtr + size);
+    if (tailSize) {
+        munmap(alignedPtr + size, tailSize);
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(alignedPtr, size, MADV_HUGEPAGE);
+#endif
+
+    return alignedPtr;
+#else
+    return static_cast<quint8*>(malloc(size));
+#endif
+}
+
+void unmapArena(quint8 *ptr, quint64 size)
+{
+#if defined(Q_OS_WIN)
+    Q_UNUSED(size);
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(Q_OS_UNIX)
+    munmap(ptr, size);
+#else
+    Q_UNUSED(size);
+    free(ptr);
+#endif
+}
+
+struct SizeClass
+{
+    qint32 blockSize = 0;
+    quint64 arenaSize = 0;
+
+    KisLocklessStack<Magazine*> fullMagazines;
+    KisLocklessStack<Magazine*> emptyMagazines;
+
+    QMutex arenaLock;
+    QVector<Arena> arenas;
+};
+
+}
+
+struct Q_DECL_HIDDEN KisTileDataAllocator::Private
+{
+    struct ThreadCache;
+
+    /**
+     * In NUMA mode every node has its own set of size classes, which
+     * arenas are bound to the memory of this node. Otherwise, only
+     * the first set is used.
+     */
+    int numNodes = 1;
+    SizeClass sizeClasses[MAX_NUMA_NODES][NUM_SIZE_CLASSES];
+
+    QAtomicInt generation;
+    QAtomicInteger<qint64> reservedMemory;
+    QAtomicInteger<qint64> remoteDeallocations;
+
+    /**
+     * Set when an arena could not be mapped and the blocks had to be
+     * allocated with malloc(). From then on every freed block is
+     * looked up in arenaRanges to find out how it should be freed.
+     */
+    std::atomic<bool> hasMallocedBlocks;
+
+    /**
+     * The ranges of all the arenas sorted by their start, so that we
+     * could find out where a freed block should go. Used in NUMA mode
+     * and for the blocks allocated with malloc().
+     *
+     * A published table is never modified: mapping an arena publishes
+     * a new copy of it, so deallocate() can search the table without
+     * locking. The replaced tables are deleted only by purge(), when
+     * no thread can be reading them.
+     */
+    struct ArenaRange {
+        quintptr begin;
+        quintptr end;
+        int node;
+    };
+    typedef QVector<ArenaRange> ArenaRangeTable;
+
+    std::atomic<const ArenaRangeTable*> arenaRanges;
+    QMutex arenaRangesLock;
+    QVector<const ArenaRangeTable*> retiredArenaRanges;
+
+    /**
+     * purge() must not unmap the arenas while some thread has already
+     * passed the generation check and is popping a block from (or
+     * pushing a block into) them. A shared lock would make all the
+     * threads fight for its cache line on every allocation, so every
+     * thread cache has its own "active" flag instead. The thread sets
+     * the flag and then checks \p purging, purge() sets \p purging and
+     * then waits until all the flags are reset. The threads that come
+     * while the purge is in progress wait for it on \p purgeLock.
+     */
+    std::atomic<bool> purging;
+    QMutex purgeLock;
+
+    QMutex threadCacheListLock;
+    QVector<ThreadCache*> threadCacheList;
+
+    QThreadStorage<ThreadCache*> threadCaches;
+
+    inline ThreadCache* enterThreadCache();
+    inline void enterThreadCache(ThreadCache *cache);
+    inline void leaveThreadCache(ThreadCache *cache);
+    void waitForThreadCaches();
+
+    Magazine* fetchFullMagazine(int node, int index);
+    Magazine* fetchEmptyMagazine(int node, int index);
+    void returnMagazine(int node, int index, Magazine *magazine);
+    void addArenaRange(quint8 *arena, quint64 size, int node);
+    int nodeOfBlock(quint8 *ptr);
+    void releaseArenas();
+};
+
+/**
+ * Every thread keeps two magazines per size class: the loaded one,
+ * which is used for allocations and deallocations, and the previous
+ * one, which serves as a buffer that avoids going to the shared
+ * stacks when the thread allocates and frees memory alternately.
+ */
+struct KisTileDataAllocator::Private::ThreadCache
+{
+    ThreadCache(KisTileDataAllocator::Private *_d, int _generation, int _node)
+        : d(_d),
+          generation(_generation),
+          node(_node),
+          active(false)
+    {
+        std::fill(loaded, loaded + NUM_SIZE_CLASSES, nullptr);
+        std::fill(previous, previous + NUM_SIZE_CLASSES, nullptr);
+        std::fill(&remote[0][0], &remote[0][0] + MAX_NUMA_NODES * NUM_SIZE_CLASSES, nullptr);
+    }
+
+    ~ThreadCache()
+    {
+        d->enterThreadCache(this);
+
+        for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+            d->returnMagazine(node, i, loaded[i]);
+            d->returnMagazine(node, i, previous[i]);
+
+            for (int j = 0; j < MAX_NUMA_NODES; j++) {
+                d->returnMagazine(j, i, remote[j][i]);
+            }
+        }
+
+        d->leaveThreadCache(this);
+
+        QMutexLocker l(&d->threadCacheListLock);
+        d->threadCacheList.removeOne(this);
+    }
+
+    void dropMagazines()
+    {
+        for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+            delete loaded[i];
+            delete previous[i];
+            loaded[i] = 0;
+            previous[i] = 0;
+
+            for (int j = 0; j < MAX_NUMA_NODES; j++) {
+                delete remote[j][i];
+                remote[j][i] = 0;
+            }
+        }
+    }
+
+    KisTileDataAllocator::Private *d;
+    int generation;
+    int node;
+
+    std::atomic<bool> active;
+
+    Magazine *loaded[NUM_SIZE_CLASSES];
+    Magazine *previous[NUM_SIZE_CLASSES];
+
+    /**
+     * Blocks of other nodes freed by this thread, they are sent back
+     * to their nodes in full magazines
+     */
+    Magazine *remote[MAX_NUMA_NODES][NUM_SIZE_CLASSES];
+};
+
+/**
+ * Returns the cache of the current thread and marks it active, so
+ * that purge() would not unmap the arenas until leaveThreadCache()
+ */
+inline KisTileDataAllocator::Private::ThreadCache* KisTileDataAllocator::Private::enterThreadCache()
+{
+    ThreadCache *cache = threadCaches.localData();
+
+    if (!cache) {
+        /**
+         * The workers of the updater context are bound to their nodes
+         * in NUMA mode, so the node of the thread never changes
+         */
+        const int node = numNodes > 1 ? KisNumaUtils::currentNode() % numNodes : 0;
+
+        cache = new ThreadCache(this, generation.loadAcquire(), node);
+        threadCaches.setLocalData(cache);
+
+        QMutexLocker l(&threadCacheListLock);
+        threadCacheList.append(cache);
+    }
+
+    enterThreadCache(cache);
+    return cache;
+}
+
+inline void KisTileDataAllocator::Private::enterThreadCache(ThreadCache *cache)
+{
+    /**
+     * Both the flag and purging are sequentially consistent, so
+     * either we see the purge or the purge sees our flag
+     */
+    cache->active.store(true);
+
+    while (purging.load()) {
+        cache->active.store(false);
+
+        {
+            QMutexLocker l(&purgeLock);
+        }
+
+        cache->active.store(true);
+    }
+
+    const int currentGeneration = generation.loadAcquire();
+
+    if (cache->generation != currentGeneration) {
+        // the arenas have been purged, the cached blocks are invalid
+        cache->dropMagazines();
+        cache->generation = currentGeneration;
+    }
+}
+
+inline void KisTileDataAllocator::Private::leaveThreadCache(ThreadCache *cache)
+{
+    cache->active.store(false, std::memory_order_release);
+}
+
+void KisTileDataAllocator::Private::waitForThreadCaches()
+{
+    QMutexLocker l(&threadCacheListLock);
+
+    Q_FOREACH (ThreadCache *cache, threadCacheList) {
+        while (cache->active.load()) {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+Magazine* KisTileDataAllocator::Private::fetchEmptyMagazine(int node, int index)
+{
+    Magazine *magazine = 0;
+
+    if (!sizeClasses[node][index].emptyMagazines.pop(magazine)) {
+        magazine = new Magazine();
+    }
+
+    return magazine;
+}
+
+Magazine* KisTileDataAllocator::Private::fetchFullMagazine(int node, int index)
+{
+    SizeClass &sizeClass = sizeClasses[node][index];
+    Magazine *magazine = 0;
+
+    if (sizeClass.fullMagazines.pop(magazine)) {
+        return magazine;
+    }
+
+    QMutexLocker l(&sizeClass.arenaLock);
+
+    // someone might have mapped a new arena while we were waiting
+    if (sizeClass.fullMagazines.pop(magazine)) {
+        return magazine;
+    }
+
+    quint8 *arena = mapArena(sizeClass.arenaSize);
+    if (!arena) return 0;
+
+    sizeClass.arenas.append({arena, sizeClass.arenaSize});
+    reservedMemory.fetchAndAddOrdered(sizeClass.arenaSize);
+
+    if (numNodes > 1) {
+        // the pages are not touched yet, so nothing has to be migrated
+        KisNumaUtils::setPreferredNode(arena, sizeClass.arenaSize, node);
+    }
+
+    addArenaRange(arena, sizeClass.arenaSize, node);
+
+    const int numBlocks = sizeClass.arenaSize / sizeClass.blockSize;
+    Magazine *result = 0;
+
+    for (int i = 0; i < numBlocks;) {
+        magazine = fetchEmptyMagazine(node, index);
+
+        for (; i < numBlocks && !magazine->isFull(); i++) {
+            magazine->blocks[magazine->count++] = arena + i * sizeClass.blockSize;
+        }
+
+        if (!result) {
+            result = magazine;
+        } else {
+            sizeClass.fullMagazines.push(magazine);
+        }
+    }
+
+    return result;
+}
+
+void KisTileDataAllocator::Private::returnMagazine(int node, int index, Magazine *magazine)
+{
+    if (!magazine) return;
+
+    if (magazine->isEmpty()) {
+        sizeClasses[node][index].emptyMagazines.push(magazine);
+    } else {
+        sizeClasses[node][index].fullMagazines.push(magazine);
+    }
+}
+
+void KisTileDataAllocator::Private::addArenaRange(quint8 *arena, quint64 size, int node)
+{
+    const quintptr begin = reinterpret_cast<quintptr>(arena);
+
+    QMutexLocker l(&arenaRangesLock);
+
+    const ArenaRangeTable *oldTable = arenaRanges.load(std::memory_order_relaxed);
+    ArenaRangeTable *newTable = oldTable ? new ArenaRangeTable(*oldTable) : new ArenaRangeTable();
+
+    auto it = std::upper_bound(newTable->begin(), newTable->end(), begin,
+                               [] (quintptr value, const ArenaRange &range) {
+                                   return value < range.begin;
+                               });
+    newTable->insert(it, {begin, begin + size, node});
+
+    arenaRanges.store(newTable, std::memory_order_release);
+
+    if (oldTable) {
+        retiredArenaRanges.append(oldTable);
+    }
+}
+
+int KisTileDataAllocator::Private::nodeOfBlock(quint8 *ptr)
+{
+    const quintptr address = reinterpret_cast<quintptr>(ptr);
+
+    const ArenaRangeTable *table = arenaRanges.load(std::memory_order_acquire);
+    if (!table) return -1;
+
+    auto it = std::upper_bound(table->constBegin(), table->constEnd(), address,
+                               [] (quintptr value, const ArenaRange &range) {
+                                   return value < range.begin;
+                               });
+    if (it == table->constBegin()) return -1;
+    --it;
+
+    return address < it->end ? it->node : -1;
+}
+
+void KisTileDataAllocator::Private::releaseArenas()
+{
+    for (int i = 0; i < MAX_NUMA_NODES * NUM_SIZE_CLASSES; i++) {
+        SizeClass &sizeClass = sizeClasses[i / NUM_SIZE_CLASSES][i % NUM_SIZE_CLASSES];
+        QMutexLocker l(&sizeClass.arenaLock);
+
+        Magazine *magazine = 0;
+
+        while (sizeClass.fullMagazines.pop(magazine)) {
+            delete magazine;
+        }
+
+        while (sizeClass.emptyMagazines.pop(magazine)) {
+            delete magazine;
+        }
+
+        Q_FOREACH (const Arena &arena, sizeClass.arenas) {
+            unmapArena(arena.ptr, arena.size);
+            reservedMemory.fetchAndAddOrdered(-qint64(arena.size));
+        }
+
+        sizeClass.arenas.clear();
+    }
+
+    QMutexLocker l(&arenaRangesLock);
+
+    delete arenaRanges.exchange(nullptr);
+
+    qDeleteAll(retiredArenaRanges);
+    retiredArenaRanges.clear();
+}
+
+KisTileDataAllocator::KisTileDataAllocator(int numaNodes)
+    : m_d(new Private)
+{
+    m_d->numNodes = qBound(1, numaNodes, MAX_NUMA_NODES);
+    m_d->hasMallocedBlocks.store(false);
+    m_d->purging.store(false);
+    m_d->arenaRanges.store(nullptr);
+
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+            SizeClass &sizeClass = m_d->sizeClasses[node][i];
+            sizeClass.blockSize = pooledPixelSizes[i] * TILE_AREA;
+
+            const quint64 minArenaSize = quint64(MIN_BLOCKS_PER_ARENA) * sizeClass.blockSize;
+            sizeClass.arenaSize =
+                (minArenaSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        }
+    }
+}
+
+KisTileDataAllocator::~KisTileDataAllocator()
+{
+    m_d->generation.ref();
+    m_d->releaseArenas();
+}
+
+KisTileDataAllocator* KisTileDataAllocator::instance()
+{
+    return s_instance;
+}
+
+bool KisTileDataAllocator::isPooledPixelSize(qint32 pixelSize)
+{
+    return sizeClassIndex(pixelSize) >= 0;
+}
+
+quint8* KisTileDataAllocator::allocate(qint32 pixelSize)
+{
+    const int index = sizeClassIndex(pixelSize);
+    if (index < 0) {
+        return static_cast<quint8*>(malloc(pixelSize * TILE_AREA));
+    }
+
+    Private::ThreadCache *cache = m_d->enterThreadCache();
+    Magazine *&loaded = cache->loaded[index];
+    Magazine *&previous = cache->previous[index];
+
+    if (!loaded || loaded->isEmpty()) {
+        if (previous && !previous->isEmpty()) {
+            std::swap(loaded, previous);
+        } else {
+            Magazine *full = m_d->fetchFullMagazine(cache->node, index);
+
+            if (!full) {
+                m_d->leaveThreadCache(cache);
+
+                /**
+                 * The address space is exhausted or fragmented, but
+                 * the tile still might fit into the heap
+                 */
+                m_d->hasMallocedBlocks.store(true);
+                return static_cast<quint8*>(malloc(pixelSize * TILE_AREA));
+            }
+
+            if (previous) {
+                m_d->sizeClasses[cache->node][index].emptyMagazines.push(previous);
+            }
+            previous = loaded;
+            loaded = full;
+        }
+    }
+
+    quint8 *ptr = loaded->blocks[--loaded->count];
+    m_d->leaveThreadCache(cache);
+
+    return ptr;
+}
+
+void KisTileDataAllocator::deallocate(quint8 *ptr, qint32 pixelSize)
+{
+    const int index = sizeClassIndex(pixelSize);
+    if (index < 0) {
+        free(ptr);
+        return;
+    }
+
+    Private::ThreadCache *cache = m_d->enterThreadCache();
+
+    if (m_d->numNodes > 1 || m_d->hasMallocedBlocks.load(std::memory_order_relaxed)) {
+        const int node = m_d->nodeOfBlock(ptr);
+
+        if (node < 0) {
+            m_d->leaveThreadCache(cache);
+            free(ptr);
+            return;
+        }
+
+        if (node != cache->node) {
+            m_d->remoteDeallocations.ref();
+
+            Magazine *&remote = cache->remote[node][index];
+            if (!remote) {
+                remote = m_d->fetchEmptyMagazine(node, index);
+            }
+
+            remote->blocks[remote->count++] = ptr;
+
+            if (remote->isFull()) {
+                m_d->sizeClasses[node][index].fullMagazines.push(remote);
+                remote = 0;
+            }
+
+            m_d->leaveThreadCache(cache);
+            return;
+        }
+    }
+
+    Magazine *&loaded = cache->loaded[index];
+    Magazine *&previous = cache->previous[index];
+
+    if (!loaded || loaded->isFull()) {
+        if (previous && !previous->isFull()) {
+            std::swap(loaded, previous);
+        } else {
+            Magazine *empty = m_d->fetchEmptyMagazine(cache->node, index);
+
+            if (previous) {
+                m_d->sizeClasses[cache->node][index].fullMagazines.push(previous);
+            }
+            previous = loaded;
+            loaded = empty;
+        }
+    }
+
+    loaded->blocks[loaded->count++] = ptr;
+    m_d->leaveThreadCache(cache);
+}
+
+void KisTileDataAllocator::purge()
+{
+    QMutexLocker l(&m_d->purgeLock);
+
+    m_d->purging.store(true);
+    m_d->waitForThreadCaches();
+
+    /**
+     * Bumping the generation makes all the threads drop
+     * their cached magazines on the next access
+     */
+    m_d->generation.ref();
+    m_d->releaseArenas();
+
+    m_d->purging.store(false);
+}
+
+qint64 KisTileDataAllocator::reservedMemory() const
+{
+    return m_d->reservedMemory.loadAcquire();
+}
+
+int KisTileDataAllocator::numNodes() const
+{
+    return m_d->numNodes;
+}
+
+qint64 KisTileDataAllocator::remoteDeallocations() const
+{
+    return m_d->remoteDeallocations.loadAcquire();
+}
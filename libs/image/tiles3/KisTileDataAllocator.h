@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISTILEDATAALLOCATOR_H
+#define KISTILEDATAALLOCATOR_H
+
+#include <QtGlobal>
+#include <QScopedPointer>
+
+#include "kritaimage_export.h"
+
+/**
+ * A slab allocator for the pixel data of KisTileData objects.
+ *
+ * Every pixel size used by Krita's color spaces (1, 2, 4, 5, 8,
+ * 10, 16 and 20 bytes) has its own size class. The blocks are
+ * carved from big arenas (backed by transparent huge pages where
+ * the OS supports it) and circulate between the threads in
+ * "magazines" of several blocks. Every thread keeps two magazines
+ * per size class, so most of the allocations and deallocations
+ * don't touch any shared state at all. Full and empty magazines
+ * are exchanged through lock-free stacks, the lock is taken only
+ * when a new arena should be mapped. A per-thread flag protects
+ * the blocks from being unmapped by a concurrent purge().
+ *
+ * Other pixel sizes are served with plain malloc(), as well as
+ * all the allocations made when a new arena cannot be mapped.
+ *
+ * In NUMA mode (see KisImageConfig::numaAwareTileAllocation()) every
+ * node gets its own set of arenas, bound to the memory of the node,
+ * and the threads take the blocks from the arenas of their node. The
+ * blocks freed on another node are sent back to the node they belong
+ * to.
+ */
+class KRITAIMAGE_EXPORT KisTileDataAllocator
+{
+public:
+    /**
+     * \p numaNodes is the number of NUMA nodes the allocator keeps
+     * separate pools for, 1 disables NUMA mode
+     */
+    KisTileDataAllocator(int numaNodes = 1);
+    ~KisTileDataAllocator();
+
+    static KisTileDataAllocator* instance();
+
+    /**
+     * Allocates memory for a tile with pixels of \p pixelSize bytes
+     */
+    quint8* allocate(qint32 pixelSize);
+
+    /**
+     * Frees the memory previously allocated with allocate()
+     * with the same \p pixelSize
+     */
+    void deallocate(quint8 *ptr, qint32 pixelSize);
+
+    /**
+     * \return true if tiles of \p pixelSize are served from the slabs
+     */
+    static bool isPooledPixelSize(qint32 pixelSize);
+
+    /**
+     * Unmaps all the arenas and gives the memory back to the OS.
+     *
+     * WARNING: all the blocks become invalid after this call,
+     *          so the caller must guarantee that no pooled memory
+     *          is in use (see KisTileData::releaseInternalPools())
+     */
+    void purge();
+
+    /**
+     * \return the total amount of memory mapped for the arenas
+     */
+    qint64 reservedMemory() const;
+
+    /**
+     * \return the number of NUMA nodes the allocator keeps pools for
+     */
+    int numNodes() const;
+
+    /**
+     * \return the number of blocks freed by a thread running on a node
+     *         other than the one of the block. It is always zero if
+     *         NUMA mode is disabled.
+     */
+    qint64 remoteDeallocations() const;
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif // KISTILEDATAALLOCATOR_H
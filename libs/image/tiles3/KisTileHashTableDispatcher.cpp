@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTileHashTableDispatcher.h"
+
+#include <QAtomicInt>
+#include "kis_image_config.h"
+
+namespace {
+enum TableImplementation {
+    Unknown = 0,
+    LockFree,
+    Blocking
+};
+
+QAtomicInt s_implementation(Unknown);
+}
+
+namespace KisTileHashTableImplementation {
+
+bool useLockFreeTable()
+{
+    int value = s_implementation.loadAcquire();
+
+    if (value == Unknown) {
+        KisImageConfig cfg(true);
+        value = cfg.useLockFreeTileHashTable() ? LockFree : Blocking;
+
+        /**
+         * If someone has already set the value (e.g. via
+         * setUseLockFreeTable()), prefer it over the config
+         */
+        if (!s_implementation.testAndSetOrdered(Unknown, value)) {
+            value = s_implementation.loadAcquire();
+        }
+    }
+
+    return value == LockFree;
+}
+
+void setUseLockFreeTable(bool value)
+{
+    s_implementation.storeRelease(value ? LockFree : Blocking);
+}
+
+}
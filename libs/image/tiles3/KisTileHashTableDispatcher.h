@@ -0,0 +1,257 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KISTILEHASHTABLEDISPATCHER_H
+#define KISTILEHASHTABLEDISPATCHER_H
+
+#include <QScopedPointer>
+#include "kritaimage_export.h"
+
+#include "kis_tile_hash_table.h"
+#include "kis_tile_hash_table2.h"
+
+
+namespace KisTileHashTableImplementation {
+
+/**
+ * Returns true if the newly created tile hash tables should use the
+ * lock-free implementation. The value is fetched from KisImageConfig
+ * on the first call and is cached for the rest of the session.
+ */
+KRITAIMAGE_EXPORT bool useLockFreeTable();
+
+/**
+ * Overrides the selected implementation. Only the hash tables created
+ * after the call are affected, so it should be used in tests and
+ * benchmarks only.
+ */
+KRITAIMAGE_EXPORT void setUseLockFreeTable(bool value);
+
+}
+
+template <class T, class LockerType>
+class KisTileHashTableDispatcherIterator;
+
+/**
+ * A thin wrapper that forwards all the calls either to the lock-free
+ * KisTileHashTableTraits2 or to the blocking KisTileHashTableTraits.
+ * The implementation is chosen in the constructor (see
+ * KisTileHashTableImplementation::useLockFreeTable()), copies of the
+ * table always inherit the implementation of the source.
+ */
+template <class T>
+class KisTileHashTableDispatcher
+{
+public:
+    typedef T TileType;
+    typedef KisSharedPtr<T> TileTypeSP;
+    typedef KisTileHashTableTraits<T> BlockingTable;
+    typedef KisTileHashTableTraits2<T> LockFreeTable;
+
+    KisTileHashTableDispatcher(KisMementoManager *mm)
+    {
+        if (KisTileHashTableImplementation::useLockFreeTable()) {
+            m_lockFreeTable.reset(new LockFreeTable(mm));
+        } else {
+            m_blockingTable.reset(new BlockingTable(mm));
+        }
+    }
+
+    KisTileHashTableDispatcher(const KisTileHashTableDispatcher<T> &ht, KisMementoManager *mm)
+    {
+        if (ht.m_lockFreeTable) {
+            m_lockFreeTable.reset(new LockFreeTable(*ht.m_lockFreeTable, mm));
+        } else {
+            m_blockingTable.reset(new BlockingTable(*ht.m_blockingTable, mm));
+        }
+    }
+
+    bool isLockFree() const {
+        return !m_lockFreeTable.isNull();
+    }
+
+    bool isEmpty() {
+        return m_lockFreeTable ? m_lockFreeTable->isEmpty() : m_blockingTable->isEmpty();
+    }
+
+    bool tileExists(qint32 col, qint32 row) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->tileExists(col, row) :
+            m_blockingTable->tileExists(col, row);
+    }
+
+    TileTypeSP getExistingTile(qint32 col, qint32 row) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->getExistingTile(col, row) :
+            m_blockingTable->getExistingTile(col, row);
+    }
+
+    TileTypeSP getTileLazy(qint32 col, qint32 row, bool& newTile) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->getTileLazy(col, row, newTile) :
+            m_blockingTable->getTileLazy(col, row, newTile);
+    }
+
+    TileTypeSP getReadOnlyTileLazy(qint32 col, qint32 row, bool &existingTile) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->getReadOnlyTileLazy(col, row, existingTile) :
+            m_blockingTable->getReadOnlyTileLazy(col, row, existingTile);
+    }
+
+    void addTile(TileTypeSP tile) {
+        if (m_lockFreeTable) {
+            m_lockFreeTable->addTile(tile);
+        } else {
+            m_blockingTable->addTile(tile);
+        }
+    }
+
+    bool deleteTile(TileTypeSP tile) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->deleteTile(tile) :
+            m_blockingTable->deleteTile(tile);
+    }
+
+    bool deleteTile(qint32 col, qint32 row) {
+        return m_lockFreeTable ?
+            m_lockFreeTable->deleteTile(col, row) :
+            m_blockingTable->deleteTile(col, row);
+    }
+
+    void clear() {
+        if (m_lockFreeTable) {
+            m_lockFreeTable->clear();
+        } else {
+            m_blockingTable->clear();
+        }
+    }
+
+    void setDefaultTileData(KisTileData *defaultTileData) {
+        if (m_lockFreeTable) {
+            m_lockFreeTable->setDefaultTileData(defaultTileData);
+        } else {
+            m_blockingTable->setDefaultTileData(defaultTileData);
+        }
+    }
+
+    KisTileData* defaultTileData() {
+        return m_lockFreeTable ?
+            m_lockFreeTable->defaultTileData() :
+            m_blockingTable->defaultTileData();
+    }
+
+    qint32 numTiles() {
+        return m_lockFreeTable ? m_lockFreeTable->numTiles() : m_blockingTable->numTiles();
+    }
+
+    void debugPrintInfo() {
+        if (m_lockFreeTable) {
+            m_lockFreeTable->debugPrintInfo();
+        } else {
+            m_blockingTable->debugPrintInfo();
+        }
+    }
+
+    void debugMaxListLength(qint32 &min, qint32 &max) {
+        if (m_lockFreeTable) {
+            m_lockFreeTable->debugMaxListLength(min, max);
+        } else {
+            m_blockingTable->debugMaxListLength(min, max);
+        }
+    }
+
+private:
+    template<class U, class LockerType> friend class KisTileHashTableDispatcherIterator;
+
+    QScopedPointer<LockFreeTable> m_lockFreeTable;
+    QScopedPointer<BlockingTable> m_blockingTable;
+
+    Q_DISABLE_COPY(KisTileHashTableDispatcher)
+};
+
+
+/**
+ * Iterator over KisTileHashTableDispatcher. LockerType has the same
+ * meaning as in KisTileHashTableIteratorTraits, the lock-free table
+ * doesn't distinguish the two cases.
+ */
+template <class T, class LockerType>
+class KisTileHashTableDispatcherIterator
+{
+public:
+    typedef T TileType;
+    typedef KisSharedPtr<T> TileTypeSP;
+    typedef KisTileHashTableIteratorTraits2<T> LockFreeIterator;
+    typedef KisTileHashTableIteratorTraits<T, LockerType> BlockingIterator;
+
+    KisTileHashTableDispatcherIterator(KisTileHashTableDispatcher<T> *ht)
+    {
+        if (ht->m_lockFreeTable) {
+            m_lockFreeIterator.reset(new LockFreeIterator(ht->m_lockFreeTable.data()));
+        } else {
+            m_blockingIterator.reset(new BlockingIterator(ht->m_blockingTable.data()));
+        }
+    }
+
+    void next() {
+        if (m_lockFreeIterator) {
+            m_lockFreeIterator->next();
+        } else {
+            m_blockingIterator->next();
+        }
+    }
+
+    TileTypeSP tile() const {
+        return m_lockFreeIterator ? m_lockFreeIterator->tile() : m_blockingIterator->tile();
+    }
+
+    bool isDone() const {
+        return m_lockFreeIterator ? m_lockFreeIterator->isDone() : m_blockingIterator->isDone();
+    }
+
+    void deleteCurrent() {
+        if (m_lockFreeIterator) {
+            m_lockFreeIterator->deleteCurrent();
+        } else {
+            m_blockingIterator->deleteCurrent();
+        }
+    }
+
+    void moveCurrentToHashTable(KisTileHashTableDispatcher<T> *newHashTable) {
+        if (m_lockFreeIterator) {
+            KIS_SAFE_ASSERT_RECOVER_RETURN(newHashTable->m_lockFreeTable);
+            m_lockFreeIterator->moveCurrentToHashTable(newHashTable->m_lockFreeTable.data());
+        } else {
+            KIS_SAFE_ASSERT_RECOVER_RETURN(newHashTable->m_blockingTable);
+            m_blockingIterator->moveCurrentToHashTable(newHashTable->m_blockingTable.data());
+        }
+    }
+
+private:
+    QScopedPointer<LockFreeIterator> m_lockFreeIterator;
+    QScopedPointer<BlockingIterator> m_blockingIterator;
+
+    Q_DISABLE_COPY(KisTileHashTableDispatcherIterator)
+};
+
+typedef KisTileHashTableDispatcher<KisTile> KisTileHashTable;
+typedef KisTileHashTableDispatcherIterator<KisTile, QWriteLocker> KisTileHashTableIterator;
+typedef KisTileHashTableDispatcherIterator<KisTile, QReadLocker> KisTileHashTableConstIterator;
+
+#endif // KISTILEHASHTABLEDISPATCHER_H
@@ -195,6 +195,23 @@ void KisMementoManager::commit()
         mi->commit();
         revisionList.append(mi);
 
+        if (mi->type() == KisMementoItem::CHANGED) {
+            KisTileDataStore::instance()->tryMakeTileDataUniform(mi->tileData());
+
+            /**
+             * The previous revision of the tile is needed for undo
+             * only now, so try to keep only the rows changed since
+             * then. If the difference is too big, just compress the
+             * whole tile in the background.
+             */
+            if (parentMI->type() == KisMementoItem::CHANGED) {
+                KisTileDataStore *store = KisTileDataStore::instance();
+                if (!store->tryConvertToDelta(parentMI->tileData(), mi->tileData())) {
+                    store->queueHistoryCompression(parentMI->tileData());
+                }
+            }
+        }
+
         m_headsHashTable.deleteTile(mi->col(), mi->row());
 
         iter.moveCurrentToHashTable(&m_headsHashTable);
@@ -22,7 +22,6 @@
 #include <QList>
 
 #include "kis_memento_item.h"
-#include "config-hash-table-implementaion.h"
 
 typedef QList<KisMementoItemSP> KisMementoItemList;
 typedef QListIterator<KisMementoItemSP> KisMementoItemListIterator;
@@ -38,19 +37,11 @@ typedef QList<KisHistoryItem> KisHistoryList;
 class KisMemento;
 typedef KisSharedPtr<KisMemento> KisMementoSP;
 
-#ifdef USE_LOCK_FREE_HASH_TABLE
-#include "kis_tile_hash_table2.h"
+#include "KisTileHashTableDispatcher.h"
 
-typedef KisTileHashTableTraits2<KisMementoItem> KisMementoItemHashTable;
-typedef KisTileHashTableIteratorTraits2<KisMementoItem> KisMementoItemHashTableIterator;
-typedef KisTileHashTableIteratorTraits2<KisMementoItem> KisMementoItemHashTableIteratorConst;
-#else
-#include "kis_tile_hash_table.h"
-
-typedef KisTileHashTableTraits<KisMementoItem> KisMementoItemHashTable;
-typedef KisTileHashTableIteratorTraits<KisMementoItem, QWriteLocker> KisMementoItemHashTableIterator;
-typedef KisTileHashTableIteratorTraits<KisMementoItem, QReadLocker> KisMementoItemHashTableIteratorConst;
-#endif // USE_LOCK_FREE_HASH_TABLE
+typedef KisTileHashTableDispatcher<KisMementoItem> KisMementoItemHashTable;
+typedef KisTileHashTableDispatcherIterator<KisMementoItem, QWriteLocker> KisMementoItemHashTableIterator;
+typedef KisTileHashTableDispatcherIterator<KisMementoItem, QReadLocker> KisMementoItemHashTableIteratorConst;
 
 
 class KRITAIMAGE_EXPORT KisMementoManager
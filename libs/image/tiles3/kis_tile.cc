@@ -38,6 +38,8 @@ void KisTile::init(qint32 col, qint32 row,
     m_tileData = defaultTileData;
     m_tileData->acquire();
 
+    m_contentRevision.store(nextContentRevision(), std::memory_order_release);
+
     if (mm) {
         mm->registerTileChange(this);
     }
@@ -152,6 +154,10 @@ void KisTile::notifyAttachedToDataManager(KisMementoManager *mm)
 //#define DEBUG_TILE_LOCKING
 //#define DEBUG_TILE_COWING
 
+#if defined DEBUG_TILE_LOCKING || defined DEBUG_TILE_COWING
+#include <stdio.h>
+#endif
+
 #ifdef DEBUG_TILE_LOCKING
 #define DEBUG_LOG_ACTION(action)                                        \
     printf("### %s \ttile:\t0x%llX (%d, %d) (0x%llX) ###\n", action, (quintptr)this, m_col, m_row, (quintptr)m_tileData)
@@ -267,13 +273,23 @@ void KisTile::lockForWrite()
 #ifdef DEAD_TILES_SANITY_CHECK
         m_sanityNumCOWHappened.ref();
 #endif
+    } else if (m_tileData->hasSharedData()) {
+        /**
+         * The tile data is not shared, but its pixels live in
+         * a read-only buffer, so we should expand it first
+         */
+        m_tileData->m_store->expandSharedTileData(m_tileData);
     }
 
+    m_tileData->resetContentChecks();
+
     DEBUG_LOG_ACTION("lock [W]");
 }
 
 void KisTile::unlockForWrite()
 {
+    m_contentRevision.store(nextContentRevision(), std::memory_order_release);
+
     unblockSwapping();
     DEBUG_LOG_ACTION("unlock [W]");
 
@@ -295,7 +311,26 @@ void KisTile::unlockForRead() const
 }
 
 
-#include <stdio.h>
+quint64 KisTile::nextContentRevision()
+{
+    /**
+     * The revisions are reserved in blocks per thread to avoid
+     * contention on the global counter
+     */
+    static const quint64 blockSize = 1024;
+    static std::atomic<quint64> s_lastReservedRevision(0);
+
+    thread_local quint64 nextRevision = 0;
+    thread_local quint64 blockEnd = 0;
+
+    if (nextRevision == blockEnd) {
+        nextRevision = s_lastReservedRevision.fetch_add(blockSize) + 1;
+        blockEnd = nextRevision + blockSize;
+    }
+
+    return nextRevision++;
+}
+
 void KisTile::debugPrintInfo()
 {
     dbgTiles << "------\n"
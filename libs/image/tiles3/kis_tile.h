@@ -27,6 +27,8 @@
 #include <QRect>
 #include <QStack>
 
+#include <atomic>
+
 #include <kis_shared.h>
 #include <kis_shared_ptr.h>
 
@@ -131,6 +133,20 @@ public:
         return m_tileData;
     }
 
+    /**
+     * The revision of the pixels of the tile. It is changed every time
+     * the tile is unlocked after writing and is unique among all the
+     * tiles of the application, so it can be used to validate any
+     * metadata calculated from the pixels of the tile.
+     *
+     * NOTE: read the revision *before* reading the pixels, then the
+     *       metadata will never be considered valid if someone is
+     *       writing into the tile meanwhile.
+     */
+    inline quint64 contentRevision() const {
+        return m_contentRevision.load(std::memory_order_acquire);
+    }
+
 private:
     void init(qint32 col, qint32 row,
               KisTileData *defaultTileData, KisMementoManager* mm);
@@ -138,6 +154,8 @@ private:
     inline void blockSwapping() const;
     inline void unblockSwapping() const;
 
+    static quint64 nextContentRevision();
+
     inline void safeReleaseOldTileData(KisTileData *td);
 
 private:
@@ -160,6 +178,8 @@ private:
 
     QAtomicPointer<KisMementoManager> m_mementoManager;
 
+    std::atomic<quint64> m_contentRevision;
+
     /**
      * This is a special mutex for guarding copy-on-write
      * operations. We do not use lockless way here as it'll
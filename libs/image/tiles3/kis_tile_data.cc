@@ -23,42 +23,236 @@
 
 #include <kis_debug.h>
 
-#include <boost/pool/singleton_pool.hpp>
-#include "kis_tile_data_store_iterators.h"
-
-// BPP == bytes per pixel
-#define TILE_SIZE_4BPP (4 * __TILE_DATA_WIDTH * __TILE_DATA_HEIGHT)
-#define TILE_SIZE_8BPP (8 * __TILE_DATA_WIDTH * __TILE_DATA_HEIGHT)
+#include <QHash>
+#include <QMutex>
+#include <QGlobalStatic>
 
-typedef boost::singleton_pool<KisTileData, TILE_SIZE_4BPP, boost::default_user_allocator_new_delete, boost::details::pool::default_mutex, 256, 4096> BoostPool4BPP;
-typedef boost::singleton_pool<KisTileData, TILE_SIZE_8BPP, boost::default_user_allocator_new_delete, boost::details::pool::default_mutex, 128, 2048> BoostPool8BPP;
+#include "KisTileDataAllocator.h"
+#include "kis_tile_data_store_iterators.h"
 
 const qint32 KisTileData::WIDTH = __TILE_DATA_WIDTH;
 const qint32 KisTileData::HEIGHT = __TILE_DATA_HEIGHT;
 
-SimpleCache KisTileData::m_cache;
+namespace {
 
-SimpleCache::~SimpleCache()
+/**
+ * Keeps read-only pixel buffers of uniform tile data objects. One
+ * buffer is shared by all the tile data objects of the same color.
+ *
+ * The buffers, which became unused, are not freed immediately,
+ * because the same colors tend to be used again and again. Instead,
+ * they are evicted in LRU order when there are too many of them or
+ * when the internal pools are released.
+ */
+class UniformBufferCache
 {
-    clear();
-}
+public:
+    ~UniformBufferCache() {
+        Q_FOREACH (const Entry &entry, m_buffers) {
+            free(entry.buffer);
+        }
+    }
+
+    quint8* acquire(const quint8 *pixel, qint32 pixelSize) {
+        const QByteArray key(reinterpret_cast<const char*>(pixel), pixelSize);
+
+        QMutexLocker l(&m_lock);
+
+        auto it = m_buffers.find(key);
+        if (it == m_buffers.end()) {
+            const int numPixels = KisTileData::WIDTH * KisTileData::HEIGHT;
+            quint8 *buffer = static_cast<quint8*>(malloc(pixelSize * numPixels));
+
+            quint8 *dstIt = buffer;
+            for (int i = 0; i < numPixels; i++, dstIt += pixelSize) {
+                memcpy(dstIt, pixel, pixelSize);
+            }
+
+            it = m_buffers.insert(key, Entry{buffer, 0});
+        } else if (!it->refCount) {
+            m_unused.removeOne(key);
+        }
+
+        it->refCount++;
+        return it->buffer;
+    }
+
+    void release(quint8 *buffer, qint32 pixelSize) {
+        const QByteArray key(reinterpret_cast<const char*>(buffer), pixelSize);
+
+        QMutexLocker l(&m_lock);
+
+        auto it = m_buffers.find(key);
+        KIS_SAFE_ASSERT_RECOVER_RETURN(it != m_buffers.end());
+        KIS_SAFE_ASSERT_RECOVER_RETURN(it->buffer == buffer);
+
+        if (--it->refCount == 0) {
+            m_unused.append(key);
 
-void SimpleCache::clear()
+            while (m_unused.size() > MAX_UNUSED_BUFFERS) {
+                evictBuffer(m_unused.takeFirst());
+            }
+        }
+    }
+
+    void purgeUnused() {
+        QMutexLocker l(&m_lock);
+
+        Q_FOREACH (const QByteArray &key, m_unused) {
+            evictBuffer(key);
+        }
+        m_unused.clear();
+    }
+
+private:
+    void evictBuffer(const QByteArray &key) {
+        auto it = m_buffers.find(key);
+        KIS_SAFE_ASSERT_RECOVER_RETURN(it != m_buffers.end());
+
+        free(it->buffer);
+        m_buffers.erase(it);
+    }
+
+private:
+    static const int MAX_UNUSED_BUFFERS = 64;
+
+    struct Entry {
+        quint8 *buffer;
+        int refCount;
+    };
+
+    QMutex m_lock;
+    QHash<QByteArray, Entry> m_buffers;
+    QList<QByteArray> m_unused;
+};
+
+Q_GLOBAL_STATIC(UniformBufferCache, s_uniformBuffers)
+
+/**
+ * Keeps read-only pixel buffers shared by deduplicated tile data
+ * objects. The buffers are looked up by the hash of their content
+ * and are freed as soon as the last tile data releases them.
+ *
+ * The buffers are allocated with malloc(), not with
+ * KisTileDataAllocator. Deduplicated tile data is not registered in
+ * the store, so KisTileData::releaseInternalPools() cannot migrate
+ * its memory before the arenas of the allocator are unmapped.
+ */
+class DeduplicatedBufferIndex
 {
-    QWriteLocker l(&m_cacheLock);
-    quint8 *ptr = 0;
+public:
+    quint8* acquire(uint hash, const quint8 *data, qint32 pixelSize) {
+        const qint32 dataSize = pixelSize * KisTileData::WIDTH * KisTileData::HEIGHT;
+
+        QMutexLocker l(&m_lock);
+
+        auto it = m_entriesByHash.find(hash);
+        while (it != m_entriesByHash.end() && it.key() == hash) {
+            Entry *entry = it.value();
+
+            if (entry->pixelSize == pixelSize &&
+                !memcmp(entry->buffer, data, dataSize)) {
+
+                entry->refCount++;
+                return entry->buffer;
+            }
+            ++it;
+        }
 
-    while (m_4Pool.pop(ptr)) {
-        BoostPool4BPP::free(ptr);
+        return 0;
     }
 
-    while (m_8Pool.pop(ptr)) {
-        BoostPool8BPP::free(ptr);
+    /**
+     * Creates a new shared buffer with a copy of \p data
+     */
+    quint8* insert(uint hash, const quint8 *data, qint32 pixelSize) {
+        const qint32 dataSize = pixelSize * KisTileData::WIDTH * KisTileData::HEIGHT;
+
+        quint8 *buffer = static_cast<quint8*>(malloc(dataSize));
+        memcpy(buffer, data, dataSize);
+
+        Entry *entry = new Entry{buffer, hash, pixelSize, 1};
+
+        QMutexLocker l(&m_lock);
+        m_entriesByHash.insert(hash, entry);
+        m_entriesByBuffer.insert(buffer, entry);
+        m_memoryMetric.fetchAndAddOrdered(pixelSize);
+
+        return buffer;
+    }
+
+    /**
+     * Frees the buffer when the last tile data releases it
+     */
+    void release(quint8 *buffer) {
+        QMutexLocker l(&m_lock);
+
+        Entry *entry = m_entriesByBuffer.value(buffer, 0);
+        KIS_SAFE_ASSERT_RECOVER_RETURN(entry);
+
+        if (--entry->refCount > 0) return;
+
+        m_entriesByBuffer.remove(buffer);
+        m_entriesByHash.remove(entry->hash, entry);
+        m_memoryMetric.fetchAndAddOrdered(-entry->pixelSize);
+        delete entry;
+
+        free(buffer);
     }
 
-    while (m_16Pool.pop(ptr)) {
-        free(ptr);
+    /**
+     * The metric of the memory occupied by the buffers
+     * \see KisTileDataStore::memoryMetric()
+     */
+    qint32 memoryMetric() const {
+        return m_memoryMetric.loadAcquire();
     }
+
+private:
+    struct Entry {
+        quint8 *buffer;
+        uint hash;
+        qint32 pixelSize;
+        int refCount;
+    };
+
+    QMutex m_lock;
+    QMultiHash<uint, Entry*> m_entriesByHash;
+    QHash<quint8*, Entry*> m_entriesByBuffer;
+    QAtomicInt m_memoryMetric;
+};
+
+Q_GLOBAL_STATIC(DeduplicatedBufferIndex, s_deduplicatedBuffers)
+
+/**
+ * The delta is a sequence of spans of consecutive changed rows. Each
+ * span is a header followed by numRows chunks of length bytes, taken
+ * at offset bytes from the beginning of each row.
+ */
+struct DeltaSpanHeader {
+    quint16 row;
+    quint16 numRows;
+    quint16 offset;
+    quint16 length;
+};
+
+inline bool rowDifferenceRange(const quint8 *row, const quint8 *baseRow, qint32 rowSize,
+                               qint32 *begin, qint32 *end)
+{
+    if (!memcmp(row, baseRow, rowSize)) return false;
+
+    qint32 first = 0;
+    while (row[first] == baseRow[first]) first++;
+
+    qint32 last = rowSize - 1;
+    while (row[last] == baseRow[last]) last--;
+
+    *begin = first;
+    *end = last + 1;
+
+    return true;
+}
+
 }
 
 
@@ -69,7 +263,14 @@ KisTileData::KisTileData(qint32 pixelSize, const quint8 *defPixel, KisTileDataSt
       m_usersCount(0),
       m_refCount(0),
       m_pixelSize(pixelSize),
-      m_store(store)
+      m_store(store),
+      m_uniformityChecked(1),
+      m_contentHash(0),
+      m_contentHashValid(0),
+      m_retiredData(0),
+      m_retiredState(NORMAL),
+      m_deltaBase(0),
+      m_deltaDependents(0)
 {
     if (checkFreeMemory) {
         m_store->checkFreeMemory();
@@ -98,7 +299,14 @@ KisTileData::KisTileData(const KisTileData& rhs, bool checkFreeMemory)
       m_usersCount(0),
       m_refCount(0),
       m_pixelSize(rhs.m_pixelSize),
-      m_store(rhs.m_store)
+      m_store(rhs.m_store),
+      m_uniformityChecked(1),
+      m_contentHash(0),
+      m_contentHashValid(0),
+      m_retiredData(0),
+      m_retiredState(NORMAL),
+      m_deltaBase(0),
+      m_deltaDependents(0)
 {
     if (checkFreeMemory) {
         m_store->checkFreeMemory();
@@ -123,13 +331,265 @@ void KisTileData::fillWithPixel(const quint8 *defPixel)
     }
 }
 
+bool KisTileData::checkPixelsUniform() const
+{
+    Q_ASSERT(m_data);
+
+    const quint8 *pixel = m_data;
+    const qint32 rowSize = m_pixelSize * WIDTH;
+
+    for (const quint8 *it = m_data + m_pixelSize; it < m_data + rowSize; it += m_pixelSize) {
+        if (memcmp(pixel, it, m_pixelSize)) return false;
+    }
+
+    for (int row = 1; row < HEIGHT; row++) {
+        if (memcmp(m_data, m_data + row * rowSize, rowSize)) return false;
+    }
+
+    return true;
+}
+
+void KisTileData::convertToUniform()
+{
+    Q_ASSERT(m_state == NORMAL);
+    Q_ASSERT(m_data);
+
+    releaseRetiredData();
+
+    quint8 *buffer = acquireUniformBuffer(m_data, m_pixelSize);
+    freeData(m_data, m_pixelSize);
+
+    m_data = buffer;
+    m_state = UNIFORM;
+}
+
+void KisTileData::expandSharedData()
+{
+    Q_ASSERT(hasSharedData());
+    Q_ASSERT(!m_retiredData);
+
+    quint8 *buffer = allocateData(m_pixelSize);
+    memcpy(buffer, m_data, m_pixelSize * WIDTH * HEIGHT);
+
+    m_retiredData = m_data;
+    m_retiredState = m_state;
+
+    m_data = buffer;
+    m_state = NORMAL;
+}
+
+bool KisTileData::encodeRowsDelta(const quint8 *data, const quint8 *base,
+                                  qint32 pixelSize, QByteArray *delta)
+{
+    const qint32 rowSize = pixelSize * WIDTH;
+    const qint32 maxDeltaSize = rowSize * HEIGHT / 2;
+
+    QByteArray result;
+    qint32 row = 0;
+
+    while (row < HEIGHT) {
+        qint32 begin = 0;
+        qint32 end = 0;
+
+        if (!rowDifferenceRange(data + row * rowSize, base + row * rowSize,
+                                rowSize, &begin, &end)) {
+            row++;
+            continue;
+        }
+
+        qint32 spanEnd = row + 1;
+        qint32 rowBegin = 0;
+        qint32 rowEnd = 0;
+
+        while (spanEnd < HEIGHT &&
+               rowDifferenceRange(data + spanEnd * rowSize, base + spanEnd * rowSize,
+                                  rowSize, &rowBegin, &rowEnd)) {
+
+            begin = qMin(begin, rowBegin);
+            end = qMax(end, rowEnd);
+            spanEnd++;
+        }
+
+        DeltaSpanHeader header;
+        header.row = row;
+        header.numRows = spanEnd - row;
+        header.offset = begin;
+        header.length = end - begin;
+
+        if (result.size() + qint32(sizeof(header)) + header.numRows * header.length > maxDeltaSize) {
+            return false;
+        }
+
+        result.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (qint32 i = row; i < spanEnd; i++) {
+            result.append(reinterpret_cast<const char*>(data + i * rowSize + begin), header.length);
+        }
+
+        row = spanEnd;
+    }
+
+    *delta = result;
+    return true;
+}
+
+void KisTileData::applyRowsDelta(quint8 *data, const QByteArray &delta, qint32 pixelSize)
+{
+    const qint32 rowSize = pixelSize * WIDTH;
+
+    const char *it = delta.constData();
+    const char *end = it + delta.size();
+
+    while (it < end) {
+        DeltaSpanHeader header;
+        memcpy(&header, it, sizeof(header));
+        it += sizeof(header);
+
+        for (qint32 row = header.row; row < header.row + header.numRows; row++) {
+            memcpy(data + row * rowSize + header.offset, it, header.length);
+            it += header.length;
+        }
+    }
+}
+
+void KisTileData::convertToDelta(KisTileData *base, const QByteArray &delta)
+{
+    Q_ASSERT(m_state == NORMAL);
+    Q_ASSERT(m_data);
+    Q_ASSERT(!m_deltaBase);
+
+    releaseRetiredData();
+    freeData(m_data, m_pixelSize);
+
+    m_data = 0;
+    m_deltaBase = base;
+    m_deltaBase->m_deltaDependents.ref();
+    m_delta = delta;
+    m_state = DELTA;
+}
+
+KisTileData* KisTileData::restoreFromDelta(quint8 *buffer)
+{
+    Q_ASSERT(m_state == DELTA);
+    Q_ASSERT(!m_data);
+
+    KisTileData *base = m_deltaBase;
+    base->m_deltaDependents.deref();
+
+    m_data = buffer;
+    m_deltaBase = 0;
+    m_delta.clear();
+    m_state = NORMAL;
+
+    return base;
+}
+
+void KisTileData::releaseRetiredData()
+{
+    if (!m_retiredData) return;
+
+    if (m_retiredState == UNIFORM) {
+        releaseUniformBuffer(m_retiredData, m_pixelSize);
+    } else if (!s_deduplicatedBuffers.isDestroyed()) {
+        s_deduplicatedBuffers->release(m_retiredData);
+    }
+
+    m_retiredData = 0;
+    m_retiredState = NORMAL;
+}
+
+void KisTileData::updateContentHash()
+{
+    Q_ASSERT(m_data);
+
+    m_contentHash = qHashBits(m_data, m_pixelSize * WIDTH * HEIGHT);
+    m_contentHashValid.storeRelease(1);
+}
+
+bool KisTileData::tryConvertToDeduplicated()
+{
+    Q_ASSERT(m_state == NORMAL);
+    Q_ASSERT(m_data);
+
+    quint8 *buffer =
+        s_deduplicatedBuffers->acquire(m_contentHash, m_data, m_pixelSize);
+
+    if (!buffer) return false;
+
+    releaseRetiredData();
+    freeData(m_data, m_pixelSize);
+
+    m_data = buffer;
+    m_state = DEDUPLICATED;
+
+    return true;
+}
+
+void KisTileData::convertToDeduplicated()
+{
+    Q_ASSERT(m_state == NORMAL);
+    Q_ASSERT(m_data);
+
+    releaseRetiredData();
+
+    quint8 *buffer =
+        s_deduplicatedBuffers->insert(m_contentHash, m_data, m_pixelSize);
+    freeData(m_data, m_pixelSize);
+
+    m_data = buffer;
+    m_state = DEDUPLICATED;
+}
+
+qint32 KisTileData::deduplicatedBuffersMetric()
+{
+    return !s_deduplicatedBuffers.isDestroyed() ?
+        s_deduplicatedBuffers->memoryMetric() : 0;
+}
+
+quint8* KisTileData::acquireUniformBuffer(const quint8 *pixel, qint32 pixelSize)
+{
+    return s_uniformBuffers->acquire(pixel, pixelSize);
+}
+
+void KisTileData::releaseUniformBuffer(quint8 *buffer, qint32 pixelSize)
+{
+    // the tiles may outlive the cache on application exit
+    if (!s_uniformBuffers.isDestroyed()) {
+        s_uniformBuffers->release(buffer, pixelSize);
+    }
+}
+
 void KisTileData::releaseMemory()
 {
+    releaseRetiredData();
+
     if (m_data) {
-        freeData(m_data, m_pixelSize);
+        if (m_state == UNIFORM) {
+            releaseUniformBuffer(m_data, m_pixelSize);
+            m_state = NORMAL;
+        } else if (m_state == DEDUPLICATED) {
+            // the tiles may outlive the index on application exit
+            if (!s_deduplicatedBuffers.isDestroyed()) {
+                s_deduplicatedBuffers->release(m_data);
+            }
+            m_state = NORMAL;
+        } else {
+            freeData(m_data, m_pixelSize);
+        }
         m_data = 0;
     }
 
+    if (m_state == DELTA) {
+        m_delta.clear();
+
+        if (m_deltaBase) {
+            m_deltaBase->m_deltaDependents.deref();
+            m_deltaBase->release();
+            m_deltaBase = 0;
+        }
+        m_state = NORMAL;
+    }
+
     KisTileData *clone = 0;
     while (m_clonesStack.pop(clone)) {
         delete clone;
@@ -146,39 +606,15 @@ void KisTileData::allocateMemory()
 
 quint8* KisTileData::allocateData(const qint32 pixelSize)
 {
-    quint8 *ptr = 0;
-
-    if (!m_cache.pop(pixelSize, ptr)) {
-        switch (pixelSize) {
-        case 4:
-            ptr = (quint8*)BoostPool4BPP::malloc();
-            break;
-        case 8:
-            ptr = (quint8*)BoostPool8BPP::malloc();
-            break;
-        default:
-            ptr = (quint8*) malloc(pixelSize * WIDTH * HEIGHT);
-            break;
-        }
-    }
-
-    return ptr;
+    return KisTileDataAllocator::instance()->allocate(pixelSize);
 }
 
 void KisTileData::freeData(quint8* ptr, const qint32 pixelSize)
 {
-    if (!m_cache.push(pixelSize, ptr)) {
-        switch (pixelSize) {
-        case 4:
-            BoostPool4BPP::free(ptr);
-            break;
-        case 8:
-            BoostPool8BPP::free(ptr);
-            break;
-        default:
-            free(ptr);
-            break;
-        }
+    // the tiles may outlive the allocator on application exit
+    KisTileDataAllocator *allocator = KisTileDataAllocator::instance();
+    if (allocator) {
+        allocator->deallocate(ptr, pixelSize);
     }
 }
 
@@ -188,6 +624,12 @@ void KisTileData::freeData(quint8* ptr, const qint32 pixelSize)
 #include <unistd.h>
 #endif /* DEBUG_POOL_RELEASE */
 
+/**
+ * Only the registered tile data in NORMAL state (and its clones) owns
+ * pooled memory. The buffers of uniform and deduplicated tile data,
+ * including the ones kept in m_retiredData after expandSharedData(),
+ * are allocated with malloc(), so they survive the purge.
+ */
 void KisTileData::releaseInternalPools()
 {
     const int maxMigratedTiles = 100;
@@ -210,8 +652,7 @@ void KisTileData::releaseInternalPools()
             }
 
             // check if the tile data has actually been pooled
-            if (item->m_pixelSize != 4 &&
-                item->m_pixelSize != 8) {
+            if (!KisTileDataAllocator::isPooledPixelSize(item->m_pixelSize)) {
 
                 continue;
             }
@@ -233,9 +674,8 @@ void KisTileData::releaseInternalPools()
 
         if (!failedToLock) {
             // purge the pools memory
-            m_cache.clear();
-            BoostPool4BPP::purge_memory();
-            BoostPool8BPP::purge_memory();
+            KisTileDataAllocator::instance()->purge();
+            s_uniformBuffers->purgeUnused();
 
             auto it = dataObjects.begin();
             auto chunkIt = memoryChunks.constBegin();
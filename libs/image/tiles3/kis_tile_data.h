@@ -116,7 +116,28 @@ inline void KisTileData::setMementoed(bool value) {
 }
 
 inline bool KisTileData::historical() const {
-    return mementoed() && numUsers() <= 1;
+    return mementoed() && numUsers() - m_deltaDependents.loadAcquire() <= 1;
+}
+
+inline bool KisTileData::isUniform() const {
+    return m_state == UNIFORM;
+}
+
+inline bool KisTileData::isDeduplicated() const {
+    return m_state == DEDUPLICATED;
+}
+
+inline bool KisTileData::hasSharedData() const {
+    return m_state == UNIFORM || m_state == DEDUPLICATED;
+}
+
+inline bool KisTileData::isDelta() const {
+    return m_state == DELTA;
+}
+
+inline void KisTileData::resetContentChecks() {
+    m_uniformityChecked.storeRelease(0);
+    m_contentHashValid.storeRelease(0);
 }
 
 inline int KisTileData::age() const {
@@ -22,6 +22,7 @@
 
 #include <QReadWriteLock>
 #include <QAtomicInt>
+#include <QByteArray>
 
 #include "kis_lockless_stack.h"
 #include "swap/kis_chunk_allocator.h"
@@ -43,57 +44,6 @@ typedef KisTileDataList::iterator KisTileDataListIterator;
 typedef KisTileDataList::const_iterator KisTileDataListConstIterator;
 
 
-class SimpleCache
-{
-public:
-    SimpleCache() = default;
-    ~SimpleCache();
-
-    bool push(int pixelSize, quint8 *&ptr)
-    {
-        QReadLocker l(&m_cacheLock);
-        switch (pixelSize) {
-        case 4:
-            m_4Pool.push(ptr);
-            break;
-        case 8:
-            m_8Pool.push(ptr);
-            break;
-        case 16:
-            m_16Pool.push(ptr);
-            break;
-        default:
-            return false;
-        }
-
-        return true;
-    }
-
-    bool pop(int pixelSize, quint8 *&ptr)
-    {
-        QReadLocker l(&m_cacheLock);
-        switch (pixelSize) {
-        case 4:
-            return m_4Pool.pop(ptr);
-        case 8:
-            return m_8Pool.pop(ptr);
-        case 16:
-            return m_16Pool.pop(ptr);
-        default:
-            return false;
-        }
-    }
-
-    void clear();
-
-private:
-    QReadWriteLock m_cacheLock;
-    KisLocklessStack<quint8*> m_4Pool;
-    KisLocklessStack<quint8*> m_8Pool;
-    KisLocklessStack<quint8*> m_16Pool;
-};
-
-
 /**
  * Stores actual tile's data
  */
@@ -111,7 +61,10 @@ public:
     enum EnumTileDataState {
         NORMAL = 0,
         COMPRESSED,
-        SWAPPED
+        SWAPPED,
+        UNIFORM,
+        DEDUPLICATED,
+        DELTA
     };
 
     /**
@@ -188,10 +141,66 @@ public:
      * Convenience method. Returns true iff the tile data is linked to
      * information only and therefore can be swapped out easily.
      *
-     * Effectively equivalent to: (mementoed() && numUsers() <= 1)
+     * Effectively equivalent to: (mementoed() && numUsers() <= 1),
+     * the users that are older revisions stored as deltas against
+     * this tile data are not counted.
      */
     inline bool historical() const;
 
+    /**
+     * Returns true if all the pixels of the tile data have the same
+     * value and the tile data keeps them in a compact form. Such
+     * tile data doesn't own its pixel buffer, data() points to a
+     * read-only buffer shared by all the uniform tile data objects
+     * of the same color. The first pixel of data() is the color.
+     *
+     * Uniform tile data is expanded back into a normal one as
+     * soon as anyone locks it for write access.
+     */
+    inline bool isUniform() const;
+
+    /**
+     * Returns true if the tile data shares a read-only pixel buffer
+     * with other tile data objects having byte-identical content.
+     * Like uniform tile data, it is expanded on write access.
+     */
+    inline bool isDeduplicated() const;
+
+    /**
+     * Returns true if data() points to a read-only buffer the tile
+     * data doesn't own, that is the tile data is either uniform or
+     * deduplicated.
+     */
+    inline bool hasSharedData() const;
+
+    /**
+     * Returns true if the tile data doesn't keep its pixels in memory,
+     * but only the rows that differ from a newer revision of the same
+     * tile (the base). Only historical tile data is converted into
+     * this form. Like a swapped out tile data, it is reconstructed on
+     * the first access, data() is null until then.
+     */
+    inline bool isDelta() const;
+
+    /**
+     * Checks whether all the pixels of the tile data are the same.
+     * The data must be present in memory.
+     */
+    bool checkPixelsUniform() const;
+
+    /**
+     * Tells the pooler the tile data has been modified since the
+     * last uniformity check and content hashing
+     */
+    inline void resetContentChecks();
+
+    /**
+     * Returns the memory metric of the buffers shared by
+     * deduplicated tile data objects
+     * \see KisTileDataStore::memoryMetric()
+     */
+    static qint32 deduplicatedBuffersMetric();
+
     /**
      * Used for swapping purposes only.
      * Frees the memory occupied by the tile data.
@@ -213,7 +222,7 @@ public:
     /**
      * Releases internal pools, which keep blobs where the tiles are
      * stored.  The point is that we don't allocate the tiles from
-     * glibc directly, but use pools (implemented via boost) to
+     * glibc directly, but use pools (see KisTileDataAllocator) to
      * allocate bigger chunks. This method should be called when one
      * knows that we have just free'd quite a lot of memory and we
      * won't need it anymore. E.g. when a document has been closed.
@@ -223,6 +232,78 @@ public:
 private:
     void fillWithPixel(const quint8 *defPixel);
 
+    /**
+     * Switches the tile data into the uniform state. The caller should
+     * hold m_swapLock in write mode and ensure the pixels are uniform.
+     */
+    void convertToUniform();
+
+    /**
+     * Allocates a private buffer for the pixels of the uniform or
+     * deduplicated tile data and switches it back into the normal
+     * state. The shared buffer is not released immediately, because
+     * concurrent readers may still access it. It is released by
+     * releaseRetiredData() when nobody holds m_swapLock.
+     */
+    void expandSharedData();
+
+    /**
+     * Releases the shared buffer left after expansion. The caller
+     * should hold m_swapLock in write mode.
+     */
+    void releaseRetiredData();
+
+    /**
+     * Computes the hash of the pixels and stores it in m_contentHash
+     */
+    void updateContentHash();
+
+    /**
+     * Tries to find a deduplicated buffer with the same content and
+     * switch the tile data to it. The caller should hold m_swapLock
+     * in write mode and ensure the hash is up to date.
+     */
+    bool tryConvertToDeduplicated();
+
+    /**
+     * Moves the tile data's pixels into a new shared buffer, so that
+     * other tile data objects with the same content could reuse it.
+     */
+    void convertToDeduplicated();
+
+    /**
+     * Encodes the rows of \p data that differ from \p base into
+     * \p delta. Returns false if the delta would not be considerably
+     * smaller than the tile itself.
+     */
+    static bool encodeRowsDelta(const quint8 *data, const quint8 *base,
+                                qint32 pixelSize, QByteArray *delta);
+
+    /**
+     * Writes the rows stored in \p delta over the copy of the base
+     * pixels in \p data
+     */
+    static void applyRowsDelta(quint8 *data, const QByteArray &delta, qint32 pixelSize);
+
+    /**
+     * Releases the pixel buffer and keeps only \p delta against
+     * \p base. The caller should hold m_swapLock in write mode and
+     * acquire() the base beforehand, the reference is released when
+     * the tile data is restored or destroyed.
+     */
+    void convertToDelta(KisTileData *base, const QByteArray &delta);
+
+    /**
+     * Adopts \p buffer with the reconstructed pixels and switches
+     * the tile data back into the normal state. Returns the base
+     * tile data, which should be release()'d by the caller after
+     * all the locks are released.
+     */
+    KisTileData* restoreFromDelta(quint8 *buffer);
+
+    static quint8* acquireUniformBuffer(const quint8 *pixel, qint32 pixelSize);
+    static void releaseUniformBuffer(quint8 *buffer, qint32 pixelSize);
+
     static quint8* allocateData(const qint32 pixelSize);
     static void freeData(quint8 *ptr, const qint32 pixelSize);
 private:
@@ -317,7 +398,41 @@ private:
     //qint32 m_timeStamp;
 
     KisTileDataStore *m_store;
-    static SimpleCache m_cache;
+
+    /**
+     * Set by the pooler after checking the tile for uniformity,
+     * reset on every write access. Freshly created tile data is
+     * considered checked, because nobody has written into it yet.
+     */
+    QAtomicInt m_uniformityChecked;
+
+    /**
+     * The hash of the pixels used for deduplication. It is valid
+     * only when m_contentHashValid is set, the flag is reset on
+     * every write access.
+     */
+    uint m_contentHash;
+    QAtomicInt m_contentHashValid;
+
+    /**
+     * The shared buffer left after expansion of the tile data
+     * \see expandSharedData()
+     */
+    quint8 *m_retiredData;
+    EnumTileDataState m_retiredState;
+
+    /**
+     * The newer revision of the tile and the rows that differ from it
+     * \see convertToDelta()
+     */
+    KisTileData *m_deltaBase;
+    QByteArray m_delta;
+
+    /**
+     * The number of delta tile data objects using this tile data as
+     * a base. Each of them is counted in m_usersCount as well.
+     */
+    QAtomicInt m_deltaDependents;
 
 public:
     static const qint32 WIDTH;
@@ -30,6 +30,8 @@ const qint32 KisTileDataPooler::MAX_NUM_CLONES = 16;
 const qint32 KisTileDataPooler::MAX_TIMEOUT = 60000; // 01m00s
 const qint32 KisTileDataPooler::MIN_TIMEOUT = 100; // 00m00.100s
 const qint32 KisTileDataPooler::TIMEOUT_FACTOR = 2;
+const qint32 KisTileDataPooler::MAX_UNIFORMITY_CHECKS = 256;
+const qint32 KisTileDataPooler::MAX_HASHED_TILES = 256;
 
 //#define DEBUG_POOLER
 
@@ -101,6 +103,8 @@ KisTileDataPooler::KisTileDataPooler(KisTileDataStore *store, qint32 memoryLimit
     else {
         m_memoryLimit = MiB_TO_METRIC(KisImageConfig(true).poolLimit());
     }
+
+    m_enableDeduplication = KisImageConfig(true).enableTileDeduplication();
 }
 
 KisTileDataPooler::~KisTileDataPooler()
@@ -215,11 +219,44 @@ void KisTileDataPooler::run()
 
         m_store->endIteration(iter);
 
+        m_lastCycleHadWork |= compactUniformTiles();
+
+        if (m_enableDeduplication) {
+            m_lastCycleHadWork |= m_store->deduplicateTileData(MAX_HASHED_TILES);
+        }
+
         DEBUG_TILE_STATISTICS();
         DEBUG_SIMPLE_ACTION("cycle finished");
     }
 }
 
+bool KisTileDataPooler::compactUniformTiles()
+{
+    KisTileDataStoreIterator *iter = m_store->beginIteration();
+    KisTileData *item;
+
+    qint32 numChecks = 0;
+    bool hasUncheckedTiles = false;
+
+    while (iter->hasNext()) {
+        item = iter->next();
+
+        if (item->m_uniformityChecked.loadAcquire()) continue;
+
+        if (numChecks >= MAX_UNIFORMITY_CHECKS) {
+            hasUncheckedTiles = true;
+            break;
+        }
+
+        iter->tryMakeUniform(item);
+        numChecks++;
+    }
+
+    m_store->endIteration(iter);
+
+    return hasUncheckedTiles;
+}
+
 void KisTileDataPooler::forceUpdateMemoryStats()
 {
     KIS_SAFE_ASSERT_RECOVER_RETURN(!isRunning());
@@ -417,4 +454,5 @@ void KisTileDataPooler::debugTileStatistics()
 void KisTileDataPooler::testingRereadConfig()
 {
     m_memoryLimit = MiB_TO_METRIC(KisImageConfig(true).poolLimit());
+    m_enableDeduplication = KisImageConfig(true).enableTileDeduplication();
 }
@@ -58,6 +58,8 @@ protected:
     static const qint32 MAX_TIMEOUT;
     static const qint32 MIN_TIMEOUT;
     static const qint32 TIMEOUT_FACTOR;
+    static const qint32 MAX_UNIFORMITY_CHECKS;
+    static const qint32 MAX_HASHED_TILES;
 
     void waitForWork();
     qint32 numClonesNeeded(KisTileData *td) const;
@@ -83,6 +85,13 @@ protected:
                       QList<KisTileData*> &donors,
                       qint32 &memoryOccupied);
 
+    /**
+     * Converts the tiles filled with a single color into a compact
+     * uniform form. Checks at most MAX_UNIFORMITY_CHECKS tiles per
+     * cycle. Returns true if there are tiles left unchecked.
+     */
+    bool compactUniformTiles();
+
 private:
     void debugTileStatistics();
 protected:
@@ -92,6 +101,7 @@ protected:
     qint32 m_timeout;
     bool m_lastCycleHadWork;
     qint32 m_memoryLimit;
+    bool m_enableDeduplication;
     qint32 m_lastPoolMemoryMetric;
     qint32 m_lastRealMemoryMetric;
     qint32 m_lastHistoricalMemoryMetric;
@@ -21,12 +21,14 @@
 #include "config-memory-leak-tracker.h"
 
 #include <QGlobalStatic>
+#include <QHash>
 
 #include "kis_tile_data_store.h"
 #include "kis_tile_data.h"
 #include "kis_debug.h"
 
 #include "kis_tile_data_store_iterators.h"
+#include "kis_image_config.h"
 
 Q_GLOBAL_STATIC(KisTileDataStore, s_instance)
 
@@ -71,6 +73,13 @@ KisTileDataStore::KisTileDataStore()
     : m_pooler(this),
       m_swapper(this),
       m_numTiles(0),
+      m_numUniformTiles(0),
+      m_numDeduplicatedTiles(0),
+      m_deduplicatedMetric(0),
+      m_numDeltaTiles(0),
+      m_deltaMemorySize(0),
+      m_enableDeltaMementos(KisImageConfig(true).enableDeltaMementos()),
+      m_enableHistoryCompression(KisImageConfig(true).compressHistoryTiles()),
       m_memoryMetric(0),
       m_counter(1),
       m_clockIndex(1)
@@ -84,6 +93,8 @@ KisTileDataStore::~KisTileDataStore()
     m_pooler.terminatePooler();
     m_swapper.terminateSwapper();
 
+    clearHistoryCompressionQueue();
+
     if (numTiles() > 0) {
         errKrita << "Warning: some tiles have leaked:";
         errKrita << "\tTiles in memory:" << numTilesInMemory() << "\n"
@@ -111,12 +122,30 @@ KisTileDataStore::MemoryStatistics KisTileDataStore::memoryStatistics()
     const qint64 metricCoeff = qint64(KisTileData::WIDTH) * KisTileData::HEIGHT;
 
     stats.realMemorySize = m_pooler.lastRealMemoryMetric() * metricCoeff;
-    stats.historicalMemorySize = m_pooler.lastHistoricalMemoryMetric() * metricCoeff;
+    stats.deltaSize = m_deltaMemorySize.loadAcquire();
+    stats.numDeltaTiles = m_numDeltaTiles.loadAcquire();
+
+    // the deltas are kept only for the historical tiles
+    stats.historicalMemorySize =
+        m_pooler.lastHistoricalMemoryMetric() * metricCoeff + stats.deltaSize;
     stats.poolSize = m_pooler.lastPoolMemoryMetric() * metricCoeff;
 
     stats.totalMemorySize = memoryMetric() * metricCoeff + stats.poolSize;
 
     stats.swapSize = m_swappedStore.totalMemoryMetric() * metricCoeff;
+    stats.swapFileSize = m_swappedStore.swapFileSize();
+
+    stats.compressedSize = m_swappedStore.compressedMemorySize();
+    stats.numCompressedTiles = m_swappedStore.numCompressedTiles();
+    stats.compressionSavedSize = m_swappedStore.compressionSavedSize();
+
+    stats.numSwappedOutTiles = m_swappedStore.numSwappedOutTiles();
+    stats.numSwapBatches = m_swappedStore.numSwapBatches();
+
+    stats.numDeduplicatedTiles = m_numDeduplicatedTiles.loadAcquire();
+    stats.deduplicationSavedSize =
+        (qint64(m_deduplicatedMetric.loadAcquire()) -
+         KisTileData::deduplicatedBuffersMetric()) * metricCoeff;
 
     return stats;
 }
@@ -129,9 +158,10 @@ inline void KisTileDataStore::registerTileDataImp(KisTileData *td)
     // make sure that access to the hash table is guarded by GC block
     // (it avoids removal of the referenced cells caused by concurrent
     // migrations)
-    m_tileDataMap.getGC().lockRawPointerAccess();
+    const int gcToken = m_tileDataMap.getGC().lockRawPointerAccess();
     m_tileDataMap.assign(index, td);
-    m_tileDataMap.getGC().unlockRawPointerAccess();
+    m_tileDataMap.getGC().unlockRawPointerAccess(gcToken);
+    m_tileDataMap.getGC().update();
 
     m_numTiles.ref();
     m_memoryMetric += td->pixelSize();
@@ -148,7 +178,7 @@ inline void KisTileDataStore::unregisterTileDataImp(KisTileData *td)
     // make sure that access to the hash table is guarded by GC block
     // (it avoids removal of the referenced cells caused by concurrent
     // migrations)
-    m_tileDataMap.getGC().lockRawPointerAccess();
+    const int gcToken = m_tileDataMap.getGC().lockRawPointerAccess();
 
     if (m_clockIndex == td->m_tileNumber) {
         do {
@@ -162,7 +192,8 @@ inline void KisTileDataStore::unregisterTileDataImp(KisTileData *td)
     m_numTiles.deref();
     m_memoryMetric -= td->pixelSize();
 
-    m_tileDataMap.getGC().unlockRawPointerAccess();
+    m_tileDataMap.getGC().unlockRawPointerAccess(gcToken);
+    m_tileDataMap.getGC().update();
 }
 
 void KisTileDataStore::unregisterTileData(KisTileData *td)
@@ -171,10 +202,18 @@ void KisTileDataStore::unregisterTileData(KisTileData *td)
     unregisterTileDataImp(td);
 }
 
-KisTileData *KisTileDataStore::allocTileData(qint32 pixelSize, const quint8 *defPixel)
+KisTileData *KisTileDataStore::createDefaultTileData(qint32 pixelSize, const quint8 *defPixel)
 {
-    KisTileData *td = new KisTileData(pixelSize, defPixel, this);
-    registerTileData(td);
+    KisTileData *td = new KisTileData(pixelSize, defPixel, this, false);
+
+    /**
+     * The default tile data is never registered in the store,
+     * it is shared by all the tiles without a private copy
+     */
+    td->convertToUniform();
+    td->m_uniformityChecked.storeRelease(1);
+    m_numUniformTiles.ref();
+
     return td;
 }
 
@@ -206,7 +245,15 @@ void KisTileDataStore::freeTileData(KisTileData *td)
     m_iteratorLock.lockForRead();
     td->m_swapLock.lockForWrite();
 
-    if (!td->data()) {
+    if (td->isUniform()) {
+        m_numUniformTiles.deref();
+    } else if (td->isDeduplicated()) {
+        m_numDeduplicatedTiles.deref();
+        m_deduplicatedMetric -= td->pixelSize();
+    } else if (td->isDelta()) {
+        m_numDeltaTiles.deref();
+        m_deltaMemorySize.fetchAndAddOrdered(-qint64(td->m_delta.size()));
+    } else if (!td->data()) {
         m_swappedStore.forgetTileData(td);
     } else {
         unregisterTileDataImp(td);
@@ -226,8 +273,37 @@ void KisTileDataStore::ensureTileDataLoaded(KisTileData *td)
     td->m_swapLock.lockForRead();
 
     while (!td->data()) {
+        KisTileData *base = 0;
+        QByteArray delta;
+
+        if (td->isDelta()) {
+            base = td->m_deltaBase;
+            base->ref();
+            delta = td->m_delta;
+        }
+
         td->m_swapLock.unlock();
 
+        /**
+         * The base tile data may be swapped out or be a delta itself,
+         * so it should be loaded with no locks held. We reconstruct
+         * the pixels into a separate buffer and install it later.
+         */
+        quint8 *reconstructedData = 0;
+
+        if (base) {
+            reconstructedData = KisTileData::allocateData(td->pixelSize());
+
+            base->blockSwapping();
+            memcpy(reconstructedData, base->data(),
+                   td->pixelSize() * KisTileData::WIDTH * KisTileData::HEIGHT);
+            base->unblockSwapping();
+
+            KisTileData::applyRowsDelta(reconstructedData, delta, td->pixelSize());
+        }
+
+        KisTileData *restoredBase = 0;
+
         /**
          * The order of this heavy locking is very important.
          * Change it only in case, you really know what you are doing.
@@ -250,14 +326,35 @@ void KisTileDataStore::ensureTileDataLoaded(KisTileData *td)
         if (!td->data()) {
             td->m_swapLock.lockForWrite();
 
-            m_swappedStore.swapInTileData(td);
-            registerTileDataImp(td);
+            if (!td->isDelta()) {
+                m_swappedStore.swapInTileData(td);
+                registerTileDataImp(td);
+            } else if (reconstructedData && td->m_deltaBase == base) {
+                m_numDeltaTiles.deref();
+                m_deltaMemorySize.fetchAndAddOrdered(-qint64(td->m_delta.size()));
+
+                restoredBase = td->restoreFromDelta(reconstructedData);
+                reconstructedData = 0;
+                registerTileDataImp(td);
+            }
 
             td->m_swapLock.unlock();
         }
 
         m_iteratorLock.unlock();
 
+        if (reconstructedData) {
+            KisTileData::freeData(reconstructedData, td->pixelSize());
+        }
+
+        if (restoredBase) {
+            restoredBase->release();
+        }
+
+        if (base) {
+            base->deref();
+        }
+
         /**
          * <-- In theory, livelock is possible here...
          */
@@ -286,6 +383,382 @@ bool KisTileDataStore::trySwapTileData(KisTileData *td)
     return result;
 }
 
+qint64 KisTileDataStore::trySwapTileDataBatch(const QVector<KisTileData*> &tiles, bool compressInMemory)
+{
+    /**
+     * This function is called with m_listLock acquired
+     */
+
+    QVector<KisTileData*> lockedTiles;
+    lockedTiles.reserve(tiles.size());
+
+    Q_FOREACH (KisTileData *td, tiles) {
+        if (!td->m_swapLock.tryLockForWrite()) continue;
+
+        if (td->data() && td->m_state == KisTileData::NORMAL) {
+            lockedTiles.append(td);
+        } else {
+            td->m_swapLock.unlock();
+        }
+    }
+
+    qint64 freedMetric = 0;
+
+    if (compressInMemory) {
+        const qint64 compressedSize = m_swappedStore.compressTileDataBatch(lockedTiles);
+
+        Q_FOREACH (KisTileData *td, lockedTiles) {
+            unregisterTileDataImp(td);
+            freedMetric += td->pixelSize();
+        }
+
+        const qint64 tileArea = KisTileData::WIDTH * KisTileData::HEIGHT;
+        freedMetric -= (compressedSize + tileArea - 1) / tileArea;
+
+    } else if (m_swappedStore.trySwapOutTileDataBatch(lockedTiles)) {
+        Q_FOREACH (KisTileData *td, lockedTiles) {
+            unregisterTileDataImp(td);
+            freedMetric += td->pixelSize();
+        }
+    }
+
+    Q_FOREACH (KisTileData *td, lockedTiles) {
+        td->m_swapLock.unlock();
+    }
+
+    return freedMetric;
+}
+
+bool KisTileDataStore::tryMakeTileDataUniform(KisTileData *td)
+{
+    QReadLocker lock(&m_iteratorLock);
+    return tryMakeTileDataUniformImp(td);
+}
+
+bool KisTileDataStore::tryMakeTileDataUniformImp(KisTileData *td)
+{
+    /**
+     * This function is called with m_listLock acquired
+     */
+
+    bool result = false;
+    if (td->m_uniformityChecked.loadAcquire()) return result;
+    if (!td->m_swapLock.tryLockForWrite()) return result;
+
+    td->releaseRetiredData();
+
+    if (td->data() && !td->hasSharedData()) {
+        if (td->checkPixelsUniform()) {
+            unregisterTileDataImp(td);
+            td->convertToUniform();
+            m_numUniformTiles.ref();
+
+            // pre-clones of the uniform tile data are useless now
+            KisTileData *clone = 0;
+            while (td->m_clonesStack.pop(clone)) {
+                delete clone;
+            }
+
+            result = true;
+        }
+        td->m_uniformityChecked.storeRelease(1);
+    }
+    td->m_swapLock.unlock();
+
+    return result;
+}
+
+bool KisTileDataStore::tryConvertToDelta(KisTileData *td, KisTileData *base)
+{
+    if (!m_enableDeltaMementos.loadAcquire()) return false;
+    if (td == base || td->pixelSize() != base->pixelSize()) return false;
+
+    /**
+     * Fast check without locking, will be repeated later
+     */
+    if (!td->historical() || td->m_state != KisTileData::NORMAL || !td->data()) return false;
+
+    /**
+     * The delta chains are never longer than one step: a tile data
+     * that is a base of other deltas never becomes a delta itself,
+     * and a delta is never used as a base. Otherwise restoring a tile
+     * would recurse through the whole history of the tile.
+     */
+    if (td->m_deltaDependents.loadAcquire() || base->isDelta()) return false;
+
+    QByteArray delta;
+
+    td->blockSwapping();
+    base->blockSwapping();
+
+    const bool deltaIsSmall =
+        KisTileData::encodeRowsDelta(td->data(), base->data(), td->pixelSize(), &delta);
+
+    base->unblockSwapping();
+    td->unblockSwapping();
+
+    if (!deltaIsSmall) return false;
+
+    /**
+     * The base is acquired to make sure its pixels will never be
+     * changed in-place while the delta depends on them: any writer
+     * will have to copy-on-write the base.
+     */
+    base->acquire();
+
+    bool result = false;
+
+    m_iteratorLock.lockForRead();
+
+    if (td->m_swapLock.tryLockForWrite()) {
+        td->releaseRetiredData();
+
+        /**
+         * The base is locked for reading, so it cannot be converted
+         * into a delta concurrently, and new dependents of td can
+         * appear only while td is not locked for writing.
+         */
+        if (base->m_swapLock.tryLockForRead()) {
+            if (td->data() && td->m_state == KisTileData::NORMAL && td->historical() &&
+                !td->m_deltaDependents.loadAcquire() && !base->isDelta()) {
+
+                unregisterTileDataImp(td);
+                td->convertToDelta(base, delta);
+
+                m_numDeltaTiles.ref();
+                m_deltaMemorySize.fetchAndAddOrdered(delta.size());
+
+                // pre-clones of the historical tile data are useless
+                KisTileData *clone = 0;
+                while (td->m_clonesStack.pop(clone)) {
+                    delete clone;
+                }
+
+                result = true;
+            }
+
+            base->m_swapLock.unlock();
+        }
+
+        td->m_swapLock.unlock();
+    }
+
+    m_iteratorLock.unlock();
+
+    if (!result) {
+        base->release();
+    }
+
+    return result;
+}
+
+void KisTileDataStore::expandSharedTileData(KisTileData *td)
+{
+    checkFreeMemory();
+
+    /**
+     * The tile data is blocked from swapping, so the only thing
+     * that can happen to it is a concurrent expansion by another
+     * writer. Shared tile data is never converted back while
+     * someone holds its swap lock.
+     */
+    QMutexLocker l(&m_sharedDataExpansionLock);
+
+    if (td->isUniform()) {
+        m_numUniformTiles.deref();
+    } else if (td->isDeduplicated()) {
+        m_numDeduplicatedTiles.deref();
+        m_deduplicatedMetric -= td->pixelSize();
+    } else {
+        return;
+    }
+
+    td->expandSharedData();
+    registerTileData(td);
+}
+
+inline void KisTileDataStore::convertToDeduplicatedImp(KisTileData *td, bool createBuffer)
+{
+    unregisterTileDataImp(td);
+
+    if (createBuffer) {
+        td->convertToDeduplicated();
+    }
+
+    m_numDeduplicatedTiles.ref();
+    m_deduplicatedMetric += td->pixelSize();
+
+    // pre-clones are not counted by the saved memory, drop them
+    KisTileData *clone = 0;
+    while (td->m_clonesStack.pop(clone)) {
+        delete clone;
+    }
+}
+
+bool KisTileDataStore::deduplicateTileData(qint32 maxTilesToHash)
+{
+    /**
+     * Tiles that have no duplicates among the deduplicated ones are
+     * kept in this hash to be matched against the rest of the tiles.
+     */
+    QMultiHash<uint, KisTileData*> candidates;
+
+    qint32 numHashedTiles = 0;
+    bool hasUnhashedTiles = false;
+
+    KisTileDataStoreIterator *iter = beginIteration();
+
+    while (iter->hasNext()) {
+        KisTileData *td = iter->next();
+
+        // uniform tiles are stored in a more compact way
+        if (tryMakeTileDataUniformImp(td)) continue;
+
+        if (!td->m_contentHashValid.loadAcquire() &&
+            numHashedTiles >= maxTilesToHash) {
+
+            hasUnhashedTiles = true;
+            continue;
+        }
+
+        if (!td->m_swapLock.tryLockForWrite()) continue;
+
+        td->releaseRetiredData();
+
+        if (!td->m_contentHashValid.loadAcquire()) {
+            td->updateContentHash();
+            numHashedTiles++;
+        }
+
+        if (td->tryConvertToDeduplicated()) {
+            convertToDeduplicatedImp(td, false);
+        } else {
+            const qint32 dataSize = td->pixelSize() * KisTileData::WIDTH * KisTileData::HEIGHT;
+            bool duplicateFound = false;
+
+            auto it = candidates.find(td->m_contentHash);
+            while (it != candidates.end() && it.key() == td->m_contentHash) {
+                KisTileData *other = it.value();
+
+                if (other->pixelSize() == td->pixelSize() &&
+                    other->m_swapLock.tryLockForWrite()) {
+
+                    /**
+                     * The candidate could have been changed after hashing,
+                     * so we should check its content once again
+                     */
+                    if (other->m_contentHashValid.loadAcquire() &&
+                        !memcmp(other->data(), td->data(), dataSize)) {
+
+                        convertToDeduplicatedImp(other, true);
+
+                        const bool result = td->tryConvertToDeduplicated();
+                        KIS_SAFE_ASSERT_RECOVER_NOOP(result);
+
+                        if (result) {
+                            convertToDeduplicatedImp(td, false);
+                        }
+
+                        duplicateFound = true;
+                    }
+
+                    other->m_swapLock.unlock();
+                }
+
+                if (duplicateFound) {
+                    candidates.erase(it);
+                    break;
+                }
+
+                ++it;
+            }
+
+            if (!duplicateFound) {
+                candidates.insert(td->m_contentHash, td);
+            }
+        }
+
+        td->m_swapLock.unlock();
+    }
+
+    endIteration(iter);
+
+    return hasUnhashedTiles;
+}
+
+void KisTileDataStore::queueHistoryCompression(KisTileData *td)
+{
+    if (!m_enableHistoryCompression.loadAcquire()) return;
+
+    td->ref();
+    m_historyCompressionQueue.push(td);
+    m_swapper.requestHistoryCompression();
+}
+
+int KisTileDataStore::compressQueuedHistoryTiles(int maxTiles, bool compressInMemory)
+{
+    QVector<KisTileData*> queuedTiles;
+    queuedTiles.reserve(maxTiles);
+
+    KisTileData *td = 0;
+    while (queuedTiles.size() < maxTiles && m_historyCompressionQueue.pop(td)) {
+        queuedTiles.append(td);
+    }
+
+    if (compressInMemory) {
+        /**
+         * The tile might have been reused by undo, converted into
+         * a delta or become uniform since it was queued. Such tiles
+         * are filtered out here and in trySwapTileDataBatch()
+         */
+        QVector<KisTileData*> batch;
+        batch.reserve(queuedTiles.size());
+
+        Q_FOREACH (td, queuedTiles) {
+            if (td->historical() && td->data()) {
+                batch.append(td);
+            }
+        }
+
+        QReadLocker lock(&m_iteratorLock);
+        trySwapTileDataBatch(batch, true);
+    }
+
+    /**
+     * Dropping the reference may free the tile data, so it
+     * should be done without m_iteratorLock held
+     */
+    Q_FOREACH (td, queuedTiles) {
+        td->deref();
+    }
+
+    return queuedTiles.size();
+}
+
+void KisTileDataStore::clearHistoryCompressionQueue()
+{
+    KisTileData *td = 0;
+    while (m_historyCompressionQueue.pop(td)) {
+        td->deref();
+    }
+}
+
+qint64 KisTileDataStore::spillCompressedTileData(qint64 metric)
+{
+    const qint64 tileArea = KisTileData::WIDTH * KisTileData::HEIGHT;
+    return m_swappedStore.spillCompressedTiles(metric * tileArea) / tileArea;
+}
+
+void KisTileDataStore::requestSwapCompaction()
+{
+    m_swapper.requestCompaction();
+}
+
+quint64 KisTileDataStore::compactSwapFile(quint64 maxBytesToMove)
+{
+    return m_swappedStore.compact(maxBytesToMove);
+}
+
 KisTileDataStoreIterator* KisTileDataStore::beginIteration()
 {
     m_iteratorLock.lockForWrite();
@@ -356,6 +829,8 @@ void KisTileDataStore::debugSwapAll()
 
 void KisTileDataStore::debugClear()
 {
+    clearHistoryCompressionQueue();
+
     QWriteLocker l(&m_iteratorLock);
     ConcurrentMap<int, KisTileData*>::Iterator iter(m_tileDataMap);
 
@@ -367,11 +842,18 @@ void KisTileDataStore::debugClear()
     m_counter = 1;
     m_clockIndex = 1;
     m_numTiles = 0;
+    m_numUniformTiles = 0;
+    m_numDeduplicatedTiles = 0;
+    m_deduplicatedMetric = 0;
+    m_numDeltaTiles = 0;
+    m_deltaMemorySize = 0;
     m_memoryMetric = 0;
 }
 
 void KisTileDataStore::testingRereadConfig()
 {
+    m_enableDeltaMementos.storeRelease(KisImageConfig(true).enableDeltaMementos());
+    m_enableHistoryCompression.storeRelease(KisImageConfig(true).compressHistoryTiles());
     m_pooler.testingRereadConfig();
     m_swapper.testingRereadConfig();
     kickPooler();
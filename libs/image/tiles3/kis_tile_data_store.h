@@ -23,6 +23,7 @@
 #include "kritaimage_export.h"
 
 #include <QReadWriteLock>
+#include <QMutex>
 #include "kis_tile_data_interface.h"
 
 #include "kis_tile_data_pooler.h"
@@ -54,6 +55,20 @@ public:
         qint64 poolSize;
 
         qint64 swapSize;
+        qint64 swapFileSize;
+
+        qint64 compressedSize;
+        qint64 numCompressedTiles;
+        qint64 compressionSavedSize;
+
+        qint64 numSwappedOutTiles;
+        qint64 numSwapBatches;
+
+        qint64 numDeduplicatedTiles;
+        qint64 deduplicationSavedSize;
+
+        qint64 deltaSize;
+        qint64 numDeltaTiles;
     };
 
     MemoryStatistics memoryStatistics();
@@ -64,7 +79,18 @@ public:
      */
     inline qint32 numTiles() const
     {
-        return m_numTiles.loadAcquire() + m_swappedStore.numTiles();
+        return m_numTiles.loadAcquire() + m_swappedStore.numTiles() +
+            m_numUniformTiles.loadAcquire() + m_numDeduplicatedTiles.loadAcquire() +
+            m_numDeltaTiles.loadAcquire();
+    }
+
+    /**
+     * Returns the number of tiles kept in a compact uniform
+     * form. These tiles are not counted in numTilesInMemory()
+     */
+    inline qint32 numUniformTiles() const
+    {
+        return m_numUniformTiles.loadAcquire();
     }
 
     /**
@@ -85,7 +111,30 @@ public:
      */
     inline qint64 memoryMetric() const
     {
-        return m_memoryMetric.loadAcquire();
+        return m_memoryMetric.loadAcquire() +
+            KisTileData::deduplicatedBuffersMetric() +
+            m_swappedStore.compressedMemoryMetric() +
+            deltaMemoryMetric();
+    }
+
+    /**
+     * Returns the metric of the memory occupied by the deltas of
+     * the historical tiles
+     * \see tryConvertToDelta()
+     */
+    inline qint64 deltaMemoryMetric() const
+    {
+        const qint64 tileArea = KisTileData::WIDTH * KisTileData::HEIGHT;
+        return (qint64(m_deltaMemorySize.loadAcquire()) + tileArea - 1) / tileArea;
+    }
+
+    /**
+     * Returns the metric of the memory occupied by the tiles
+     * compressed in memory
+     */
+    inline qint64 compressedMemoryMetric() const
+    {
+        return m_swappedStore.compressedMemoryMetric();
     }
 
     KisTileDataStoreIterator* beginIteration();
@@ -97,10 +146,10 @@ public:
     KisTileDataStoreClockIterator* beginClockIteration();
     void endIteration(KisTileDataStoreClockIterator* iterator);
 
-    inline KisTileData* createDefaultTileData(qint32 pixelSize, const quint8 *defPixel)
-    {
-        return allocTileData(pixelSize, defPixel);
-    }
+    /**
+     * Creates a uniform tile data filled with \p defPixel
+     */
+    KisTileData* createDefaultTileData(qint32 pixelSize, const quint8 *defPixel);
 
     // Called by The Memento Manager after every commit
     inline void kickPooler()
@@ -118,6 +167,88 @@ public:
      */
     bool trySwapTileData(KisTileData *td);
 
+    /**
+     * Try swap out a batch of tile data objects. The tiles
+     * that are being accessed at the moment are skipped.
+     * If \p compressInMemory is true, the tiles are compressed
+     * and kept in memory instead of being written to the swap
+     * file. Returns the metric of the memory freed.
+     */
+    qint64 trySwapTileDataBatch(const QVector<KisTileData*> &tiles, bool compressInMemory = false);
+
+    /**
+     * Moves the oldest tiles compressed in memory to the swap
+     * file to free at least \p metric of memory. Returns the
+     * metric of the memory freed.
+     */
+    qint64 spillCompressedTileData(qint64 metric);
+
+    /**
+     * Asks the swapper thread to defragment the swap file and give
+     * the freed space back to the OS. Should be called when the
+     * application is idle, the job is done asynchronously.
+     */
+    void requestSwapCompaction();
+
+    /**
+     * Moves at most \p maxBytesToMove bytes of swapped data to
+     * defragment the swap file. Returns the number of bytes moved.
+     * Called by the swapper thread only.
+     */
+    quint64 compactSwapFile(quint64 maxBytesToMove);
+
+    /**
+     * Checks whether all the pixels of the tile data are the same
+     * and, if so, converts it into a compact uniform form. It may
+     * fail in case the tile is being accessed at the same moment
+     * of time. Called by the memento manager on commit.
+     */
+    bool tryMakeTileDataUniform(KisTileData *td);
+
+    /**
+     * The same as tryMakeTileDataUniform(), but is called
+     * with m_iteratorLock acquired
+     */
+    bool tryMakeTileDataUniformImp(KisTileData *td);
+
+    /**
+     * Looks for byte-identical tile data objects and makes them
+     * share a single read-only pixel buffer. The content hashes of
+     * at most \p maxTilesToHash tiles are calculated per call, the
+     * others are left for the next pass. Returns true if there are
+     * tiles left unhashed. Called by the pooler thread.
+     */
+    bool deduplicateTileData(qint32 maxTilesToHash);
+
+    /**
+     * Replaces the pixels of the historical tile data \p td with the
+     * rows that differ from its newer revision \p base. Does nothing
+     * if delta mementos are disabled in the config, \p td is used by
+     * anyone except the undo history or is being accessed at the
+     * moment, or the difference is too big. Called by the memento
+     * manager on commit.
+     */
+    bool tryConvertToDelta(KisTileData *td, KisTileData *base);
+
+    /**
+     * Queues the historical tile data \p td for compression in the
+     * background. The tile is kept compressed in memory until undo
+     * accesses it again, or until the swapper spills it to the
+     * swap file. Does nothing if history compression is disabled
+     * in the config. Called by the memento manager on commit.
+     */
+    void queueHistoryCompression(KisTileData *td);
+
+    /**
+     * Compresses at most \p maxTiles tiles queued by
+     * queueHistoryCompression(). The tiles that are not historical
+     * anymore or are being accessed at the moment are skipped. If
+     * \p compressInMemory is false, the tiles are just removed from
+     * the queue. Returns the number of tiles taken from the queue.
+     * Called by the swapper thread.
+     */
+    int compressQueuedHistoryTiles(int maxTiles, bool compressInMemory = true);
+
 
     /**
      * WARN: The following three method are only for usage
@@ -140,14 +271,21 @@ public:
      */
     void ensureTileDataLoaded(KisTileData *td);
 
+    /**
+     * Allocates a private pixel buffer for the uniform or
+     * deduplicated tile data and registers it in the store.
+     * PRECONDITIONS: td->m_swapLock is locked in read mode
+     */
+    void expandSharedTileData(KisTileData *td);
+
     void registerTileData(KisTileData *td);
     void unregisterTileData(KisTileData *td);
 
 private:
-    KisTileData *allocTileData(qint32 pixelSize, const quint8 *defPixel);
-
     inline void registerTileDataImp(KisTileData *td);
     inline void unregisterTileDataImp(KisTileData *td);
+    inline void convertToDeduplicatedImp(KisTileData *td, bool createBuffer);
+    void clearHistoryCompressionQueue();
     void freeRegisteredTiles();
 
     friend class DeadlockyThread;
@@ -175,11 +313,25 @@ private:
      * metric = num_bytes / (KisTileData::WIDTH * KisTileData::HEIGHT)
      */
     QAtomicInt m_numTiles;
+    QAtomicInt m_numUniformTiles;
+    QAtomicInt m_numDeduplicatedTiles;
+    QAtomicInt m_deduplicatedMetric;
+    QAtomicInt m_numDeltaTiles;
+    QAtomicInteger<qint64> m_deltaMemorySize;
+    QAtomicInt m_enableDeltaMementos;
+    QAtomicInt m_enableHistoryCompression;
     QAtomicInt m_memoryMetric;
     QAtomicInt m_counter;
     QAtomicInt m_clockIndex;
     ConcurrentMap<int, KisTileData*> m_tileDataMap;
     QReadWriteLock m_iteratorLock;
+    QMutex m_sharedDataExpansionLock;
+
+    /**
+     * The historical tiles waiting for background compression,
+     * every tile in the queue holds an extra reference
+     */
+    KisTileDataCache m_historyCompressionQueue;
 };
 
 template<typename T>
@@ -73,6 +73,24 @@ public:
         return m_store->trySwapTileData(td);
     }
 
+    inline qint64 trySwapOut(const QVector<KisTileData*> &tiles, bool compressInMemory = false)
+    {
+        while (m_iterator.isValid() && tiles.contains(m_iterator.getValue())) {
+            m_iterator.next();
+        }
+
+        return m_store->trySwapTileDataBatch(tiles, compressInMemory);
+    }
+
+    inline bool tryMakeUniform(KisTileData *td)
+    {
+        if (td == m_iterator.getValue()) {
+            m_iterator.next();
+        }
+
+        return m_store->tryMakeTileDataUniformImp(td);
+    }
+
 private:
     ConcurrentMap<int, KisTileData*> &m_map;
     ConcurrentMap<int, KisTileData*>::Iterator m_iterator;
@@ -148,6 +166,15 @@ public:
         return m_store->trySwapTileData(td);
     }
 
+    inline qint64 trySwapOut(const QVector<KisTileData*> &tiles, bool compressInMemory = false)
+    {
+        while (m_iterator.isValid() && tiles.contains(m_iterator.getValue())) {
+            m_iterator.next();
+        }
+
+        return m_store->trySwapTileDataBatch(tiles, compressInMemory);
+    }
+
 private:
     friend class KisTileDataStore;
     inline int getFinalPosition()
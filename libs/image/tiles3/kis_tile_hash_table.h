@@ -227,9 +227,4 @@ private:
     Q_DISABLE_COPY(KisTileHashTableIteratorTraits)
 };
 
-
-typedef KisTileHashTableTraits<KisTile> KisTileHashTable;
-typedef KisTileHashTableIteratorTraits<KisTile, QWriteLocker> KisTileHashTableIterator;
-typedef KisTileHashTableIteratorTraits<KisTile, QReadLocker> KisTileHashTableConstIterator;
-
 #endif /* KIS_TILEHASHTABLE_H_ */
@@ -145,10 +145,11 @@ private:
     {
         TileTypeSP::ref(&item, item.data());
         TileType *tile = 0;
+        int gcToken = 0;
 
         {
             QReadLocker locker(&m_iteratorLock);
-            m_map.getGC().lockRawPointerAccess();
+            gcToken = m_map.getGC().lockRawPointerAccess();
             tile = m_map.assign(idx, item.data());
         }
 
@@ -159,14 +160,14 @@ private:
             m_numTiles.fetchAndAddRelaxed(1);
         }
 
-        m_map.getGC().unlockRawPointerAccess();
+        m_map.getGC().unlockRawPointerAccess(gcToken);
 
         m_map.getGC().update();
     }
 
     inline bool erase(quint32 idx)
     {
-        m_map.getGC().lockRawPointerAccess();
+        const int gcToken = m_map.getGC().lockRawPointerAccess();
 
         bool wasDeleted = false;
         TileType *tile = m_map.erase(idx);
@@ -179,7 +180,7 @@ private:
             m_map.getGC().enqueue(&MemoryReclaimer::destroy, new MemoryReclaimer(tile));
         }
 
-        m_map.getGC().unlockRawPointerAccess();
+        m_map.getGC().unlockRawPointerAccess(gcToken);
 
         m_map.getGC().update();
         return wasDeleted;
@@ -297,9 +298,9 @@ typename KisTileHashTableTraits2<T>::TileTypeSP KisTileHashTableTraits2<T>::getE
 {
     quint32 idx = calculateHash(col, row);
 
-    m_map.getGC().lockRawPointerAccess();
+    const int gcToken = m_map.getGC().lockRawPointerAccess();
     TileTypeSP tile = m_map.get(idx);
-    m_map.getGC().unlockRawPointerAccess();
+    m_map.getGC().unlockRawPointerAccess(gcToken);
 
     m_map.getGC().update();
     return tile;
@@ -313,14 +314,14 @@ typename KisTileHashTableTraits2<T>::TileTypeSP KisTileHashTableTraits2<T>::getT
 
     // we are going to assign a raw-pointer tile from the table
     // to a shared pointer...
-    m_map.getGC().lockRawPointerAccess();
+    int gcToken = m_map.getGC().lockRawPointerAccess();
 
     TileTypeSP tile = m_map.get(idx);
 
     while (!tile) {
         // we shouldn't try to acquire **any** lock with
         // raw-pointer lock held
-        m_map.getGC().unlockRawPointerAccess();
+        m_map.getGC().unlockRawPointerAccess(gcToken);
 
         {
             QReadLocker locker(&m_defaultPixelDataLock);
@@ -335,7 +336,7 @@ typename KisTileHashTableTraits2<T>::TileTypeSP KisTileHashTableTraits2<T>::getT
         m_iteratorLock.lockForRead();
 
         // and now lock raw-pointers again
-        m_map.getGC().lockRawPointerAccess();
+        gcToken = m_map.getGC().lockRawPointerAccess();
 
         // mutator might have become invalidated when
         // we released raw pointers, so we need to reinitialize it
@@ -367,7 +368,7 @@ typename KisTileHashTableTraits2<T>::TileTypeSP KisTileHashTableTraits2<T>::getT
             tile->notifyAttachedToDataManager(m_mementoManager);
         }
     }
-    m_map.getGC().unlockRawPointerAccess();
+    m_map.getGC().unlockRawPointerAccess(gcToken);
 
     m_map.getGC().update();
     return tile;
@@ -378,9 +379,9 @@ typename KisTileHashTableTraits2<T>::TileTypeSP KisTileHashTableTraits2<T>::getR
 {
     quint32 idx = calculateHash(col, row);
 
-    m_map.getGC().lockRawPointerAccess();
+    const int gcToken = m_map.getGC().lockRawPointerAccess();
     TileTypeSP tile = m_map.get(idx);
-    m_map.getGC().unlockRawPointerAccess();
+    m_map.getGC().unlockRawPointerAccess(gcToken);
 
     existingTile = tile;
 
@@ -423,14 +424,14 @@ void KisTileHashTableTraits2<T>::clear()
         TileType *tile = 0;
 
         while (iter.isValid()) {
-            m_map.getGC().lockRawPointerAccess();
+            const int gcToken = m_map.getGC().lockRawPointerAccess();
             tile = m_map.erase(iter.getKey());
 
             if (tile) {
                 tile->notifyDetachedFromDataManager();
                 m_map.getGC().enqueue(&MemoryReclaimer::destroy, new MemoryReclaimer(tile));
             }
-            m_map.getGC().unlockRawPointerAccess();
+            m_map.getGC().unlockRawPointerAccess(gcToken);
 
             iter.next();
         }
@@ -475,8 +476,4 @@ void KisTileHashTableTraits2<T>::debugMaxListLength(qint32 &/*min*/, qint32 &/*m
 {
 }
 
-typedef KisTileHashTableTraits2<KisTile> KisTileHashTable;
-typedef KisTileHashTableIteratorTraits2<KisTile> KisTileHashTableIterator;
-typedef KisTileHashTableIteratorTraits2<KisTile> KisTileHashTableConstIterator;
-
 #endif // KIS_TILEHASHTABLE_2_H
@@ -283,7 +283,12 @@ void KisTiledDataManager::purge(const QRect& area)
         while ((tile = iter.tile())) {
             if (tile->extent().intersects(area)) {
                 tile->lockForRead();
-                if(memcmp(defaultData, tile->data(), tileDataSize) == 0) {
+
+                // uniform tiles need only the first pixel to be checked
+                const qint32 compareSize = tile->tileData()->isUniform() ?
+                    pixelSize() : tileDataSize;
+
+                if(memcmp(defaultData, tile->data(), compareSize) == 0) {
                     tilesToDelete.push_back(tile);
                 }
                 tile->unlockForRead();
@@ -682,6 +687,21 @@ KisRegion KisTiledDataManager::region() const
     return KisRegion(std::move(rects));
 }
 
+QVector<KisTileSP> KisTiledDataManager::tiles() const
+{
+    QVector<KisTileSP> result;
+
+    KisTileHashTableConstIterator iter(m_hashTable);
+    KisTileSP tile;
+
+    while ((tile = iter.tile())) {
+        result << tile;
+        iter.next();
+    }
+
+    return result;
+}
+
 void KisTiledDataManager::setPixel(qint32 x, qint32 y, const quint8 * data)
 {
     KisTileDataWrapper tw(this, x, y, KisTileDataWrapper::WRITE);
@@ -25,16 +25,11 @@
 
 #include <kis_shared.h>
 #include <kis_shared_ptr.h>
-#include "config-hash-table-implementaion.h"
 
 //#include "kis_debug.h"
 #include "kritaimage_export.h"
 
-#ifdef USE_LOCK_FREE_HASH_TABLE
-#include "kis_tile_hash_table2.h"
-#else
-#include "kis_tile_hash_table.h"
-#endif // USE_LOCK_FREE_HASH_TABLE
+#include "KisTileHashTableDispatcher.h"
 
 #include "kis_memento_manager.h"
 #include "kis_memento.h"
@@ -228,6 +223,11 @@ public:
 
     KisRegion region() const;
 
+    /**
+     * \return all the tiles currently present in the data manager
+     */
+    QVector<KisTileSP> tiles() const;
+
     void clear(QRect clearRect, quint8 clearValue);
     void clear(QRect clearRect, const quint8 *clearPixel);
     void clear(qint32 x, qint32 y, qint32 w, qint32 h, quint8 clearValue);
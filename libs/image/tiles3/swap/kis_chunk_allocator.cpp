@@ -88,6 +88,38 @@ KisChunk KisChunkAllocator::getChunk(quint64 size)
     return KisChunk(m_list.end());
 }
 
+QVector<KisChunk> KisChunkAllocator::getChunks(const QVector<quint64> &sizes)
+{
+    QVector<KisChunk> chunks;
+    if (sizes.isEmpty()) return chunks;
+
+    quint64 totalSize = 0;
+    Q_FOREACH (quint64 size, sizes) {
+        totalSize += size;
+    }
+
+    KisChunk region = getChunk(totalSize);
+    KisChunkDataListIterator it = region.position();
+    quint64 begin = it->m_begin;
+
+    chunks.reserve(sizes.size());
+
+    /**
+     * Split the region into separate chunks. The new entries are
+     * inserted right before the region's one, so m_iterator (which
+     * points after the region) stays valid.
+     */
+    for (int i = 0; i < sizes.size() - 1; i++) {
+        chunks.append(KisChunk(m_list.insert(it, KisChunkData(begin, sizes[i]))));
+        begin += sizes[i];
+    }
+
+    it->setChunk(begin, sizes.last());
+    chunks.append(KisChunk(it));
+
+    return chunks;
+}
+
 bool KisChunkAllocator::tryInsertChunk(KisChunkDataList &list,
                                        KisChunkDataListIterator &iterator,
                                        quint64 size)
@@ -124,6 +156,31 @@ void KisChunkAllocator::freeChunk(KisChunk chunk)
     m_list.erase(chunk.position());
 }
 
+void KisChunkAllocator::freeChunk(KisChunk chunk, quint64 *gapBegin, quint64 *gapEnd)
+{
+    KisChunkDataListIterator it = chunk.position();
+
+    *gapBegin = HAS_PREVIOUS(m_list, it) ? PEEK_PREVIOUS(it).m_end + 1 : 0;
+
+    ++it;
+    *gapEnd = HAS_NEXT(m_list, it) ? PEEK_NEXT(it).m_begin : m_storeSize;
+
+    freeChunk(chunk);
+}
+
+quint64 KisChunkAllocator::usedSize() const
+{
+    return !m_list.isEmpty() ? m_list.last().m_end + 1 : 0;
+}
+
+quint64 KisChunkAllocator::shrinkStore()
+{
+    const quint64 numSlabs = qMax(1ULL, (usedSize() + m_storeSlabSize - 1) / m_storeSlabSize);
+    m_storeSize = numSlabs * m_storeSlabSize;
+
+    return m_storeSize;
+}
+
 
 
 /**************************************************************/
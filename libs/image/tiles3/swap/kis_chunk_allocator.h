@@ -20,6 +20,7 @@
 #define __KIS_CHUNK_LIST_H
 
 #include <QLinkedList>
+#include <QVector>
 #include "kritaimage_export.h"
 
 #define MiB (1ULL << 20)
@@ -139,6 +140,52 @@ public:
     KisChunk getChunk(quint64 size);
     void freeChunk(KisChunk chunk);
 
+    /**
+     * Allocates a continuous region for several chunks of sizes
+     * \p sizes, which are placed one after another. It lets the
+     * swap store write a batch of tiles with a single sequential
+     * write. The chunks can be freed independently afterwards.
+     */
+    QVector<KisChunk> getChunks(const QVector<quint64> &sizes);
+
+    /**
+     * Frees the \p chunk and reports the boundaries of the whole
+     * free space that surrounds it (including the chunk itself)
+     * in a form of a half-open interval [\p gapBegin, \p gapEnd).
+     * The swap store uses this information to give the freed disk
+     * space back to the file system.
+     */
+    void freeChunk(KisChunk chunk, quint64 *gapBegin, quint64 *gapEnd);
+
+    /**
+     * Moves the chunks towards the beginning of the store, closing
+     * the gaps between them. The chunks never change their order in
+     * the list, so all the existing KisChunk objects stay valid and
+     * just point to the new position of the data.
+     *
+     * \p moveFunc is called for every chunk as moveFunc(oldBegin,
+     * newBegin, size) and must copy the actual data. If it returns
+     * false, the chunk is left in place and the pass is stopped. The
+     * pass also stops as soon as \p maxBytesToMove bytes have been
+     * moved.
+     *
+     * \return the number of bytes moved
+     */
+    template <typename MoveFunc>
+    quint64 compact(quint64 maxBytesToMove, MoveFunc moveFunc);
+
+    /**
+     * Shrinks the size of the store down to the last used slab.
+     * \return the new size of the store
+     */
+    quint64 shrinkStore();
+
+    /**
+     * \return the offset of the first byte after the last
+     *         allocated chunk
+     */
+    quint64 usedSize() const;
+
     void debugChunks();
     bool sanityCheck(bool pleaseCrash = true);
     qreal debugFragmentation(bool toStderr = true);
@@ -159,5 +206,29 @@ private:
     DECLARE_FAIL_COUNTER()
 };
 
+template <typename MoveFunc>
+quint64 KisChunkAllocator::compact(quint64 maxBytesToMove, MoveFunc moveFunc)
+{
+    quint64 bytesMoved = 0;
+    quint64 freePosition = 0;
+
+    for (KisChunkDataListIterator it = m_list.begin();
+         it != m_list.end() && bytesMoved < maxBytesToMove;
+         ++it) {
+
+        if (it->m_begin > freePosition) {
+            const quint64 size = it->size();
+            if (!moveFunc(it->m_begin, freePosition, size)) break;
+
+            it->setChunk(freePosition, size);
+            bytesMoved += size;
+        }
+
+        freePosition = it->m_end + 1;
+    }
+
+    return bytesMoved;
+}
+
 #endif /* __KIS_CHUNK_ALLOCATOR_H */
 
@@ -20,12 +20,45 @@
 #include "kis_memory_window.h"
 
 #include <QDir>
+#include <limits>
+
+#if defined Q_OS_LINUX || defined Q_OS_MACOS
+#include <fcntl.h>
+#include <errno.h>
+#endif
 
 #define SWP_PREFIX "KRITA_SWAP_FILE_XXXXXX"
 
+/**
+ * The holes are punched with page granularity only
+ */
+#define HOLE_ALIGNMENT 4096ULL
+#define ALIGN_DOWN(value) ((value) & ~(HOLE_ALIGNMENT - 1))
+#define ALIGN_UP(value) ALIGN_DOWN((value) + HOLE_ALIGNMENT - 1)
+
+/**
+ * The neighbouring segments overlap by this value, so that
+ * the usual tile chunks would never need a separate mapping
+ */
+#define MAX_SEGMENT_OVERLAP (1*MiB)
+
+/**
+ * On 32-bit systems we cannot afford mapping the whole swap file,
+ * so the number of simultaneously mapped segments is limited
+ */
+#define MAX_MAPPED_SIZE_32BIT (256*MiB)
+
+
 KisMemoryWindow::KisMemoryWindow(const QString &swapDir, quint64 writeWindowSize)
-    : m_readWindowEx(writeWindowSize / 4),
-      m_writeWindowEx(writeWindowSize)
+    : m_canPunchHoles(true),
+      m_numRemaps(0),
+      m_segmentSize(writeWindowSize),
+      m_segmentOverlap(qMin(writeWindowSize, MAX_SEGMENT_OVERLAP)),
+      m_maxMappedSegments(sizeof(void*) > 4 ?
+                          std::numeric_limits<int>::max() :
+                          qMax(1, int(MAX_MAPPED_SIZE_32BIT / (writeWindowSize + MAX_SEGMENT_OVERLAP)))),
+      m_numMappedSegments(0),
+      m_oversizedWindow(0)
 {
     m_valid = true;
 
@@ -61,76 +94,125 @@ KisMemoryWindow::~KisMemoryWindow()
 
 quint8* KisMemoryWindow::getReadChunkPtr(const KisChunkData &readChunk)
 {
-    if (!adjustWindow(readChunk, &m_readWindowEx, &m_writeWindowEx)) {
-        return nullptr;
-    }
-
-    return m_readWindowEx.calculatePointer(readChunk);
+    return getChunkPtr(readChunk);
 }
 
 quint8* KisMemoryWindow::getWriteChunkPtr(const KisChunkData &writeChunk)
 {
-    if (!adjustWindow(writeChunk, &m_writeWindowEx, &m_readWindowEx)) {
+    return getChunkPtr(writeChunk);
+}
+
+quint8* KisMemoryWindow::getChunkPtr(const KisChunkData &chunk)
+{
+    if (!m_valid) return nullptr;
+
+    const int index = chunk.m_begin / m_segmentSize;
+    const quint64 segmentBegin = index * m_segmentSize;
+    const quint64 segmentEnd = segmentBegin + m_segmentSize + m_segmentOverlap;
+
+    if (chunk.m_end < segmentEnd) {
+        quint8 *segment = mapSegment(index);
+        return segment ? segment + chunk.m_begin - segmentBegin : nullptr;
+    }
+
+    if (!adjustWindow(chunk, &m_oversizedWindow)) {
         return nullptr;
     }
 
-    return m_writeWindowEx.calculatePointer(writeChunk);
+    return m_oversizedWindow.calculatePointer(chunk);
 }
 
-bool KisMemoryWindow::adjustWindow(const KisChunkData &requestedChunk,
-                                   MappingWindow *adjustingWindow,
-                                   MappingWindow *otherWindow)
+quint8* KisMemoryWindow::mapSegment(int index)
 {
-    if(!(adjustingWindow->window) ||
-       !(requestedChunk.m_begin >= adjustingWindow->chunk.m_begin &&
-         requestedChunk.m_end <= adjustingWindow->chunk.m_end))
-    {
-        m_file.unmap(adjustingWindow->window);
-
-        quint64 windowSize = adjustingWindow->defaultSize;
-        if(requestedChunk.size() > windowSize) {
-            warnKrita <<
-                "KisMemoryWindow: the requested chunk is too "
-                "big to fit into the mapping! "
-                "Adjusting mapping to avoid SIGSEGV...";
+    if (index >= m_segments.size()) {
+        m_segments.resize(index + 1);
+    }
 
-            windowSize = requestedChunk.size();
+    if (!m_segments[index]) {
+        if (m_numMappedSegments >= m_maxMappedSegments) {
+            unmapAll();
         }
 
-        adjustingWindow->chunk.setChunk(requestedChunk.m_begin, windowSize);
+        const quint64 offset = index * m_segmentSize;
+        const quint64 size = m_segmentSize + m_segmentOverlap;
 
-        if(adjustingWindow->chunk.m_end >= (quint64)m_file.size()) {
-            // Align by 32 bytes
-            quint64 newSize = (adjustingWindow->chunk.m_end + 1 + 32) & (~31ULL);
+        if (!ensureFileSize(offset + size)) {
+            return nullptr;
+        }
 
-#ifdef Q_OS_WIN32
-            /**
-             * Workaround for Qt's "feature"
-             *
-             * On windows QFSEnginePrivate caches the value of
-             * mapHandle which is limited to the size of the file at
-             * the moment of its (handle's) creation. That is we will
-             * not be able to use it after resizing the file.  The
-             * only way to free the handle is to release all the
-             * mappings we have. Sad but true.
-             */
-            if (otherWindow->chunk.size()) {
-                m_file.unmap(otherWindow->window);
-            }
-#else
-            Q_UNUSED(otherWindow);
+#ifdef Q_OS_UNIX
+        // A workaround for https://bugreports.qt-project.org/browse/QTBUG-6330
+        m_file.exists();
 #endif
 
-            if (!m_file.resize(newSize)) {
-                return false;
-            }
+        m_segments[index] = m_file.map(offset, size);
+
+        if (m_segments[index]) {
+            m_numMappedSegments++;
+            m_numRemaps++;
+        }
+    }
+
+    return m_segments[index];
+}
+
+bool KisMemoryWindow::ensureFileSize(quint64 size)
+{
+    if (size <= (quint64)m_file.size()) return true;
+
+    // Align by 32 bytes
+    quint64 newSize = (size + 32) & (~31ULL);
 
 #ifdef Q_OS_WIN32
-            if (otherWindow->chunk.size()) {
-                otherWindow->window = m_file.map(otherWindow->chunk.m_begin,
-                                                 otherWindow->chunk.size());
-            }
+    /**
+     * Workaround for Qt's "feature"
+     *
+     * On windows QFSEnginePrivate caches the value of
+     * mapHandle which is limited to the size of the file at
+     * the moment of its (handle's) creation. That is we will
+     * not be able to use it after resizing the file.  The
+     * only way to free the handle is to release all the
+     * mappings we have. Sad but true.
+     */
+    unmapAll();
 #endif
+
+    return m_file.resize(newSize);
+}
+
+void KisMemoryWindow::unmapAll()
+{
+    for (int i = 0; i < m_segments.size(); i++) {
+        if (m_segments[i]) {
+            m_file.unmap(m_segments[i]);
+            m_segments[i] = 0;
+        }
+    }
+    m_numMappedSegments = 0;
+
+    if (m_oversizedWindow.window) {
+        m_file.unmap(m_oversizedWindow.window);
+        m_oversizedWindow.window = 0;
+    }
+}
+
+bool KisMemoryWindow::adjustWindow(const KisChunkData &requestedChunk,
+                                   MappingWindow *adjustingWindow)
+{
+    if(!(adjustingWindow->window) ||
+       !(requestedChunk.m_begin >= adjustingWindow->chunk.m_begin &&
+         requestedChunk.m_end <= adjustingWindow->chunk.m_end))
+    {
+        if (adjustingWindow->window) {
+            m_file.unmap(adjustingWindow->window);
+            adjustingWindow->window = 0;
+        }
+
+        const quint64 windowSize = qMax(adjustingWindow->defaultSize, requestedChunk.size());
+        adjustingWindow->chunk.setChunk(requestedChunk.m_begin, windowSize);
+
+        if (!ensureFileSize(adjustingWindow->chunk.m_end + 1)) {
+            return false;
         }
 
 #ifdef Q_OS_UNIX
@@ -144,7 +226,68 @@ bool KisMemoryWindow::adjustWindow(const KisChunkData &requestedChunk,
         if (!adjustingWindow->window) {
             return false;
         }
+
+        m_numRemaps++;
+    }
+
+    return true;
+}
+
+void KisMemoryWindow::punchHole(quint64 begin, quint64 end, quint64 hintBegin, quint64 hintEnd)
+{
+    if (!m_valid || !m_canPunchHoles) return;
+
+    const quint64 holeBegin = qMax(ALIGN_UP(begin), ALIGN_DOWN(hintBegin));
+    const quint64 holeEnd = qMin(qMin(ALIGN_DOWN(end), ALIGN_UP(hintEnd)), fileSize());
+
+    if (holeBegin >= holeEnd) return;
+
+#if defined Q_OS_LINUX
+    if (fallocate(m_file.handle(),
+                  FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  holeBegin, holeEnd - holeBegin) < 0) {
+
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            m_canPunchHoles = false;
+        }
     }
+#elif defined Q_OS_MACOS && defined F_PUNCHHOLE
+    fpunchhole_t args;
+    args.fp_flags = 0;
+    args.reserved = 0;
+    args.fp_offset = holeBegin;
+    args.fp_length = holeEnd - holeBegin;
+
+    if (fcntl(m_file.handle(), F_PUNCHHOLE, &args) < 0) {
+        if (errno == ENOTSUP) {
+            m_canPunchHoles = false;
+        }
+    }
+#else
+    m_canPunchHoles = false;
+#endif
+}
+
+bool KisMemoryWindow::shrinkFile(quint64 newSize)
+{
+    if (!m_valid || newSize >= fileSize()) return true;
+
+    /**
+     * The mappings may point beyond the end of the file,
+     * so just drop all of them. They will be recreated
+     * on the next access.
+     */
+    unmapAll();
 
-	return true;
+    return m_file.resize(newSize);
+}
+
+quint64 KisMemoryWindow::fileSize() const
+{
+    return m_file.size();
+}
+
+quint64 KisMemoryWindow::numRemaps() const
+{
+    return m_numRemaps;
 }
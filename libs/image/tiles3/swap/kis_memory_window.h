@@ -20,18 +20,32 @@
 #define __KIS_MEMORY_WINDOW_H
 
 #include <QTemporaryFile>
+#include <QVector>
 
 #include "kis_chunk_allocator.h"
 
 
 #define DEFAULT_WINDOW_SIZE (16*MiB)
 
+/**
+ * Maps the swap file into memory. The file is mapped in big
+ * segments that stay mapped for the whole lifetime of the object,
+ * so swapping a tile in or out usually needs no remapping at all.
+ * The neighbouring segments overlap a bit, so a chunk crossing the
+ * segment border can still be accessed through a single pointer.
+ * Only the chunks that are bigger than the overlap and cross the
+ * border are mapped separately.
+ *
+ * The freed ranges of the file can be given back to the file system
+ * with punchHole(), so the file becomes sparse, and the unused tail
+ * of the file can be cut off with shrinkFile().
+ */
 class KRITAIMAGE_EXPORT KisMemoryWindow
 {
 public:
     /**
      * @param swapDir If the dir doesn't exist, it'll be created, if it's empty QDir::tempPath will be used.
-     * @param writeWindowSize write window size.
+     * @param writeWindowSize the size of the mapped segments of the file.
      */
     KisMemoryWindow(const QString &swapDir, quint64 writeWindowSize = DEFAULT_WINDOW_SIZE);
     ~KisMemoryWindow();
@@ -47,6 +61,32 @@ public:
     quint8* getReadChunkPtr(const KisChunkData &readChunk);
     quint8* getWriteChunkPtr(const KisChunkData &writeChunk);
 
+    /**
+     * Tells the file system that the range [\p begin, \p end) of
+     * the file contains no useful data anymore, so the disk space
+     * can be deallocated. Only the pages lying completely inside
+     * the range and overlapping [\p hintBegin, \p hintEnd) are
+     * deallocated. Does nothing if the file system doesn't support
+     * sparse files.
+     */
+    void punchHole(quint64 begin, quint64 end, quint64 hintBegin, quint64 hintEnd);
+
+    /**
+     * Truncates the file to \p newSize bytes, if it is bigger
+     */
+    bool shrinkFile(quint64 newSize);
+
+    /**
+     * The current size of the swap file (including holes)
+     */
+    quint64 fileSize() const;
+
+    /**
+     * The number of the mappings created since the creation
+     * of the window
+     */
+    quint64 numRemaps() const;
+
 private:
     struct MappingWindow {
         MappingWindow(quint64 _defaultSize)
@@ -67,16 +107,28 @@ private:
 
 
 private:
+    quint8* getChunkPtr(const KisChunkData &chunk);
+    quint8* mapSegment(int index);
+    bool ensureFileSize(quint64 size);
+    void unmapAll();
+
     bool adjustWindow(const KisChunkData &requestedChunk,
-                      MappingWindow *adjustingWindow,
-                      MappingWindow *otherWindow);
+                      MappingWindow *adjustingWindow);
 
 private:
     QTemporaryFile m_file;
 
     bool m_valid;
-    MappingWindow m_readWindowEx;
-    MappingWindow m_writeWindowEx;
+    bool m_canPunchHoles;
+    quint64 m_numRemaps;
+
+    const quint64 m_segmentSize;
+    const quint64 m_segmentOverlap;
+    const int m_maxMappedSegments;
+    int m_numMappedSegments;
+    QVector<quint8*> m_segments;
+
+    MappingWindow m_oversizedWindow;
 };
 
 #endif /* __KIS_MEMORY_WINDOW_H */
@@ -21,12 +21,19 @@
 #include "kis_memory_window.h"
 #include "kis_image_config.h"
 
-#include "kis_tile_compressor_2.h"
+#include "kis_tile_compressor_factory.h"
 
-//#define COMPRESSOR_VERSION 2
+#include <QtConcurrent>
 
 KisSwappedDataStore::KisSwappedDataStore()
-    : m_memoryMetric(0)
+    : m_memoryMetric(0),
+      m_numSwappedOutTiles(0),
+      m_numSwapBatches(0),
+      m_nextSequenceNumber(0),
+      m_compressedMemorySize(0),
+      m_compressedOriginalSize(0),
+      m_compressedMemoryMetric(0),
+      m_numCompressedTiles(0)
 {
     KisImageConfig config(true);
     const quint64 maxSwapSize = config.maxSwapSize() * MiB;
@@ -36,13 +43,26 @@ KisSwappedDataStore::KisSwappedDataStore()
     m_allocator = new KisChunkAllocator(swapSlabSize, maxSwapSize);
     m_swapSpace = new KisMemoryWindow(config.swapDir(), swapWindowSize);
 
-    // FIXME: use a factory after the patch is committed
-    m_compressor = new KisTileCompressor2();
+    m_compressor = KisTileCompressorFactory::createForSwap(config.swapCompressionAlgorithm(),
+                                                           config.swapCompressionLevel());
+
+    /**
+     * The compressors keep their internal buffers, so every
+     * compression thread needs a separate one
+     */
+    const int numThreads = config.swapperThreadCount();
+    for (int i = 0; i < numThreads; i++) {
+        m_batchCompressors.append(
+            KisTileCompressorFactory::createForSwap(config.swapCompressionAlgorithm(),
+                                                    config.swapCompressionLevel()));
+    }
+
+    // the calling thread compresses its own share of the batch
+    m_compressionPool.setMaxThreadCount(qMax(1, numThreads - 1));
 }
 
 KisSwappedDataStore::~KisSwappedDataStore()
 {
-    delete m_compressor;
     delete m_swapSpace;
     delete m_allocator;
 }
@@ -52,7 +72,7 @@ quint64 KisSwappedDataStore::numTiles() const
     // We are not acquiring the lock here...
     // Hope QLinkedList will ensure atomic access to it's size...
 
-    return m_allocator->numChunks();
+    return m_allocator->numChunks() + m_numCompressedTiles.loadAcquire();
 }
 
 bool KisSwappedDataStore::trySwapOutTileData(KisTileData *td)
@@ -85,10 +105,217 @@ bool KisSwappedDataStore::trySwapOutTileData(KisTileData *td)
     td->setSwapChunk(chunk);
 
     m_memoryMetric += td->pixelSize();
+    m_numSwappedOutTiles++;
+    m_numSwapBatches++;
 
     return true;
 }
 
+void KisSwappedDataStore::compressBatch(const QVector<KisTileData*> &tiles, QVector<quint64> &sizes)
+{
+    const int numTiles = tiles.size();
+    const int numJobs = qMin(m_batchCompressors.size(), numTiles);
+
+    if (m_batchBuffers.size() < numTiles) {
+        m_batchBuffers.resize(numTiles);
+    }
+
+    sizes.resize(numTiles);
+
+    QByteArray *buffers = m_batchBuffers.data();
+    quint64 *sizesPtr = sizes.data();
+
+    auto compressJob = [this, &tiles, buffers, sizesPtr, numTiles, numJobs] (int job) {
+        KisAbstractTileCompressor *compressor = m_batchCompressors.at(job).data();
+
+        for (int i = job; i < numTiles; i += numJobs) {
+            KisTileData *td = tiles[i];
+            Q_ASSERT(td->data());
+
+            const qint32 expectedBufferSize = compressor->tileDataBufferSize(td);
+            if (buffers[i].size() < expectedBufferSize) {
+                buffers[i].resize(expectedBufferSize);
+            }
+
+            qint32 bytesWritten = 0;
+            compressor->compressTileData(td, (quint8*) buffers[i].data(), buffers[i].size(), bytesWritten);
+            sizesPtr[i] = bytesWritten;
+        }
+    };
+
+    QVector<QFuture<void>> jobs;
+    for (int job = 1; job < numJobs; job++) {
+        jobs.append(QtConcurrent::run(&m_compressionPool, compressJob, job));
+    }
+
+    compressJob(0);
+
+    Q_FOREACH (QFuture<void> job, jobs) {
+        job.waitForFinished();
+    }
+}
+
+bool KisSwappedDataStore::trySwapOutTileDataBatch(const QVector<KisTileData*> &tiles)
+{
+    if (tiles.isEmpty()) return true;
+
+    QMutexLocker batchLocker(&m_batchLock);
+
+    const int numTiles = tiles.size();
+
+    QVector<quint64> sizes;
+    compressBatch(tiles, sizes);
+
+    const QByteArray *buffers = m_batchBuffers.constData();
+
+    QMutexLocker locker(&m_lock);
+
+    const QVector<KisChunk> chunks = m_allocator->getChunks(sizes);
+
+    const quint64 regionBegin = chunks.first().begin();
+    const quint64 regionSize = chunks.last().end() + 1 - regionBegin;
+
+    quint8 *ptr = m_swapSpace->getWriteChunkPtr(KisChunkData(regionBegin, regionSize));
+    if (!ptr) {
+        qWarning() << "swap out of a batch of tiles failed";
+
+        Q_FOREACH (KisChunk chunk, chunks) {
+            freeChunk(chunk);
+        }
+        return false;
+    }
+
+    for (int i = 0; i < numTiles; i++) {
+        KisTileData *td = tiles[i];
+
+        memcpy(ptr, buffers[i].constData(), sizes[i]);
+        ptr += sizes[i];
+
+        td->releaseMemory();
+        td->setSwapChunk(chunks[i]);
+
+        m_memoryMetric += td->pixelSize();
+    }
+
+    m_numSwappedOutTiles += numTiles;
+    m_numSwapBatches++;
+
+    return true;
+}
+
+qint64 KisSwappedDataStore::compressTileDataBatch(const QVector<KisTileData*> &tiles)
+{
+    if (tiles.isEmpty()) return 0;
+
+    QMutexLocker batchLocker(&m_batchLock);
+
+    QVector<quint64> sizes;
+    compressBatch(tiles, sizes);
+
+    QMutexLocker locker(&m_lock);
+
+    qint64 compressedSize = 0;
+
+    for (int i = 0; i < tiles.size(); i++) {
+        KisTileData *td = tiles[i];
+
+        CompressedTile tile;
+        tile.data = QByteArray(m_batchBuffers[i].constData(), int(sizes[i]));
+        tile.sequenceNumber = m_nextSequenceNumber++;
+
+        m_compressedTiles.insert(td, tile);
+        m_compressionQueue.insert(tile.sequenceNumber, td);
+        m_numCompressedTiles.ref();
+
+        td->releaseMemory();
+
+        m_memoryMetric += td->pixelSize();
+        m_compressedOriginalSize += td->pixelSize() * KisTileData::WIDTH * KisTileData::HEIGHT;
+        compressedSize += sizes[i];
+    }
+
+    m_compressedMemorySize += compressedSize;
+    updateCompressedMemoryMetric();
+
+    return compressedSize;
+}
+
+qint64 KisSwappedDataStore::spillCompressedTiles(qint64 maxBytesToSpill)
+{
+    QMutexLocker locker(&m_lock);
+
+    QVector<KisTileData*> tiles;
+    QVector<quint64> sizes;
+    qint64 spilledSize = 0;
+
+    for (auto it = m_compressionQueue.constBegin();
+         it != m_compressionQueue.constEnd() && spilledSize < maxBytesToSpill;
+         ++it) {
+
+        const int size = m_compressedTiles.value(it.value()).data.size();
+
+        tiles.append(it.value());
+        sizes.append(size);
+        spilledSize += size;
+    }
+
+    if (tiles.isEmpty()) return 0;
+
+    const QVector<KisChunk> chunks = m_allocator->getChunks(sizes);
+
+    const quint64 regionBegin = chunks.first().begin();
+    const quint64 regionSize = chunks.last().end() + 1 - regionBegin;
+
+    quint8 *ptr = m_swapSpace->getWriteChunkPtr(KisChunkData(regionBegin, regionSize));
+    if (!ptr) {
+        qWarning() << "spilling of compressed tiles to the swap file failed";
+
+        Q_FOREACH (KisChunk chunk, chunks) {
+            freeChunk(chunk);
+        }
+        return 0;
+    }
+
+    /**
+     * The tiles are already compressed, so we just write them
+     * to the swap file as they are. The tile data objects are not
+     * touched, except for their swap chunks, which are accessed
+     * under m_lock only.
+     */
+    for (int i = 0; i < tiles.size(); i++) {
+        KisTileData *td = tiles[i];
+
+        CompressedTilesHash::iterator it = m_compressedTiles.find(td);
+        memcpy(ptr, it->data.constData(), sizes[i]);
+        ptr += sizes[i];
+
+        forgetCompressedTile(it);
+        td->setSwapChunk(chunks[i]);
+    }
+
+    m_numSwappedOutTiles += tiles.size();
+    m_numSwapBatches++;
+
+    return spilledSize;
+}
+
+void KisSwappedDataStore::updateCompressedMemoryMetric()
+{
+    const qint64 tileArea = KisTileData::WIDTH * KisTileData::HEIGHT;
+    m_compressedMemoryMetric.storeRelease(int((m_compressedMemorySize + tileArea - 1) / tileArea));
+}
+
+void KisSwappedDataStore::forgetCompressedTile(CompressedTilesHash::iterator it)
+{
+    m_numCompressedTiles.deref();
+    m_compressionQueue.remove(it->sequenceNumber);
+    m_compressedMemorySize -= it->data.size();
+    m_compressedOriginalSize -= it.key()->pixelSize() * KisTileData::WIDTH * KisTileData::HEIGHT;
+    updateCompressedMemoryMetric();
+
+    m_compressedTiles.erase(it);
+}
+
 void KisSwappedDataStore::swapInTileData(KisTileData *td)
 {
     Q_ASSERT(!td->data());
@@ -96,6 +323,16 @@ void KisSwappedDataStore::swapInTileData(KisTileData *td)
 
     // see comment in swapOutTileData()
 
+    CompressedTilesHash::iterator it = m_compressedTiles.find(td);
+    if (it != m_compressedTiles.end()) {
+        td->allocateMemory();
+        m_compressor->decompressTileData((quint8*) it->data.data(), it->data.size(), td);
+        forgetCompressedTile(it);
+
+        m_memoryMetric -= td->pixelSize();
+        return;
+    }
+
     KisChunk chunk = td->swapChunk();
 
     td->allocateMemory();
@@ -104,7 +341,7 @@ void KisSwappedDataStore::swapInTileData(KisTileData *td)
     quint8 *ptr = m_swapSpace->getReadChunkPtr(chunk);
     Q_ASSERT(ptr);
     m_compressor->decompressTileData(ptr, chunk.size(), td);
-    m_allocator->freeChunk(chunk);
+    freeChunk(chunk);
 
     m_memoryMetric -= td->pixelSize();
 }
@@ -113,19 +350,115 @@ void KisSwappedDataStore::forgetTileData(KisTileData *td)
 {
     QMutexLocker locker(&m_lock);
 
-    m_allocator->freeChunk(td->swapChunk());
-    td->setSwapChunk(KisChunk());
+    CompressedTilesHash::iterator it = m_compressedTiles.find(td);
+    if (it != m_compressedTiles.end()) {
+        forgetCompressedTile(it);
+    } else {
+        freeChunk(td->swapChunk());
+        td->setSwapChunk(KisChunk());
+    }
 
     m_memoryMetric -= td->pixelSize();
 }
 
+void KisSwappedDataStore::freeChunk(KisChunk chunk)
+{
+    const quint64 chunkBegin = chunk.begin();
+    const quint64 chunkEnd = chunk.end() + 1;
+
+    quint64 gapBegin = 0;
+    quint64 gapEnd = 0;
+    m_allocator->freeChunk(chunk, &gapBegin, &gapEnd);
+
+    /**
+     * Give the pages, that became free after the chunk
+     * has been released, back to the file system
+     */
+    m_swapSpace->punchHole(gapBegin, gapEnd, chunkBegin, chunkEnd);
+}
+
+quint64 KisSwappedDataStore::compact(quint64 maxBytesToMove)
+{
+    QMutexLocker locker(&m_lock);
+
+    /**
+     * The chunks are only moved towards the beginning of the file,
+     * so the source and destination ranges may overlap. That is
+     * why we copy the data through an intermediate buffer.
+     */
+    const quint64 bytesMoved = m_allocator->compact(maxBytesToMove,
+        [this] (quint64 oldBegin, quint64 newBegin, quint64 size) {
+            if ((quint64)m_buffer.size() < size) {
+                m_buffer.resize(int(size));
+            }
+
+            quint8 *src = m_swapSpace->getReadChunkPtr(KisChunkData(oldBegin, size));
+            if (!src) return false;
+            memcpy(m_buffer.data(), src, size);
+
+            quint8 *dst = m_swapSpace->getWriteChunkPtr(KisChunkData(newBegin, size));
+            if (!dst) return false;
+            memcpy(dst, m_buffer.data(), size);
+
+            return true;
+        });
+
+    if (bytesMoved < maxBytesToMove) {
+        const quint64 usedSize = m_allocator->usedSize();
+        const quint64 storeSize = m_allocator->shrinkStore();
+
+        m_swapSpace->punchHole(usedSize, storeSize, usedSize, storeSize);
+        m_swapSpace->shrinkFile(storeSize);
+    }
+
+    return bytesMoved;
+}
+
+quint64 KisSwappedDataStore::swapFileSize() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_swapSpace->fileSize();
+}
+
+qint64 KisSwappedDataStore::numSwappedOutTiles() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_numSwappedOutTiles;
+}
+
+qint64 KisSwappedDataStore::numSwapBatches() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_numSwapBatches;
+}
+
 qint64 KisSwappedDataStore::totalMemoryMetric() const
 {
     return m_memoryMetric;
 }
 
+qint64 KisSwappedDataStore::compressedMemorySize() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_compressedMemorySize;
+}
+
+qint64 KisSwappedDataStore::compressionSavedSize() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_compressedOriginalSize - m_compressedMemorySize;
+}
+
+qint64 KisSwappedDataStore::numCompressedTiles() const
+{
+    return m_numCompressedTiles.loadAcquire();
+}
+
 void KisSwappedDataStore::debugStatistics()
 {
     m_allocator->sanityCheck();
     m_allocator->debugFragmentation();
+
+    qInfo() << "Swap file size:\t\t" << m_swapSpace->fileSize();
+    qInfo() << "Swap file remaps:\t" << m_swapSpace->numRemaps();
 }
@@ -23,11 +23,17 @@
 
 #include <QMutex>
 #include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QThreadPool>
 
+#include <kis_shared_ptr.h>
 
 class QMutex;
 class KisTileData;
 class KisAbstractTileCompressor;
+class KisChunk;
 class KisChunkAllocator;
 class KisMemoryWindow;
 
@@ -50,6 +56,35 @@ public:
      */
     bool trySwapOutTileData(KisTileData *td);
 
+    /**
+     * Swap out a batch of tile data objects. The tiles are
+     * compressed in parallel and then written to the swap file
+     * with a single sequential write. Either all the tiles
+     * are swapped out or none of them.
+     * LOCKING: the locks on all the tile data objects should be
+     *          taken by the caller before making a call.
+     */
+    bool trySwapOutTileDataBatch(const QVector<KisTileData*> &tiles);
+
+    /**
+     * Compress a batch of tile data objects and keep the compressed
+     * data in memory. Such tiles can be swapped in much faster than
+     * the ones stored in the swap file. Returns the total size of the
+     * compressed data.
+     * LOCKING: the locks on all the tile data objects should be
+     *          taken by the caller before making a call.
+     */
+    qint64 compressTileDataBatch(const QVector<KisTileData*> &tiles);
+
+    /**
+     * Writes the tiles compressed in memory to the swap file, the
+     * oldest ones go first. At least \p maxBytesToSpill bytes of
+     * memory are freed if there are enough compressed tiles.
+     * Returns the number of bytes freed.
+     * LOCKING: the tile data objects need not be locked
+     */
+    qint64 spillCompressedTiles(qint64 maxBytesToSpill);
+
     /**
      * Restore the data of a \a td basing on information
      * stored in the swap file.
@@ -71,21 +106,106 @@ public:
      */
     qint64 totalMemoryMetric() const;
 
+    /**
+     * Returns the size of the memory occupied by the
+     * tiles compressed in memory
+     */
+    qint64 compressedMemorySize() const;
+
+    /**
+     * Returns the number of bytes saved by keeping the tiles
+     * compressed in memory, that is the difference between their
+     * uncompressed and compressed sizes
+     */
+    qint64 compressionSavedSize() const;
+
+    /**
+     * Returns the metric of the memory occupied by the tiles
+     * compressed in memory. Doesn't take any locks.
+     */
+    inline qint32 compressedMemoryMetric() const {
+        return m_compressedMemoryMetric.loadAcquire();
+    }
+
+    /**
+     * Returns the number of tiles compressed in memory
+     */
+    qint64 numCompressedTiles() const;
+
+    /**
+     * Moves the swapped data towards the beginning of the swap file
+     * and cuts off the unused tail of the file. The data is moved in
+     * portions of at most \p maxBytesToMove bytes, so that the swap
+     * would not be blocked for too long.
+     *
+     * \return the number of bytes moved. If it is less than
+     *         \p maxBytesToMove, the file is fully compacted.
+     */
+    quint64 compact(quint64 maxBytesToMove);
+
+    /**
+     * Returns the size of the swap file on disk (including holes)
+     */
+    quint64 swapFileSize() const;
+
+    /**
+     * Returns the total number of tiles written to the swap file
+     */
+    qint64 numSwappedOutTiles() const;
+
+    /**
+     * Returns the total number of batched writes to the swap file
+     */
+    qint64 numSwapBatches() const;
+
     /**
      * Some debugging output
      */
     void debugStatistics();
 
+private:
+    struct CompressedTile {
+        QByteArray data;
+        qint64 sequenceNumber;
+    };
+
+    typedef QHash<KisTileData*, CompressedTile> CompressedTilesHash;
+
+private:
+    void freeChunk(KisChunk chunk);
+    void compressBatch(const QVector<KisTileData*> &tiles, QVector<quint64> &sizes);
+    void forgetCompressedTile(CompressedTilesHash::iterator it);
+    void updateCompressedMemoryMetric();
+
 private:
     QByteArray m_buffer;
-    KisAbstractTileCompressor *m_compressor;
+    KisSharedPtr<KisAbstractTileCompressor> m_compressor;
 
     KisChunkAllocator *m_allocator;
     KisMemoryWindow *m_swapSpace;
 
-    QMutex m_lock;
+    mutable QMutex m_lock;
+
+    QMutex m_batchLock;
+    QThreadPool m_compressionPool;
+    QVector<KisSharedPtr<KisAbstractTileCompressor>> m_batchCompressors;
+    QVector<QByteArray> m_batchBuffers;
 
     qint64 m_memoryMetric;
+    qint64 m_numSwappedOutTiles;
+    qint64 m_numSwapBatches;
+
+    /**
+     * The tiles compressed in memory and the order
+     * they should be spilled to the swap file
+     */
+    CompressedTilesHash m_compressedTiles;
+    QMap<qint64, KisTileData*> m_compressionQueue;
+    qint64 m_nextSequenceNumber;
+    qint64 m_compressedMemorySize;
+    qint64 m_compressedOriginalSize;
+    QAtomicInt m_compressedMemoryMetric;
+    QAtomicInt m_numCompressedTiles;
 };
 
 #endif /* __KIS_SWAPPED_DATA_STORE_H */
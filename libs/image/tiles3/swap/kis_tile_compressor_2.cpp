@@ -19,20 +19,124 @@
 #include "kis_tile_compressor_2.h"
 #include "kis_lzf_compression.h"
 #include <QIODevice>
+#include <QStringList>
+#include <algorithm>
 #include "kis_paint_device_writer.h"
-#define TILE_DATA_SIZE(pixelSize) ((pixelSize) * KisTileData::WIDTH * KisTileData::HEIGHT)
+#include <config-tiles-compression.h>
+
+#ifdef HAVE_LZ4
+#include "kis_lz4_compression.h"
+#endif
+
+#ifdef HAVE_ZSTD
+#include "kis_zstd_compression.h"
+#endif
 
-const QString KisTileCompressor2::m_compressionName = "LZF";
+#define TILE_DATA_SIZE(pixelSize) ((pixelSize) * KisTileData::WIDTH * KisTileData::HEIGHT)
 
 
 KisTileCompressor2::KisTileCompressor2()
+    : KisTileCompressor2("LZF")
 {
-    m_compression = new KisLzfCompression();
+}
+
+KisTileCompressor2::KisTileCompressor2(const QString &compressionName, int compressionLevel)
+{
+    std::fill(m_decompressors, m_decompressors + NUM_DATA_FLAGS, nullptr);
+
+    m_compressionFlag = flagForCompressionName(compressionName);
+    m_compression = createCompression(m_compressionFlag, compressionLevel);
+
+    if (!m_compression) {
+        warnKrita << "KisTileCompressor2: compression" << compressionName
+                  << "is not available, falling back to LZF";
+
+        m_compressionFlag = COMPRESSED_DATA_FLAG;
+        m_compression = createCompression(m_compressionFlag, compressionLevel);
+    }
+
+    m_decompressors[m_compressionFlag] = m_compression;
+
+    m_compressionName =
+        m_compressionFlag == LZ4_COMPRESSED_DATA_FLAG ? "LZ4" :
+        m_compressionFlag == ZSTD_COMPRESSED_DATA_FLAG ? "ZSTD" :
+        "LZF";
 }
 
 KisTileCompressor2::~KisTileCompressor2()
 {
-    delete m_compression;
+    for (int i = 0; i < NUM_DATA_FLAGS; i++) {
+        delete m_decompressors[i];
+    }
+}
+
+QString KisTileCompressor2::compressionName() const
+{
+    return m_compressionName;
+}
+
+QStringList KisTileCompressor2::availableCompressions()
+{
+    QStringList result;
+    result << "LZF";
+#ifdef HAVE_LZ4
+    result << "LZ4";
+#endif
+#ifdef HAVE_ZSTD
+    result << "ZSTD";
+#endif
+    return result;
+}
+
+qint8 KisTileCompressor2::flagForCompressionName(const QString &compressionName)
+{
+    const QString name = compressionName.toUpper();
+
+    return
+        name == "LZ4" ? LZ4_COMPRESSED_DATA_FLAG :
+        name == "ZSTD" ? ZSTD_COMPRESSED_DATA_FLAG :
+        name == "LZF" ? COMPRESSED_DATA_FLAG :
+        RAW_DATA_FLAG;
+}
+
+KisAbstractCompression* KisTileCompressor2::createCompression(qint8 flag, int compressionLevel)
+{
+    Q_UNUSED(compressionLevel);
+
+    KisAbstractCompression *compression = 0;
+
+    switch (flag) {
+    case COMPRESSED_DATA_FLAG:
+        compression = new KisLzfCompression();
+        break;
+#ifdef HAVE_LZ4
+    case LZ4_COMPRESSED_DATA_FLAG:
+        compression = new KisLz4Compression();
+        break;
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD_COMPRESSED_DATA_FLAG:
+        compression = compressionLevel >= 0 ?
+            new KisZstdCompression(compressionLevel) :
+            new KisZstdCompression();
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return compression;
+}
+
+KisAbstractCompression* KisTileCompressor2::compressionForFlag(qint8 flag)
+{
+    if (flag <= RAW_DATA_FLAG || flag >= NUM_DATA_FLAGS) return 0;
+
+    if (!m_decompressors[flag]) {
+        m_decompressors[flag] = createCompression(flag, -1);
+    }
+
+    return m_decompressors[flag];
 }
 
 bool KisTileCompressor2::writeTile(KisTileSP tile, KisPaintDeviceWriter &store)
@@ -75,7 +179,11 @@ bool KisTileCompressor2::readTile(QIODevice *stream, KisTiledDataManager *dm)
         qint32 dataSize = headerItems.takeFirst().toInt();
 
         Q_ASSERT(headerItems.isEmpty());
-        Q_ASSERT(compressionName == m_compressionName);
+
+        if (!compressionForFlag(flagForCompressionName(compressionName))) {
+            warnFile << "Unsupported tile compression:" << compressionName;
+            return false;
+        }
 
         qint32 row = yToRow(dm, y);
         qint32 col = xToCol(dm, x);
@@ -129,8 +237,8 @@ void KisTileCompressor2::compressTileData(KisTileData *tileData,
     compressedBytes = m_compression->compress((quint8*)m_linearizationBuffer.data(), tileDataSize,
                                               (quint8*)m_compressionBuffer.data(), m_compressionBuffer.size());
 
-    if(compressedBytes < tileDataSize) {
-        buffer[0] = COMPRESSED_DATA_FLAG;
+    if(compressedBytes > 0 && compressedBytes < tileDataSize) {
+        buffer[0] = m_compressionFlag;
         memcpy(buffer + 1, m_compressionBuffer.data(), compressedBytes);
         bytesWritten = compressedBytes + 1;
     }
@@ -148,23 +256,25 @@ bool KisTileCompressor2::decompressTileData(quint8 *buffer,
     const qint32 pixelSize = tileData->pixelSize();
     const qint32 tileDataSize = TILE_DATA_SIZE(pixelSize);
 
-    if(buffer[0] == COMPRESSED_DATA_FLAG) {
+    if(buffer[0] == RAW_DATA_FLAG) {
+        memcpy(tileData->data(), buffer + 1, tileDataSize);
+        return true;
+    }
+
+    KisAbstractCompression *compression = compressionForFlag(buffer[0]);
+
+    if (compression) {
         prepareWorkBuffers(tileDataSize);
 
         qint32 bytesWritten;
-        bytesWritten = m_compression->decompress(buffer + 1, bufferSize - 1,
-                                                 (quint8*)m_linearizationBuffer.data(), tileDataSize);
+        bytesWritten = compression->decompress(buffer + 1, bufferSize - 1,
+                                               (quint8*)m_linearizationBuffer.data(), tileDataSize);
         if (bytesWritten == tileDataSize) {
             KisAbstractCompression::delinearizeColors((quint8*)m_linearizationBuffer.data(),
                                                       tileData->data(),
                                                       tileDataSize, pixelSize);
             return true;
         }
-        return false;
-    }
-    else {
-        memcpy(tileData->data(), buffer + 1, tileDataSize);
-        return true;
     }
     return false;
 
@@ -21,12 +21,40 @@
 
 #include "kis_abstract_tile_compressor.h"
 
+#include <QStringList>
+
 class KisAbstractCompression;
 
+/**
+ * Compressor of the second version of the tiles format. The tile
+ * data is linearized and then compressed with one of the supported
+ * algorithms. The algorithm used for every tile is recorded in the
+ * first byte of its compressed data, so the compressor can always
+ * decompress the data written with any other algorithm. It is
+ * important for the swap, because the user may change the algorithm
+ * while the old swap data is still alive.
+ *
+ * NOTE: only LZF compression is supported by older versions of
+ *       Krita, so the other algorithms should not be used for
+ *       writing files on disk, only for the swap.
+ */
 class KRITAIMAGE_EXPORT KisTileCompressor2 : public KisAbstractTileCompressor
 {
 public:
+    /**
+     * Creates a compressor using LZF algorithm, compatible with
+     * all versions of Krita
+     */
     KisTileCompressor2();
+
+    /**
+     * Creates a compressor using \p compressionName algorithm
+     * ("LZF", "LZ4" or "ZSTD"). If the algorithm is not available in
+     * the current build, LZF is used as a fallback. The \p compressionLevel
+     * is used by ZSTD algorithm only. Negative value means default level.
+     */
+    KisTileCompressor2(const QString &compressionName, int compressionLevel = -1);
+
     ~KisTileCompressor2() override;
 
     bool writeTile(KisTileSP tile, KisPaintDeviceWriter &store) override;
@@ -38,6 +66,16 @@ public:
     bool decompressTileData(quint8 *buffer, qint32 bufferSize, KisTileData *tileData) override;
     qint32 tileDataBufferSize(KisTileData *tileData) override;
 
+    /**
+     * The name of the algorithm actually used for compression
+     */
+    QString compressionName() const;
+
+    /**
+     * The list of the algorithms available in the current build
+     */
+    static QStringList availableCompressions();
+
 private:
     /**
      * Quite self describing
@@ -49,16 +87,26 @@ private:
     void prepareWorkBuffers(qint32 tileDataSize);
     void prepareStreamingBuffer(qint32 tileDataSize);
 
+    KisAbstractCompression* compressionForFlag(qint8 flag);
+
+    static qint8 flagForCompressionName(const QString &compressionName);
+    static KisAbstractCompression* createCompression(qint8 flag, int compressionLevel);
+
 private:
     static const qint8 RAW_DATA_FLAG = 0;
     static const qint8 COMPRESSED_DATA_FLAG = 1;
+    static const qint8 LZ4_COMPRESSED_DATA_FLAG = 2;
+    static const qint8 ZSTD_COMPRESSED_DATA_FLAG = 3;
+    static const qint8 NUM_DATA_FLAGS = 4;
 
 private:
     QByteArray m_linearizationBuffer;
     QByteArray m_compressionBuffer;
     QByteArray m_streamingBuffer;
     KisAbstractCompression *m_compression;
-    static const QString m_compressionName;
+    KisAbstractCompression *m_decompressors[NUM_DATA_FLAGS];
+    qint8 m_compressionFlag;
+    QString m_compressionName;
 };
 
 #endif /* __KIS_TILE_COMPRESSOR_2_H */
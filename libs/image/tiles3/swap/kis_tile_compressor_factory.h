@@ -39,6 +39,17 @@ public:
         };
     }
 
+    /**
+     * Creates a compressor for the swap. The data written by it
+     * is never saved into the files, so it may use any compression
+     * algorithm available in the current build.
+     *
+     * \see KisImageConfig::swapCompressionAlgorithm()
+     */
+    static KisAbstractTileCompressorSP createForSwap(const QString &compressionName, int compressionLevel = -1) {
+        return KisAbstractTileCompressorSP(new KisTileCompressor2(compressionName, compressionLevel));
+    }
+
 private:
     KisTileCompressorFactory();
 };
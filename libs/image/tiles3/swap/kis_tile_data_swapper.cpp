@@ -23,12 +23,14 @@
 #include "tiles3/kis_tile_data.h"
 #include "tiles3/kis_tile_data_store.h"
 #include "tiles3/kis_tile_data_store_iterators.h"
+#include "kis_image_config.h"
 #include "kis_debug.h"
 
 #define SEC 1000
 
 const qint32 KisTileDataSwapper::TIMEOUT = -1;
 const qint32 KisTileDataSwapper::DELAY = 0.7 * SEC;
+const quint64 KisTileDataSwapper::COMPACTION_PORTION = 8 * 1024 * 1024;
 
 //#define DEBUG_SWAPPER
 
@@ -49,9 +51,12 @@ struct Q_DECL_HIDDEN KisTileDataSwapper::Private
 public:
     QSemaphore semaphore;
     QAtomicInt shouldExitFlag;
+    QAtomicInt compactionRequested;
+    QAtomicInt historyCompressionRequested;
     KisTileDataStore *store;
     KisStoreLimits limits;
     QMutex cycleLock;
+    int batchSize;
 };
 
 KisTileDataSwapper::KisTileDataSwapper(KisTileDataStore *store)
@@ -59,7 +64,10 @@ KisTileDataSwapper::KisTileDataSwapper(KisTileDataStore *store)
       m_d(new Private())
 {
     m_d->shouldExitFlag = 0;
+    m_d->compactionRequested = 0;
+    m_d->historyCompressionRequested = 0;
     m_d->store = store;
+    m_d->batchSize = KisImageConfig(true).swapperBatchSize();
 }
 
 KisTileDataSwapper::~KisTileDataSwapper()
@@ -72,6 +80,20 @@ void KisTileDataSwapper::kick()
     m_d->semaphore.release();
 }
 
+void KisTileDataSwapper::requestCompaction()
+{
+    if (m_d->compactionRequested.testAndSetOrdered(0, 1)) {
+        kick();
+    }
+}
+
+void KisTileDataSwapper::requestHistoryCompression()
+{
+    if (m_d->historyCompressionRequested.testAndSetOrdered(0, 1)) {
+        kick();
+    }
+}
+
 void KisTileDataSwapper::terminateSwapper()
 {
     unsigned long exitTimeout = 100;
@@ -97,6 +119,67 @@ void KisTileDataSwapper::run()
         QThread::msleep(DELAY);
 
         doJob();
+
+        if (m_d->compactionRequested.testAndSetOrdered(1, 0)) {
+            doCompaction();
+        }
+
+        if (m_d->historyCompressionRequested.testAndSetOrdered(1, 0)) {
+            doHistoryCompression();
+        }
+    }
+}
+
+void KisTileDataSwapper::doCompaction()
+{
+    /**
+     * Compaction is a low-priority job: move the data in small
+     * portions and give up as soon as somebody kicks us with
+     * some real swapping work.
+     */
+    while (!m_d->shouldExitFlag && !m_d->semaphore.available()) {
+        QMutexLocker locker(&m_d->cycleLock);
+
+        const quint64 moved = m_d->store->compactSwapFile(COMPACTION_PORTION);
+        DEBUG_VALUE(moved);
+
+        if (moved < COMPACTION_PORTION) break;
+    }
+}
+
+void KisTileDataSwapper::doHistoryCompression()
+{
+    /**
+     * The tiles of the undo history are compressed in batches, the
+     * same way as the ones pushed out of memory by the swapping
+     * passes. The compressed tier is disabled when its limit is
+     * zero, then the queued tiles are just dropped.
+     */
+    const bool compressInMemory = m_d->limits.compressedLimit() > 0;
+    bool queueIsEmpty = false;
+
+    while (!m_d->shouldExitFlag && !m_d->semaphore.available()) {
+        QMutexLocker locker(&m_d->cycleLock);
+
+        const int processed =
+            m_d->store->compressQueuedHistoryTiles(m_d->batchSize, compressInMemory);
+        DEBUG_VALUE(processed);
+
+        if (processed < m_d->batchSize) {
+            queueIsEmpty = true;
+            break;
+        }
+    }
+
+    /**
+     * We have been interrupted by some real swapping work. The queued
+     * tiles hold a reference to their tile data, so we cannot just
+     * leave them until somebody queues a new tile. Raise the request
+     * again, it will be handled in the next cycle (the semaphore is
+     * already signalled, so no kick is needed).
+     */
+    if (!queueIsEmpty && !m_d->shouldExitFlag) {
+        m_d->historyCompressionRequested = 1;
     }
 }
 
@@ -126,21 +209,52 @@ void KisTileDataSwapper::doJob()
     DEBUG_VALUE(m_d->limits.hardLimitThreshold());
 
 
+    const bool compressInMemory = m_d->limits.compressedLimit() > 0;
+
     if(memoryMetric > m_d->limits.softLimitThreshold()) {
         qint32 softFree =  memoryMetric - m_d->limits.softLimit();
         DEBUG_VALUE(softFree);
         DEBUG_ACTION("\t pass0");
-        memoryMetric -= pass<SoftSwapStrategy>(softFree);
+        memoryMetric -= pass<SoftSwapStrategy>(softFree, compressInMemory);
         DEBUG_VALUE(memoryMetric);
 
         if(memoryMetric > m_d->limits.hardLimitThreshold()) {
             qint32 hardFree =  memoryMetric - m_d->limits.hardLimit();
             DEBUG_VALUE(hardFree);
             DEBUG_ACTION("\t pass1");
-            memoryMetric -= pass<AggressiveSwapStrategy>(hardFree);
+            memoryMetric -= pass<AggressiveSwapStrategy>(hardFree, compressInMemory);
             DEBUG_VALUE(memoryMetric);
         }
     }
+
+    if (compressInMemory) {
+        const qint64 compressedMetric = m_d->store->compressedMemoryMetric();
+
+        qint64 spillMetric = compressedMetric - m_d->limits.compressedLimit();
+
+        if (memoryMetric > m_d->limits.hardLimitThreshold()) {
+            spillMetric = qMax(spillMetric, qint64(memoryMetric - m_d->limits.hardLimit()));
+        }
+
+        if (spillMetric > 0) {
+            DEBUG_VALUE(spillMetric);
+            DEBUG_ACTION("\t spill");
+            memoryMetric -= m_d->store->spillCompressedTileData(spillMetric);
+            DEBUG_VALUE(memoryMetric);
+
+            /**
+             * Compression hasn't helped enough, write the
+             * working tiles to the swap file directly
+             */
+            if(memoryMetric > m_d->limits.hardLimitThreshold()) {
+                qint32 hardFree =  memoryMetric - m_d->limits.hardLimit();
+                DEBUG_VALUE(hardFree);
+                DEBUG_ACTION("\t pass2");
+                memoryMetric -= pass<AggressiveSwapStrategy>(hardFree, false);
+                DEBUG_VALUE(memoryMetric);
+            }
+        }
+    }
 }
 
 
@@ -193,27 +307,51 @@ public:
 
 
 template<class strategy>
-qint64 KisTileDataSwapper::pass(qint64 needToFreeMetric)
+qint64 KisTileDataSwapper::pass(qint64 needToFreeMetric, bool compressInMemory)
 {
     qint64 freedMetric = 0;
     QList<KisTileData*> additionalCandidates;
 
+    /**
+     * The victims are not swapped out one-by-one, but are collected
+     * into batches, which are compressed in parallel and written
+     * to the swap file in one go.
+     */
+    QVector<KisTileData*> batch;
+    qint64 batchMetric = 0;
+    batch.reserve(m_d->batchSize);
+
     typename strategy::iterator *iter =
         strategy::beginIteration(m_d->store);
 
+    auto flushBatch = [&] () {
+        if (batch.isEmpty()) return;
+
+        freedMetric += iter->trySwapOut(batch, compressInMemory);
+        batch.clear();
+        batchMetric = 0;
+    };
+
+    auto addToBatch = [&] (KisTileData *td) {
+        batch.append(td);
+        batchMetric += td->pixelSize();
+
+        if (batch.size() >= m_d->batchSize) {
+            flushBatch();
+        }
+    };
+
     KisTileData *item = 0;
 
     while (iter->hasNext()) {
         item = iter->next();
 
-        if (freedMetric >= needToFreeMetric) break;
+        if (freedMetric + batchMetric >= needToFreeMetric) break;
 
         if (!strategy::isInteresting(item)) continue;
 
         if (strategy::swapOutFirst(item)) {
-            if (iter->trySwapOut(item)) {
-                freedMetric += item->pixelSize();
-            }
+            addToBatch(item);
         }
         else {
             item->markOld();
@@ -223,13 +361,13 @@ qint64 KisTileDataSwapper::pass(qint64 needToFreeMetric)
     }
 
     Q_FOREACH (item, additionalCandidates) {
-        if (freedMetric >= needToFreeMetric) break;
+        if (freedMetric + batchMetric >= needToFreeMetric) break;
 
-        if (iter->trySwapOut(item)) {
-            freedMetric += item->pixelSize();
-        }
+        addToBatch(item);
     }
 
+    flushBatch();
+
     strategy::endIteration(m_d->store, iter);
 
     return freedMetric;
@@ -238,4 +376,5 @@ qint64 KisTileDataSwapper::pass(qint64 needToFreeMetric)
 void KisTileDataSwapper::testingRereadConfig()
 {
     m_d->limits = KisStoreLimits();
+    m_d->batchSize = KisImageConfig(true).swapperBatchSize();
 }
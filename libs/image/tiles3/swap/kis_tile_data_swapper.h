@@ -40,6 +40,20 @@ public:
     void terminateSwapper();
     void checkFreeMemory();
 
+    /**
+     * Asks the swapper to defragment the swap file on its next
+     * wake-up. Compaction is done in small portions and is
+     * interrupted as soon as any other swapping work arrives.
+     */
+    void requestCompaction();
+
+    /**
+     * Asks the swapper to compress the tiles queued by the undo
+     * history on its next wake-up. Like compaction, the job is
+     * interrupted as soon as any other swapping work arrives.
+     */
+    void requestHistoryCompression();
+
     void testingRereadConfig();
 
 private:
@@ -47,11 +61,14 @@ private:
     void run() override;
 
     void doJob();
-    template<class strategy> qint64 pass(qint64 needToFreeMetric);
+    void doCompaction();
+    void doHistoryCompression();
+    template<class strategy> qint64 pass(qint64 needToFreeMetric, bool compressInMemory);
 
 private:
     static const qint32 TIMEOUT;
     static const qint32 DELAY;
+    static const quint64 COMPACTION_PORTION;
 
 private:
     struct Private;
@@ -53,6 +53,13 @@
   |                        |
   +------------------------+  <-- 0 MiB
 
+  When compressedLimit is non-zero, the tiles are not written to
+  the swap file directly, but are compressed and kept in memory.
+  The compressed tiles are counted in the memory metric as well, so
+  they are spilled to the swap file (without recompression) when
+  either the compressed tiles take more than compressedLimit or
+  the memory is still above hardLimitThreshold.
+
  */
 
 
@@ -69,6 +76,8 @@ public:
 
         m_softLimitThreshold = qBound(0, MiB_TO_METRIC(config.tilesSoftLimit()), m_hardLimitThreshold);
         m_softLimit = m_softLimitThreshold - m_softLimitThreshold / 8;
+
+        m_compressedLimit = qBound(0, MiB_TO_METRIC(config.tilesCompressedLimit()), m_hardLimit);
     }
 
     /**
@@ -95,12 +104,17 @@ public:
         return m_softLimit;
     }
 
+    inline qint32 compressedLimit() {
+        return m_compressedLimit;
+    }
+
 private:
     qint32 m_emergencyThreshold;
     qint32 m_hardLimitThreshold;
     qint32 m_hardLimit;
     qint32 m_softLimitThreshold;
     qint32 m_softLimit;
+    qint32 m_compressedLimit;
 };
 
 
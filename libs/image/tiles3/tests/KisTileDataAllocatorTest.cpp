@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "KisTileDataAllocatorTest.h"
+
+#include <QTest>
+#include <QThread>
+
+#include "tiles3/KisTileDataAllocator.h"
+#include "tiles3/kis_tile_data.h"
+#include "kis_random_source.h"
+
+namespace {
+const qint32 TILE_AREA = KisTileData::WIDTH * KisTileData::HEIGHT;
+const qint32 allPixelSizes[] = {1, 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 32};
+}
+
+void KisTileDataAllocatorTest::testAllPixelSizes()
+{
+    KisTileDataAllocator allocator;
+
+    const int numTiles = 100;
+
+    for (qint32 pixelSize : allPixelSizes) {
+        const qint32 tileSize = pixelSize * TILE_AREA;
+
+        QVector<quint8*> tiles;
+
+        for (int i = 0; i < numTiles; i++) {
+            quint8 *ptr = allocator.allocate(pixelSize);
+            QVERIFY(ptr);
+            QCOMPARE(reinterpret_cast<quintptr>(ptr) % 16, quintptr(0));
+
+            memset(ptr, i, tileSize);
+            tiles << ptr;
+        }
+
+        // no tile should overlap with the others
+        for (int i = 0; i < numTiles; i++) {
+            const quint8 *ptr = tiles[i];
+            QCOMPARE(int(ptr[0]), i);
+            QCOMPARE(int(ptr[tileSize - 1]), i);
+        }
+
+        Q_FOREACH (quint8 *ptr, tiles) {
+            allocator.deallocate(ptr, pixelSize);
+        }
+    }
+
+    QVERIFY(allocator.reservedMemory() > 0);
+}
+
+class AllocatingThread : public QThread
+{
+public:
+    AllocatingThread(KisTileDataAllocator *allocator, int seed)
+        : m_allocator(allocator),
+          m_seed(seed),
+          m_failed(false)
+    {
+    }
+
+    void run() override {
+        KisRandomSource random(m_seed);
+
+        QVector<QPair<quint8*, qint32>> tiles;
+
+        for (int i = 0; i < 20000; i++) {
+            if (tiles.size() < 64 && random.generate(0, 1)) {
+                const qint32 pixelSize = allPixelSizes[random.generate(0, int(sizeof(allPixelSizes) / sizeof(qint32)) - 1)];
+                quint8 *ptr = m_allocator->allocate(pixelSize);
+                memset(ptr, quint8(m_seed), pixelSize * TILE_AREA);
+                tiles.append(qMakePair(ptr, pixelSize));
+            } else if (!tiles.isEmpty()) {
+                const int index = random.generate(0, tiles.size() - 1);
+                QPair<quint8*, qint32> tile = tiles.takeAt(index);
+
+                const qint32 tileSize = tile.second * TILE_AREA;
+                for (int j = 0; j < tileSize; j += 509) {
+                    m_failed |= tile.first[j] != quint8(m_seed);
+                }
+
+                m_allocator->deallocate(tile.first, tile.second);
+            }
+        }
+
+        for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+            m_allocator->deallocate(it->first, it->second);
+        }
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+
+private:
+    KisTileDataAllocator *m_allocator;
+    int m_seed;
+    bool m_failed;
+};
+
+void KisTileDataAllocatorTest::testMultithreaded()
+{
+    KisTileDataAllocator allocator;
+
+    QVector<AllocatingThread*> threads;
+    for (int i = 0; i < 8; i++) {
+        threads << new AllocatingThread(&allocator, i + 1);
+    }
+
+    Q_FOREACH (AllocatingThread *thread, threads) {
+        thread->start();
+    }
+
+    Q_FOREACH (AllocatingThread *thread, threads) {
+        thread->wait();
+        QVERIFY(!thread->failed());
+    }
+
+    qDeleteAll(threads);
+}
+
+void KisTileDataAllocatorTest::testNumaPools()
+{
+    KisTileDataAllocator allocator(2);
+    QCOMPARE(allocator.numNodes(), 2);
+
+    QVector<AllocatingThread*> threads;
+    for (int i = 0; i < 8; i++) {
+        threads << new AllocatingThread(&allocator, i + 1);
+    }
+
+    Q_FOREACH (AllocatingThread *thread, threads) {
+        thread->start();
+    }
+
+    Q_FOREACH (AllocatingThread *thread, threads) {
+        thread->wait();
+        QVERIFY(!thread->failed());
+    }
+
+    qDeleteAll(threads);
+
+    // the blocks freed by the thread that allocated them are never remote
+    KisTileDataAllocator localAllocator(2);
+
+    QVector<quint8*> tiles;
+    for (int i = 0; i < 100; i++) {
+        tiles << localAllocator.allocate(4);
+    }
+
+    Q_FOREACH (quint8 *ptr, tiles) {
+        localAllocator.deallocate(ptr, 4);
+    }
+
+    QCOMPARE(localAllocator.remoteDeallocations(), qint64(0));
+}
+
+void KisTileDataAllocatorTest::testPurge()
+{
+    KisTileDataAllocator allocator;
+
+    QVector<quint8*> tiles;
+    for (int i = 0; i < 1000; i++) {
+        tiles << allocator.allocate(4);
+    }
+
+    Q_FOREACH (quint8 *ptr, tiles) {
+        allocator.deallocate(ptr, 4);
+    }
+
+    QVERIFY(allocator.reservedMemory() >= 1000 * 4 * TILE_AREA);
+
+    allocator.purge();
+    QCOMPARE(allocator.reservedMemory(), qint64(0));
+
+    // the allocator must still be usable after purging
+    quint8 *ptr = allocator.allocate(4);
+    memset(ptr, 0xff, 4 * TILE_AREA);
+    allocator.deallocate(ptr, 4);
+
+    QVERIFY(allocator.reservedMemory() > 0);
+}
+
+QTEST_MAIN(KisTileDataAllocatorTest)
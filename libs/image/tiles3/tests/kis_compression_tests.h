@@ -42,12 +42,24 @@ private Q_SLOTS:
     void testLzfRoundTrip();
     void testLzfOverflow();
 
+    void testLz4RoundTrip();
+    void testLz4Overflow();
+
+    void testZstdRoundTrip();
+    void testZstdOverflow();
+
     void benchmarkMemCpy();
 
     void benchmarkCompressionLzf();
     void benchmarkCompressionLzfTwoPass();
     void benchmarkDecompressionLzf();
     void benchmarkDecompressionLzfTwoPass();
+
+    void benchmarkCompressionLz4TwoPass();
+    void benchmarkDecompressionLz4TwoPass();
+
+    void benchmarkCompressionZstdTwoPass();
+    void benchmarkDecompressionZstdTwoPass();
 };
 
 #endif /* KIS_COMPRESSION_TESTS_H */
@@ -131,5 +131,200 @@ void KisSwappedDataStoreTest::testRandomAccess()
         delete tileDataList[i];
 }
 
+inline void fillNoise(quint8 *data, qint32 size, quint32 seed)
+{
+    // a poorly compressible pattern, so that the chunks
+    // occupy some real space in the swap file
+    quint32 state = seed * 2654435761U + 1;
+    for (qint32 i = 0; i < size; i++) {
+        state = state * 1103515245U + 12345U;
+        data[i] = quint8(state >> 16);
+    }
+}
+
+inline bool checkNoise(const quint8 *data, qint32 size, quint32 seed)
+{
+    QByteArray reference(size, 0);
+    fillNoise(reinterpret_cast<quint8*>(reference.data()), size, seed);
+    return !memcmp(data, reference.constData(), size);
+}
+
+void KisSwappedDataStoreTest::testCompaction()
+{
+    const qint32 pixelSize = 1;
+    const quint8 defaultPixel = 128;
+    const qint32 NUM_TILES = 1000;
+
+    KisImageConfig config(false);
+    config.setMaxSwapSize(40);
+    config.setSwapSlabSize(1);
+    config.setSwapWindowSize(1);
+
+
+    KisSwappedDataStore store;
+
+    QList<KisTileData*> tileDataList;
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        tileDataList.append(new KisTileData(pixelSize, &defaultPixel, KisTileDataStore::instance()));
+
+    for(qint32 i = 0; i < NUM_TILES; i++) {
+        KisTileData *td = tileDataList[i];
+        fillNoise(td->data(), TILESIZE, i);
+        QVERIFY(store.trySwapOutTileData(td));
+    }
+
+    const quint64 initialFileSize = store.swapFileSize();
+
+    // swap in every second tile to make holes in the file
+    for(qint32 i = 0; i < NUM_TILES; i += 2) {
+        KisTileData *td = tileDataList[i];
+        store.swapInTileData(td);
+        QVERIFY(checkNoise(td->data(), TILESIZE, i));
+    }
+
+    // the first tile has been moved, so a partial
+    // compaction must move something
+    QVERIFY(store.compact(TILESIZE) > 0);
+
+    while (store.compact(1024 * 1024) > 0);
+
+    store.debugStatistics();
+
+    QVERIFY(store.swapFileSize() < initialFileSize);
+
+    for(qint32 i = 1; i < NUM_TILES; i += 2) {
+        KisTileData *td = tileDataList[i];
+        QVERIFY(!td->data());
+        store.swapInTileData(td);
+        QVERIFY(checkNoise(td->data(), TILESIZE, i));
+    }
+
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        delete tileDataList[i];
+}
+
+void KisSwappedDataStoreTest::testBatchSwapOut()
+{
+    const qint32 pixelSize = 1;
+    const quint8 defaultPixel = 128;
+    const qint32 NUM_TILES = 1000;
+    const qint32 BATCH_SIZE = 64;
+
+    KisImageConfig config(false);
+    config.setMaxSwapSize(40);
+    config.setSwapSlabSize(1);
+    config.setSwapWindowSize(1);
+    config.setSwapperThreadCount(4);
+
+
+    KisSwappedDataStore store;
+
+    QList<KisTileData*> tileDataList;
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        tileDataList.append(new KisTileData(pixelSize, &defaultPixel, KisTileDataStore::instance()));
+
+    QVector<KisTileData*> batch;
+    qint32 numBatches = 0;
+
+    for(qint32 i = 0; i < NUM_TILES; i++) {
+        KisTileData *td = tileDataList[i];
+        fillNoise(td->data(), TILESIZE, i);
+        batch.append(td);
+
+        if (batch.size() == BATCH_SIZE || i == NUM_TILES - 1) {
+            QVERIFY(store.trySwapOutTileDataBatch(batch));
+            batch.clear();
+            numBatches++;
+        }
+    }
+
+    QCOMPARE(store.numSwappedOutTiles(), qint64(NUM_TILES));
+    QCOMPARE(store.numSwapBatches(), qint64(numBatches));
+
+    store.debugStatistics();
+
+    // swap in in reverse order to make sure the chunks are independent
+    for(qint32 i = NUM_TILES - 1; i >= 0; i--) {
+        KisTileData *td = tileDataList[i];
+        QVERIFY(!td->data());
+        store.swapInTileData(td);
+        QVERIFY(checkNoise(td->data(), TILESIZE, i));
+    }
+
+    QCOMPARE(store.numTiles(), quint64(0));
+
+    config.setSwapperThreadCount(config.swapperThreadCount(true));
+
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        delete tileDataList[i];
+}
+
+void KisSwappedDataStoreTest::testCompressedTier()
+{
+    const qint32 pixelSize = 1;
+    const quint8 defaultPixel = 128;
+    const qint32 NUM_TILES = 256;
+    const qint32 BATCH_SIZE = 64;
+
+    KisImageConfig config(false);
+    config.setMaxSwapSize(40);
+    config.setSwapSlabSize(1);
+    config.setSwapWindowSize(1);
+
+
+    KisSwappedDataStore store;
+
+    QList<KisTileData*> tileDataList;
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        tileDataList.append(new KisTileData(pixelSize, &defaultPixel, KisTileDataStore::instance()));
+
+    QVector<KisTileData*> batch;
+    qint64 compressedSize = 0;
+
+    for(qint32 i = 0; i < NUM_TILES; i++) {
+        KisTileData *td = tileDataList[i];
+
+        // only a part of the tile is noisy, so that it could be compressed
+        fillNoise(td->data(), TILESIZE / 4, i);
+        batch.append(td);
+
+        if (batch.size() == BATCH_SIZE) {
+            compressedSize += store.compressTileDataBatch(batch);
+            batch.clear();
+        }
+    }
+
+    QCOMPARE(store.numCompressedTiles(), qint64(NUM_TILES));
+    QCOMPARE(store.numTiles(), quint64(NUM_TILES));
+    QCOMPARE(store.compressedMemorySize(), compressedSize);
+    QVERIFY(compressedSize < qint64(NUM_TILES) * TILESIZE);
+
+    // the compressed tiles are not written to the swap file
+    QCOMPARE(store.numSwappedOutTiles(), qint64(0));
+
+    // spill the oldest half of the tiles to the swap file
+    const qint64 spilledSize = store.spillCompressedTiles(compressedSize / 2);
+    QVERIFY(spilledSize >= compressedSize / 2);
+    QCOMPARE(store.compressedMemorySize(), compressedSize - spilledSize);
+    QVERIFY(store.numSwappedOutTiles() > 0);
+    QCOMPARE(store.numCompressedTiles() + store.numSwappedOutTiles(), qint64(NUM_TILES));
+    QCOMPARE(store.numTiles(), quint64(NUM_TILES));
+
+    for(qint32 i = NUM_TILES - 1; i >= 0; i--) {
+        KisTileData *td = tileDataList[i];
+        QVERIFY(!td->data());
+        store.swapInTileData(td);
+        QVERIFY(checkNoise(td->data(), TILESIZE / 4, i));
+        QVERIFY(memoryIsFilled(defaultPixel, td->data() + TILESIZE / 4, TILESIZE - TILESIZE / 4));
+    }
+
+    QCOMPARE(store.numTiles(), quint64(0));
+    QCOMPARE(store.numCompressedTiles(), qint64(0));
+    QCOMPARE(store.compressedMemorySize(), qint64(0));
+
+    for(qint32 i = 0; i < NUM_TILES; i++)
+        delete tileDataList[i];
+}
+
 QTEST_MAIN(KisSwappedDataStoreTest)
 
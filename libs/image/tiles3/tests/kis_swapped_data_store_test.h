@@ -33,6 +33,9 @@ private:
 private Q_SLOTS:
     void testRoundTrip();
     void testRandomAccess();
+    void testCompaction();
+    void testBatchSwapOut();
+    void testCompressedTier();
 
 };
 
@@ -179,6 +179,58 @@ void KisTileCompressorsTest::testLowLevelRoundTripIncompressible2()
     delete compressor;
 }
 
+void KisTileCompressorsTest::testLowLevelRoundTripSwapCompressions()
+{
+    Q_FOREACH (const QString &name, KisTileCompressor2::availableCompressions()) {
+        KisTileCompressor2 *compressor = new KisTileCompressor2(name);
+        QCOMPARE(compressor->compressionName(), name);
+
+        doLowLevelRoundTrip(compressor);
+        doLowLevelRoundTripIncompressible(compressor);
+        delete compressor;
+    }
+}
+
+void KisTileCompressorsTest::testDecompressForeignCompression()
+{
+    const qint32 pixelSize = 1;
+    quint8 oddPixel1 = 128;
+    quint8 oddPixel2 = 129;
+
+    KisTiledDataManager dm(pixelSize, &oddPixel1);
+    KisTileSP tile = dm.getTile(0, 0, true);
+    tile->lockForWrite();
+
+    KisTileData *td = tile->tileData();
+
+    /**
+     * The data written by one compression algorithm should be
+     * readable by a compressor set up for any other one, because
+     * the swap file may contain tiles written before the user
+     * changed the settings.
+     */
+    Q_FOREACH (const QString &srcName, KisTileCompressor2::availableCompressions()) {
+        Q_FOREACH (const QString &dstName, KisTileCompressor2::availableCompressions()) {
+            KisTileCompressor2 srcCompressor(srcName);
+            KisTileCompressor2 dstCompressor(dstName);
+
+            memset(td->data(), oddPixel1, TILESIZE);
+
+            qint32 bufferSize = srcCompressor.tileDataBufferSize(td);
+            quint8 *buffer = new quint8[bufferSize];
+            qint32 bytesWritten;
+            srcCompressor.compressTileData(td, buffer, bufferSize, bytesWritten);
+
+            memset(td->data(), oddPixel2, TILESIZE);
+            QVERIFY(dstCompressor.decompressTileData(buffer, bytesWritten, td));
+            QVERIFY(memoryIsFilled(oddPixel1, td->data(), TILESIZE));
+
+            delete[] buffer;
+        }
+    }
+
+    tile->unlock();
+}
 
 QTEST_MAIN(KisTileCompressorsTest)
 
@@ -38,6 +38,9 @@ private Q_SLOTS:
     void testRoundTrip2();
     void testLowLevelRoundTrip2();
     void testLowLevelRoundTripIncompressible2();
+
+    void testLowLevelRoundTripSwapCompressions();
+    void testDecompressForeignCompression();
 };
 
 #endif /* KIS_TILE_COMPRESSORS_TEST_H */
@@ -46,7 +46,8 @@ void KisTileDataPoolerTest::testCycles()
 
     for(int i = 0; i < 12; i++) {
         KisTileData *td =
-            KisTileDataStore::instance()->createDefaultTileData(pixelSize, &defaultPixel);
+            new KisTileData(pixelSize, &defaultPixel, KisTileDataStore::instance());
+        KisTileDataStore::instance()->registerTileData(td);
 
         for(int j = 0; j < 1 + (2 - i % 3); j++) {
             td->acquire();
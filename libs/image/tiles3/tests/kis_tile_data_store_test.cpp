@@ -188,5 +188,312 @@ void KisTileDataStoreTest::testSwapping()
     }
 }
 
+void KisTileDataStoreTest::testDeduplication()
+{
+    KisTileDataStore *store = KisTileDataStore::instance();
+    store->debugClear();
+
+    const qint32 pixelSize = 1;
+    quint8 defaultPixel = 0;
+
+    {
+        KisTiledDataManager dm1(pixelSize, &defaultPixel);
+        KisTiledDataManager dm2(pixelSize, &defaultPixel);
+
+        QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+        for (int i = 0; i < TILESIZE; i++) {
+            buffer[i] = i % 251;
+        }
+
+        KisMementoSP memento1 = dm1.getMemento();
+        dm1.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm1.commit();
+
+        KisMementoSP memento2 = dm2.getMemento();
+        dm2.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm2.commit();
+
+        KisTileSP tile1 = dm1.getTile(0, 0, false);
+        KisTileSP tile2 = dm2.getTile(0, 0, false);
+
+        QVERIFY(tile1->tileData() != tile2->tileData());
+        QVERIFY(tile1->data() != tile2->data());
+
+        store->deduplicateTileData(1024);
+
+        QVERIFY(tile1->tileData()->isDeduplicated());
+        QVERIFY(tile2->tileData()->isDeduplicated());
+        QCOMPARE(tile1->data(), tile2->data());
+
+        KisTileDataStore::MemoryStatistics stats = store->memoryStatistics();
+        QCOMPARE(stats.numDeduplicatedTiles, qint64(2));
+        QCOMPARE(stats.deduplicationSavedSize, qint64(TILESIZE));
+
+        // writing into a deduplicated tile gives it a private copy
+        quint8 oddPixel = 255;
+        tile1->lockForWrite();
+        QVERIFY(!tile1->tileData()->isDeduplicated());
+        tile1->data()[0] = oddPixel;
+        tile1->unlockForWrite();
+
+        QVERIFY(tile2->tileData()->isDeduplicated());
+        QVERIFY(tile1->data() != tile2->data());
+
+        QScopedArrayPointer<quint8> result(new quint8[TILESIZE]);
+
+        dm2.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        buffer[0] = oddPixel;
+        dm1.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+    }
+
+    QCOMPARE(store->numTiles(), 0);
+}
+
+void KisTileDataStoreTest::testReleasePoolsWithDeduplicatedTiles()
+{
+    KisTileDataStore *store = KisTileDataStore::instance();
+    store->debugClear();
+
+    const qint32 pixelSize = 1;
+    quint8 defaultPixel = 0;
+    quint8 oddPixel = 255;
+
+    {
+        KisTiledDataManager dm1(pixelSize, &defaultPixel);
+        KisTiledDataManager dm2(pixelSize, &defaultPixel);
+
+        QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+        for (int i = 0; i < TILESIZE; i++) {
+            buffer[i] = i % 251;
+        }
+
+        dm1.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm2.writeBytes(buffer.data(), 0, 0, 64, 64);
+
+        store->deduplicateTileData(1024);
+        QCOMPARE(store->memoryStatistics().numDeduplicatedTiles, qint64(2));
+
+        // dm1 gets a private copy, the shared buffer is retired
+        dm1.setPixel(0, 0, &oddPixel);
+
+        {
+            // closing a document releases the pools
+            KisTiledDataManager dm3(pixelSize, &defaultPixel);
+            dm3.writeBytes(buffer.data(), 0, 0, 64, 64);
+        }
+        KisTiledDataManager::releaseInternalPools();
+
+        QScopedArrayPointer<quint8> result(new quint8[TILESIZE]);
+
+        dm2.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        // the buffers freed after the purge must not get into the pools
+        store->deduplicateTileData(1024);
+        dm2.setPixel(0, 0, &oddPixel);
+
+        KisTiledDataManager dm4(pixelSize, &defaultPixel);
+        for (int col = 0; col < 16; col++) {
+            dm4.writeBytes(buffer.data(), col * 64, 0, 64, 64);
+        }
+
+        buffer[0] = oddPixel;
+
+        dm1.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        dm2.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        buffer[0] = 0;
+
+        for (int col = 0; col < 16; col++) {
+            dm4.readBytes(result.data(), col * 64, 0, 64, 64);
+            QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+        }
+    }
+
+    QCOMPARE(store->numTiles(), 0);
+}
+
+void KisTileDataStoreTest::testDeltaMementos()
+{
+    KisTileDataStore *store = KisTileDataStore::instance();
+    store->debugClear();
+
+    const int oldEnableDeltaMementos = store->m_enableDeltaMementos.loadAcquire();
+    store->m_enableDeltaMementos.storeRelease(1);
+
+    const qint32 pixelSize = 1;
+    quint8 defaultPixel = 0;
+    quint8 oddPixel = 255;
+
+    {
+        KisTiledDataManager dm(pixelSize, &defaultPixel);
+
+        QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+        for (int i = 0; i < TILESIZE; i++) {
+            buffer[i] = i % 251;
+        }
+
+        KisMementoSP memento1 = dm.getMemento();
+        dm.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm.commit();
+
+        QCOMPARE(store->memoryStatistics().numDeltaTiles, qint64(0));
+
+        // a one-pixel change leaves only a single row in the history
+        KisMementoSP memento2 = dm.getMemento();
+        dm.setPixel(10, 20, &oddPixel);
+        dm.commit();
+
+        KisTileDataStore::MemoryStatistics stats = store->memoryStatistics();
+        QCOMPARE(stats.numDeltaTiles, qint64(1));
+        QVERIFY(stats.deltaSize > 0);
+        QVERIFY(stats.deltaSize < 64);
+
+        QScopedArrayPointer<quint8> result(new quint8[TILESIZE]);
+
+        dm.rollback(memento2);
+        dm.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        // the tile has been reconstructed on access
+        stats = store->memoryStatistics();
+        QCOMPARE(stats.numDeltaTiles, qint64(0));
+        QCOMPARE(stats.deltaSize, qint64(0));
+
+        dm.rollforward(memento2);
+        buffer[20 * 64 + 10] = oddPixel;
+        dm.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+    }
+
+    store->m_enableDeltaMementos.storeRelease(oldEnableDeltaMementos);
+
+    QCOMPARE(store->numTiles(), 0);
+}
+
+void KisTileDataStoreTest::testDeltaChainLength()
+{
+    KisTileDataStore *store = KisTileDataStore::instance();
+    store->debugClear();
+
+    const int oldEnableDeltaMementos = store->m_enableDeltaMementos.loadAcquire();
+    store->m_enableDeltaMementos.storeRelease(1);
+
+    const qint32 pixelSize = 1;
+    quint8 defaultPixel = 0;
+    quint8 oddPixel = 255;
+
+    {
+        KisTiledDataManager dm(pixelSize, &defaultPixel);
+
+        QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+        for (int i = 0; i < TILESIZE; i++) {
+            buffer[i] = i % 251;
+        }
+
+        KisMementoSP memento1 = dm.getMemento();
+        dm.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm.commit();
+
+        QScopedArrayPointer<quint8> revision2(new quint8[TILESIZE]);
+        memcpy(revision2.data(), buffer.data(), TILESIZE);
+        revision2[20 * 64 + 10] = oddPixel;
+
+        KisMementoSP memento2 = dm.getMemento();
+        dm.setPixel(10, 20, &oddPixel);
+        dm.commit();
+
+        QCOMPARE(store->memoryStatistics().numDeltaTiles, qint64(1));
+
+        /**
+         * The second revision is the base of the delta of the first
+         * one, so it must not become a delta itself
+         */
+        KisMementoSP memento3 = dm.getMemento();
+        dm.setPixel(30, 40, &oddPixel);
+        dm.commit();
+
+        QCOMPARE(store->memoryStatistics().numDeltaTiles, qint64(1));
+
+        QScopedArrayPointer<quint8> result(new quint8[TILESIZE]);
+
+        dm.rollback(memento3);
+        dm.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), revision2.data(), TILESIZE));
+
+        dm.rollback(memento2);
+        dm.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+    }
+
+    store->m_enableDeltaMementos.storeRelease(oldEnableDeltaMementos);
+
+    QCOMPARE(store->numTiles(), 0);
+}
+
+void KisTileDataStoreTest::testHistoryCompression()
+{
+    KisTileDataStore *store = KisTileDataStore::instance();
+    store->debugClear();
+
+    const int oldEnableDeltaMementos = store->m_enableDeltaMementos.loadAcquire();
+    const int oldEnableHistoryCompression = store->m_enableHistoryCompression.loadAcquire();
+    store->m_enableDeltaMementos.storeRelease(0);
+    store->m_enableHistoryCompression.storeRelease(1);
+
+    const qint32 pixelSize = 1;
+    quint8 defaultPixel = 0;
+
+    {
+        KisTiledDataManager dm(pixelSize, &defaultPixel);
+
+        QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+        for (int i = 0; i < TILESIZE; i++) {
+            buffer[i] = i % 251;
+        }
+
+        KisMementoSP memento1 = dm.getMemento();
+        dm.writeBytes(buffer.data(), 0, 0, 64, 64);
+        dm.commit();
+
+        QCOMPARE(store->memoryStatistics().numCompressedTiles, qint64(0));
+
+        // overwrite the whole tile, so that the old one goes to the history
+        KisMementoSP memento2 = dm.getMemento();
+        dm.clear(0, 0, 64, 64, 1);
+        dm.commit();
+
+        // the swapper thread might have already picked up the tile
+        store->compressQueuedHistoryTiles(1024);
+        QTRY_COMPARE(store->memoryStatistics().numCompressedTiles, qint64(1));
+
+        KisTileDataStore::MemoryStatistics stats = store->memoryStatistics();
+        QVERIFY(stats.compressedSize > 0);
+        QCOMPARE(stats.compressionSavedSize, qint64(TILESIZE) - stats.compressedSize);
+
+        QScopedArrayPointer<quint8> result(new quint8[TILESIZE]);
+
+        dm.rollback(memento2);
+        dm.readBytes(result.data(), 0, 0, 64, 64);
+        QVERIFY(!memcmp(result.data(), buffer.data(), TILESIZE));
+
+        // the tile has been decompressed on access
+        stats = store->memoryStatistics();
+        QCOMPARE(stats.numCompressedTiles, qint64(0));
+        QCOMPARE(stats.compressionSavedSize, qint64(0));
+    }
+
+    store->m_enableDeltaMementos.storeRelease(oldEnableDeltaMementos);
+    store->m_enableHistoryCompression.storeRelease(oldEnableHistoryCompression);
+
+    QCOMPARE(store->numTiles(), 0);
+}
+
 QTEST_MAIN(KisTileDataStoreTest)
 
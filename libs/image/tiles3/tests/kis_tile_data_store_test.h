@@ -30,6 +30,11 @@ private Q_SLOTS:
     void testClockIterator();
     void testLeaks();
     void testSwapping();
+    void testDeduplication();
+    void testReleasePoolsWithDeduplicatedTiles();
+    void testDeltaMementos();
+    void testDeltaChainLength();
+    void testHistoryCompression();
 };
 
 #endif /* KIS_TILE_DATA_STORE_TEST_H */
@@ -539,6 +539,135 @@ void KisTiledDataManagerTest::testUndoSetDefaultPixel()
     QVERIFY(memoryIsFilled(oddPixel2, tile10->data(), TILESIZE));
 }
 
+void KisTiledDataManagerTest::testUniformTiles()
+{
+    quint8 defaultPixel = 0;
+    KisTiledDataManager dm(1, &defaultPixel);
+
+    quint8 oddPixel1 = 128;
+    quint8 oddPixel2 = 129;
+
+    KisTileSP tile00;
+    KisTileSP tile10;
+
+    tile00 = dm.getTile(0, 0, false);
+    QVERIFY(tile00->tileData()->isUniform());
+
+    KisMementoSP memento1 = dm.getMemento();
+    dm.clear(QRect(0,0,64,64), &oddPixel1);
+    dm.commit();
+
+    tile00 = dm.getTile(0, 0, false);
+    QVERIFY(tile00->tileData()->isUniform());
+    QVERIFY(memoryIsFilled(oddPixel1, tile00->data(), TILESIZE));
+
+    // a tile filled pixel-by-pixel becomes uniform on commit
+    QScopedArrayPointer<quint8> buffer(new quint8[TILESIZE]);
+    memset(buffer.data(), oddPixel2, TILESIZE);
+
+    KisMementoSP memento2 = dm.getMemento();
+    dm.writeBytes(buffer.data(), 64, 0, 64, 64);
+    dm.commit();
+
+    tile10 = dm.getTile(1, 0, false);
+    QVERIFY(tile10->tileData()->isUniform());
+    QVERIFY(memoryIsFilled(oddPixel2, tile10->data(), TILESIZE));
+
+    // writing into a uniform tile expands it
+    KisMementoSP memento3 = dm.getMemento();
+    dm.clear(QRect(10,10,10,10), &oddPixel2);
+    dm.commit();
+
+    tile00 = dm.getTile(0, 0, false);
+    QVERIFY(!tile00->tileData()->isUniform());
+
+    dm.readBytes(buffer.data(), 0, 0, 64, 64);
+    QVERIFY(checkHole(buffer.data(), oddPixel2, QRect(10,10,10,10),
+                      oddPixel1, QRect(0,0,64,64)));
+
+    dm.rollback(memento3);
+
+    tile00 = dm.getTile(0, 0, false);
+    QVERIFY(tile00->tileData()->isUniform());
+    QVERIFY(memoryIsFilled(oddPixel1, tile00->data(), TILESIZE));
+
+    dm.rollback(memento2);
+    dm.rollback(memento1);
+
+    tile00 = dm.getTile(0, 0, false);
+    tile10 = dm.getTile(1, 0, false);
+    QVERIFY(memoryIsFilled(defaultPixel, tile00->data(), TILESIZE));
+    QVERIFY(memoryIsFilled(defaultPixel, tile10->data(), TILESIZE));
+
+    // purging uniform tiles of the default color removes them
+    memset(buffer.data(), defaultPixel, TILESIZE);
+
+    KisMementoSP memento4 = dm.getMemento();
+    dm.writeBytes(buffer.data(), 0, 0, 64, 64);
+    dm.commit();
+
+    QVERIFY(dm.getTile(0, 0, false)->tileData()->isUniform());
+    QCOMPARE(dm.extent(), QRect(0,0,64,64));
+
+    dm.purge(QRect(0,0,64,64));
+    QCOMPARE(dm.extent(), QRect());
+}
+
+void KisTiledDataManagerTest::testHashTableImplementations_data()
+{
+    QTest::addColumn<bool>("useLockFree");
+
+    QTest::newRow("lock-free") << true;
+    QTest::newRow("blocking") << false;
+}
+
+void KisTiledDataManagerTest::testHashTableImplementations()
+{
+    QFETCH(bool, useLockFree);
+
+    const bool oldValue = KisTileHashTableImplementation::useLockFreeTable();
+    KisTileHashTableImplementation::setUseLockFreeTable(useLockFree);
+
+    {
+        quint8 defaultPixel = 0;
+        quint8 oddPixel1 = 128;
+        quint8 oddPixel2 = 129;
+
+        KisTiledDataManager dm(1, &defaultPixel);
+
+        KisMementoSP memento1 = dm.getMemento();
+        dm.clear(QRect(0,0,256,256), &oddPixel1);
+        dm.commit();
+
+        KisMementoSP memento2 = dm.getMemento();
+        dm.clear(QRect(64,64,64,64), &oddPixel2);
+        dm.commit();
+
+        QVERIFY(memoryIsFilled(oddPixel2, dm.getTile(1, 1, false)->data(), TILESIZE));
+        QCOMPARE(dm.extent(), QRect(0,0,256,256));
+
+        dm.rollback(memento2);
+        QVERIFY(memoryIsFilled(oddPixel1, dm.getTile(1, 1, false)->data(), TILESIZE));
+
+        dm.rollforward(memento2);
+        QVERIFY(memoryIsFilled(oddPixel2, dm.getTile(1, 1, false)->data(), TILESIZE));
+
+        // the copy should inherit the implementation of the source
+        KisTiledDataManager copyDM(dm);
+        KisTileHashTableImplementation::setUseLockFreeTable(!useLockFree);
+
+        QVERIFY(memoryIsFilled(oddPixel2, copyDM.getTile(1, 1, false)->data(), TILESIZE));
+        QVERIFY(memoryIsFilled(oddPixel1, copyDM.getTile(0, 0, false)->data(), TILESIZE));
+        QCOMPARE(copyDM.extent(), QRect(0,0,256,256));
+
+        copyDM.clear();
+        QCOMPARE(copyDM.extent(), QRect());
+        QVERIFY(memoryIsFilled(oddPixel1, dm.getTile(0, 0, false)->data(), TILESIZE));
+    }
+
+    KisTileHashTableImplementation::setUseLockFreeTable(oldValue);
+}
+
 //#include <valgrind/callgrind.h>
 
 void KisTiledDataManagerTest::benchmarkReadOnlyTileLazy()
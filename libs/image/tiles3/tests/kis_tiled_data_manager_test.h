@@ -52,6 +52,9 @@ private Q_SLOTS:
     void testTransactions();
     void testPurgeHistory();
     void testUndoSetDefaultPixel();
+    void testUniformTiles();
+    void testHashTableImplementations_data();
+    void testHashTableImplementations();
 
     void benchmarkReadOnlyTileLazy();
     void benchmarkSharedPointers();
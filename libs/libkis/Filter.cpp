@@ -29,7 +29,6 @@
 #include <KisView.h>
 
 #include <strokes/kis_filter_stroke_strategy.h>
-#include <krita_utils.h>
 #include <KisGlobalResourcesInterface.h>
 
 #include "Krita.h"
@@ -149,15 +148,7 @@ bool Filter::startFilter(Node *node, int x, int y, int w, int h)
     QRect processRect = filter->changedRect(applyRect, filterConfig.data(), 0);
     processRect &= image->bounds();
 
-    if (filter->supportsThreading()) {
-        QSize size = KritaUtils::optimalPatchSize();
-        QVector<QRect> rects = KritaUtils::splitRectIntoPatches(processRect, size);
-        Q_FOREACH (const QRect &rc, rects) {
-            image->addJob(currentStrokeId, new KisFilterStrokeStrategy::Data(rc, true));
-        }
-    } else {
-        image->addJob(currentStrokeId, new KisFilterStrokeStrategy::Data(processRect, false));
-    }
+    image->addJob(currentStrokeId, new KisFilterStrokeStrategy::Data(processRect, false));
 
     image->endStroke(currentStrokeId);
     image->waitForDone();
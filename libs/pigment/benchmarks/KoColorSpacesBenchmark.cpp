@@ -18,11 +18,18 @@
 
 #include "KoColorSpacesBenchmark.h"
 
+#include <thread>
+#include <vector>
+
 #include <QTest>
+#include <QThread>
 #include <KoColorSpaceRegistry.h>
 #include <KoColorSpace.h>
+#include <KoColorModelStandardIds.h>
 
 #define NB_PIXELS 1000000
+#define NB_QCOLOR_CONVERSIONS 100000
+#define NB_CONVERSION_CHUNK_PIXELS 4096
 
 void KoColorSpacesBenchmark::createRowsColumns()
 {
@@ -34,6 +41,50 @@ void KoColorSpacesBenchmark::createRowsColumns()
     }
 }
 
+void KoColorSpacesBenchmark::createConversionRowsColumns()
+{
+    QTest::addColumn<QString>("modelID");
+    QTest::addColumn<QString>("depthID");
+    QTest::addColumn<int>("numThreads");
+
+    const QList<QPair<KoID, KoID>> colorSpaces = {
+        qMakePair(RGBAColorModelID, Integer8BitsColorDepthID),
+        qMakePair(RGBAColorModelID, Integer16BitsColorDepthID),
+        qMakePair(CMYKAColorModelID, Integer8BitsColorDepthID),
+        qMakePair(GrayAColorModelID, Integer8BitsColorDepthID)
+    };
+
+    QList<int> threadCounts = {1};
+    if (QThread::idealThreadCount() > 1) {
+        threadCounts << QThread::idealThreadCount();
+    }
+
+    for (auto it = colorSpaces.begin(); it != colorSpaces.end(); ++it) {
+        Q_FOREACH (int numThreads, threadCounts) {
+            QTest::newRow(QString("%1-%2-%3threads").arg(it->first.id()).arg(it->second.id()).arg(numThreads).toLatin1().data())
+                << it->first.id() << it->second.id() << numThreads;
+        }
+    }
+}
+
+/**
+ * Runs \p func(threadIndex) in \p numThreads threads at the same time
+ * and waits until all of them are finished
+ */
+template <typename Func>
+void runInThreads(int numThreads, Func func)
+{
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(func, i);
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
 #define START_BENCHMARK \
     QFETCH(QString, modelID); \
     QFETCH(QString, depthID); \
@@ -146,4 +197,80 @@ void KoColorSpacesBenchmark::benchmarkSetAlpha2IndividualCall()
     END_BENCHMARK
 }
 
+void KoColorSpacesBenchmark::benchmarkQColorConversion_data()
+{
+    createConversionRowsColumns();
+}
+
+void KoColorSpacesBenchmark::benchmarkQColorConversion()
+{
+    QFETCH(QString, modelID);
+    QFETCH(QString, depthID);
+    QFETCH(int, numThreads);
+
+    const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->colorSpace(modelID, depthID, 0);
+    QVERIFY(colorSpace);
+
+    // an explicit profile makes the conversion go through the
+    // non-default transformation, like the color selectors do
+    const KoColorProfile *rgbProfile = KoColorSpaceRegistry::instance()->rgb8()->profile();
+
+    QBENCHMARK {
+        runInThreads(numThreads, [colorSpace, rgbProfile] (int threadIndex) {
+            QVector<quint8> pixel(colorSpace->pixelSize());
+            QColor color;
+
+            for (int i = 0; i < NB_QCOLOR_CONVERSIONS; ++i) {
+                colorSpace->fromQColor(QColor(i & 0xff, (i >> 8) & 0xff, threadIndex & 0xff), pixel.data(), rgbProfile);
+                colorSpace->toQColor(pixel.data(), &color, rgbProfile);
+            }
+        });
+    }
+}
+
+void KoColorSpacesBenchmark::benchmarkBulkConversion_data()
+{
+    createConversionRowsColumns();
+}
+
+void KoColorSpacesBenchmark::benchmarkBulkConversion()
+{
+    QFETCH(QString, modelID);
+    QFETCH(QString, depthID);
+    QFETCH(int, numThreads);
+
+    const KoColorSpace *colorSpace = KoColorSpaceRegistry::instance()->colorSpace(modelID, depthID, 0);
+    QVERIFY(colorSpace);
+
+    const KoColorSpace *dstColorSpace = KoColorSpaceRegistry::instance()->lab16();
+
+    // every thread converts its own share of NB_PIXELS
+    const int pixelsPerThread = NB_PIXELS / numThreads;
+
+    QVector<QVector<quint8>> srcBuffers;
+    QVector<QVector<quint8>> dstBuffers;
+
+    for (int i = 0; i < numThreads; i++) {
+        srcBuffers << QVector<quint8>(pixelsPerThread * colorSpace->pixelSize(), 0);
+        dstBuffers << QVector<quint8>(pixelsPerThread * dstColorSpace->pixelSize(), 0);
+    }
+
+    QBENCHMARK {
+        runInThreads(numThreads, [&] (int threadIndex) {
+            const quint8 *src = srcBuffers[threadIndex].constData();
+            quint8 *dst = dstBuffers[threadIndex].data();
+
+            for (int i = 0; i < pixelsPerThread; i += NB_CONVERSION_CHUNK_PIXELS) {
+                const int numPixels = qMin(NB_CONVERSION_CHUNK_PIXELS, pixelsPerThread - i);
+
+                colorSpace->convertPixelsTo(src + i * colorSpace->pixelSize(),
+                                            dst + i * dstColorSpace->pixelSize(),
+                                            dstColorSpace, numPixels,
+                                            KoColorConversionTransformation::internalRenderingIntent(),
+                                            KoColorConversionTransformation::internalConversionFlags());
+            }
+        });
+    }
+}
+
 QTEST_MAIN(KoColorSpacesBenchmark)
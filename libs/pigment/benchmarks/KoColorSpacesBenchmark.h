@@ -26,6 +26,7 @@ class KoColorSpacesBenchmark : public QObject
     Q_OBJECT
 private:
     void createRowsColumns();
+    void createConversionRowsColumns();
 private Q_SLOTS:
     void benchmarkAlpha_data();
     void benchmarkAlpha();
@@ -39,6 +40,10 @@ private Q_SLOTS:
     void benchmarkSetAlphaIndividualCall();
     void benchmarkSetAlpha2IndividualCall_data();
     void benchmarkSetAlpha2IndividualCall();
+    void benchmarkQColorConversion_data();
+    void benchmarkQColorConversion();
+    void benchmarkBulkConversion_data();
+    void benchmarkBulkConversion();
 };
 
 #endif
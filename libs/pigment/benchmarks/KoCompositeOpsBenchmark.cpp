@@ -20,10 +20,15 @@
 
 #include "../compositeops/KoCompositeOpAlphaDarken.h"
 #include "../compositeops/KoCompositeOpOver.h"
+#include "../compositeops/KoCompositeOpCopy2.h"
+#include "../compositeops/KoCompositeOpErase.h"
+#include "../compositeops/KoAlphaDarkenParamsWrapper.h"
 #include <KoOptimizedCompositeOpFactory.h>
 
 #include <KoColorSpaceTraits.h>
 #include <KoColorSpaceRegistry.h>
+#include <KoColorModelStandardIds.h>
+#include <KoCompositeOpRegistry.h>
 
 #include <QTest>
 
@@ -108,5 +113,229 @@ void KoCompositeOpsBenchmark::benchmarkCompositeAlphaDarkenCreamy()
     }
 }
 
+void KoCompositeOpsBenchmark::benchmarkCompositeGenericSC_data()
+{
+    QTest::addColumn<QString>("depthID");
+    QTest::addColumn<QString>("compositeOpID");
+
+    const QList<KoID> depths = {
+        Integer8BitsColorDepthID,
+        Integer16BitsColorDepthID,
+        Float32BitsColorDepthID
+    };
+
+    const QStringList compositeOps = {
+        COMPOSITE_MULT,
+        COMPOSITE_SCREEN,
+        COMPOSITE_OVERLAY,
+        COMPOSITE_HARD_LIGHT,
+        COMPOSITE_SOFT_LIGHT_PHOTOSHOP,
+        COMPOSITE_SOFT_LIGHT_SVG,
+        COMPOSITE_DODGE,
+        COMPOSITE_BURN,
+        COMPOSITE_DARKEN,
+        COMPOSITE_LIGHTEN,
+        COMPOSITE_ADD,
+        COMPOSITE_SUBTRACT,
+        COMPOSITE_DIFF
+    };
+
+    Q_FOREACH (const KoID &depth, depths) {
+        Q_FOREACH (const QString &compositeOp, compositeOps) {
+            QTest::newRow(QString("%1-%2").arg(depth.id()).arg(compositeOp).toLatin1().data())
+                << depth.id() << compositeOp;
+        }
+    }
+}
+
+/**
+ * Composites a 2048x2048 image of random pixels with \p compositeOp
+ * tile-by-tile, the same way the projection does it
+ */
+void benchmarkCompositeImage(const KoColorSpace *cs, const KoCompositeOp *compositeOp)
+{
+    const int pixelSize = cs->pixelSize();
+    const int rowStride = IMG_WIDTH * pixelSize;
+
+    QVector<quint8> dstBuffer(IMG_HEIGHT * rowStride);
+    QVector<quint8> srcBuffer(IMG_HEIGHT * rowStride);
+    QVector<quint8> mskBuffer(IMG_HEIGHT * IMG_WIDTH);
+
+    qsrand(42);
+
+    // the pixels are generated via normalized values to avoid
+    // garbage in the floating point channels
+    QVector<float> channels(cs->channelCount());
+
+    for (int x = 0; x < IMG_WIDTH; x++) {
+        for (int i = 0; i < channels.size(); i++) {
+            channels[i] = float(qrand()) / RAND_MAX;
+        }
+        cs->fromNormalisedChannelsValue(srcBuffer.data() + x * pixelSize, channels);
+
+        for (int i = 0; i < channels.size(); i++) {
+            channels[i] = float(qrand()) / RAND_MAX;
+        }
+        cs->fromNormalisedChannelsValue(dstBuffer.data() + x * pixelSize, channels);
+    }
+
+    for (int y = 1; y < IMG_HEIGHT; y++) {
+        memcpy(srcBuffer.data() + y * rowStride, srcBuffer.constData(), rowStride);
+        memcpy(dstBuffer.data() + y * rowStride, dstBuffer.constData(), rowStride);
+    }
+
+    for (int i = 0; i < mskBuffer.size(); i++) {
+        mskBuffer[i] = qrand() & 0xFF;
+    }
+
+    QBENCHMARK {
+        for (int y = 0; y < TILES_IN_HEIGHT; y++) {
+            for (int x = 0; x < TILES_IN_WIDTH; x++) {
+                const int bufOffset = y * TILE_HEIGHT * rowStride + x * TILE_WIDTH * pixelSize;
+                const int mskOffset = y * TILE_HEIGHT * IMG_WIDTH + x * TILE_WIDTH;
+
+                compositeOp->composite(dstBuffer.data() + bufOffset, rowStride,
+                                       srcBuffer.constData() + bufOffset, rowStride,
+                                       mskBuffer.constData() + mskOffset, IMG_WIDTH,
+                                       TILE_HEIGHT, TILE_WIDTH,
+                                       OPACITY_HALF);
+            }
+        }
+    }
+}
+
+void KoCompositeOpsBenchmark::benchmarkCompositeGenericSC()
+{
+    QFETCH(QString, depthID);
+    QFETCH(QString, compositeOpID);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(), depthID, 0);
+    QVERIFY(cs);
+
+    const KoCompositeOp *compositeOp = cs->compositeOp(compositeOpID);
+    QCOMPARE(compositeOp->id(), compositeOpID);
+
+    benchmarkCompositeImage(cs, compositeOp);
+}
+
+void KoCompositeOpsBenchmark::benchmarkComposite64_data()
+{
+    QTest::addColumn<QString>("depthID");
+    QTest::addColumn<QString>("compositeOpID");
+    QTest::addColumn<bool>("optimized");
+
+    QList<KoID> depths = { Integer16BitsColorDepthID };
+#ifdef HAVE_OPENEXR
+    depths << Float16BitsColorDepthID;
+#endif
+
+    const QStringList compositeOps = {
+        COMPOSITE_OVER,
+        "alphadarken-hard",
+        "alphadarken-creamy",
+        COMPOSITE_COPY,
+        COMPOSITE_ERASE
+    };
+
+    Q_FOREACH (const KoID &depth, depths) {
+        Q_FOREACH (const QString &compositeOp, compositeOps) {
+            QTest::newRow(QString("%1-%2-scalar").arg(depth.id()).arg(compositeOp).toLatin1().data())
+                << depth.id() << compositeOp << false;
+            QTest::newRow(QString("%1-%2-optimized").arg(depth.id()).arg(compositeOp).toLatin1().data())
+                << depth.id() << compositeOp << true;
+        }
+    }
+}
+
+template <class Traits>
+KoCompositeOp* createScalarComposite64Op(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = new KoCompositeOpOver<Traits>(cs);
+    } else if (id == "alphadarken-hard") {
+        op = new KoCompositeOpAlphaDarken<Traits, KoAlphaDarkenParamsWrapperHard>(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = new KoCompositeOpAlphaDarken<Traits, KoAlphaDarkenParamsWrapperCreamy>(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = new KoCompositeOpCopy2<Traits>(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = new KoCompositeOpErase<Traits>(cs);
+    }
+
+    return op;
+}
+
+KoCompositeOp* createOptimizedComposite64OpU16(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = KoOptimizedCompositeOpFactory::createOverOpU16(cs);
+    } else if (id == "alphadarken-hard") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpHardU16(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpCreamyU16(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = KoOptimizedCompositeOpFactory::createCopyOpU16(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = KoOptimizedCompositeOpFactory::createEraseOpU16(cs);
+    }
+
+    return op;
+}
+
+#ifdef HAVE_OPENEXR
+KoCompositeOp* createOptimizedComposite64OpF16(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = KoOptimizedCompositeOpFactory::createOverOpF16(cs);
+    } else if (id == "alphadarken-hard") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpHardF16(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpCreamyF16(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = KoOptimizedCompositeOpFactory::createCopyOpF16(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = KoOptimizedCompositeOpFactory::createEraseOpF16(cs);
+    }
+
+    return op;
+}
+#endif
+
+void KoCompositeOpsBenchmark::benchmarkComposite64()
+{
+    QFETCH(QString, depthID);
+    QFETCH(QString, compositeOpID);
+    QFETCH(bool, optimized);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(), depthID, 0);
+    QVERIFY(cs);
+
+    KoCompositeOp *compositeOp = 0;
+
+    if (depthID == Integer16BitsColorDepthID.id()) {
+        compositeOp = optimized ?
+            createOptimizedComposite64OpU16(cs, compositeOpID) :
+            createScalarComposite64Op<KoBgrU16Traits>(cs, compositeOpID);
+    }
+#ifdef HAVE_OPENEXR
+    else if (depthID == Float16BitsColorDepthID.id()) {
+        compositeOp = optimized ?
+            createOptimizedComposite64OpF16(cs, compositeOpID) :
+            createScalarComposite64Op<KoRgbF16Traits>(cs, compositeOpID);
+    }
+#endif
+
+    QVERIFY(compositeOp);
+
+    benchmarkCompositeImage(cs, compositeOp);
+
+    delete compositeOp;
+}
 
 QTEST_GUILESS_MAIN(KoCompositeOpsBenchmark)
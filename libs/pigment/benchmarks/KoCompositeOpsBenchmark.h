@@ -34,6 +34,12 @@ private Q_SLOTS:
     void benchmarkCompositeAlphaDarkenHard();
     void benchmarkCompositeAlphaDarkenCreamy();
 
+    void benchmarkCompositeGenericSC_data();
+    void benchmarkCompositeGenericSC();
+
+    void benchmarkComposite64_data();
+    void benchmarkComposite64();
+
 private:
     quint8 * m_dstBuffer;
     quint8 * m_srcBuffer;
@@ -62,6 +62,12 @@ struct OptimizedOpsSelector
     static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
         return new KoCompositeOpOver<Traits>(cs);
     }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return new KoCompositeOpCopy2<Traits>(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return new KoCompositeOpErase<Traits>(cs);
+    }
 };
 
 template<>
@@ -75,6 +81,12 @@ struct OptimizedOpsSelector<KoBgrU8Traits>
     static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
         return KoOptimizedCompositeOpFactory::createOverOp32(cs);
     }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return new KoCompositeOpCopy2<KoBgrU8Traits>(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return new KoCompositeOpErase<KoBgrU8Traits>(cs);
+    }
 };
 
 template<>
@@ -88,6 +100,12 @@ struct OptimizedOpsSelector<KoLabU8Traits>
     static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
         return KoOptimizedCompositeOpFactory::createOverOp32(cs);
     }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return new KoCompositeOpCopy2<KoLabU8Traits>(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return new KoCompositeOpErase<KoLabU8Traits>(cs);
+    }
 };
 
 template<>
@@ -112,6 +130,96 @@ struct OptimizedOpsSelector<KoRgbF32Traits>
     static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
         return KoOptimizedCompositeOpFactory::createOverOp128(cs);
     }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return new KoCompositeOpCopy2<KoRgbF32Traits>(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return new KoCompositeOpErase<KoRgbF32Traits>(cs);
+    }
+};
+
+template<>
+struct OptimizedOpsSelector<KoBgrU16Traits>
+{
+    static KoCompositeOp* createAlphaDarkenOp(const KoColorSpace *cs) {
+        return useCreamyAlphaDarken() ?
+            KoOptimizedCompositeOpFactory::createAlphaDarkenOpCreamyU16(cs) :
+            KoOptimizedCompositeOpFactory::createAlphaDarkenOpHardU16(cs);
+    }
+    static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createOverOpU16(cs);
+    }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createCopyOpU16(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createEraseOpU16(cs);
+    }
+};
+
+#ifdef HAVE_OPENEXR
+template<>
+struct OptimizedOpsSelector<KoRgbF16Traits>
+{
+    static KoCompositeOp* createAlphaDarkenOp(const KoColorSpace *cs) {
+        // alpha darken of floating point colorspaces is not vectorized
+        // because of bug 404133, see KoRgbF32Traits
+        if (useCreamyAlphaDarken()) {
+            return new KoCompositeOpAlphaDarken<KoRgbF16Traits, KoAlphaDarkenParamsWrapperCreamy>(cs);
+        } else {
+            return new KoCompositeOpAlphaDarken<KoRgbF16Traits, KoAlphaDarkenParamsWrapperHard>(cs);
+        }
+    }
+    static KoCompositeOp* createOverOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createOverOpF16(cs);
+    }
+    static KoCompositeOp* createCopyOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createCopyOpF16(cs);
+    }
+    static KoCompositeOp* createEraseOp(const KoColorSpace *cs) {
+        return KoOptimizedCompositeOpFactory::createEraseOpF16(cs);
+    }
+};
+#endif
+
+/**
+ * Selects a vectorized version of a separable blending mode if
+ * there is one for the colorspace, otherwise returns null
+ */
+template<class Traits>
+struct OptimizedGenericSCOpSelector
+{
+    static KoCompositeOp* createOp(const KoColorSpace *cs, const QString& id, const QString& description, const QString& category) {
+        Q_UNUSED(cs);
+        Q_UNUSED(id);
+        Q_UNUSED(description);
+        Q_UNUSED(category);
+        return 0;
+    }
+};
+
+template<>
+struct OptimizedGenericSCOpSelector<KoBgrU8Traits>
+{
+    static KoCompositeOp* createOp(const KoColorSpace *cs, const QString& id, const QString& description, const QString& category) {
+        return KoOptimizedCompositeOpFactory::createGenericSCOp32(cs, id, description, category);
+    }
+};
+
+template<>
+struct OptimizedGenericSCOpSelector<KoBgrU16Traits>
+{
+    static KoCompositeOp* createOp(const KoColorSpace *cs, const QString& id, const QString& description, const QString& category) {
+        return KoOptimizedCompositeOpFactory::createGenericSCOp64(cs, id, description, category);
+    }
+};
+
+template<>
+struct OptimizedGenericSCOpSelector<KoRgbF32Traits>
+{
+    static KoCompositeOp* createOp(const KoColorSpace *cs, const QString& id, const QString& description, const QString& category) {
+        return KoOptimizedCompositeOpFactory::createGenericSCOp128(cs, id, description, category);
+    }
 };
 
 template<class Traits>
@@ -123,14 +231,20 @@ struct AddGeneralOps<Traits, true>
 
      template<CompositeFunc func>
      static void add(KoColorSpace* cs, const QString& id, const QString& description, const QString& category) {
-         cs->addCompositeOp(new KoCompositeOpGenericSC<Traits, func>(cs, id, description, category));
+         KoCompositeOp *op = OptimizedGenericSCOpSelector<Traits>::createOp(cs, id, description, category);
+
+         if (!op) {
+             op = new KoCompositeOpGenericSC<Traits, func>(cs, id, description, category);
+         }
+
+         cs->addCompositeOp(op);
      }
 
      static void add(KoColorSpace* cs) {
          cs->addCompositeOp(OptimizedOpsSelector<Traits>::createOverOp(cs));
          cs->addCompositeOp(OptimizedOpsSelector<Traits>::createAlphaDarkenOp(cs));
-         cs->addCompositeOp(new KoCompositeOpCopy2<Traits>(cs));
-         cs->addCompositeOp(new KoCompositeOpErase<Traits>(cs));
+         cs->addCompositeOp(OptimizedOpsSelector<Traits>::createCopyOp(cs));
+         cs->addCompositeOp(OptimizedOpsSelector<Traits>::createEraseOp(cs));
          cs->addCompositeOp(new KoCompositeOpBehind<Traits>(cs));
          cs->addCompositeOp(new KoCompositeOpDestinationIn<Traits>(cs));
          cs->addCompositeOp(new KoCompositeOpDestinationAtop<Traits>(cs));
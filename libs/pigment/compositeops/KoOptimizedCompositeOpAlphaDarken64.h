@@ -0,0 +1,245 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KOOPTIMIZEDCOMPOSITEOPALPHADARKEN64_H
+#define KOOPTIMIZEDCOMPOSITEOPALPHADARKEN64_H
+
+#include "KoCompositeOpBase.h"
+#include "KoCompositeOpRegistry.h"
+#include "KoStreamedMath.h"
+#include "KoAlphaDarkenParamsWrapper.h"
+
+/**
+ * Alpha darken compositor for 8 byte RGBA pixels (16-bit integer or
+ * half float channels). The math is the same as in
+ * AlphaDarkenCompositor128, but it is done in normalized floats.
+ */
+template<typename channels_type, typename _ParamsWrapper>
+struct AlphaDarkenCompositor64 {
+    using ParamsWrapper = _ParamsWrapper;
+
+    // \see docs in AlphaDarkenCompositor128
+    template<bool haveMask, bool src_aligned, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeVector(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+
+        Vc::float_v src_c1;
+        Vc::float_v src_c2;
+        Vc::float_v src_c3;
+        Vc::float_v src_alpha;
+
+        PixelIO::template fetch<src_aligned>(src, src_c1, src_c2, src_c3, src_alpha);
+
+        Vc::float_v msk_norm_alpha;
+        if (haveMask) {
+            const Vc::float_v uint8Rec1((float)1.0 / 255.0);
+            Vc::float_v mask_vec = KoStreamedMath<_impl>::fetch_mask_8(mask);
+            msk_norm_alpha = mask_vec * uint8Rec1 * src_alpha;
+        }
+        else {
+            msk_norm_alpha = src_alpha;
+        }
+
+        // we don't use directly passed value
+        Q_UNUSED(opacity);
+
+        // instead we use value calculated by ParamsWrapper
+        opacity = oparams.opacity;
+        Vc::float_v opacity_vec(opacity);
+
+        src_alpha = msk_norm_alpha * opacity_vec;
+
+        const Vc::float_v zeroValue(Vc::Zero);
+
+        Vc::float_v dst_c1;
+        Vc::float_v dst_c2;
+        Vc::float_v dst_c3;
+        Vc::float_v dst_alpha;
+
+        PixelIO::template fetch<true>(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+
+        Vc::float_m empty_dst_pixels_mask = dst_alpha == zeroValue;
+
+        if (!empty_dst_pixels_mask.isFull()) {
+            if (empty_dst_pixels_mask.isEmpty()) {
+                dst_c1 = (src_c1 - dst_c1) * src_alpha + dst_c1;
+                dst_c2 = (src_c2 - dst_c2) * src_alpha + dst_c2;
+                dst_c3 = (src_c3 - dst_c3) * src_alpha + dst_c3;
+            }
+            else {
+                dst_c1(empty_dst_pixels_mask) = src_c1;
+                dst_c2(empty_dst_pixels_mask) = src_c2;
+                dst_c3(empty_dst_pixels_mask) = src_c3;
+                Vc::float_m not_empty_dst_pixels_mask = !empty_dst_pixels_mask;
+                dst_c1(not_empty_dst_pixels_mask) = (src_c1 - dst_c1) * src_alpha + dst_c1;
+                dst_c2(not_empty_dst_pixels_mask) = (src_c2 - dst_c2) * src_alpha + dst_c2;
+                dst_c3(not_empty_dst_pixels_mask) = (src_c3 - dst_c3) * src_alpha + dst_c3;
+            }
+        }
+        else {
+            dst_c1 = src_c1;
+            dst_c2 = src_c2;
+            dst_c3 = src_c3;
+        }
+
+        Vc::float_v fullFlowAlpha(dst_alpha);
+
+        if (oparams.averageOpacity > opacity) {
+            Vc::float_v average_opacity_vec(oparams.averageOpacity);
+            Vc::float_m fullFlowAlpha_mask = average_opacity_vec > dst_alpha;
+            fullFlowAlpha(fullFlowAlpha_mask) = (average_opacity_vec - src_alpha) * (dst_alpha / average_opacity_vec) + src_alpha;
+        }
+        else {
+            Vc::float_m fullFlowAlpha_mask = opacity_vec > dst_alpha;
+            fullFlowAlpha(fullFlowAlpha_mask) = (opacity_vec - dst_alpha) * msk_norm_alpha + dst_alpha;
+        }
+
+        if (oparams.flow == 1.0) {
+            dst_alpha = fullFlowAlpha;
+        }
+        else {
+            Vc::float_v zeroFlowAlpha = ParamsWrapper::calculateZeroFlowAlpha(src_alpha, dst_alpha);
+            Vc::float_v flow_norm_vec(oparams.flow);
+            dst_alpha = (fullFlowAlpha - zeroFlowAlpha) * flow_norm_vec + zeroFlowAlpha;
+        }
+
+        PixelIO::write(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+    }
+
+    /**
+     * Composes one pixel of the source into the destination
+     */
+    template <bool haveMask, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeOnePixelScalar(const quint8 *s, quint8 *d, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+        const qint32 alpha_pos = 3;
+
+        const channels_type *src = reinterpret_cast<const channels_type*>(s);
+        channels_type *dst = reinterpret_cast<channels_type*>(d);
+
+        float dstAlphaNorm = PixelIO::normalize(dst[alpha_pos]);
+        float srcAlphaNorm = PixelIO::normalize(src[alpha_pos]);
+
+        const float uint8Rec1 = 1.0 / 255.0;
+        float mskAlphaNorm = haveMask ? float(*mask) * uint8Rec1 * srcAlphaNorm : srcAlphaNorm;
+
+        Q_UNUSED(opacity);
+        opacity = oparams.opacity;
+
+        srcAlphaNorm = mskAlphaNorm * opacity;
+
+        if (dstAlphaNorm != 0) {
+            for (int i = 0; i < 3; i++) {
+                const float dstValue = PixelIO::normalize(dst[i]);
+                const float srcValue = PixelIO::normalize(src[i]);
+                dst[i] = PixelIO::denormalize((srcValue - dstValue) * srcAlphaNorm + dstValue);
+            }
+        } else {
+            KoStreamedMathFunctions::copyPixel<8>(s, d);
+        }
+
+        float flow = oparams.flow;
+        float averageOpacity = oparams.averageOpacity;
+
+        float fullFlowAlpha;
+
+        if (averageOpacity > opacity) {
+            fullFlowAlpha = averageOpacity > dstAlphaNorm ?
+                (averageOpacity - srcAlphaNorm) * (dstAlphaNorm / averageOpacity) + srcAlphaNorm :
+                dstAlphaNorm;
+        } else {
+            fullFlowAlpha = opacity > dstAlphaNorm ?
+                (opacity - dstAlphaNorm) * mskAlphaNorm + dstAlphaNorm :
+                dstAlphaNorm;
+        }
+
+        if (flow == 1.0) {
+            dst[alpha_pos] = PixelIO::denormalize(fullFlowAlpha);
+        } else {
+            float zeroFlowAlpha = ParamsWrapper::calculateZeroFlowAlpha(srcAlphaNorm, dstAlphaNorm);
+            dst[alpha_pos] = PixelIO::denormalize((fullFlowAlpha - zeroFlowAlpha) * flow + zeroFlowAlpha);
+        }
+    }
+};
+
+/**
+ * An optimized version of a composite op for the use in 8 byte
+ * colorspaces with alpha channel placed at the last channel of
+ * the pixel: C1_C2_C3_A.
+ */
+template<Vc::Implementation _impl, typename channels_type, typename ParamsWrapper>
+class KoOptimizedCompositeOpAlphaDarken64Impl : public KoCompositeOp
+{
+public:
+    KoOptimizedCompositeOpAlphaDarken64Impl(const KoColorSpace* cs)
+        : KoCompositeOp(cs, COMPOSITE_ALPHA_DARKEN, i18n("Alpha darken"), KoCompositeOp::categoryMix()) {}
+
+    using KoCompositeOp::composite;
+
+    virtual void composite(const KoCompositeOp::ParameterInfo& params) const override
+    {
+        if(params.maskRowStart) {
+            KoStreamedMath<_impl>::template genericComposite64<true, true, AlphaDarkenCompositor64<channels_type, ParamsWrapper> >(params);
+        } else {
+            KoStreamedMath<_impl>::template genericComposite64<false, true, AlphaDarkenCompositor64<channels_type, ParamsWrapper> >(params);
+        }
+    }
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenHardU16
+    : public KoOptimizedCompositeOpAlphaDarken64Impl<_impl, quint16, KoAlphaDarkenParamsWrapperHard>
+{
+public:
+    KoOptimizedCompositeOpAlphaDarkenHardU16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpAlphaDarken64Impl<_impl, quint16, KoAlphaDarkenParamsWrapperHard>(cs) {}
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenCreamyU16
+    : public KoOptimizedCompositeOpAlphaDarken64Impl<_impl, quint16, KoAlphaDarkenParamsWrapperCreamy>
+{
+public:
+    KoOptimizedCompositeOpAlphaDarkenCreamyU16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpAlphaDarken64Impl<_impl, quint16, KoAlphaDarkenParamsWrapperCreamy>(cs) {}
+};
+
+#ifdef HAVE_OPENEXR
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenHardF16
+    : public KoOptimizedCompositeOpAlphaDarken64Impl<_impl, half, KoAlphaDarkenParamsWrapperHard>
+{
+public:
+    KoOptimizedCompositeOpAlphaDarkenHardF16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpAlphaDarken64Impl<_impl, half, KoAlphaDarkenParamsWrapperHard>(cs) {}
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenCreamyF16
+    : public KoOptimizedCompositeOpAlphaDarken64Impl<_impl, half, KoAlphaDarkenParamsWrapperCreamy>
+{
+public:
+    KoOptimizedCompositeOpAlphaDarkenCreamyF16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpAlphaDarken64Impl<_impl, half, KoAlphaDarkenParamsWrapperCreamy>(cs) {}
+};
+#endif
+
+#endif // KOOPTIMIZEDCOMPOSITEOPALPHADARKEN64_H
@@ -0,0 +1,234 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KOOPTIMIZEDCOMPOSITEOPCOPY64_H
+#define KOOPTIMIZEDCOMPOSITEOPCOPY64_H
+
+#include "KoCompositeOpBase.h"
+#include "KoCompositeOpRegistry.h"
+#include "KoStreamedMath.h"
+
+
+/**
+ * Copy compositor for 8 byte RGBA pixels (16-bit integer or half float
+ * channels). Implements the same math as KoCompositeOpCopy2, but
+ * in normalized floats.
+ */
+template<typename channels_type, bool alphaLocked, bool allChannelsFlag>
+struct CopyCompositor64 {
+    struct ParamsWrapper {
+        ParamsWrapper(const KoCompositeOp::ParameterInfo& params)
+            : channelFlags(params.channelFlags)
+        {
+        }
+        const QBitArray &channelFlags;
+    };
+
+    // \see docs in AlphaDarkenCompositor32
+    template<bool haveMask, bool src_aligned, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeVector(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        Q_UNUSED(oparams);
+
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+
+        Vc::float_v opacity_vec(opacity);
+
+        if (haveMask) {
+            const Vc::float_v uint8MaxRec1((float)1.0 / 255.0);
+            opacity_vec *= KoStreamedMath<_impl>::fetch_mask_8(mask) * uint8MaxRec1;
+        }
+
+        const Vc::float_v zeroValue(Vc::Zero);
+        const Vc::float_v oneValue(Vc::One);
+
+        const Vc::float_m zero_opacity_mask = opacity_vec == zeroValue;
+
+        if (zero_opacity_mask.isFull()) {
+            return;
+        }
+
+        Vc::float_v src_c1;
+        Vc::float_v src_c2;
+        Vc::float_v src_c3;
+        Vc::float_v src_alpha;
+
+        PixelIO::template fetch<src_aligned>(src, src_c1, src_c2, src_c3, src_alpha);
+
+        const Vc::float_m full_opacity_mask = opacity_vec == oneValue;
+
+        if (full_opacity_mask.isFull()) {
+            PixelIO::write(dst, src_c1, src_c2, src_c3, src_alpha);
+            return;
+        }
+
+        Vc::float_v dst_c1;
+        Vc::float_v dst_c2;
+        Vc::float_v dst_c3;
+        Vc::float_v dst_alpha;
+
+        PixelIO::template fetch<true>(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+
+        const Vc::float_v new_alpha = (src_alpha - dst_alpha) * opacity_vec + dst_alpha;
+
+        /**
+         * The colors are premultiplied, blended and then unmultiplied.
+         * The pixels with zero resulting alpha keep their color.
+         */
+        const Vc::float_m keep_dst_mask = zero_opacity_mask || new_alpha == zeroValue;
+        Vc::float_v new_alpha_rec = oneValue / new_alpha;
+        new_alpha_rec.setZero(keep_dst_mask);
+
+        Vc::float_v result_c1 = ((src_c1 * src_alpha - dst_c1 * dst_alpha) * opacity_vec + dst_c1 * dst_alpha) * new_alpha_rec;
+        Vc::float_v result_c2 = ((src_c2 * src_alpha - dst_c2 * dst_alpha) * opacity_vec + dst_c2 * dst_alpha) * new_alpha_rec;
+        Vc::float_v result_c3 = ((src_c3 * src_alpha - dst_c3 * dst_alpha) * opacity_vec + dst_c3 * dst_alpha) * new_alpha_rec;
+
+        result_c1 = Vc::iif(keep_dst_mask, dst_c1, Vc::iif(full_opacity_mask, src_c1, result_c1));
+        result_c2 = Vc::iif(keep_dst_mask, dst_c2, Vc::iif(full_opacity_mask, src_c2, result_c2));
+        result_c3 = Vc::iif(keep_dst_mask, dst_c3, Vc::iif(full_opacity_mask, src_c3, result_c3));
+
+        PixelIO::write(dst, result_c1, result_c2, result_c3, new_alpha);
+    }
+
+    template <bool haveMask, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeOnePixelScalar(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+        const qint32 alpha_pos = 3;
+
+        const channels_type *s = reinterpret_cast<const channels_type*>(src);
+        channels_type *d = reinterpret_cast<channels_type*>(dst);
+
+        if (haveMask) {
+            const float uint8Rec1 = 1.0 / 255;
+            opacity *= float(*mask) * uint8Rec1;
+        }
+
+        const float srcAlpha = PixelIO::normalize(s[alpha_pos]);
+        const float dstAlpha = PixelIO::normalize(d[alpha_pos]);
+        float newAlpha = 0.0f;
+
+        if (!allChannelsFlag && dstAlpha == 0.0f) {
+            KoStreamedMathFunctions::clearPixel<8>(dst);
+        }
+
+        if (opacity == 1.0f) {
+            if (!alphaLocked || srcAlpha != 0.0f) {
+                for (int i = 0; i < 3; i++) {
+                    if (allChannelsFlag || oparams.channelFlags.at(i)) {
+                        d[i] = s[i];
+                    }
+                }
+            }
+
+            newAlpha = srcAlpha;
+
+        } else if (opacity == 0.0f) {
+
+            newAlpha = dstAlpha;
+
+        } else if (!alphaLocked || srcAlpha != 0.0f) {
+
+            newAlpha = (srcAlpha - dstAlpha) * opacity + dstAlpha;
+
+            if (newAlpha != 0.0f) {
+                for (int i = 0; i < 3; i++) {
+                    if (allChannelsFlag || oparams.channelFlags.at(i)) {
+                        const float dstMult = PixelIO::normalize(d[i]) * dstAlpha;
+                        const float srcMult = PixelIO::normalize(s[i]) * srcAlpha;
+                        d[i] = PixelIO::denormalize(((srcMult - dstMult) * opacity + dstMult) / newAlpha);
+                    }
+                }
+            }
+        }
+
+        if (!alphaLocked) {
+            d[alpha_pos] = PixelIO::denormalize(newAlpha);
+        }
+    }
+};
+
+/**
+ * An optimized version of a composite op for the use in 8 byte
+ * colorspaces with alpha channel placed at the last channel of
+ * the pixel: C1_C2_C3_A.
+ */
+template<Vc::Implementation _impl, typename channels_type>
+class KoOptimizedCompositeOpCopy64 : public KoCompositeOp
+{
+public:
+    KoOptimizedCompositeOpCopy64(const KoColorSpace* cs)
+        : KoCompositeOp(cs, COMPOSITE_COPY, i18n("Copy"), KoCompositeOp::categoryMisc()) {}
+
+    using KoCompositeOp::composite;
+
+    virtual void composite(const KoCompositeOp::ParameterInfo& params) const
+    {
+        if(params.maskRowStart) {
+            composite<true>(params);
+        } else {
+            composite<false>(params);
+        }
+    }
+
+    template <bool haveMask>
+    inline void composite(const KoCompositeOp::ParameterInfo& params) const {
+        if (params.channelFlags.isEmpty() ||
+            params.channelFlags == QBitArray(4, true)) {
+
+            KoStreamedMath<_impl>::template genericComposite64<haveMask, false, CopyCompositor64<channels_type, false, true> >(params);
+        } else {
+            const bool allChannelsFlag =
+                params.channelFlags.at(0) &&
+                params.channelFlags.at(1) &&
+                params.channelFlags.at(2);
+
+            const bool alphaLocked =
+                !params.channelFlags.at(3);
+
+            if (allChannelsFlag && alphaLocked) {
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, CopyCompositor64<channels_type, true, true> >(params);
+            } else if (!allChannelsFlag && !alphaLocked) {
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, CopyCompositor64<channels_type, false, false> >(params);
+            } else /*if (!allChannelsFlag && alphaLocked) */{
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, CopyCompositor64<channels_type, true, false> >(params);
+            }
+        }
+    }
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpCopyU16 : public KoOptimizedCompositeOpCopy64<_impl, quint16>
+{
+public:
+    KoOptimizedCompositeOpCopyU16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpCopy64<_impl, quint16>(cs) {}
+};
+
+#ifdef HAVE_OPENEXR
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpCopyF16 : public KoOptimizedCompositeOpCopy64<_impl, half>
+{
+public:
+    KoOptimizedCompositeOpCopyF16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpCopy64<_impl, half>(cs) {}
+};
+#endif
+
+#endif // KOOPTIMIZEDCOMPOSITEOPCOPY64_H
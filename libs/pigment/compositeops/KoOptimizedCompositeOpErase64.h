@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KOOPTIMIZEDCOMPOSITEOPERASE64_H
+#define KOOPTIMIZEDCOMPOSITEOPERASE64_H
+
+#include "KoCompositeOpBase.h"
+#include "KoCompositeOpRegistry.h"
+#include "KoStreamedMath.h"
+
+
+/**
+ * Erase compositor for 8 byte RGBA pixels (16-bit integer or half float
+ * channels). Like KoCompositeOpErase, it ignores the channel flags.
+ */
+template<typename channels_type>
+struct EraseCompositor64 {
+    struct ParamsWrapper {
+        ParamsWrapper(const KoCompositeOp::ParameterInfo& params)
+        {
+            Q_UNUSED(params);
+        }
+    };
+
+    // \see docs in AlphaDarkenCompositor32
+    template<bool haveMask, bool src_aligned, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeVector(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        Q_UNUSED(oparams);
+
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+
+        Vc::float_v src_c1;
+        Vc::float_v src_c2;
+        Vc::float_v src_c3;
+        Vc::float_v src_alpha;
+
+        PixelIO::template fetch<src_aligned>(src, src_c1, src_c2, src_c3, src_alpha);
+
+        src_alpha *= Vc::float_v(opacity);
+
+        if (haveMask) {
+            const Vc::float_v uint8MaxRec1((float)1.0 / 255.0);
+            src_alpha *= KoStreamedMath<_impl>::fetch_mask_8(mask) * uint8MaxRec1;
+        }
+
+        if ((src_alpha == Vc::float_v(Vc::Zero)).isFull()) {
+            return;
+        }
+
+        Vc::float_v dst_c1;
+        Vc::float_v dst_c2;
+        Vc::float_v dst_c3;
+        Vc::float_v dst_alpha;
+
+        PixelIO::template fetch<true>(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+
+        dst_alpha *= Vc::float_v(Vc::One) - src_alpha;
+
+        PixelIO::write(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+    }
+
+    template <bool haveMask, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeOnePixelScalar(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        Q_UNUSED(oparams);
+
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+        const qint32 alpha_pos = 3;
+
+        const channels_type *s = reinterpret_cast<const channels_type*>(src);
+        channels_type *d = reinterpret_cast<channels_type*>(dst);
+
+        float srcAlpha = PixelIO::normalize(s[alpha_pos]) * opacity;
+
+        if (haveMask) {
+            const float uint8Rec1 = 1.0 / 255;
+            srcAlpha *= float(*mask) * uint8Rec1;
+        }
+
+        if (srcAlpha != 0.0f) {
+            d[alpha_pos] = PixelIO::denormalize(PixelIO::normalize(d[alpha_pos]) * (1.0f - srcAlpha));
+        }
+    }
+};
+
+/**
+ * An optimized version of a composite op for the use in 8 byte
+ * colorspaces with alpha channel placed at the last channel of
+ * the pixel: C1_C2_C3_A.
+ */
+template<Vc::Implementation _impl, typename channels_type>
+class KoOptimizedCompositeOpErase64 : public KoCompositeOp
+{
+public:
+    KoOptimizedCompositeOpErase64(const KoColorSpace* cs)
+        : KoCompositeOp(cs, COMPOSITE_ERASE, i18n("Erase"), KoCompositeOp::categoryMix()) {}
+
+    using KoCompositeOp::composite;
+
+    virtual void composite(const KoCompositeOp::ParameterInfo& params) const
+    {
+        if(params.maskRowStart) {
+            KoStreamedMath<_impl>::template genericComposite64<true, false, EraseCompositor64<channels_type> >(params);
+        } else {
+            KoStreamedMath<_impl>::template genericComposite64<false, false, EraseCompositor64<channels_type> >(params);
+        }
+    }
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpEraseU16 : public KoOptimizedCompositeOpErase64<_impl, quint16>
+{
+public:
+    KoOptimizedCompositeOpEraseU16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpErase64<_impl, quint16>(cs) {}
+};
+
+#ifdef HAVE_OPENEXR
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpEraseF16 : public KoOptimizedCompositeOpErase64<_impl, half>
+{
+public:
+    KoOptimizedCompositeOpEraseF16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpErase64<_impl, half>(cs) {}
+};
+#endif
+
+#endif // KOOPTIMIZEDCOMPOSITEOPERASE64_H
@@ -22,8 +22,11 @@
 
 #include "kritapigment_export.h"
 
+#include <KoConfig.h>
+
 class KoCompositeOp;
 class KoColorSpace;
+class QString;
 
 /**
  * The creation of the optimized composite ops is moved into a separate
@@ -46,6 +49,29 @@ public:
     static KoCompositeOp* createAlphaDarkenOpHard128(const KoColorSpace *cs);
     static KoCompositeOp* createAlphaDarkenOpCreamy128(const KoColorSpace *cs);
     static KoCompositeOp* createOverOp128(const KoColorSpace *cs);
+
+    static KoCompositeOp* createAlphaDarkenOpHardU16(const KoColorSpace *cs);
+    static KoCompositeOp* createAlphaDarkenOpCreamyU16(const KoColorSpace *cs);
+    static KoCompositeOp* createOverOpU16(const KoColorSpace *cs);
+    static KoCompositeOp* createCopyOpU16(const KoColorSpace *cs);
+    static KoCompositeOp* createEraseOpU16(const KoColorSpace *cs);
+
+#ifdef HAVE_OPENEXR
+    static KoCompositeOp* createAlphaDarkenOpHardF16(const KoColorSpace *cs);
+    static KoCompositeOp* createAlphaDarkenOpCreamyF16(const KoColorSpace *cs);
+    static KoCompositeOp* createOverOpF16(const KoColorSpace *cs);
+    static KoCompositeOp* createCopyOpF16(const KoColorSpace *cs);
+    static KoCompositeOp* createEraseOpF16(const KoColorSpace *cs);
+#endif
+
+    /**
+     * Create vectorized versions of the separable blending modes for
+     * 8-bit, 16-bit and 32-bit float RGBA colorspaces. Return null if
+     * there is no optimized version of the mode \p id.
+     */
+    static KoCompositeOp* createGenericSCOp32(const KoColorSpace *cs, const QString &id, const QString &description, const QString &category);
+    static KoCompositeOp* createGenericSCOp64(const KoColorSpace *cs, const QString &id, const QString &description, const QString &category);
+    static KoCompositeOp* createGenericSCOp128(const KoColorSpace *cs, const QString &id, const QString &description, const QString &category);
 };
 
 #endif /* KOOPTIMIZEDCOMPOSITEOPFACTORY_H */
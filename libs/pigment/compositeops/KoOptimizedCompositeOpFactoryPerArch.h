@@ -23,6 +23,7 @@
 
 #include <compositeops/KoVcMultiArchBuildSupport.h>
 
+#include <QString>
 
 class KoCompositeOp;
 class KoColorSpace;
@@ -46,6 +47,36 @@ class KoOptimizedCompositeOpAlphaDarkenCreamy128;
 template<Vc::Implementation _impl>
 class KoOptimizedCompositeOpOver128;
 
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpOverU16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenHardU16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenCreamyU16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpCopyU16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpEraseU16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpOverF16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenHardF16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpAlphaDarkenCreamyF16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpCopyF16;
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpEraseF16;
+
 template<template<Vc::Implementation I> class CompositeOp>
 struct KoOptimizedCompositeOpFactoryPerArch
 {
@@ -56,5 +87,34 @@ struct KoOptimizedCompositeOpFactoryPerArch
     static ReturnType create(ParamType param);
 };
 
+/**
+ * Creates a vectorized version of a separable blending mode
+ * (see KoCompositeOpGenericSC) for RGBA colorspace with \p Traits.
+ * The mode is selected by the id of the composite op. If there is
+ * no optimized version of the mode, null is returned and the caller
+ * should fall back to the generic op.
+ */
+template<class Traits>
+struct KoOptimizedCompositeOpGenericSCFactoryPerArch
+{
+    struct Params {
+        Params(const KoColorSpace *_cs, const QString &_id, const QString &_description, const QString &_category)
+            : cs(_cs), id(_id), description(_description), category(_category)
+        {
+        }
+
+        const KoColorSpace *cs;
+        QString id;
+        QString description;
+        QString category;
+    };
+
+    typedef const Params& ParamType;
+    typedef KoCompositeOp* ReturnType;
+
+    template<Vc::Implementation _impl>
+    static ReturnType create(ParamType param);
+};
+
 
 #endif /* KOOPTIMIZEDCOMPOSITEOPFACTORYPERARCH_H */
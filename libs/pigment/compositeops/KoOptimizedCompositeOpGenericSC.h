@@ -0,0 +1,414 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KOOPTIMIZEDCOMPOSITEOPGENERICSC_H
+#define KOOPTIMIZEDCOMPOSITEOPGENERICSC_H
+
+#include <limits>
+
+#include "KoCompositeOpGeneric.h"
+#include "KoCompositeOpRegistry.h"
+#include "KoStreamedMath.h"
+
+
+/**
+ * Vectorized counterparts of the separable blending functions from
+ * KoCompositeOpFunctions.h. vector() works with channel values
+ * normalized into 0.0...1.0 range, scalar() is the original function
+ * used for unaligned pixels and non-trivial channel flags.
+ *
+ * NOTE: all the functions are templated by the implementation (even
+ *       the scalar ones), otherwise the versions compiled for different
+ *       architectures would be merged by the linker.
+ */
+namespace KoStreamedBlendFunctions {
+
+/**
+ * Integer channels cannot go out of the unit range, so the results
+ * of the blending functions are clamped the same way as
+ * Arithmetic::clamp() does for them. Floating point channels are
+ * left untouched.
+ */
+template<Vc::Implementation _impl, typename channels_type>
+ALWAYS_INLINE Vc::float_v clampToUnitRange(Vc::float_v::AsArg value) {
+    return std::numeric_limits<channels_type>::is_integer ?
+        Vc::min(Vc::max(value, Vc::float_v(Vc::Zero)), Vc::float_v(Vc::One)) :
+        value;
+}
+
+template<Vc::Implementation _impl>
+ALWAYS_INLINE Vc::float_v screen(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+    return src + dst - src * dst;
+}
+
+template<Vc::Implementation _impl>
+ALWAYS_INLINE Vc::float_v hardLight(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+    const Vc::float_v src2 = src + src;
+    return Vc::iif(src > Vc::float_v(0.5f),
+                   screen<_impl>(src2 - Vc::float_v(Vc::One), dst),
+                   src2 * dst);
+}
+
+struct Multiply {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfMultiply(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return src * dst;
+    }
+};
+
+struct Screen {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfScreen(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return screen<_impl>(src, dst);
+    }
+};
+
+struct Overlay {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfOverlay(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return hardLight<_impl>(dst, src);
+    }
+};
+
+struct HardLight {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfHardLight(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return hardLight<_impl>(src, dst);
+    }
+};
+
+struct SoftLight {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfSoftLight(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        const Vc::float_v oneValue(Vc::One);
+        const Vc::float_v src2 = src + src;
+
+        return clampToUnitRange<_impl, channels_type>(
+            Vc::iif(src > Vc::float_v(0.5f),
+                    dst + (src2 - oneValue) * (Vc::sqrt(dst) - dst),
+                    dst - (oneValue - src2) * dst * (oneValue - dst)));
+    }
+};
+
+struct SoftLightSvg {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfSoftLightSvg(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        const Vc::float_v oneValue(Vc::One);
+        const Vc::float_v src2 = src + src;
+
+        const Vc::float_v D =
+            Vc::iif(dst > Vc::float_v(0.25f),
+                    Vc::sqrt(dst),
+                    ((Vc::float_v(16.0f) * dst - Vc::float_v(12.0f)) * dst + Vc::float_v(4.0f)) * dst);
+
+        return clampToUnitRange<_impl, channels_type>(
+            Vc::iif(src > Vc::float_v(0.5f),
+                    dst + (src2 - oneValue) * (D - dst),
+                    dst - (oneValue - src2) * dst * (oneValue - dst)));
+    }
+};
+
+struct ColorDodge {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfColorDodge(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        const Vc::float_v oneValue(Vc::One);
+
+        // the division by zero is masked out by iif()
+        return Vc::iif(src == oneValue,
+                       oneValue,
+                       clampToUnitRange<_impl, channels_type>(dst / (oneValue - src)));
+    }
+};
+
+struct ColorBurn {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfColorBurn(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        const Vc::float_v oneValue(Vc::One);
+        const Vc::float_v invDst = oneValue - dst;
+
+        // the division by zero is masked out by iif()
+        return Vc::iif(dst == oneValue,
+                       oneValue,
+                       Vc::iif(src < invDst,
+                               Vc::float_v(Vc::Zero),
+                               oneValue - clampToUnitRange<_impl, channels_type>(invDst / src)));
+    }
+};
+
+struct Darken {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfDarkenOnly(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return Vc::min(src, dst);
+    }
+};
+
+struct Lighten {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfLightenOnly(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return Vc::max(src, dst);
+    }
+};
+
+struct Addition {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfAddition(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return clampToUnitRange<_impl, channels_type>(src + dst);
+    }
+};
+
+struct Subtract {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfSubtract(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return clampToUnitRange<_impl, channels_type>(dst - src);
+    }
+};
+
+struct Difference {
+    template<Vc::Implementation _impl, typename T> static inline T scalar(T src, T dst) { return cfDifference(src, dst); }
+
+    template<Vc::Implementation _impl, typename channels_type>
+    static ALWAYS_INLINE Vc::float_v vector(Vc::float_v::AsArg src, Vc::float_v::AsArg dst) {
+        return Vc::max(src, dst) - Vc::min(src, dst);
+    }
+};
+
+}
+
+
+template<class Traits, class BlendFunction>
+struct GenericSCCompositor {
+    typedef typename Traits::channels_type channels_type;
+
+    template<Vc::Implementation _impl>
+    struct ScalarOp {
+        typedef KoCompositeOpGenericSC<Traits, &BlendFunction::template scalar<_impl, channels_type> > type;
+    };
+
+    static const qint32 alpha_pos = Traits::alpha_pos;
+
+    struct ParamsWrapper {
+        ParamsWrapper(const KoCompositeOp::ParameterInfo& params)
+            : opacity(Arithmetic::scale<channels_type>(params.opacity)),
+              channelFlags(params.channelFlags)
+        {
+        }
+        const channels_type opacity;
+        const QBitArray &channelFlags;
+    };
+
+    /**
+     * The vector version of KoCompositeOpGenericSC::composeColorChannels()
+     * for the case when all the channel flags are set and alpha is not locked.
+     */
+    template<bool haveMask, bool src_aligned, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeVector(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        Q_UNUSED(oparams);
+
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+
+        Vc::float_v src_c1;
+        Vc::float_v src_c2;
+        Vc::float_v src_c3;
+        Vc::float_v src_alpha;
+
+        PixelIO::template fetch<src_aligned>(src, src_c1, src_c2, src_c3, src_alpha);
+
+        src_alpha *= Vc::float_v(opacity);
+
+        if (haveMask) {
+            const Vc::float_v uint8MaxRec1((float)1.0 / 255.0);
+            src_alpha *= KoStreamedMath<_impl>::fetch_mask_8(mask) * uint8MaxRec1;
+        }
+
+        const Vc::float_v zeroValue(Vc::Zero);
+
+        // The source cannot change the colors in the destination,
+        // since its fully transparent
+        if ((src_alpha == zeroValue).isFull()) {
+            return;
+        }
+
+        Vc::float_v dst_c1;
+        Vc::float_v dst_c2;
+        Vc::float_v dst_c3;
+        Vc::float_v dst_alpha;
+
+        PixelIO::template fetch<true>(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+
+        /**
+         * Arithmetic::blend() split into the weights of the source,
+         * the destination and the blended color respectively
+         */
+        const Vc::float_v both_alpha = src_alpha * dst_alpha;
+        const Vc::float_v src_only = src_alpha - both_alpha;
+        const Vc::float_v dst_only = dst_alpha - both_alpha;
+        const Vc::float_v new_alpha = src_alpha + dst_only;
+
+        /**
+         * The pixels with zero new alpha keep their color untouched,
+         * exactly like the scalar version does
+         */
+        const Vc::float_m empty_mask = new_alpha == zeroValue;
+        Vc::float_v new_alpha_rec = Vc::float_v(Vc::One) / new_alpha;
+        new_alpha_rec.setZero(empty_mask);
+
+        Vc::float_v result_c1 =
+            (src_only * src_c1 + dst_only * dst_c1 +
+             both_alpha * BlendFunction::template vector<_impl, channels_type>(src_c1, dst_c1)) * new_alpha_rec;
+        Vc::float_v result_c2 =
+            (src_only * src_c2 + dst_only * dst_c2 +
+             both_alpha * BlendFunction::template vector<_impl, channels_type>(src_c2, dst_c2)) * new_alpha_rec;
+        Vc::float_v result_c3 =
+            (src_only * src_c3 + dst_only * dst_c3 +
+             both_alpha * BlendFunction::template vector<_impl, channels_type>(src_c3, dst_c3)) * new_alpha_rec;
+
+        if (!empty_mask.isEmpty()) {
+            result_c1 = Vc::iif(empty_mask, dst_c1, result_c1);
+            result_c2 = Vc::iif(empty_mask, dst_c2, result_c2);
+            result_c3 = Vc::iif(empty_mask, dst_c3, result_c3);
+        }
+
+        PixelIO::write(dst, result_c1, result_c2, result_c3, new_alpha);
+    }
+
+    template <bool haveMask, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeOnePixelScalar(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        using namespace Arithmetic;
+        Q_UNUSED(opacity);
+
+        const channels_type *s = reinterpret_cast<const channels_type*>(src);
+        channels_type *d = reinterpret_cast<channels_type*>(dst);
+
+        const channels_type maskAlpha =
+            haveMask ? scale<channels_type>(*mask) : unitValue<channels_type>();
+
+        d[alpha_pos] =
+            ScalarOp<_impl>::type::template composeColorChannels<false, true>(
+                s, s[alpha_pos], d, d[alpha_pos],
+                maskAlpha, oparams.opacity, oparams.channelFlags);
+    }
+};
+
+/**
+ * An optimized version of KoCompositeOpGenericSC for RGBA colorspaces
+ * with the alpha channel placed at the end of the pixel. The vector
+ * code path is used when all the channel flags are set, otherwise the
+ * composition is delegated to the generic scalar op.
+ */
+template<Vc::Implementation _impl, class Traits, class BlendFunction>
+class KoOptimizedCompositeOpGenericSC : public KoCompositeOp
+{
+    typedef GenericSCCompositor<Traits, BlendFunction> Compositor;
+
+public:
+    KoOptimizedCompositeOpGenericSC(const KoColorSpace* cs, const QString& id, const QString& description, const QString& category)
+        : KoCompositeOp(cs, id, description, category),
+          m_scalarOp(cs, id, description, category)
+    {
+    }
+
+    using KoCompositeOp::composite;
+
+    virtual void composite(const KoCompositeOp::ParameterInfo& params) const
+    {
+        if (params.channelFlags.isEmpty() ||
+            params.channelFlags == QBitArray(Traits::channels_nb, true)) {
+
+            if (params.maskRowStart) {
+                KoStreamedMath<_impl>::template genericComposite<true, false, Compositor, Traits::pixelSize>(params);
+            } else {
+                KoStreamedMath<_impl>::template genericComposite<false, false, Compositor, Traits::pixelSize>(params);
+            }
+        } else {
+            m_scalarOp.composite(params);
+        }
+    }
+
+private:
+    typename Compositor::template ScalarOp<_impl>::type m_scalarOp;
+};
+
+/**
+ * Creates a vectorized version of the separable blending mode \p id
+ * for \p Traits colorspace. Returns null if the mode has no vector
+ * implementation yet.
+ */
+template<Vc::Implementation _impl, class Traits>
+KoCompositeOp* createOptimizedCompositeOpGenericSC(const KoColorSpace *cs, const QString &id, const QString &description, const QString &category)
+{
+    using namespace KoStreamedBlendFunctions;
+
+    if (id == COMPOSITE_MULT) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Multiply>(cs, id, description, category);
+    } else if (id == COMPOSITE_SCREEN) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Screen>(cs, id, description, category);
+    } else if (id == COMPOSITE_OVERLAY) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Overlay>(cs, id, description, category);
+    } else if (id == COMPOSITE_HARD_LIGHT) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, HardLight>(cs, id, description, category);
+    } else if (id == COMPOSITE_SOFT_LIGHT_PHOTOSHOP) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, SoftLight>(cs, id, description, category);
+    } else if (id == COMPOSITE_SOFT_LIGHT_SVG) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, SoftLightSvg>(cs, id, description, category);
+    } else if (id == COMPOSITE_DODGE) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, ColorDodge>(cs, id, description, category);
+    } else if (id == COMPOSITE_BURN) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, ColorBurn>(cs, id, description, category);
+    } else if (id == COMPOSITE_DARKEN) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Darken>(cs, id, description, category);
+    } else if (id == COMPOSITE_LIGHTEN) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Lighten>(cs, id, description, category);
+    } else if (id == COMPOSITE_ADD || id == COMPOSITE_LINEAR_DODGE) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Addition>(cs, id, description, category);
+    } else if (id == COMPOSITE_SUBTRACT) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Subtract>(cs, id, description, category);
+    } else if (id == COMPOSITE_DIFF) {
+        return new KoOptimizedCompositeOpGenericSC<_impl, Traits, Difference>(cs, id, description, category);
+    }
+
+    return 0;
+}
+
+#endif // KOOPTIMIZEDCOMPOSITEOPGENERICSC_H
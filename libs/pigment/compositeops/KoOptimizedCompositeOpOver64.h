@@ -0,0 +1,234 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef KOOPTIMIZEDCOMPOSITEOPOVER64_H
+#define KOOPTIMIZEDCOMPOSITEOPOVER64_H
+
+#include "KoCompositeOpBase.h"
+#include "KoCompositeOpRegistry.h"
+#include "KoStreamedMath.h"
+
+
+/**
+ * Over compositor for 8 byte RGBA pixels (16-bit integer or half float
+ * channels). The math is done in normalized floats, the conversion
+ * is done by KoStreamedPixelIO.
+ */
+template<typename channels_type, bool alphaLocked, bool allChannelsFlag>
+struct OverCompositor64 {
+    struct ParamsWrapper {
+        ParamsWrapper(const KoCompositeOp::ParameterInfo& params)
+            : channelFlags(params.channelFlags)
+        {
+        }
+        const QBitArray &channelFlags;
+    };
+
+    // \see docs in AlphaDarkenCompositor32
+    template<bool haveMask, bool src_aligned, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeVector(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        Q_UNUSED(oparams);
+
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+
+        Vc::float_v src_c1;
+        Vc::float_v src_c2;
+        Vc::float_v src_c3;
+        Vc::float_v src_alpha;
+
+        PixelIO::template fetch<src_aligned>(src, src_c1, src_c2, src_c3, src_alpha);
+
+        src_alpha *= Vc::float_v(opacity);
+
+        if (haveMask) {
+            const Vc::float_v uint8MaxRec1((float)1.0 / 255.0);
+            src_alpha *= KoStreamedMath<_impl>::fetch_mask_8(mask) * uint8MaxRec1;
+        }
+
+        const Vc::float_v zeroValue(Vc::Zero);
+
+        // The source cannot change the colors in the destination,
+        // since its fully transparent
+        if ((src_alpha == zeroValue).isFull()) {
+            return;
+        }
+
+        Vc::float_v dst_c1;
+        Vc::float_v dst_c2;
+        Vc::float_v dst_c3;
+        Vc::float_v dst_alpha;
+
+        PixelIO::template fetch<true>(dst, dst_c1, dst_c2, dst_c3, dst_alpha);
+
+        Vc::float_v src_blend;
+        Vc::float_v new_alpha;
+
+        const Vc::float_v oneValue(Vc::One);
+        if ((dst_alpha == oneValue).isFull()) {
+            new_alpha = dst_alpha;
+            src_blend = src_alpha;
+        } else if ((dst_alpha == zeroValue).isFull()) {
+            new_alpha = src_alpha;
+            src_blend = oneValue;
+        } else {
+            /**
+             * The value of new_alpha can have *some* zero values,
+             * which will result in NaN values while division.
+             */
+            new_alpha = dst_alpha + (oneValue - dst_alpha) * src_alpha;
+            Vc::float_m mask = (new_alpha == zeroValue);
+            src_blend = src_alpha / new_alpha;
+            src_blend.setZero(mask);
+        }
+
+        if (!(src_blend == oneValue).isFull()) {
+            dst_c1 = src_blend * (src_c1 - dst_c1) + dst_c1;
+            dst_c2 = src_blend * (src_c2 - dst_c2) + dst_c2;
+            dst_c3 = src_blend * (src_c3 - dst_c3) + dst_c3;
+
+            PixelIO::write(dst, dst_c1, dst_c2, dst_c3, new_alpha);
+        } else {
+            PixelIO::write(dst, src_c1, src_c2, src_c3, new_alpha);
+        }
+    }
+
+    template <bool haveMask, Vc::Implementation _impl>
+    static ALWAYS_INLINE void compositeOnePixelScalar(const quint8 *src, quint8 *dst, const quint8 *mask, float opacity, const ParamsWrapper &oparams)
+    {
+        typedef KoStreamedPixelIO<_impl, channels_type> PixelIO;
+        const qint32 alpha_pos = 3;
+
+        const channels_type *s = reinterpret_cast<const channels_type*>(src);
+        channels_type *d = reinterpret_cast<channels_type*>(dst);
+
+        float srcAlpha = PixelIO::normalize(s[alpha_pos]);
+        srcAlpha *= opacity;
+
+        if (haveMask) {
+            const float uint8Rec1 = 1.0 / 255;
+            srcAlpha *= float(*mask) * uint8Rec1;
+        }
+
+        if (srcAlpha != 0.0f) {
+
+            float dstAlpha = PixelIO::normalize(d[alpha_pos]);
+            float srcBlendNorm;
+
+            if (dstAlpha == 1.0f) {
+                srcBlendNorm = srcAlpha;
+            } else if (dstAlpha == 0.0f) {
+                dstAlpha = srcAlpha;
+                srcBlendNorm = 1.0f;
+
+                if (!allChannelsFlag) {
+                    KoStreamedMathFunctions::clearPixel<8>(dst);
+                }
+            } else {
+                dstAlpha += (1.0f - dstAlpha) * srcAlpha;
+                srcBlendNorm = srcAlpha / dstAlpha;
+            }
+
+            for (int i = 0; i < 3; i++) {
+                if (allChannelsFlag || oparams.channelFlags.at(i)) {
+                    if (srcBlendNorm == 1.0f) {
+                        d[i] = s[i];
+                    } else if (srcBlendNorm != 0.0f) {
+                        const float dstValue = PixelIO::normalize(d[i]);
+                        const float srcValue = PixelIO::normalize(s[i]);
+                        d[i] = PixelIO::denormalize(srcBlendNorm * (srcValue - dstValue) + dstValue);
+                    }
+                }
+            }
+
+            if (!alphaLocked) {
+                d[alpha_pos] = PixelIO::denormalize(dstAlpha);
+            }
+        }
+    }
+};
+
+/**
+ * An optimized version of a composite op for the use in 8 byte
+ * colorspaces with alpha channel placed at the last channel of
+ * the pixel: C1_C2_C3_A.
+ */
+template<Vc::Implementation _impl, typename channels_type>
+class KoOptimizedCompositeOpOver64 : public KoCompositeOp
+{
+public:
+    KoOptimizedCompositeOpOver64(const KoColorSpace* cs)
+        : KoCompositeOp(cs, COMPOSITE_OVER, i18n("Normal"), KoCompositeOp::categoryMix()) {}
+
+    using KoCompositeOp::composite;
+
+    virtual void composite(const KoCompositeOp::ParameterInfo& params) const
+    {
+        if(params.maskRowStart) {
+            composite<true>(params);
+        } else {
+            composite<false>(params);
+        }
+    }
+
+    template <bool haveMask>
+    inline void composite(const KoCompositeOp::ParameterInfo& params) const {
+        if (params.channelFlags.isEmpty() ||
+            params.channelFlags == QBitArray(4, true)) {
+
+            KoStreamedMath<_impl>::template genericComposite64<haveMask, false, OverCompositor64<channels_type, false, true> >(params);
+        } else {
+            const bool allChannelsFlag =
+                params.channelFlags.at(0) &&
+                params.channelFlags.at(1) &&
+                params.channelFlags.at(2);
+
+            const bool alphaLocked =
+                !params.channelFlags.at(3);
+
+            if (allChannelsFlag && alphaLocked) {
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, OverCompositor64<channels_type, true, true> >(params);
+            } else if (!allChannelsFlag && !alphaLocked) {
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, OverCompositor64<channels_type, false, false> >(params);
+            } else /*if (!allChannelsFlag && alphaLocked) */{
+                KoStreamedMath<_impl>::template genericComposite64_novector<haveMask, false, OverCompositor64<channels_type, true, false> >(params);
+            }
+        }
+    }
+};
+
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpOverU16 : public KoOptimizedCompositeOpOver64<_impl, quint16>
+{
+public:
+    KoOptimizedCompositeOpOverU16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpOver64<_impl, quint16>(cs) {}
+};
+
+#ifdef HAVE_OPENEXR
+template<Vc::Implementation _impl>
+class KoOptimizedCompositeOpOverF16 : public KoOptimizedCompositeOpOver64<_impl, half>
+{
+public:
+    KoOptimizedCompositeOpOverF16(const KoColorSpace* cs)
+        : KoOptimizedCompositeOpOver64<_impl, half>(cs) {}
+};
+#endif
+
+#endif // KOOPTIMIZEDCOMPOSITEOPOVER64_H
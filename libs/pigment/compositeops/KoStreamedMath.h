@@ -37,6 +37,15 @@
 #include <iostream>
 #include <KoCompositeOp.h>
 
+#include <KoConfig.h>
+#ifdef HAVE_OPENEXR
+#include <half.h>
+#endif
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
 #define BLOCKDEBUG 0
 
 #if !defined _MSC_VER
@@ -97,6 +106,12 @@ template<bool useMask, bool useFlow, class Compositor>
     genericComposite_novector<useMask, useFlow, Compositor, 4>(params);
 }
 
+template<bool useMask, bool useFlow, class Compositor>
+    static void genericComposite64_novector(const KoCompositeOp::ParameterInfo& params)
+{
+    genericComposite_novector<useMask, useFlow, Compositor, 8>(params);
+}
+
 template<bool useMask, bool useFlow, class Compositor>
     static void genericComposite128_novector(const KoCompositeOp::ParameterInfo& params)
 {
@@ -376,6 +391,12 @@ template<bool useMask, bool useFlow, class Compositor>
     genericComposite<useMask, useFlow, Compositor, 4>(params);
 }
 
+template<bool useMask, bool useFlow, class Compositor>
+    static void genericComposite64(const KoCompositeOp::ParameterInfo& params)
+{
+    genericComposite<useMask, useFlow, Compositor, 8>(params);
+}
+
 template<bool useMask, bool useFlow, class Compositor>
     static void genericComposite128(const KoCompositeOp::ParameterInfo& params)
 {
@@ -384,6 +405,242 @@ template<bool useMask, bool useFlow, class Compositor>
 
 };
 
+/**
+ * Loads and stores Vc::float_v::size() RGBA pixels with \p channels_type
+ * channels as separate channel vectors normalized into 0.0...1.0 range.
+ * The alpha channel is expected to be the last one in the pixel.
+ *
+ * NOTE: the order of the color channels is the same for fetch() and
+ *       write(), but is not guaranteed to follow the order of the
+ *       channels in memory, so the helpers are suitable for separable
+ *       operations only.
+ */
+template<Vc::Implementation _impl, typename channels_type>
+struct KoStreamedPixelIO;
+
+template<Vc::Implementation _impl>
+struct KoStreamedPixelIO<_impl, quint8>
+{
+    static ALWAYS_INLINE float normalize(quint8 value) {
+        return float(value) * ((float)1.0 / 255.0);
+    }
+
+    static ALWAYS_INLINE quint8 denormalize(float value) {
+        return quint8(qBound(0.0f, value * 255.0f, 255.0f) + 0.5f);
+    }
+
+    template <bool aligned>
+    static ALWAYS_INLINE void fetch(const quint8 *data,
+                                    Vc::float_v &c1,
+                                    Vc::float_v &c2,
+                                    Vc::float_v &c3,
+                                    Vc::float_v &alpha) {
+        const Vc::float_v uint8MaxRec1((float)1.0 / 255.0);
+
+        KoStreamedMath<_impl>::template fetch_colors_32<aligned>(data, c1, c2, c3);
+        alpha = KoStreamedMath<_impl>::template fetch_alpha_32<aligned>(data);
+
+        c1 *= uint8MaxRec1;
+        c2 *= uint8MaxRec1;
+        c3 *= uint8MaxRec1;
+        alpha *= uint8MaxRec1;
+    }
+
+    /**
+     * NOTE: \p data must be aligned pointer!
+     */
+    static ALWAYS_INLINE void write(quint8 *data,
+                                    Vc::float_v::AsArg c1,
+                                    Vc::float_v::AsArg c2,
+                                    Vc::float_v::AsArg c3,
+                                    Vc::float_v::AsArg alpha) {
+        const Vc::float_v uint8Max((float)255.0);
+
+        KoStreamedMath<_impl>::write_channels_32(data,
+                                                 alpha * uint8Max,
+                                                 c1 * uint8Max,
+                                                 c2 * uint8Max,
+                                                 c3 * uint8Max);
+    }
+};
+
+template<Vc::Implementation _impl>
+struct KoStreamedPixelIO<_impl, quint16>
+{
+    static ALWAYS_INLINE float normalize(quint16 value) {
+        return float(value) * ((float)1.0 / 65535.0);
+    }
+
+    static ALWAYS_INLINE quint16 denormalize(float value) {
+        return quint16(qBound(0.0f, value * 65535.0f, 65535.0f) + 0.5f);
+    }
+
+    template <bool aligned>
+    static ALWAYS_INLINE void fetch(const quint8 *data,
+                                    Vc::float_v &c1,
+                                    Vc::float_v &c2,
+                                    Vc::float_v &c3,
+                                    Vc::float_v &alpha) {
+        const quint16 *ptr = reinterpret_cast<const quint16*>(data);
+        const Vc::float_v uint16MaxRec1((float)1.0 / 65535.0);
+        const Vc::float_v::IndexType indexes =
+            Vc::float_v::IndexType(Vc::IndexesFromZero) * 4;
+
+        c1.gather(ptr, indexes);
+        c2.gather(ptr + 1, indexes);
+        c3.gather(ptr + 2, indexes);
+        alpha.gather(ptr + 3, indexes);
+
+        c1 *= uint16MaxRec1;
+        c2 *= uint16MaxRec1;
+        c3 *= uint16MaxRec1;
+        alpha *= uint16MaxRec1;
+    }
+
+    static ALWAYS_INLINE void write(quint8 *data,
+                                    Vc::float_v::AsArg c1,
+                                    Vc::float_v::AsArg c2,
+                                    Vc::float_v::AsArg c3,
+                                    Vc::float_v::AsArg alpha) {
+        const Vc::float_v uint16Max((float)65535.0);
+        const Vc::float_v zeroValue(Vc::Zero);
+
+        // the values must be clamped, otherwise they would overflow
+        // when converted into integers
+        const Vc::float_v v1 = Vc::round(Vc::min(Vc::max(c1 * uint16Max, zeroValue), uint16Max));
+        const Vc::float_v v2 = Vc::round(Vc::min(Vc::max(c2 * uint16Max, zeroValue), uint16Max));
+        const Vc::float_v v3 = Vc::round(Vc::min(Vc::max(c3 * uint16Max, zeroValue), uint16Max));
+        const Vc::float_v v4 = Vc::round(Vc::min(Vc::max(alpha * uint16Max, zeroValue), uint16Max));
+
+        quint16 *ptr = reinterpret_cast<quint16*>(data);
+
+        for (size_t i = 0; i < Vc::float_v::size(); i++) {
+            ptr[0] = quint16(v1[i]);
+            ptr[1] = quint16(v2[i]);
+            ptr[2] = quint16(v3[i]);
+            ptr[3] = quint16(v4[i]);
+            ptr += 4;
+        }
+    }
+};
+
+template<Vc::Implementation _impl>
+struct KoStreamedPixelIO<_impl, float>
+{
+    static ALWAYS_INLINE float normalize(float value) {
+        return value;
+    }
+
+    static ALWAYS_INLINE float denormalize(float value) {
+        return value;
+    }
+
+    struct Pixel {
+        float c1;
+        float c2;
+        float c3;
+        float alpha;
+    };
+
+    template <bool aligned>
+    static ALWAYS_INLINE void fetch(const quint8 *data,
+                                    Vc::float_v &c1,
+                                    Vc::float_v &c2,
+                                    Vc::float_v &c3,
+                                    Vc::float_v &alpha) {
+        const Vc::float_v::IndexType indexes(Vc::IndexesFromZero);
+        Vc::InterleavedMemoryWrapper<Pixel, Vc::float_v> wrapper(
+            reinterpret_cast<Pixel*>(const_cast<quint8*>(data)));
+        tie(c1, c2, c3, alpha) = wrapper[indexes];
+    }
+
+    static ALWAYS_INLINE void write(quint8 *data,
+                                    Vc::float_v::AsArg c1,
+                                    Vc::float_v::AsArg c2,
+                                    Vc::float_v::AsArg c3,
+                                    Vc::float_v::AsArg alpha) {
+        Vc::float_v v1(c1);
+        Vc::float_v v2(c2);
+        Vc::float_v v3(c3);
+        Vc::float_v v4(alpha);
+
+        const Vc::float_v::IndexType indexes(Vc::IndexesFromZero);
+        Vc::InterleavedMemoryWrapper<Pixel, Vc::float_v> wrapper(reinterpret_cast<Pixel*>(data));
+        wrapper[indexes] = tie(v1, v2, v3, v4);
+    }
+};
+
+#ifdef HAVE_OPENEXR
+
+/**
+ * Half floats are converted into a temporary buffer of floats and then
+ * deinterleaved the same way as 32-bit float pixels. When F16C is
+ * available the conversion is done by the hardware, otherwise OpenEXR's
+ * lookup table is used.
+ */
+template<Vc::Implementation _impl>
+struct KoStreamedPixelIO<_impl, half>
+{
+    static const int numValues = 4 * Vc::float_v::size();
+
+    static ALWAYS_INLINE float normalize(half value) {
+        return float(value);
+    }
+
+    static ALWAYS_INLINE half denormalize(float value) {
+        return half(value);
+    }
+
+    static ALWAYS_INLINE void convertToFloat(const half *src, float *dst) {
+#ifdef __F16C__
+        for (int i = 0; i < numValues; i += 4) {
+            const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_ps(dst + i, _mm_cvtph_ps(values));
+        }
+#else
+        for (int i = 0; i < numValues; i++) {
+            dst[i] = src[i];
+        }
+#endif
+    }
+
+    static ALWAYS_INLINE void convertFromFloat(const float *src, half *dst) {
+#ifdef __F16C__
+        for (int i = 0; i < numValues; i += 4) {
+            const __m128i values = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), values);
+        }
+#else
+        for (int i = 0; i < numValues; i++) {
+            dst[i] = src[i];
+        }
+#endif
+    }
+
+    template <bool aligned>
+    static ALWAYS_INLINE void fetch(const quint8 *data,
+                                    Vc::float_v &c1,
+                                    Vc::float_v &c2,
+                                    Vc::float_v &c3,
+                                    Vc::float_v &alpha) {
+        float buf[numValues];
+        convertToFloat(reinterpret_cast<const half*>(data), buf);
+        KoStreamedPixelIO<_impl, float>::template fetch<false>(reinterpret_cast<quint8*>(buf), c1, c2, c3, alpha);
+    }
+
+    static ALWAYS_INLINE void write(quint8 *data,
+                                    Vc::float_v::AsArg c1,
+                                    Vc::float_v::AsArg c2,
+                                    Vc::float_v::AsArg c3,
+                                    Vc::float_v::AsArg alpha) {
+        float buf[numValues];
+        KoStreamedPixelIO<_impl, float>::write(reinterpret_cast<quint8*>(buf), c1, c2, c3, alpha);
+        convertFromFloat(buf, reinterpret_cast<half*>(data));
+    }
+};
+
+#endif /* HAVE_OPENEXR */
+
 namespace KoStreamedMathFunctions {
 
 template<int pixelSize>
@@ -396,6 +653,13 @@ ALWAYS_INLINE void clearPixel<4>(quint8* dst)
     *d = 0;
 }
 
+template<>
+ALWAYS_INLINE void clearPixel<8>(quint8* dst)
+{
+    quint64 *d = reinterpret_cast<quint64*>(dst);
+    *d = 0;
+}
+
 template<>
 ALWAYS_INLINE void clearPixel<16>(quint8* dst)
 {
@@ -415,6 +679,14 @@ ALWAYS_INLINE void copyPixel<4>(const quint8 *src, quint8* dst)
     *d = *s;
 }
 
+template<>
+ALWAYS_INLINE void copyPixel<8>(const quint8 *src, quint8* dst)
+{
+    const quint64 *s = reinterpret_cast<const quint64*>(src);
+    quint64 *d = reinterpret_cast<quint64*>(dst);
+    *d = *s;
+}
+
 template<>
 ALWAYS_INLINE void copyPixel<16>(const quint8 *src, quint8* dst)
 {
@@ -62,28 +62,142 @@ namespace Vc {
 
 
 #include <QDebug>
+#include <QString>
 #include <ksharedconfig.h>
 #include <kconfig.h>
 #include <kconfiggroup.h>
 
+/**
+ * Parses the name of a vector instruction set as used by the
+ * "forceVectorImplementation" config option and the
+ * KRITA_FORCE_VECTOR_IMPLEMENTATION environment variable.
+ *
+ * Returns false if \p name is not an implementation the optimized
+ * classes are built for. AVX-512 and NEON are not implemented by Vc
+ * (1.x), so on such CPUs AVX2 and the scalar version are used
+ * correspondingly.
+ */
+static inline bool parseVcImplementation(const QString &name, Vc::Implementation *impl)
+{
+    const QString id = name.trimmed().toLower();
+
+    if (id == "scalar") {
+        *impl = Vc::ScalarImpl;
+        return true;
+    }
+
+#ifdef HAVE_VC
+    if (id == "sse2") {
+        *impl = Vc::SSE2Impl;
+        return true;
+    } else if (id == "ssse3") {
+        *impl = Vc::SSSE3Impl;
+        return true;
+    } else if (id == "sse4.1" || id == "sse41") {
+        *impl = Vc::SSE41Impl;
+        return true;
+    } else if (id == "avx") {
+        *impl = Vc::AVXImpl;
+        return true;
+    } else if (id == "avx2") {
+        *impl = Vc::AVX2Impl;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
 template<class FactoryType>
 typename FactoryType::ReturnType
-createOptimizedClass(typename FactoryType::ParamType param)
+createOptimizedClassForImplementation(Vc::Implementation impl, typename FactoryType::ParamType param)
+{
+#ifdef HAVE_VC
+    switch (impl) {
+    case Vc::AVX2Impl:
+        return FactoryType::template create<Vc::AVX2Impl>(param);
+    case Vc::AVXImpl:
+        return FactoryType::template create<Vc::AVXImpl>(param);
+    case Vc::SSE41Impl:
+        return FactoryType::template create<Vc::SSE41Impl>(param);
+    case Vc::SSSE3Impl:
+        return FactoryType::template create<Vc::SSSE3Impl>(param);
+    case Vc::SSE2Impl:
+        return FactoryType::template create<Vc::SSE2Impl>(param);
+    default:
+        break;
+    }
+#else
+    Q_UNUSED(impl);
+#endif
+
+    return FactoryType::template create<Vc::ScalarImpl>(param);
+}
+
+struct KoVcImplementationSelection
+{
+    Vc::Implementation implementation = Vc::ScalarImpl;
+    bool isForced = false;
+};
+
+/**
+ * Selects the implementation the optimized classes are created for.
+ *
+ * The implementation can be forced for debugging and benchmarking
+ * purposes with the "forceVectorImplementation" config option or the
+ * KRITA_FORCE_VECTOR_IMPLEMENTATION environment variable. The
+ * environment variable has priority over the config option. Otherwise
+ * the best implementation supported by the CPU is used.
+ */
+static inline KoVcImplementationSelection detectVcImplementation()
 {
-    static bool isConfigInitialized = false;
-    static bool useVectorization = true;
-    static bool disableAVXOptimizations = false;
-
-    if (!isConfigInitialized) {
-        KConfigGroup cfg = KSharedConfig::openConfig()->group("");
-        useVectorization = !cfg.readEntry("amdDisableVectorWorkaround", false);
-        disableAVXOptimizations = cfg.readEntry("disableAVXOptimizations", false);
-        isConfigInitialized = true;
+    KoVcImplementationSelection selection;
+
+    KConfigGroup cfg = KSharedConfig::openConfig()->group("");
+    const bool useVectorization = !cfg.readEntry("amdDisableVectorWorkaround", false);
+    const bool disableAVXOptimizations = cfg.readEntry("disableAVXOptimizations", false);
+
+    QString forcedName = cfg.readEntry("forceVectorImplementation", QString());
+    if (qEnvironmentVariableIsSet("KRITA_FORCE_VECTOR_IMPLEMENTATION")) {
+        forcedName = QString::fromLatin1(qgetenv("KRITA_FORCE_VECTOR_IMPLEMENTATION"));
+    }
+
+    if (!forcedName.isEmpty()) {
+        Vc::Implementation forcedImplementation = Vc::ScalarImpl;
+
+        if (!parseVcImplementation(forcedName, &forcedImplementation)) {
+            qWarning() << "WARNING: unsupported vector implementation is requested:" << forcedName;
+        }
+#ifdef HAVE_VC
+        else if (forcedImplementation != Vc::ScalarImpl &&
+                 !Vc::isImplementationSupported(forcedImplementation)) {
+            qWarning() << "WARNING: the requested vector implementation is not supported by the CPU:" << forcedName;
+        }
+#endif
+        /**
+         * The safety options are workarounds for broken hardware and
+         * drivers, so forcing the implementation must not bypass them
+         */
+        else if (!useVectorization && forcedImplementation != Vc::ScalarImpl) {
+            qWarning() << "WARNING: the requested vector implementation is ignored, vector instructions are disabled by \'amdDisableVectorWorkaround\' option:" << forcedName;
+        }
+#ifdef HAVE_VC
+        else if (disableAVXOptimizations &&
+                 (forcedImplementation == Vc::AVXImpl ||
+                  forcedImplementation == Vc::AVX2Impl)) {
+            qWarning() << "WARNING: the requested vector implementation is ignored, AVX and AVX2 optimizations are disabled by \'disableAVXOptimizations\' option:" << forcedName;
+        }
+#endif
+        else {
+            selection.implementation = forcedImplementation;
+            selection.isForced = true;
+            return selection;
+        }
     }
 
     if (!useVectorization) {
         qWarning() << "WARNING: vector instructions disabled by \'amdDisableVectorWorkaround\' option!";
-        return FactoryType::template create<Vc::ScalarImpl>(param);
+        return selection;
     }
 
 #ifdef HAVE_VC
@@ -101,32 +215,52 @@ createOptimizedClass(typename FactoryType::ParamType param)
      * TODO: Add FMA3/4 when it is adopted by Vc
      */
     if (!disableAVXOptimizations && Vc::isImplementationSupported(Vc::AVX2Impl)) {
-        return FactoryType::template create<Vc::AVX2Impl>(param);
+        selection.implementation = Vc::AVX2Impl;
     } else if (!disableAVXOptimizations && Vc::isImplementationSupported(Vc::AVXImpl)) {
-        return FactoryType::template create<Vc::AVXImpl>(param);
+        selection.implementation = Vc::AVXImpl;
     } else if (Vc::isImplementationSupported(Vc::SSE41Impl)) {
-        return FactoryType::template create<Vc::SSE41Impl>(param);
+        selection.implementation = Vc::SSE41Impl;
     } else if (Vc::isImplementationSupported(Vc::SSSE3Impl)) {
-        return FactoryType::template create<Vc::SSSE3Impl>(param);
+        selection.implementation = Vc::SSSE3Impl;
     } else if (Vc::isImplementationSupported(Vc::SSE2Impl)) {
-        return FactoryType::template create<Vc::SSE2Impl>(param);
-    } else {
-#endif
-        return FactoryType::template create<Vc::ScalarImpl>(param);
-#ifdef HAVE_VC
+        selection.implementation = Vc::SSE2Impl;
     }
+#else
+    Q_UNUSED(disableAVXOptimizations);
 #endif
 
+    return selection;
+}
+
+static inline const KoVcImplementationSelection& currentVcImplementation()
+{
+    static const KoVcImplementationSelection selection = detectVcImplementation();
+    return selection;
+}
+
+template<class FactoryType>
+typename FactoryType::ReturnType
+createOptimizedClass(typename FactoryType::ParamType param)
+{
+    return createOptimizedClassForImplementation<FactoryType>(currentVcImplementation().implementation, param);
 }
 
+/**
+ * Same as above, but lets the caller ask for the scalar version, e.g.
+ * to compare the optimized brush masks against it. The forced
+ * implementation has priority over this request, so that the override
+ * covers all the optimized classes.
+ */
 template<class FactoryType>
 typename FactoryType::ReturnType
 createOptimizedClass(typename FactoryType::ParamType param, bool forceScalarImplemetation)
 {
-    if(forceScalarImplemetation){
+    const KoVcImplementationSelection &selection = currentVcImplementation();
+
+    if (forceScalarImplemetation && !selection.isForced) {
         return FactoryType::template create<Vc::ScalarImpl>(param);
     }
-    return createOptimizedClass<FactoryType>(param);
+    return createOptimizedClassForImplementation<FactoryType>(selection.implementation, param);
 }
 
 #endif /* __KOVCMULTIARCHBUILDSUPPORT_H */
@@ -0,0 +1,477 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; see the file COPYING.LIB.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "TestKoOptimizedCompositeOps.h"
+
+#include <QTest>
+
+#include <KoColorSpace.h>
+#include <KoColorSpaceRegistry.h>
+#include <KoColorModelStandardIds.h>
+#include <KoColorSpaceTraits.h>
+#include <KoCompositeOpRegistry.h>
+#include <KoCompositeOpFunctions.h>
+#include <KoCompositeOpGeneric.h>
+#include <KoCompositeOpOver.h>
+#include <KoCompositeOpAlphaDarken.h>
+#include <KoCompositeOpCopy2.h>
+#include <KoCompositeOpErase.h>
+#include <KoAlphaDarkenParamsWrapper.h>
+#include <KoOptimizedCompositeOpFactory.h>
+#include <KoConfig.h>
+
+#include <QScopedPointer>
+
+namespace {
+
+enum AlphaRange {
+    ALPHA_ZERO,
+    ALPHA_UNIT,
+    ALPHA_RANDOM
+};
+
+const int numColumns = 64;
+const int numRows = 64;
+const int numPixels = numColumns * numRows;
+
+/**
+ * Generates random pixels via normalized values to avoid garbage in
+ * the floating point channels
+ */
+QVector<quint8> generatePixels(const KoColorSpace *cs, AlphaRange alphaRange)
+{
+    const int pixelSize = cs->pixelSize();
+    const int alphaPos = cs->alphaPos();
+
+    QVector<quint8> pixels(numPixels * pixelSize);
+    QVector<float> channels(cs->channelCount());
+
+    for (int i = 0; i < numPixels; i++) {
+        for (int j = 0; j < channels.size(); j++) {
+            channels[j] = float(qrand()) / RAND_MAX;
+        }
+
+        if (alphaRange == ALPHA_ZERO) {
+            channels[alphaPos] = 0.0f;
+        } else if (alphaRange == ALPHA_UNIT) {
+            channels[alphaPos] = 1.0f;
+        }
+
+        cs->fromNormalisedChannelsValue(pixels.data() + i * pixelSize, channels);
+    }
+
+    return pixels;
+}
+
+QVector<quint8> generateMask()
+{
+    QVector<quint8> mask(numPixels);
+
+    for (int i = 0; i < numPixels; i++) {
+        mask[i] = qrand() & 0xFF;
+    }
+
+    return mask;
+}
+
+QString alphaRangeName(AlphaRange alphaRange)
+{
+    return alphaRange == ALPHA_ZERO ? "zero" :
+           alphaRange == ALPHA_UNIT ? "unit" : "random";
+}
+
+/**
+ * Compares two composited images. The alpha channel is compared
+ * directly, the color channels are compared premultiplied by alpha
+ * (see the comment in testGenericSCOps_data()). The precision is
+ * relative for the values larger than 1.0, which float color spaces
+ * may have.
+ */
+bool compareImages(const KoColorSpace *cs,
+                   const quint8 *actual, const quint8 *expected,
+                   qreal alphaPrecision, qreal colorPrecision)
+{
+    const int pixelSize = cs->pixelSize();
+    const int alphaPos = cs->alphaPos();
+
+    QVector<float> actChannels(cs->channelCount());
+    QVector<float> expChannels(cs->channelCount());
+
+    auto fuzzyCompare = [] (qreal a, qreal b, qreal prec) {
+        return qAbs(a - b) <= prec * qMax(qreal(1.0), qAbs(b));
+    };
+
+    for (int i = 0; i < numPixels; i++) {
+        cs->normalisedChannelsValue(actual + i * pixelSize, actChannels);
+        cs->normalisedChannelsValue(expected + i * pixelSize, expChannels);
+
+        bool result = fuzzyCompare(actChannels[alphaPos], expChannels[alphaPos], alphaPrecision);
+
+        for (int j = 0; result && j < actChannels.size(); j++) {
+            if (j == alphaPos) continue;
+
+            result = fuzzyCompare(qreal(actChannels[j]) * actChannels[alphaPos],
+                                  qreal(expChannels[j]) * expChannels[alphaPos],
+                                  colorPrecision);
+        }
+
+        if (!result) {
+            qDebug() << "Wrong result in pixel:" << i;
+            qDebug() << "Act:" << actChannels;
+            qDebug() << "Exp:" << expChannels;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Composites random pixels with both ops and compares the results. All
+ * the combinations of zero, unit and random source and destination
+ * alpha are checked, with and without a mask, at full and half opacity
+ * and flow.
+ */
+void compareOps(const KoColorSpace *cs,
+                const KoCompositeOp *opAct, const KoCompositeOp *opExp,
+                qreal alphaPrecision, qreal colorPrecision)
+{
+    qsrand(42);
+
+    const QVector<AlphaRange> alphaRanges = { ALPHA_ZERO, ALPHA_UNIT, ALPHA_RANDOM };
+
+    // some of the generic ops round the opacity to 8-bit, so it should
+    // be representable in 8-bit to be fair to the vector ops
+    const QVector<qreal> opacities = { 1.0, 128.0 / 255.0 };
+    const QVector<qreal> flows = { 1.0, 0.5 };
+
+    Q_FOREACH (AlphaRange srcAlphaRange, alphaRanges) {
+        Q_FOREACH (AlphaRange dstAlphaRange, alphaRanges) {
+            Q_FOREACH (qreal opacity, opacities) {
+                Q_FOREACH (qreal flow, flows) {
+                    for (int haveMask = 0; haveMask <= 1; haveMask++) {
+                        const QVector<quint8> src = generatePixels(cs, srcAlphaRange);
+                        const QVector<quint8> mask = generateMask();
+                        QVector<quint8> dstAct = generatePixels(cs, dstAlphaRange);
+                        QVector<quint8> dstExp = dstAct;
+
+                        KoCompositeOp::ParameterInfo params;
+                        params.srcRowStart = src.constData();
+                        params.srcRowStride = numColumns * cs->pixelSize();
+                        params.dstRowStride = numColumns * cs->pixelSize();
+                        params.maskRowStart = haveMask ? mask.constData() : 0;
+                        params.maskRowStride = numColumns;
+                        params.rows = numRows;
+                        params.cols = numColumns;
+                        params.opacity = opacity;
+                        params.flow = flow;
+                        params.channelFlags = QBitArray();
+
+                        params.dstRowStart = dstAct.data();
+                        opAct->composite(params);
+
+                        params.dstRowStart = dstExp.data();
+                        opExp->composite(params);
+
+                        const QString description =
+                            QString("src alpha: %1, dst alpha: %2, opacity: %3, flow: %4, mask: %5")
+                                .arg(alphaRangeName(srcAlphaRange))
+                                .arg(alphaRangeName(dstAlphaRange))
+                                .arg(opacity)
+                                .arg(flow)
+                                .arg(haveMask ? "yes" : "no");
+
+                        QVERIFY2(compareImages(cs, dstAct.constData(), dstExp.constData(),
+                                               alphaPrecision, colorPrecision),
+                                 description.toLatin1().data());
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<class Traits>
+KoCompositeOp* createGenericSCOp(const KoColorSpace *cs, const QString &id)
+{
+    typedef typename Traits::channels_type T;
+
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_MULT) {
+        op = new KoCompositeOpGenericSC<Traits, &cfMultiply<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_SCREEN) {
+        op = new KoCompositeOpGenericSC<Traits, &cfScreen<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_OVERLAY) {
+        op = new KoCompositeOpGenericSC<Traits, &cfOverlay<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_HARD_LIGHT) {
+        op = new KoCompositeOpGenericSC<Traits, &cfHardLight<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_SOFT_LIGHT_PHOTOSHOP) {
+        op = new KoCompositeOpGenericSC<Traits, &cfSoftLight<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_SOFT_LIGHT_SVG) {
+        op = new KoCompositeOpGenericSC<Traits, &cfSoftLightSvg<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_DODGE) {
+        op = new KoCompositeOpGenericSC<Traits, &cfColorDodge<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_BURN) {
+        op = new KoCompositeOpGenericSC<Traits, &cfColorBurn<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_DARKEN) {
+        op = new KoCompositeOpGenericSC<Traits, &cfDarkenOnly<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_LIGHTEN) {
+        op = new KoCompositeOpGenericSC<Traits, &cfLightenOnly<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_ADD) {
+        op = new KoCompositeOpGenericSC<Traits, &cfAddition<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_SUBTRACT) {
+        op = new KoCompositeOpGenericSC<Traits, &cfSubtract<T> >(cs, id, QString(), QString());
+    } else if (id == COMPOSITE_DIFF) {
+        op = new KoCompositeOpGenericSC<Traits, &cfDifference<T> >(cs, id, QString(), QString());
+    }
+
+    return op;
+}
+
+template<class Traits>
+KoCompositeOp* createComposite64Op(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = new KoCompositeOpOver<Traits>(cs);
+    } else if (id == "alphadarken-hard") {
+        op = new KoCompositeOpAlphaDarken<Traits, KoAlphaDarkenParamsWrapperHard>(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = new KoCompositeOpAlphaDarken<Traits, KoAlphaDarkenParamsWrapperCreamy>(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = new KoCompositeOpCopy2<Traits>(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = new KoCompositeOpErase<Traits>(cs);
+    }
+
+    return op;
+}
+
+KoCompositeOp* createOptimizedComposite64OpU16(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = KoOptimizedCompositeOpFactory::createOverOpU16(cs);
+    } else if (id == "alphadarken-hard") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpHardU16(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpCreamyU16(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = KoOptimizedCompositeOpFactory::createCopyOpU16(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = KoOptimizedCompositeOpFactory::createEraseOpU16(cs);
+    }
+
+    return op;
+}
+
+#ifdef HAVE_OPENEXR
+KoCompositeOp* createOptimizedComposite64OpF16(const KoColorSpace *cs, const QString &id)
+{
+    KoCompositeOp *op = 0;
+
+    if (id == COMPOSITE_OVER) {
+        op = KoOptimizedCompositeOpFactory::createOverOpF16(cs);
+    } else if (id == "alphadarken-hard") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpHardF16(cs);
+    } else if (id == "alphadarken-creamy") {
+        op = KoOptimizedCompositeOpFactory::createAlphaDarkenOpCreamyF16(cs);
+    } else if (id == COMPOSITE_COPY) {
+        op = KoOptimizedCompositeOpFactory::createCopyOpF16(cs);
+    } else if (id == COMPOSITE_ERASE) {
+        op = KoOptimizedCompositeOpFactory::createEraseOpF16(cs);
+    }
+
+    return op;
+}
+#endif
+
+}
+
+void TestKoOptimizedCompositeOps::testGenericSCOps_data()
+{
+    QTest::addColumn<QString>("depthID");
+    QTest::addColumn<QString>("compositeOpID");
+    QTest::addColumn<qreal>("alphaPrecision");
+    QTest::addColumn<qreal>("colorPrecision");
+
+    /**
+     * The vector ops keep the source alpha in float, while
+     * KoCompositeOpGenericSC first quantizes mul(srcAlpha, mask, opacity)
+     * into the channel type. In the color channels this difference is
+     * divided by the new alpha, so for almost transparent pixels it may
+     * be arbitrarily large. Therefore the colors are compared premultiplied,
+     * then only the rounding of the three terms of Arithmetic::blend()
+     * and of the result is left: up to 3 units for 8-bit and up to 5 units
+     * for 16-bit, which truncates in mul(). The alpha may differ by one
+     * unit only. Float ops differ in the order of operations only.
+     *
+     * Half a unit is added to the integer precisions to cover the error
+     * of the normalization of the channels.
+     */
+    struct Depth {
+        KoID id;
+        qreal alphaPrecision;
+        qreal colorPrecision;
+    };
+
+    const QVector<Depth> depths = {
+        { Integer8BitsColorDepthID, 1.5 / 255, 3.5 / 255 },
+        { Integer16BitsColorDepthID, 1.5 / 65535, 5.5 / 65535 },
+        { Float32BitsColorDepthID, 1e-5, 1e-5 }
+    };
+
+    const QStringList compositeOps = {
+        COMPOSITE_MULT,
+        COMPOSITE_SCREEN,
+        COMPOSITE_OVERLAY,
+        COMPOSITE_HARD_LIGHT,
+        COMPOSITE_SOFT_LIGHT_PHOTOSHOP,
+        COMPOSITE_SOFT_LIGHT_SVG,
+        COMPOSITE_DODGE,
+        COMPOSITE_BURN,
+        COMPOSITE_DARKEN,
+        COMPOSITE_LIGHTEN,
+        COMPOSITE_ADD,
+        COMPOSITE_SUBTRACT,
+        COMPOSITE_DIFF
+    };
+
+    Q_FOREACH (const Depth &depth, depths) {
+        Q_FOREACH (const QString &compositeOp, compositeOps) {
+            QTest::newRow(QString("%1-%2").arg(depth.id.id()).arg(compositeOp).toLatin1().data())
+                << depth.id.id() << compositeOp << depth.alphaPrecision << depth.colorPrecision;
+        }
+    }
+}
+
+void TestKoOptimizedCompositeOps::testGenericSCOps()
+{
+    QFETCH(QString, depthID);
+    QFETCH(QString, compositeOpID);
+    QFETCH(qreal, alphaPrecision);
+    QFETCH(qreal, colorPrecision);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(), depthID, 0);
+    QVERIFY(cs);
+
+    QScopedPointer<KoCompositeOp> opAct;
+    QScopedPointer<KoCompositeOp> opExp;
+
+    if (depthID == Integer8BitsColorDepthID.id()) {
+        opAct.reset(KoOptimizedCompositeOpFactory::createGenericSCOp32(cs, compositeOpID, QString(), QString()));
+        opExp.reset(createGenericSCOp<KoBgrU8Traits>(cs, compositeOpID));
+    } else if (depthID == Integer16BitsColorDepthID.id()) {
+        opAct.reset(KoOptimizedCompositeOpFactory::createGenericSCOp64(cs, compositeOpID, QString(), QString()));
+        opExp.reset(createGenericSCOp<KoBgrU16Traits>(cs, compositeOpID));
+    } else if (depthID == Float32BitsColorDepthID.id()) {
+        opAct.reset(KoOptimizedCompositeOpFactory::createGenericSCOp128(cs, compositeOpID, QString(), QString()));
+        opExp.reset(createGenericSCOp<KoRgbF32Traits>(cs, compositeOpID));
+    }
+
+    QVERIFY(opExp);
+
+    if (!opAct) {
+        QSKIP("The optimized composite ops are not available in this build");
+    }
+
+    compareOps(cs, opAct.data(), opExp.data(), alphaPrecision, colorPrecision);
+}
+
+void TestKoOptimizedCompositeOps::testComposite64Ops_data()
+{
+    QTest::addColumn<QString>("depthID");
+    QTest::addColumn<QString>("compositeOpID");
+    QTest::addColumn<qreal>("alphaPrecision");
+    QTest::addColumn<qreal>("colorPrecision");
+
+    /**
+     * The same reasoning as for the separable blend modes applies to
+     * 16-bit integer channels. The generic ops for half floats round
+     * every intermediate value to half, so the results may differ by
+     * a couple of units in the last place of half (about 5e-4 near
+     * unit value).
+     *
+     * The half float version is run without F16C as well, see
+     * KRITA_FORCE_VECTOR_IMPLEMENTATION in CMakeLists.txt.
+     */
+    struct Depth {
+        KoID id;
+        qreal alphaPrecision;
+        qreal colorPrecision;
+    };
+
+    QVector<Depth> depths = {
+        { Integer16BitsColorDepthID, 1.5 / 65535, 3.5 / 65535 }
+    };
+
+#ifdef HAVE_OPENEXR
+    depths << Depth { Float16BitsColorDepthID, 1e-3, 2e-3 };
+#endif
+
+    const QStringList compositeOps = {
+        COMPOSITE_OVER,
+        "alphadarken-hard",
+        "alphadarken-creamy",
+        COMPOSITE_COPY,
+        COMPOSITE_ERASE
+    };
+
+    Q_FOREACH (const Depth &depth, depths) {
+        Q_FOREACH (const QString &compositeOp, compositeOps) {
+            QTest::newRow(QString("%1-%2").arg(depth.id.id()).arg(compositeOp).toLatin1().data())
+                << depth.id.id() << compositeOp << depth.alphaPrecision << depth.colorPrecision;
+        }
+    }
+}
+
+void TestKoOptimizedCompositeOps::testComposite64Ops()
+{
+    QFETCH(QString, depthID);
+    QFETCH(QString, compositeOpID);
+    QFETCH(qreal, alphaPrecision);
+    QFETCH(qreal, colorPrecision);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(), depthID, 0);
+    QVERIFY(cs);
+
+    QScopedPointer<KoCompositeOp> opAct;
+    QScopedPointer<KoCompositeOp> opExp;
+
+    if (depthID == Integer16BitsColorDepthID.id()) {
+        opAct.reset(createOptimizedComposite64OpU16(cs, compositeOpID));
+        opExp.reset(createComposite64Op<KoBgrU16Traits>(cs, compositeOpID));
+    }
+#ifdef HAVE_OPENEXR
+    else if (depthID == Float16BitsColorDepthID.id()) {
+        opAct.reset(createOptimizedComposite64OpF16(cs, compositeOpID));
+        opExp.reset(createComposite64Op<KoRgbF16Traits>(cs, compositeOpID));
+    }
+#endif
+
+    QVERIFY(opAct);
+    QVERIFY(opExp);
+
+    compareOps(cs, opAct.data(), opExp.data(), alphaPrecision, colorPrecision);
+}
+
+QTEST_GUILESS_MAIN(TestKoOptimizedCompositeOps)
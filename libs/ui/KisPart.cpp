@@ -69,6 +69,7 @@
 #include "kis_image_animation_interface.h"
 #include "kis_time_range.h"
 #include "kis_idle_watcher.h"
+#include "tiles3/kis_tile_data_store.h"
 #include "kis_image.h"
 #include "KisOpenPane.h"
 
@@ -155,6 +156,10 @@ KisPart::KisPart()
     connect(&d->idleWatcher, SIGNAL(startedIdleMode()),
             &d->animationCachePopulator, SLOT(slotRequestRegeneration()));
 
+    // defragment the swap file while the user is not painting
+    connect(&d->idleWatcher, &KisIdleWatcher::startedIdleMode,
+            [] () { KisTileDataStore::instance()->requestSwapCompaction(); });
+
 
     d->animationCachePopulator.slotRequestRegeneration();
     KisBusyWaitBroker::instance()->setFeedbackCallback(&busyWaitWithFeedback);
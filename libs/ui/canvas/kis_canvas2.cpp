@@ -100,6 +100,7 @@
 
 #include "kis_algebra_2d.h"
 #include "kis_image_signal_router.h"
+#include "KisTraceRecorder.h"
 
 #include "KisSnapPixelStrategy.h"
 
@@ -156,6 +157,7 @@ public:
     KisSignalCompressor regionOfInterestUpdateCompressor;
     QRect regionOfInterest;
     qreal regionOfInterestMargin = 0.25;
+    KisImageWSP regionOfInterestImage;
 
     QRect renderingLimit;
     int isBatchUpdateActive = 0;
@@ -294,6 +296,12 @@ KisCanvas2::~KisCanvas2()
     if (m_d->animationPlayer->isPlaying()) {
         m_d->animationPlayer->forcedStopOnExit();
     }
+
+    KisImageSP roiImage = m_d->regionOfInterestImage;
+    if (roiImage) {
+        roiImage->removeRegionOfInterest(this);
+    }
+
     delete m_d;
 }
 
@@ -784,6 +792,8 @@ void KisCanvas2::startUpdateCanvasProjection(const QRect & rc)
 
 void KisCanvas2::updateCanvasProjection()
 {
+    KIS_TRACE_SPAN("canvas", "update canvas projection");
+
     auto tryIssueCanvasUpdates = [this](const QRect &vRect) {
         if (!m_d->isBatchUpdateActive) {
             // TODO: Implement info->dirtyViewportRect() for KisOpenGLCanvas2 to avoid updating whole canvas
@@ -972,6 +982,21 @@ void KisCanvas2::slotUpdateRegionOfInterest()
 
     m_d->regionOfInterest = proposedRoi & imageRect;
 
+    KisImageSP image = this->image();
+    KisImageSP roiImage = m_d->regionOfInterestImage;
+
+    if (m_d->regionOfInterest != oldRegionOfInterest || roiImage != image) {
+        // the canvas might have been switched to another image
+        if (roiImage && roiImage != image) {
+            roiImage->removeRegionOfInterest(this);
+        }
+
+        if (image) {
+            image->setRegionOfInterest(this, m_d->regionOfInterest);
+        }
+        m_d->regionOfInterestImage = image;
+    }
+
     if (m_d->regionOfInterest != oldRegionOfInterest) {
         emit sigRegionOfInterestChanged(m_d->regionOfInterest);
     }
@@ -18,8 +18,12 @@
 
 #include "kis_canvas_updates_compressor.h"
 
+#include "KisTraceRecorder.h"
+
 bool KisCanvasUpdatesCompressor::putUpdateInfo(KisUpdateInfoSP info)
 {
+    KIS_TRACE_SPAN("canvas", "compress canvas update");
+
     const int levelOfDetail = info->levelOfDetail();
     const QRect newUpdateRect = info->dirtyImageRect();
     if (newUpdateRect.isEmpty()) return false;
@@ -52,6 +56,8 @@ bool KisCanvasUpdatesCompressor::putUpdateInfo(KisUpdateInfoSP info)
 
 void KisCanvasUpdatesCompressor::takeUpdateInfo(KisUpdateInfoList &list)
 {
+    KIS_TRACE_SPAN("canvas", "take canvas updates");
+
     KIS_SAFE_ASSERT_RECOVER(list.isEmpty()) { list.clear(); }
 
     QMutexLocker l(&m_mutex);
@@ -46,7 +46,6 @@
 #include "kis_canvas_resource_provider.h"
 #include "dialogs/kis_dlg_filter.h"
 #include "strokes/kis_filter_stroke_strategy.h"
-#include "krita_utils.h"
 #include "kis_icon_utils.h"
 #include <KisGlobalResourcesInterface.h>
 
@@ -314,18 +313,12 @@ void KisFilterManager::apply(KisFilterConfigurationSP _filterConfig)
     QRect processRect = filter->changedRect(applyRect, filterConfig.data(), 0);
     processRect &= image->bounds();
 
-    if (filter->supportsThreading()) {
-        QSize size = KritaUtils::optimalPatchSize();
-        QVector<QRect> rects = KritaUtils::splitRectIntoPatches(processRect, size);
-
-        Q_FOREACH (const QRect &rc, rects) {
-            image->addJob(d->currentStrokeId,
-                          new KisFilterStrokeStrategy::Data(rc, true));
-        }
-    } else {
-        image->addJob(d->currentStrokeId,
-                      new KisFilterStrokeStrategy::Data(processRect, false));
-    }
+    /**
+     * The stroke splits the rect into patches itself if the filter
+     * supports threading
+     */
+    image->addJob(d->currentStrokeId,
+                  new KisFilterStrokeStrategy::Data(processRect, false));
 
     d->currentlyAppliedConfiguration = filterConfig;
 }
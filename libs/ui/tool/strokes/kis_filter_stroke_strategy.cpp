@@ -22,6 +22,10 @@
 #include <filter/kis_filter_configuration.h>
 #include <kis_transaction.h>
 #include <KoCompositeOpRegistry.h>
+#include <krita_utils.h>
+#include <KisRunnableStrokeJobData.h>
+#include <KisRunnableStrokeJobUtils.h>
+#include <KisRunnableStrokeJobsInterface.h>
 
 
 struct KisFilterStrokeStrategy::Private {
@@ -137,31 +141,49 @@ void KisFilterStrokeStrategy::doStrokeCallback(KisStrokeJobData *data)
         dynamic_cast<CancelSilentlyMarker*>(data);
 
     if (d) {
-        const QRect rc = d->processRect;
-
-        if (!m_d->filterDeviceBounds.intersects(
-                m_d->filter->neededRect(rc, m_d->filterConfig.data(), m_d->levelOfDetail))) {
-
-            return;
+        if (m_d->filter->supportsThreading()) {
+            using KritaUtils::splitRectIntoPatches;
+            using KritaUtils::optimalPatchSize;
+
+            QVector<KisRunnableStrokeJobData*> jobs;
+            KritaUtils::addJobsParallelFor(jobs,
+                                           splitRectIntoPatches(d->processRect, optimalPatchSize()),
+                                           runnableJobsInterface()->threadsLimit(),
+                                           [this] (const QRect &rc) {
+                filterRect(rc);
+            });
+
+            runnableJobsInterface()->addRunnableJobs(jobs);
+        } else {
+            filterRect(d->processRect);
         }
+    } else if (cancelJob) {
+        m_d->cancelSilently = true;
+    } else {
+        KisPainterBasedStrokeStrategy::doStrokeCallback(data);
+    }
+}
 
-        m_d->filter->processImpl(m_d->filterDevice, rc,
-                                 m_d->filterConfig.data(),
-                                 m_d->progressHelper->updater());
+void KisFilterStrokeStrategy::filterRect(const QRect &rc)
+{
+    if (!m_d->filterDeviceBounds.intersects(
+            m_d->filter->neededRect(rc, m_d->filterConfig.data(), m_d->levelOfDetail))) {
 
-        if (m_d->secondaryTransaction) {
-            KisPainter::copyAreaOptimized(rc.topLeft(), m_d->filterDevice, targetDevice(), rc, activeSelection());
+        return;
+    }
 
-            // Free memory
-            m_d->filterDevice->clear(rc);
-        }
+    m_d->filter->processImpl(m_d->filterDevice, rc,
+                             m_d->filterConfig.data(),
+                             m_d->progressHelper->updater());
 
-        m_d->node->setDirty(rc);
-    } else if (cancelJob) {
-        m_d->cancelSilently = true;
-    } else {
-        qFatal("KisFilterStrokeStrategy: job type is not known");
+    if (m_d->secondaryTransaction) {
+        KisPainter::copyAreaOptimized(rc.topLeft(), m_d->filterDevice, targetDevice(), rc, activeSelection());
+
+        // Free memory
+        m_d->filterDevice->clear(rc);
     }
+
+    m_d->node->setDirty(rc);
 }
 
 void KisFilterStrokeStrategy::cancelStrokeCallback()
@@ -76,6 +76,9 @@ public:
 
     KisStrokeStrategy* createLodClone(int levelOfDetail) override;
 
+private:
+    void filterRect(const QRect &rc);
+
 private:
     struct Private;
     Private* const m_d;
@@ -32,6 +32,7 @@
 #include "KisMaskedFreehandStrokePainter.h"
 #include "KisMaskingBrushRenderer.h"
 #include "KisRunnableStrokeJobData.h"
+#include "KisRunnableStrokeJobUtils.h"
 
 #include "kis_paintop_preset.h"
 #include "kis_paintop_settings.h"
@@ -130,13 +131,11 @@ QVector<KisRunnableStrokeJobData *> KisPainterBasedStrokeStrategy::doMaskingBrus
     QVector<KisRunnableStrokeJobData *> jobs;
     KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(m_maskingBrushRenderer, jobs);
 
-    Q_FOREACH (const QRect &rc, rects) {
-        jobs.append(new KisRunnableStrokeJobData(
-            [this, rc] () {
-                this->m_maskingBrushRenderer->updateProjection(rc);
-            },
-            KisStrokeJobData::CONCURRENT));
-    }
+    KisMaskingBrushRenderer *renderer = m_maskingBrushRenderer.data();
+    KritaUtils::addJobsParallelFor(jobs, rects, threadsLimit(),
+                                   [renderer] (const QRect &rc) {
+        renderer->updateProjection(rc);
+    });
 
     return jobs;
 }
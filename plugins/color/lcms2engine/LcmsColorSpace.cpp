@@ -26,7 +26,6 @@
 #include "QDebug"
 
 cmsHPROFILE KoLcmsDefaultTransformations::s_RGBProfile = 0;
-QMap< QString, QMap< LcmsColorProfileContainer *, KoLcmsDefaultTransformations * > > KoLcmsDefaultTransformations::s_transformations;
 
 // -- LcmsColorSpaceFactory --
 QList<KoColorConversionTransformationFactory *> LcmsColorSpaceFactory::colorConversionLinks() const
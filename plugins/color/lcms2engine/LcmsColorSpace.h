@@ -24,9 +24,8 @@
 
 #include <colorprofiles/LcmsColorProfileContainer.h>
 #include <KoColorSpaceAbstract.h>
-#include <QMutex>
-#include <QMutexLocker>
 
+#include "LcmsTransformCache.h"
 #include "kis_assert.h"
 
 
@@ -68,10 +67,7 @@ private:
 };
 
 struct KoLcmsDefaultTransformations {
-    cmsHTRANSFORM toRGB;
-    cmsHTRANSFORM fromRGB;
     static cmsHPROFILE s_RGBProfile;
-    static QMap< QString, QMap< LcmsColorProfileContainer *, KoLcmsDefaultTransformations * > > s_transformations;
 };
 
 /**
@@ -157,15 +153,8 @@ class LcmsColorSpace : public KoColorSpaceAbstract<_CSTraits>, public KoLcmsInfo
     };
 
     struct Private {
-        mutable quint8 *qcolordata; // A small buffer for conversion from and to qcolor.
-        KoLcmsDefaultTransformations *defaultTransformations;
-
-        mutable cmsHPROFILE   lastRGBProfile;  // Last used profile to transform to/from RGB
-        mutable cmsHTRANSFORM lastToRGB;       // Last used transform to transform to RGB
-        mutable cmsHTRANSFORM lastFromRGB;     // Last used transform to transform from RGB
         LcmsColorProfileContainer *profile;
         KoColorProfile *colorProfile;
-        QMutex mutex;
     };
 
 protected:
@@ -184,52 +173,21 @@ protected:
         d->profile = asLcmsProfile(p);
         Q_ASSERT(d->profile);
         d->colorProfile = p;
-        d->qcolordata = 0;
-        d->lastRGBProfile = 0;
-        d->lastToRGB = 0;
-        d->lastFromRGB = 0;
-        d->defaultTransformations = 0;
     }
 
     ~LcmsColorSpace() override
     {
         delete d->colorProfile;
-        delete[] d->qcolordata;
-        delete d->defaultTransformations;
         delete d;
     }
 
     void init()
     {
-        // Default pixel buffer for QColor conversion
-        d->qcolordata = new quint8[3];
-        Q_CHECK_PTR(d->qcolordata);
-
         KIS_ASSERT(d->profile);
 
         if (KoLcmsDefaultTransformations::s_RGBProfile == 0) {
             KoLcmsDefaultTransformations::s_RGBProfile = cmsCreate_sRGBProfile();
         }
-        d->defaultTransformations = KoLcmsDefaultTransformations::s_transformations[this->id()][ d->profile];
-        if (!d->defaultTransformations) {
-            d->defaultTransformations = new KoLcmsDefaultTransformations;
-            d->defaultTransformations->fromRGB = cmsCreateTransform(KoLcmsDefaultTransformations::s_RGBProfile,
-                                                 TYPE_BGR_8,
-                                                 d->profile->lcmsProfile(),
-                                                 this->colorSpaceType(),
-                                                 KoColorConversionTransformation::internalRenderingIntent(),
-                                                 KoColorConversionTransformation::internalConversionFlags());
-            KIS_SAFE_ASSERT_RECOVER_NOOP(d->defaultTransformations->fromRGB || !d->colorProfile->isSuitableForOutput());
-
-            d->defaultTransformations->toRGB = cmsCreateTransform(d->profile->lcmsProfile(),
-                                               this->colorSpaceType(),
-                                               KoLcmsDefaultTransformations::s_RGBProfile,
-                                               TYPE_BGR_8,
-                                               KoColorConversionTransformation::internalRenderingIntent(),
-                                               KoColorConversionTransformation::internalConversionFlags());
-            KIS_SAFE_ASSERT_RECOVER_NOOP(d->defaultTransformations->toRGB);
-            KoLcmsDefaultTransformations::s_transformations[ this->id()][ d->profile ] = d->defaultTransformations;
-        }
     }
 
 public:
@@ -250,56 +208,55 @@ public:
         return (p && p->asLcms()->colorSpaceSignature() == colorSpaceSignature());
     }
 
+    /**
+     * The conversions to and from QColor are usually requested for
+     * single pixels from many threads at once (color pickers, palettes,
+     * brush color sources), so the transformations are taken from the
+     * per-thread LcmsTransformCache instead of being shared under a lock.
+     */
     void fromQColor(const QColor &color, quint8 *dst, const KoColorProfile *koprofile = 0) const override
     {
-        QMutexLocker locker(&d->mutex);
-        d->qcolordata[2] = color.red();
-        d->qcolordata[1] = color.green();
-        d->qcolordata[0] = color.blue();
+        quint8 qcolordata[3];
+        qcolordata[2] = color.red();
+        qcolordata[1] = color.green();
+        qcolordata[0] = color.blue();
 
         LcmsColorProfileContainer *profile = asLcmsProfile(koprofile);
-        if (profile == 0) {
-            // Default sRGB
-            KIS_ASSERT(d->defaultTransformations && d->defaultTransformations->fromRGB);
+        cmsHPROFILE rgbProfile = profile ? profile->lcmsProfile() : KoLcmsDefaultTransformations::s_RGBProfile;
 
-            cmsDoTransform(d->defaultTransformations->fromRGB, d->qcolordata, dst, 1);
-        } else {
-            if (d->lastFromRGB == 0 || (d->lastFromRGB != 0 && d->lastRGBProfile != profile->lcmsProfile())) {
-                d->lastFromRGB = cmsCreateTransform(profile->lcmsProfile(),
-                                                    TYPE_BGR_8,
-                                                    d->profile->lcmsProfile(),
-                                                    this->colorSpaceType(),
-                                                    KoColorConversionTransformation::internalRenderingIntent(),
-                                                    KoColorConversionTransformation::internalConversionFlags());
-                d->lastRGBProfile = profile->lcmsProfile();
+        cmsHTRANSFORM transform =
+            LcmsTransformCache::transform(rgbProfile,
+                                          TYPE_BGR_8,
+                                          d->profile->lcmsProfile(),
+                                          this->colorSpaceType(),
+                                          KoColorConversionTransformation::internalRenderingIntent(),
+                                          KoColorConversionTransformation::internalConversionFlags());
+        KIS_SAFE_ASSERT_RECOVER_RETURN(transform);
 
-            }
-            KIS_ASSERT(d->lastFromRGB);
-            cmsDoTransform(d->lastFromRGB, d->qcolordata, dst, 1);
-        }
+        cmsDoTransform(transform, qcolordata, dst, 1);
 
         this->setOpacity(dst, (quint8)(color.alpha()), 1);
     }
 
     void toQColor(const quint8 *src, QColor *c, const KoColorProfile *koprofile = 0) const override
     {
-        QMutexLocker locker(&d->mutex);
+        quint8 qcolordata[3];
+
         LcmsColorProfileContainer *profile = asLcmsProfile(koprofile);
-        if (profile == 0) {
-            // Default sRGB transform
-            Q_ASSERT(d->defaultTransformations && d->defaultTransformations->toRGB);
-            cmsDoTransform(d->defaultTransformations->toRGB, const_cast <quint8 *>(src), d->qcolordata, 1);
-        } else {
-            if (d->lastToRGB == 0 || (d->lastToRGB != 0 && d->lastRGBProfile != profile->lcmsProfile())) {
-                d->lastToRGB = cmsCreateTransform(d->profile->lcmsProfile(), this->colorSpaceType(),
-                                                  profile->lcmsProfile(), TYPE_BGR_8,
-                                                  KoColorConversionTransformation::internalRenderingIntent(),
-                                                  KoColorConversionTransformation::internalConversionFlags());
-                d->lastRGBProfile = profile->lcmsProfile();
-            }
-            cmsDoTransform(d->lastToRGB, const_cast <quint8 *>(src), d->qcolordata, 1);
-        }
-        c->setRgb(d->qcolordata[2], d->qcolordata[1], d->qcolordata[0]);
+        cmsHPROFILE rgbProfile = profile ? profile->lcmsProfile() : KoLcmsDefaultTransformations::s_RGBProfile;
+
+        cmsHTRANSFORM transform =
+            LcmsTransformCache::transform(d->profile->lcmsProfile(),
+                                          this->colorSpaceType(),
+                                          rgbProfile,
+                                          TYPE_BGR_8,
+                                          KoColorConversionTransformation::internalRenderingIntent(),
+                                          KoColorConversionTransformation::internalConversionFlags());
+        KIS_SAFE_ASSERT_RECOVER_RETURN(transform);
+
+        cmsDoTransform(transform, const_cast <quint8 *>(src), qcolordata, 1);
+
+        c->setRgb(qcolordata[2], qcolordata[1], qcolordata[0]);
         c->setAlpha(this->opacityU8(src));
     }
 
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; see the file COPYING.LIB.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "LcmsTransformCache.h"
+
+#include <atomic>
+
+#include <QVector>
+#include <QThreadStorage>
+
+namespace {
+
+const int maxCachedTransforms = 16;
+
+struct CacheEntry {
+    cmsHPROFILE srcProfile;
+    cmsUInt32Number srcType;
+    cmsHPROFILE dstProfile;
+    cmsUInt32Number dstType;
+    cmsUInt32Number intent;
+    cmsUInt32Number flags;
+    cmsHTRANSFORM transform;
+};
+
+/**
+ * The entries are sorted from the most recently used to the least
+ * recently used one. The list is tiny, so the linear search is
+ * faster than any hashing.
+ */
+struct ThreadCache {
+    ~ThreadCache() {
+        clear();
+    }
+
+    void clear() {
+        Q_FOREACH (const CacheEntry &entry, entries) {
+            cmsDeleteTransform(entry.transform);
+        }
+        entries.clear();
+    }
+
+    QVector<CacheEntry> entries;
+    int generation = 0;
+};
+
+std::atomic<int> s_generation(0);
+QThreadStorage<ThreadCache*> s_threadCache;
+
+}
+
+cmsHTRANSFORM LcmsTransformCache::transform(cmsHPROFILE srcProfile, cmsUInt32Number srcType,
+                                            cmsHPROFILE dstProfile, cmsUInt32Number dstType,
+                                            cmsUInt32Number intent, cmsUInt32Number flags)
+{
+    ThreadCache *cache = s_threadCache.localData();
+    const int generation = s_generation.load(std::memory_order_acquire);
+
+    if (!cache) {
+        cache = new ThreadCache();
+        cache->generation = generation;
+        s_threadCache.setLocalData(cache);
+    } else if (cache->generation != generation) {
+        cache->clear();
+        cache->generation = generation;
+    }
+
+    QVector<CacheEntry> &entries = cache->entries;
+
+    for (int i = 0; i < entries.size(); i++) {
+        const CacheEntry &entry = entries[i];
+
+        if (entry.srcProfile == srcProfile && entry.srcType == srcType &&
+            entry.dstProfile == dstProfile && entry.dstType == dstType &&
+            entry.intent == intent && entry.flags == flags) {
+
+            if (i > 0) {
+                entries.move(i, 0);
+            }
+            return entries.first().transform;
+        }
+    }
+
+    cmsHTRANSFORM transform = cmsCreateTransform(srcProfile, srcType, dstProfile, dstType, intent, flags);
+    if (!transform) return 0;
+
+    if (entries.size() >= maxCachedTransforms) {
+        cmsDeleteTransform(entries.last().transform);
+        entries.removeLast();
+    }
+
+    CacheEntry entry = {srcProfile, srcType, dstProfile, dstType, intent, flags, transform};
+    entries.prepend(entry);
+
+    return transform;
+}
+
+void LcmsTransformCache::profileIsDestroyed(cmsHPROFILE profile)
+{
+    Q_UNUSED(profile);
+
+    /**
+     * We cannot access the caches of other threads, so just make
+     * all of them outdated. Profiles are destroyed very rarely.
+     */
+    s_generation.fetch_add(1, std::memory_order_release);
+}
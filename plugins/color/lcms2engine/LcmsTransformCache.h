@@ -0,0 +1,54 @@
+/*
+ *  Copyright (c) 2020 Krita Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; see the file COPYING.LIB.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef LCMSTRANSFORMCACHE_H
+#define LCMSTRANSFORMCACHE_H
+
+#include <lcms2.h>
+
+/**
+ * A per-thread cache of lcms transformations for conversion of
+ * single pixels (e.g. in fromQColor()/toQColor()).
+ *
+ * Every thread keeps its own small LRU list of transformations, so
+ * the lookup doesn't need any locks and a transformation is never
+ * used by two threads at the same time.
+ *
+ * The transformations are keyed by the profile handles, so when any
+ * lcms profile is closed, profileIsDestroyed() should be called. It
+ * invalidates the caches of all the threads (they are dropped lazily
+ * on the next lookup in each thread).
+ */
+class LcmsTransformCache
+{
+public:
+    /**
+     * Returns a transformation for the given parameters, creating it
+     * if necessary. The transformation is owned by the cache of the
+     * calling thread and must not be passed to other threads or
+     * stored anywhere. Returns null if lcms cannot create it.
+     */
+    static cmsHTRANSFORM transform(cmsHPROFILE srcProfile, cmsUInt32Number srcType,
+                                   cmsHPROFILE dstProfile, cmsUInt32Number dstType,
+                                   cmsUInt32Number intent, cmsUInt32Number flags);
+
+    static void profileIsDestroyed(cmsHPROFILE profile);
+};
+
+#endif // LCMSTRANSFORMCACHE_H
@@ -23,6 +23,7 @@
 */
 
 #include "LcmsColorProfileContainer.h"
+#include "LcmsTransformCache.h"
 
 #include <cfloat>
 #include <cmath>
@@ -113,6 +114,7 @@ IccColorProfile *LcmsColorProfileContainer::createFromLcmsProfile(const cmsHPROF
 
 LcmsColorProfileContainer::~LcmsColorProfileContainer()
 {
+    LcmsTransformCache::profileIsDestroyed(d->profile);
     cmsCloseProfile(d->profile);
     delete d;
 }
@@ -122,6 +124,7 @@ LcmsColorProfileContainer::~LcmsColorProfileContainer()
 bool LcmsColorProfileContainer::init()
 {
     if (d->profile) {
+        LcmsTransformCache::profileIsDestroyed(d->profile);
         cmsCloseProfile(d->profile);
     }
 